@@ -0,0 +1,202 @@
+/*
+  ==============================================================================
+
+    BiquadCascade.h
+
+  ==============================================================================
+*/
+
+#pragma once
+
+#include <JuceHeader.h>
+
+//==============================================================================
+/**
+    One biquad's coefficients, normalised so a0 is 1, and the usual responses
+    from Robert Bristow-Johnson's Audio EQ Cookbook. They're worked out in
+    double and only stored as float.
+*/
+struct BiquadCoefficients
+{
+    float b0 = 1.f, b1 = 0.f, b2 = 0.f, a1 = 0.f, a2 = 0.f;
+
+    static BiquadCoefficients lowPass(double sampleRate, double frequency, double q)
+    {
+        Prototype p(sampleRate, frequency, q);
+        return p.normalise((1.0 - p.cosine) / 2.0, 1.0 - p.cosine, (1.0 - p.cosine) / 2.0, 1.0 + p.alpha, -2.0 * p.cosine, 1.0 - p.alpha);
+    }
+
+    static BiquadCoefficients highPass(double sampleRate, double frequency, double q)
+    {
+        Prototype p(sampleRate, frequency, q);
+        return p.normalise((1.0 + p.cosine) / 2.0, -(1.0 + p.cosine), (1.0 + p.cosine) / 2.0, 1.0 + p.alpha, -2.0 * p.cosine, 1.0 - p.alpha);
+    }
+
+    static BiquadCoefficients allPass(double sampleRate, double frequency, double q)
+    {
+        Prototype p(sampleRate, frequency, q);
+        return p.normalise(1.0 - p.alpha, -2.0 * p.cosine, 1.0 + p.alpha, 1.0 + p.alpha, -2.0 * p.cosine, 1.0 - p.alpha);
+    }
+
+    static BiquadCoefficients peak(double sampleRate, double frequency, double q, double gainDecibels)
+    {
+        Prototype p(sampleRate, frequency, q);
+        auto A = std::pow(10.0, gainDecibels / 40.0);
+
+        return p.normalise(1.0 + p.alpha * A, -2.0 * p.cosine, 1.0 - p.alpha * A, 1.0 + p.alpha / A, -2.0 * p.cosine, 1.0 - p.alpha / A);
+    }
+
+    static BiquadCoefficients lowShelf(double sampleRate, double frequency, double q, double gainDecibels)
+    {
+        Prototype p(sampleRate, frequency, q);
+        auto A = std::pow(10.0, gainDecibels / 40.0);
+        auto k = 2.0 * std::sqrt(A) * p.alpha;
+
+        return p.normalise(A * ((A + 1.0) - (A - 1.0) * p.cosine + k),
+                            2.0 * A * ((A - 1.0) - (A + 1.0) * p.cosine),
+                            A * ((A + 1.0) - (A - 1.0) * p.cosine - k),
+                            (A + 1.0) + (A - 1.0) * p.cosine + k,
+                            -2.0 * ((A - 1.0) + (A + 1.0) * p.cosine),
+                            (A + 1.0) + (A - 1.0) * p.cosine - k);
+    }
+
+    static BiquadCoefficients highShelf(double sampleRate, double frequency, double q, double gainDecibels)
+    {
+        Prototype p(sampleRate, frequency, q);
+        auto A = std::pow(10.0, gainDecibels / 40.0);
+        auto k = 2.0 * std::sqrt(A) * p.alpha;
+
+        return p.normalise(A * ((A + 1.0) + (A - 1.0) * p.cosine + k),
+                            -2.0 * A * ((A - 1.0) + (A + 1.0) * p.cosine),
+                            A * ((A + 1.0) + (A - 1.0) * p.cosine - k),
+                            (A + 1.0) - (A - 1.0) * p.cosine + k,
+                            2.0 * ((A - 1.0) - (A + 1.0) * p.cosine),
+                            (A + 1.0) - (A - 1.0) * p.cosine - k);
+    }
+
+    // Passes nothing, for lanes with nothing in them
+    static BiquadCoefficients silence()     { return { 0.f, 0.f, 0.f, 0.f, 0.f }; }
+
+private:
+    struct Prototype
+    {
+        Prototype(double sampleRate, double frequency, double q)
+        {
+            // Kept below Nyquist, where the cookbook's filters fall apart
+            auto w0 = juce::MathConstants<double>::twoPi * juce::jlimit(1.0, 0.49 * sampleRate, frequency) / sampleRate;
+
+            cosine = std::cos(w0);
+            alpha = std::sin(w0) / (2.0 * q);
+        }
+
+        BiquadCoefficients normalise(double b0, double b1, double b2, double a0, double a1, double a2) const
+        {
+            return { (float)(b0 / a0), (float)(b1 / a0), (float)(b2 / a0), (float)(a1 / a0), (float)(a2 / a0) };
+        }
+
+        double cosine, alpha;
+    };
+};
+
+//==============================================================================
+/**
+    numStages biquads in series, in transposed direct form II, run on every lane
+    of a SIMD register at once.
+
+    Each lane has its own coefficients, so the lanes can be channels going
+    through the same filters (process()), or parallel sections of one signal
+    with different filters, like the multiband overdrive's bands
+    (processSample()). Setting coefficients is a handful of stores, the
+    filters' arithmetic is only done in the sample loop.
+
+    Every stage starts out passing its input straight through.
+*/
+template <int numStages>
+class BiquadCascade
+{
+public:
+    using Vec = juce::dsp::SIMDRegister<float>;
+
+    static constexpr int lanes = (int)Vec::SIMDNumElements;
+
+    BiquadCascade()
+    {
+        for (int stage = 0; stage < numStages; ++stage)
+            setCoefficients(stage, BiquadCoefficients());
+
+        reset();
+    }
+
+    void setCoefficients(int stage, int lane, const BiquadCoefficients& c) noexcept
+    {
+        jassert(stage >= 0 && stage < numStages && lane >= 0 && lane < lanes);
+
+        auto index = stage * lanes + lane;
+
+        b0[index] = c.b0;
+        b1[index] = c.b1;
+        b2[index] = c.b2;
+        a1[index] = c.a1;
+        a2[index] = c.a2;
+    }
+
+    // The same coefficients in every lane
+    void setCoefficients(int stage, const BiquadCoefficients& c) noexcept
+    {
+        for (int lane = 0; lane < lanes; ++lane)
+            setCoefficients(stage, lane, c);
+    }
+
+    void reset() noexcept
+    {
+        for (int stage = 0; stage < numStages; ++stage)
+            state1[stage] = state2[stage] = Vec::expand(0.f);
+    }
+
+    // One sample of every lane through all the stages
+    Vec processSample(Vec x) noexcept
+    {
+        for (int stage = 0; stage < numStages; ++stage)
+        {
+            auto offset = stage * lanes;
+
+            auto y = Vec::fromRawArray(b0 + offset) * x + state1[stage];
+            state1[stage] = Vec::fromRawArray(b1 + offset) * x - Vec::fromRawArray(a1 + offset) * y + state2[stage];
+            state2[stage] = Vec::fromRawArray(b2 + offset) * x - Vec::fromRawArray(a2 + offset) * y;
+            x = y;
+        }
+
+        return x;
+    }
+
+    // Up to lanes channels in place, one to a lane
+    void process(float* const* channels, int numChannels, int startSample, int numSamples) noexcept
+    {
+        jassert(numChannels <= lanes);
+
+        alignas(Vec::SIMDRegisterSize) float frame[lanes] = {};
+
+        for (int i = startSample; i < startSample + numSamples; ++i)
+        {
+            for (int channel = 0; channel < numChannels; ++channel)
+                frame[channel] = channels[channel][i];
+
+            processSample(Vec::fromRawArray(frame)).copyToRawArray(frame);
+
+            for (int channel = 0; channel < numChannels; ++channel)
+                channels[channel][i] = frame[channel];
+        }
+    }
+
+private:
+    // Stage by stage, a register's worth of lanes each
+    alignas(Vec::SIMDRegisterSize) float b0[numStages * lanes] = {};
+    alignas(Vec::SIMDRegisterSize) float b1[numStages * lanes] = {};
+    alignas(Vec::SIMDRegisterSize) float b2[numStages * lanes] = {};
+    alignas(Vec::SIMDRegisterSize) float a1[numStages * lanes] = {};
+    alignas(Vec::SIMDRegisterSize) float a2[numStages * lanes] = {};
+
+    Vec state1[numStages], state2[numStages];
+
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR(BiquadCascade)
+};
@@ -0,0 +1,188 @@
+/*
+  ==============================================================================
+
+    ChorusEnsemble.h
+
+  ==============================================================================
+*/
+
+#pragma once
+
+#include <JuceHeader.h>
+
+//==============================================================================
+/**
+    The chorus with more than one voice a side. Every voice reads the same
+    delay line as the single voice chorus, swept by an LFO at the same rate
+    but spread evenly around the cycle, and the voices are averaged.
+
+    Voices sit one to a SIMD lane, so a sample costs one pass over the
+    registers in use rather than one read per voice: the read positions are
+    worked out, wrapped, interpolated and summed a register at a time. Only
+    fetching the two samples either side of each position is done lane by
+    lane, as there's no gather. The LFOs are rotated a sample at a time from
+    sines and cosines set up at the start of each block, so there are no
+    sin() calls in the loop and nothing to drift.
+
+    The first voice's LFO is the single voice chorus's: the phase is passed
+    in and left where the sweep got to, like the write head, so going from
+    one voice to more and back carries on from where the sweep was.
+*/
+class ChorusEnsemble
+{
+public:
+    using Vec = juce::dsp::SIMDRegister<float>;
+
+    static constexpr int lanes = (int)Vec::SIMDNumElements;
+    static constexpr int maximumVoices = 8;
+    static constexpr int numRegisters = (maximumVoices + lanes - 1) / lanes;
+
+    struct Settings
+    {
+        int numVoices = 2;
+        float rate = 0.2f;                              // Hz
+        float depth = 0.2f;                             // How much of the sweep between the delays below
+        float offset = 0.f;                             // The right side's LFOs ahead of the left's, in cycles
+        float feedback = 0.3f;
+        float minimumDelay = 0.005f, maximumDelay = 0.03f;    // Seconds
+        float dryWet = 0.5f;
+    };
+
+    void prepare(double newSampleRate) noexcept
+    {
+        sampleRate = newSampleRate;
+        reset();
+    }
+
+    void reset() noexcept
+    {
+        feedback[0] = feedback[1] = 0.f;
+    }
+
+    /*
+    * The first one or two channels, each writing into and reading from its
+    * own line. The lines are shared with the single voice chorus, so they
+    * keep one write head, and one LFO phase in cycles, between them.
+    */
+    void process(float* const* channels, int numChannels, int numSamples,
+                  float* const* lines, int length, int& writeHead, float& lfoPhase, const Settings& settings) noexcept
+    {
+        auto numSides = juce::jmin(numChannels, 2);
+
+        if (numSides <= 0 || length <= 1)
+            return;
+
+        auto numVoices = juce::jlimit(1, maximumVoices, settings.numVoices);
+        auto numActiveRegisters = (numVoices + lanes - 1) / lanes;
+
+        // Averaged, so the voices can't build up past the feedback
+        alignas(Vec::SIMDRegisterSize) float weights[numRegisters * lanes] = {};
+
+        for (int v = 0; v < numVoices; ++v)
+            weights[v] = 1.f / (float)numVoices;
+
+        // The legacy mapping, depth scaling the LFO before it's spread over the delays
+        auto centre = Vec::expand((float)(0.5 * (settings.minimumDelay + settings.maximumDelay) * sampleRate));
+        auto swing = Vec::expand((float)(0.5 * (settings.maximumDelay - settings.minimumDelay) * sampleRate) * settings.depth);
+        auto wrap = Vec::expand((float)length);
+        auto zero = Vec::expand(0.f);
+
+        // One minus the cosine, as the cosine of an LFO's step is too close to one for a float
+        auto increment = juce::MathConstants<double>::twoPi * settings.rate / sampleRate;
+        auto stepVersine = Vec::expand((float)(2.0 * std::pow(std::sin(0.5 * increment), 2.0)));
+        auto stepSin = Vec::expand((float)std::sin(increment));
+
+        // Where every voice's LFO is at the start of the block, unused lanes sitting still in the middle
+        double phase = lfoPhase;
+
+        for (int side = 0; side < numSides; ++side)
+        {
+            for (int v = 0; v < numRegisters * lanes; ++v)
+            {
+                auto voicePhase = juce::MathConstants<double>::twoPi * (phase + side * settings.offset + (double)v / numVoices);
+
+                sines[side][v] = v < numVoices ? (float)std::sin(voicePhase) : 0.f;
+                cosines[side][v] = v < numVoices ? (float)std::cos(voicePhase) : 0.f;
+            }
+        }
+
+        auto dry = 1.f - settings.dryWet;
+        auto wet = settings.dryWet;
+
+        alignas(Vec::SIMDRegisterSize) float positions[lanes];
+        alignas(Vec::SIMDRegisterSize) float before[lanes];
+        alignas(Vec::SIMDRegisterSize) float after[lanes];
+        alignas(Vec::SIMDRegisterSize) float fractions[lanes];
+
+        for (int i = 0; i < numSamples; ++i)
+        {
+            auto head = Vec::expand((float)writeHead);
+
+            for (int side = 0; side < numSides; ++side)
+            {
+                auto* line = lines[side];
+                auto input = channels[side][i];
+
+                line[writeHead] = input + feedback[side];
+
+                auto sum = zero;
+
+                for (int r = 0; r < numActiveRegisters; ++r)
+                {
+                    auto* sinesHere = sines[side] + r * lanes;
+                    auto* cosinesHere = cosines[side] + r * lanes;
+
+                    auto sine = Vec::fromRawArray(sinesHere);
+                    auto cosine = Vec::fromRawArray(cosinesHere);
+
+                    // Behind the write head, wrapped into the line
+                    auto position = head - (centre + swing * sine);
+                    position += wrap & Vec::lessThan(position, zero);
+                    position.copyToRawArray(positions);
+
+                    for (int k = 0; k < lanes; ++k)
+                    {
+                        auto x = (int)positions[k];
+                        fractions[k] = positions[k] - (float)x;
+
+                        // Wrapping a tiny negative position can round up to exactly the line's length
+                        if (x >= length)
+                            x -= length;
+
+                        auto x1 = x + 1 < length ? x + 1 : 0;
+
+                        before[k] = line[x];
+                        after[k] = line[x1];
+                    }
+
+                    auto first = Vec::fromRawArray(before);
+                    auto read = first + Vec::fromRawArray(fractions) * (Vec::fromRawArray(after) - first);
+                    sum += read * Vec::fromRawArray(weights + r * lanes);
+
+                    // On to the next sample's LFOs
+                    (sine + (cosine * stepSin - sine * stepVersine)).copyToRawArray(sinesHere);
+                    (cosine - (cosine * stepVersine + sine * stepSin)).copyToRawArray(cosinesHere);
+                }
+
+                auto output = sum.sum();
+                feedback[side] = output * settings.feedback;
+                channels[side][i] = input * dry + output * wet;
+            }
+
+            if (++writeHead >= length)
+                writeHead = 0;
+        }
+
+        phase += numSamples * settings.rate / sampleRate;
+        lfoPhase = (float)(phase - std::floor(phase));
+    }
+
+private:
+    alignas(Vec::SIMDRegisterSize) float sines[2][numRegisters * lanes] = {};
+    alignas(Vec::SIMDRegisterSize) float cosines[2][numRegisters * lanes] = {};
+
+    double sampleRate = 44100.0;
+    float feedback[2] = {};
+
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR(ChorusEnsemble)
+};
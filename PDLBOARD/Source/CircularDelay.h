@@ -0,0 +1,42 @@
+/*
+  ==============================================================================
+
+    CircularDelay.h
+
+  ==============================================================================
+*/
+
+#pragma once
+
+#include <JuceHeader.h>
+
+/*
+* Reading a circular buffer at a fractional delay behind the write head, the way
+* the chorus always has: wrap the read head into the buffer, then interpolate
+* linearly between the two samples either side of it. The chorus and the FDN
+* reverb's modulated lines both read through here.
+*/
+namespace CircularDelay
+{
+    inline float read(const float* buffer, int length, int writeHead, float delayInSamples) noexcept
+    {
+        float readHead = writeHead - delayInSamples;
+
+        if (readHead < 0)
+            readHead += length;
+
+        int x = (int)readHead;
+        float fraction = readHead - x;
+
+        // Wrapping a tiny negative position can round up to exactly the buffer length
+        if (x >= length)
+            x -= length;
+
+        int x1 = x + 1;
+
+        if (x1 >= length)
+            x1 -= length;
+
+        return (1 - fraction) * buffer[x] + fraction * buffer[x1];
+    }
+}
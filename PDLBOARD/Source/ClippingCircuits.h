@@ -0,0 +1,146 @@
+/*
+  ==============================================================================
+
+    ClippingCircuits.h
+
+  ==============================================================================
+*/
+
+#pragma once
+
+#include <JuceHeader.h>
+#include "WaveDigitalFilter.h"
+
+/*
+* The overdrive's circuit modes, built out of WaveDigitalFilter.h. One instance
+* per channel. Samples are treated as volts, so a DI guitar at around -10 dBFS
+* hits the diodes about as hard as a real pickup does.
+*
+* Both clippers use 1N914 / 1N4148 silicon diodes: Is = 2.52 nA, n = 1.752.
+*/
+
+//==============================================================================
+/*
+* The classic diode clipper: a series resistor into a capacitor to ground with
+* two diodes across it. The RC sets how much top end reaches the diodes,
+* 2.2k and 10n put the corner at 7.2 kHz.
+*/
+class DiodeClipper
+{
+public:
+    void prepare(double sampleRate) noexcept   { diodes.prepare(sampleRate); reset(); }
+    void reset() noexcept                       { diodes.reset(); }
+
+    // The voltage across the diodes
+    float processSample(float input) noexcept
+    {
+        source.setVoltage(input);
+        diodes.process();
+        return diodes.voltage();
+    }
+
+private:
+    using Source = WDF::ResistiveVoltageSource<float>;
+    using Capacitor = WDF::Capacitor<float>;
+    using Tree = WDF::Parallel<Source, Capacitor>;
+
+    Source source { 2200.f };
+    Capacitor capacitor { 10.0e-9f };
+    Tree tree { source, capacitor };
+    WDF::DiodePair<Tree> diodes { tree, 2.52e-9f, 1.752f };
+};
+
+//==============================================================================
+/*
+* The Tube Screamer's clipping stage: a non-inverting op-amp with the diodes in
+* its feedback loop, after D. Yeh's analysis. With an ideal op-amp the
+* inverting input follows the input, so the current through the 4.7k and 47n
+* to ground depends on the input alone. That current is forced through the
+* feedback network, the drive pot plus 51k with 51p and the diodes across it,
+* and the output is the input plus the voltage that builds up across them.
+*
+* So it's two trees: one works out the current, the other is driven by it.
+* The 47n makes the gain fall away below 720 Hz, which is where the mid hump
+* comes from, and the 51p rounds off the top as the drive goes up.
+*/
+class TubeScreamerClipper
+{
+public:
+    void prepare(double sampleRate) noexcept
+    {
+        groundLegRoot.prepare(sampleRate);
+        diodes.prepare(sampleRate);
+        reset();
+    }
+
+    void reset() noexcept
+    {
+        groundLegRoot.reset();
+        diodes.reset();
+    }
+
+    // 0 to 1 round the 500k drive pot. It's audio taper, so roughly the square of where the knob is.
+    void setDrive(float drive) noexcept
+    {
+        feedbackSource.setResistance(51.0e3f + 500.0e3f * drive * drive);
+        diodes.updateImpedance();
+    }
+
+    float processSample(float input) noexcept
+    {
+        groundLegRoot.setVoltage(input);
+        groundLegRoot.process();
+
+        feedbackSource.setCurrent(groundLeg.current());
+        diodes.process();
+
+        return input + diodes.voltage();
+    }
+
+private:
+    using GroundLeg = WDF::Series<WDF::Resistor<float>, WDF::Capacitor<float>>;
+    using Feedback = WDF::Parallel<WDF::ResistiveCurrentSource<float>, WDF::Capacitor<float>>;
+
+    WDF::Resistor<float> groundResistor { 4700.f };
+    WDF::Capacitor<float> groundCapacitor { 47.0e-9f };
+    GroundLeg groundLeg { groundResistor, groundCapacitor };
+    WDF::IdealVoltageSource<GroundLeg> groundLegRoot { groundLeg };
+
+    WDF::ResistiveCurrentSource<float> feedbackSource { 51.0e3f };
+    WDF::Capacitor<float> feedbackCapacitor { 51.0e-12f };
+    Feedback feedback { feedbackSource, feedbackCapacitor };
+    WDF::DiodePair<Feedback> diodes { feedback, 2.52e-9f, 1.752f };
+};
+
+//==============================================================================
+/*
+* The Tube Screamer's tone section. The passive 1k and 220n low-pass, 723 Hz,
+* is modelled as it is. The active stage after it, where the tone pot sets how
+* much of the treble is put back, is reduced to mixing the part the low-pass
+* took out back in: none at 0, all of it at 0.5 (flat), and twice it at 1.
+*/
+class TubeScreamerTone
+{
+public:
+    void prepare(double sampleRate) noexcept   { root.prepare(sampleRate); reset(); }
+    void reset() noexcept                       { root.reset(); }
+
+    float processSample(float input, float tone) noexcept
+    {
+        source.setVoltage(input);
+        root.process();
+
+        auto lowPassed = root.voltage();
+        return lowPassed + 2.f * tone * (input - lowPassed);
+    }
+
+private:
+    using Source = WDF::ResistiveVoltageSource<float>;
+    using Capacitor = WDF::Capacitor<float>;
+    using Tree = WDF::Parallel<Source, Capacitor>;
+
+    Source source { 1000.f };
+    Capacitor capacitor { 220.0e-9f };
+    Tree tree { source, capacitor };
+    WDF::OpenCircuit<Tree> root { tree };
+};
@@ -0,0 +1,155 @@
+/*
+  ==============================================================================
+
+    EnvelopeFollower.h
+
+  ==============================================================================
+*/
+
+#pragma once
+
+#include <JuceHeader.h>
+
+//==============================================================================
+/**
+    The level of a signal, a block at a time: every channel rectified, the
+    loudest taken, then smoothed by a one-pole with separate attack and
+    release times.
+
+    The one-pole is run a register's worth of samples at once. Over a run of
+    lanes samples,
+
+        y[k] = a^(k+1) y[-1] + sum over j <= k of (1 - a) a^(k-j) x[j]
+
+    so a run's outputs are the previous output times a vector of powers, plus
+    each input times a column of a lower triangular matrix. Both are worked
+    out once in setTimes(), and a run costs lanes + 1 multiply-adds on whole
+    registers rather than lanes of them one after another. Attack or release
+    is chosen per run, by whether its loudest sample is above the envelope.
+*/
+class EnvelopeFollower
+{
+public:
+    using Vec = juce::dsp::SIMDRegister<float>;
+
+    static constexpr int lanes = (int)Vec::SIMDNumElements;
+
+    // Allocates, so not on the audio thread
+    void prepare(double newSampleRate, int maximumBlockSize)
+    {
+        sampleRate = newSampleRate;
+        envelope.assign((size_t)maximumBlockSize, 0.f);
+        scratch.assign((size_t)maximumBlockSize, 0.f);
+
+        setTimes(attackMs, releaseMs);
+        reset();
+    }
+
+    // Cheap enough for the audio thread, it's a few pow()s
+    void setTimes(float newAttackMs, float newReleaseMs) noexcept
+    {
+        attackMs = newAttackMs;
+        releaseMs = newReleaseMs;
+
+        attack.set(std::exp(-1.0 / (juce::jmax(0.01, (double)attackMs) * 0.001 * sampleRate)));
+        release.set(std::exp(-1.0 / (juce::jmax(0.01, (double)releaseMs) * 0.001 * sampleRate)));
+    }
+
+    void reset() noexcept
+    {
+        last = 0.f;
+    }
+
+    // Up to the prepared block size of every channel, leaving the envelope in getEnvelope()
+    void process(const float* const* channels, int numChannels, int numSamples) noexcept
+    {
+        jassert(numSamples <= (int)envelope.size());
+
+        auto* levels = envelope.data();
+
+        if (numChannels <= 0)
+        {
+            juce::FloatVectorOperations::clear(levels, numSamples);
+        }
+        else
+        {
+            juce::FloatVectorOperations::abs(levels, channels[0], numSamples);
+
+            for (int channel = 1; channel < numChannels; ++channel)
+            {
+                juce::FloatVectorOperations::abs(scratch.data(), channels[channel], numSamples);
+                juce::FloatVectorOperations::max(levels, levels, scratch.data(), numSamples);
+            }
+        }
+
+        alignas(Vec::SIMDRegisterSize) float run[lanes];
+        auto i = 0;
+
+        for (; i + lanes <= numSamples; i += lanes)
+        {
+            auto loudest = 0.f;
+
+            for (int k = 0; k < lanes; ++k)
+            {
+                run[k] = levels[i + k];
+                loudest = juce::jmax(loudest, run[k]);
+            }
+
+            auto& pole = loudest > last ? attack : release;
+            auto y = Vec::fromRawArray(pole.powers) * Vec::expand(last);
+
+            for (int j = 0; j < lanes; ++j)
+                y += Vec::fromRawArray(pole.columns[j]) * Vec::expand(run[j]);
+
+            y.copyToRawArray(run);
+
+            for (int k = 0; k < lanes; ++k)
+                levels[i + k] = run[k];
+
+            last = run[lanes - 1];
+        }
+
+        // What's left over, a sample at a time
+        for (; i < numSamples; ++i)
+        {
+            auto a = levels[i] > last ? attack.a : release.a;
+            last = levels[i] + a * (last - levels[i]);
+            levels[i] = last;
+        }
+    }
+
+    // The last block's envelope, a value for every sample
+    const float* getEnvelope() const noexcept      { return envelope.data(); }
+
+    // Where the envelope's got to
+    float getLastValue() const noexcept            { return last; }
+
+private:
+    struct Pole
+    {
+        void set(double coefficient) noexcept
+        {
+            a = (float)coefficient;
+
+            for (int k = 0; k < lanes; ++k)
+            {
+                powers[k] = (float)std::pow(coefficient, k + 1);
+
+                for (int j = 0; j < lanes; ++j)
+                    columns[j][k] = k >= j ? (float)((1.0 - coefficient) * std::pow(coefficient, k - j)) : 0.f;
+            }
+        }
+
+        alignas(Vec::SIMDRegisterSize) float powers[lanes] = {};
+        alignas(Vec::SIMDRegisterSize) float columns[lanes][lanes] = {};
+        float a = 0.f;
+    };
+
+    Pole attack, release;
+    std::vector<float> envelope, scratch;
+    double sampleRate = 44100.0;
+    float attackMs = 5.f, releaseMs = 150.f;
+    float last = 0.f;
+
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR(EnvelopeFollower)
+};
@@ -0,0 +1,255 @@
+/*
+  ==============================================================================
+
+    FeedbackDelayNetwork.h
+
+  ==============================================================================
+*/
+
+#pragma once
+
+#include <JuceHeader.h>
+#include "CircularDelay.h"
+
+//==============================================================================
+/**
+    Feedback delay network reverb with numLines modulated delay lines.
+
+    The lines are kept in SIMD registers, SIMDNumElements lines to a register.
+    The feedback matrix is a Hadamard matrix across the registers (butterflies,
+    adds and subtracts of whole registers) times a Householder reflection inside
+    each register (subtract half the register's sum from every lane). Both are
+    orthogonal, so with a gain of 1 the loop neither grows nor decays, which is
+    what freeze uses. Every line reaches every other one after two trips round.
+
+    Each line has its own decay gain for the wanted T60 and a one-pole low-pass
+    for damping. Its read position is modulated by a sine LFO, and the lines are
+    read with CircularDelay like the chorus.
+*/
+template <int numLines>
+class FeedbackDelayNetwork
+{
+public:
+    using Vec = juce::dsp::SIMDRegister<float>;
+
+    static constexpr int lanes = (int)Vec::SIMDNumElements;
+    static constexpr int numRegisters = numLines / lanes;
+
+    static_assert (numLines % lanes == 0 && (numRegisters & (numRegisters - 1)) == 0, "Lines must fill a power of two number of registers");
+
+    FeedbackDelayNetwork()
+    {
+        for (int line = 0; line < numLines; ++line)
+        {
+            times[line] = lineTimes[line];
+            leftTaps[line]  = line % 2 == 0 ? (line % 4 == 0 ? 1.f : -1.f) : 0.f;
+            rightTaps[line] = line % 2 == 1 ? (line % 4 == 1 ? 1.f : -1.f) : 0.f;
+        }
+    }
+
+    // Allocates the lines for the longest size they may be set to
+    void prepare(double newSampleRate, float maximumSize)
+    {
+        sampleRate = newSampleRate;
+
+        auto longest = *std::max_element(std::begin(times), std::end(times));
+        lineLength = (int)std::ceil((longest * maximumSize + maximumModulationTime) * sampleRate) + 4;
+        lines.assign((size_t)(numLines * lineLength), 0.f);
+
+        // Slightly different rates, so the lines don't all swing together
+        for (int line = 0; line < numLines; ++line)
+        {
+            auto rate = 0.5f + 0.7f * (float)line / (float)numLines;
+            auto angle = juce::MathConstants<double>::twoPi * rate / sampleRate;
+
+            lfoCos[line] = (float)std::cos(angle);
+            lfoSin[line] = (float)std::sin(angle);
+        }
+
+        size.reset(sampleRate, 0.3);
+        modulationDepth.reset(sampleRate, 0.3);
+        setParameters(size.getTargetValue(), 2.f, 0.5f, 0.f, false);
+        reset();
+    }
+
+    void reset()
+    {
+        std::fill(lines.begin(), lines.end(), 0.f);
+        writeHead = 0;
+
+        for (int r = 0; r < numRegisters; ++r)
+            damping[r] = Vec::expand(0.f);
+
+        // Start the LFOs spread round the circle
+        alignas(Vec::SIMDRegisterSize) float x[numLines], y[numLines];
+
+        for (int line = 0; line < numLines; ++line)
+        {
+            auto phase = juce::MathConstants<float>::twoPi * (float)line / (float)numLines;
+            x[line] = std::sin(phase);
+            y[line] = std::cos(phase);
+        }
+
+        for (int r = 0; r < numRegisters; ++r)
+        {
+            lfoX[r] = Vec::fromRawArray(x + r * lanes);
+            lfoY[r] = Vec::fromRawArray(y + r * lanes);
+        }
+
+        size.setCurrentAndTargetValue(size.getTargetValue());
+        modulationDepth.setCurrentAndTargetValue(modulationDepth.getTargetValue());
+    }
+
+    /*
+    * Once per block. size scales every line, decay is the T60 in seconds, damping
+    * goes from bright (0) to dark (1) and modulation from none to half a
+    * millisecond. Freezing holds whatever is in the lines and ignores the input.
+    */
+    void setParameters(float newSize, float decay, float newDamping, float modulation, bool shouldFreeze) noexcept
+    {
+        size.setTargetValue(newSize);
+        freeze = shouldFreeze;
+        modulationDepth.setTargetValue(freeze ? 0.f : (float)(modulation * maximumModulationTime * sampleRate));
+
+        auto cutoff = 18000.f * std::pow(1000.f / 18000.f, newDamping);
+        auto coefficient = freeze ? 1.f : 1.f - std::exp(-juce::MathConstants<float>::twoPi * juce::jmin(cutoff, (float)(0.45 * sampleRate)) / (float)sampleRate);
+
+        dampingCoefficient = Vec::expand(coefficient);
+
+        // -60 dB after decay seconds, for every line at its own length
+        alignas(Vec::SIMDRegisterSize) float gains[numLines];
+
+        for (int line = 0; line < numLines; ++line)
+            gains[line] = freeze ? 1.f : std::pow(0.001f, times[line] * size.getTargetValue() / juce::jmax(0.01f, decay));
+
+        for (int r = 0; r < numRegisters; ++r)
+            decayGain[r] = Vec::fromRawArray(gains + r * lanes);
+    }
+
+    // Wet signal only. The inputs may be the same channel.
+    void process(const float* inputLeft, const float* inputRight, float* outputLeft, float* outputRight, int numSamples) noexcept
+    {
+        alignas(Vec::SIMDRegisterSize) float delays[numLines];
+        alignas(Vec::SIMDRegisterSize) float samples[numLines];
+
+        auto inputGain = freeze ? 0.f : 1.f / std::sqrt((float)numLines / 2.f);
+        auto outputGain = 1.f / std::sqrt((float)numLines / 2.f);
+        auto mixGain = 1.f / std::sqrt((float)numRegisters);
+
+        for (int i = 0; i < numSamples; ++i)
+        {
+            Vec v[numRegisters];
+
+            // Delay times, LFO'd, then the reads themselves, which are scalar gathers
+            auto scale = size.getNextValue();
+            auto depth = modulationDepth.getNextValue();
+
+            for (int r = 0; r < numRegisters; ++r)
+            {
+                auto time = Vec::fromRawArray(times + r * lanes) * (float)(scale * sampleRate) + lfoX[r] * depth;
+                time.copyToRawArray(delays + r * lanes);
+
+                // Rotating (x, y) by a fixed angle is a sine LFO with no sin() call
+                auto x = lfoX[r] * Vec::fromRawArray(lfoCos + r * lanes) + lfoY[r] * Vec::fromRawArray(lfoSin + r * lanes);
+                lfoY[r] = lfoY[r] * Vec::fromRawArray(lfoCos + r * lanes) - lfoX[r] * Vec::fromRawArray(lfoSin + r * lanes);
+                lfoX[r] = x;
+            }
+
+            // Interpolating loses a little top end every trip round, a frozen loop has to be whole samples
+            if (freeze && depth == 0.f && ! size.isSmoothing())
+                for (int line = 0; line < numLines; ++line)
+                    delays[line] = std::round(delays[line]);
+
+            for (int line = 0; line < numLines; ++line)
+                samples[line] = CircularDelay::read(lines.data() + line * lineLength, lineLength, writeHead, juce::jmax(1.f, delays[line]));
+
+            // Decay and damping, then the outputs are tapped off with alternating signs
+            auto left = Vec::expand(0.f), right = Vec::expand(0.f);
+
+            for (int r = 0; r < numRegisters; ++r)
+            {
+                v[r] = Vec::fromRawArray(samples + r * lanes) * decayGain[r];
+                damping[r] += dampingCoefficient * (v[r] - damping[r]);
+                v[r] = damping[r];
+
+                left += v[r] * Vec::fromRawArray(leftTaps + r * lanes);
+                right += v[r] * Vec::fromRawArray(rightTaps + r * lanes);
+            }
+
+            outputLeft[i] = left.sum() * outputGain;
+            outputRight[i] = right.sum() * outputGain;
+
+            // Hadamard across the registers
+            for (int half = 1; half < numRegisters; half *= 2)
+            {
+                for (int start = 0; start < numRegisters; start += 2 * half)
+                {
+                    for (int r = start; r < start + half; ++r)
+                    {
+                        auto a = v[r];
+                        v[r] = a + v[r + half];
+                        v[r + half] = a - v[r + half];
+                    }
+                }
+            }
+
+            // Householder inside each register, and the new input in on the way back
+            auto inLeft = inputLeft[i] * inputGain;
+            auto inRight = inputRight[i] * inputGain;
+
+            for (int r = 0; r < numRegisters; ++r)
+            {
+                v[r] = v[r] * mixGain;
+                v[r] -= Vec::expand(v[r].sum() * (2.f / (float)lanes));
+                v[r] += Vec::fromRawArray(leftTaps + r * lanes) * inLeft + Vec::fromRawArray(rightTaps + r * lanes) * inRight;
+
+                v[r].copyToRawArray(samples + r * lanes);
+            }
+
+            for (int line = 0; line < numLines; ++line)
+                lines[(size_t)(line * lineLength + writeHead)] = samples[line];
+
+            if (++writeHead >= lineLength)
+                writeHead = 0;
+        }
+
+        // Keeps the LFO rotation from drifting off the unit circle
+        for (int r = 0; r < numRegisters; ++r)
+        {
+            auto correction = (Vec::expand(3.f) - (lfoX[r] * lfoX[r] + lfoY[r] * lfoY[r])) * 0.5f;
+            lfoX[r] *= correction;
+            lfoY[r] *= correction;
+        }
+    }
+
+private:
+    static constexpr float maximumModulationTime = 0.0005f;
+
+    // Line lengths in seconds at size 1, spread so no two share a common echo
+    static constexpr float lineTimes[16] =
+    {
+        0.0231f, 0.0293f, 0.0353f, 0.0417f, 0.0479f, 0.0557f, 0.0631f, 0.0713f,
+        0.0267f, 0.0319f, 0.0389f, 0.0443f, 0.0511f, 0.0593f, 0.0679f, 0.0771f,
+    };
+
+    double sampleRate = 44100.0;
+    std::vector<float> lines;
+    int lineLength = 0, writeHead = 0;
+
+    juce::SmoothedValue<float> size { 1.f };
+    juce::SmoothedValue<float> modulationDepth { 0.f };
+    bool freeze = false;
+
+    Vec decayGain[numRegisters], damping[numRegisters], dampingCoefficient;
+    Vec lfoX[numRegisters], lfoY[numRegisters];
+
+    alignas(Vec::SIMDRegisterSize) float times[numLines] = {};
+
+    // Left from the even lines and right from the odd ones, with the signs alternating
+    alignas(Vec::SIMDRegisterSize) float leftTaps[numLines]  = {};
+    alignas(Vec::SIMDRegisterSize) float rightTaps[numLines] = {};
+    alignas(Vec::SIMDRegisterSize) float lfoCos[numLines] = {};
+    alignas(Vec::SIMDRegisterSize) float lfoSin[numLines] = {};
+
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR(FeedbackDelayNetwork)
+};
@@ -9,6 +9,7 @@
 */
 
 #include "GuitarEffects.h"
+#include "RealtimeSafety.h"
 
 namespace IDs
 {
@@ -18,21 +19,100 @@ namespace IDs
     static juce::String blend_id{ "blend" };
     static juce::String range_id{ "range" };
     static juce::String volume_id{ "volume" };
+    static juce::String odMode_id{ "odmode" };
+    static juce::String odTone_id{ "odtone" };
     static juce::String onoff_id1{ "onoff1" };
 
+    // The multiband mode's split, and a drive, blend and volume for every band
+    static juce::String odBands_id{ "odbands" };
+    static juce::String crossover_ids[]{ "crossover1", "crossover2", "crossover3" };
+    static juce::String bandDrive_ids[]{ "banddrive1", "banddrive2", "banddrive3", "banddrive4" };
+    static juce::String bandBlend_ids[]{ "bandblend1", "bandblend2", "bandblend3", "bandblend4" };
+    static juce::String bandVolume_ids[]{ "bandvolume1", "bandvolume2", "bandvolume3", "bandvolume4" };
+
+    // The neural model's file lives in the state tree, like the user IRs
+    static juce::String ampModelFile_id{ "ampmodelfile" };
+
     static juce::String chorusDryWet_id{ "dry/wet1" };
     static juce::String chorusDepth_id{ "depth" };
     static juce::String chorusRate_id{ "rate" };
     static juce::String chorusOffset_id{ "offset" };
     static juce::String chorusFeedback_id{ "feedback1" };
     static juce::String chorusType_id{ "type" };
+    static juce::String chorusVoices_id{ "chorusvoices" };
     static juce::String onoff_id2{ "onoff2" };
 
     static juce::String delayDryWet_id{ "dry/wet2" };
     static juce::String delayFeedback_id{ "feedback2" };
     static juce::String delayTime_id{ "delaytime" };
+    static juce::String delayMode_id{ "delaymode" };
+    static juce::String delayTaps_id{ "delaytaps" };
+    static juce::String tapSpacing_id{ "tapspacing" };
+    static juce::String tapDecay_id{ "tapdecay" };
+    static juce::String tapSpread_id{ "tapspread" };
+    static juce::String tapTone_id{ "taptone" };
+    static juce::String crossFeedback_id{ "crossfeed" };
     static juce::String onoff_id3{ "onoff3" };
 
+    static juce::String cabType_id{ "cabinet" };
+    static juce::String cabDryWet_id{ "dry/wet3" };
+    static juce::String cabLevel_id{ "cablevel" };
+    static juce::String onoff_id4{ "onoff4" };
+
+    // Not a parameter, the user IR's path is kept as a property of the state tree
+    static juce::String cabFile_id{ "cabfile" };
+
+    static juce::String reverbType_id{ "reverb" };
+    static juce::String reverbDryWet_id{ "dry/wet4" };
+    static juce::String onoff_id5{ "onoff5" };
+
+    // Same as the cabinet's, the user IR's path lives in the state tree
+    static juce::String reverbFile_id{ "reverbfile" };
+
+    static juce::String fdnSize_id{ "fdnsize" };
+    static juce::String fdnDecay_id{ "fdndecay" };
+    static juce::String fdnDamping_id{ "fdndamping" };
+    static juce::String fdnModulation_id{ "fdnmod" };
+    static juce::String fdnLines_id{ "fdnlines" };
+    static juce::String fdnFreeze_id{ "fdnfreeze" };
+    static juce::String fdnDryWet_id{ "dry/wet5" };
+    static juce::String onoff_id6{ "onoff6" };
+
+    static juce::String eqLow_id{ "eqlow" };
+    static juce::String eqMidFrequency_id{ "eqmidfreq" };
+    static juce::String eqMidGain_id{ "eqmid" };
+    static juce::String eqMidQ_id{ "eqmidq" };
+    static juce::String eqHigh_id{ "eqhigh" };
+    static juce::String eqPosition_id{ "eqposition" };
+    static juce::String onoff_id7{ "onoff7" };
+
+    static juce::String gateThreshold_id{ "gatethreshold" };
+    static juce::String gateHold_id{ "gatehold" };
+    static juce::String gateRelease_id{ "gaterelease" };
+    static juce::String onoff_id8{ "onoff8" };
+
+    static juce::String tunerReference_id{ "tunerref" };
+    static juce::String tunerMute_id{ "tunermute" };
+    static juce::String onoff_id9{ "onoff9" };
+
+    static juce::String wahFrequency_id{ "wahfreq" };
+    static juce::String wahRange_id{ "wahrange" };
+    static juce::String wahResonance_id{ "wahq" };
+    static juce::String wahSensitivity_id{ "wahsens" };
+    static juce::String wahAttack_id{ "wahattack" };
+    static juce::String wahRelease_id{ "wahrelease" };
+    static juce::String dryWet_id6{ "dry/wet6" };
+    static juce::String onoff_id10{ "onoff10" };
+
+    // The pedal order, kept in the state tree like the file paths
+    static juce::String routing_id{ "routing" };
+
+    // MIDI controller mappings, saved with the session the same way
+    static juce::String midiMappings_id{ "midimap" };
+
+    // The modulation matrix's sources and routes, as text
+    static juce::String modulation_id{ "modulation" };
+
 }
 
 void GuitarEffectAudioProcessor::addODParameters(juce::AudioProcessorValueTreeState::ParameterLayout& layout)
@@ -41,6 +121,8 @@ void GuitarEffectAudioProcessor::addODParameters(juce::AudioProcessorValueTreeSt
     auto range = std::make_unique<juce::AudioParameterFloat>(IDs::range_id, "Range", juce::NormalisableRange<float>(0.f, 300.f, 0.01f), 100.f);
     auto blend = std::make_unique<juce::AudioParameterFloat>(IDs::blend_id, "Blend", juce::NormalisableRange<float>(0.f, 1.f, 0.01f), 0.5f);
     auto volume = std::make_unique<juce::AudioParameterFloat>(IDs::volume_id, "Volume", juce::NormalisableRange<float>(0.f, 3.f, 0.01f), 0.5f);
+    auto mode = std::make_unique<juce::AudioParameterChoice>(IDs::odMode_id, "Mode", juce::StringArray("Atan", "Neural Model", "Diode Clipper", "Tube Screamer", "Tube Preamp", "Multiband"), 0);
+    auto tone = std::make_unique<juce::AudioParameterFloat>(IDs::odTone_id, "Tone", juce::NormalisableRange<float>(0.f, 1.f, 0.01f), 0.5f);
     auto onoff = std::make_unique<juce::AudioParameterBool>(IDs::onoff_id1, "On / Off", false);
 
     auto group = std::make_unique<juce::AudioProcessorParameterGroup>("distortion", "Distortion", "|",
@@ -48,7 +130,28 @@ void GuitarEffectAudioProcessor::addODParameters(juce::AudioProcessorValueTreeSt
                                                                         std::move(range),
                                                                         std::move(blend),
                                                                         std::move(volume),
+                                                                        std::move(mode),
+                                                                        std::move(tone),
                                                                         std::move(onoff));
+
+    // Multiband mode. The crossovers' ranges overlap, they're sorted before use.
+    group->addChild(std::make_unique<juce::AudioParameterChoice>(IDs::odBands_id, "Bands", juce::StringArray("2 Bands", "3 Bands", "4 Bands"), 1));
+
+    const float crossoverDefaults[] = { 200.f, 800.f, 2500.f };
+
+    for (int crossover = 0; crossover < 3; ++crossover)
+        group->addChild(std::make_unique<juce::AudioParameterFloat>(IDs::crossover_ids[crossover], "Crossover " + juce::String(crossover + 1),
+                                                                    juce::NormalisableRange<float>(40.f, 10000.f, 1.f, 0.3f), crossoverDefaults[crossover]));
+
+    for (int band = 0; band < 4; ++band)
+    {
+        auto name = "Band " + juce::String(band + 1) + " ";
+
+        group->addChild(std::make_unique<juce::AudioParameterFloat>(IDs::bandDrive_ids[band], name + "Overdrive", juce::NormalisableRange<float>(0.f, 1.f, 0.01f), 0.5f));
+        group->addChild(std::make_unique<juce::AudioParameterFloat>(IDs::bandBlend_ids[band], name + "Blend", juce::NormalisableRange<float>(0.f, 1.f, 0.01f), 0.5f));
+        group->addChild(std::make_unique<juce::AudioParameterFloat>(IDs::bandVolume_ids[band], name + "Volume", juce::NormalisableRange<float>(0.f, 3.f, 0.01f), 0.5f));
+    }
+
     layout.add(std::move(group));
 }
 
@@ -61,6 +164,7 @@ void GuitarEffectAudioProcessor::addChorusParameters(juce::AudioProcessorValueTr
     auto chorusOffset = std::make_unique<juce::AudioParameterFloat>(IDs::chorusOffset_id, "Phase Offset", juce::NormalisableRange<float>(0.f, 1.f, 0.01f), 0.f);
     auto chorusFeedback = std::make_unique<juce::AudioParameterFloat>(IDs::chorusFeedback_id, "Feedback", juce::NormalisableRange<float>(0.f, 0.98f, 0.01f), 0.3f);
     auto chorusType = std::make_unique<juce::AudioParameterChoice>(IDs::chorusType_id, "Type", juce::StringArray("Chorus", "Flanger"), 0);
+    auto chorusVoices = std::make_unique<juce::AudioParameterInt>(IDs::chorusVoices_id, "Voices", 1, 8, 1);
     auto onoff = std::make_unique<juce::AudioParameterBool>(IDs::onoff_id2, "On / Off", false);
 
     auto group = std::make_unique<juce::AudioProcessorParameterGroup>("chorus", "Chorus", "|",
@@ -70,6 +174,7 @@ void GuitarEffectAudioProcessor::addChorusParameters(juce::AudioProcessorValueTr
                                                                         std::move(chorusOffset),
                                                                         std::move(chorusFeedback),
                                                                         std::move(chorusType),
+                                                                        std::move(chorusVoices),
                                                                         std::move(onoff));
     layout.add(std::move(group));
 
@@ -80,12 +185,149 @@ void GuitarEffectAudioProcessor::addDelayParameters(juce::AudioProcessorValueTre
     auto delayDryWet = std::make_unique<juce::AudioParameterFloat>(IDs::delayDryWet_id, "Dry / Wet", juce::NormalisableRange<float>(0.f, 1.f, 0.01f), 0.5f);
     auto delayFeedback = std::make_unique<juce::AudioParameterFloat>(IDs::delayFeedback_id, "Feedback", juce::NormalisableRange<float>(0.f, 0.98f, 0.01f), 0.3f);
     auto delayTime = std::make_unique<juce::AudioParameterFloat>(IDs::delayTime_id, "Delay", juce::NormalisableRange<float>(0.f, MAX_DELAY_TIME, 0.01f), 0.3f);
+    auto delayMode = std::make_unique<juce::AudioParameterChoice>(IDs::delayMode_id, "Mode", juce::StringArray("Single", "Multi-Tap", "Ping-Pong"), 0);
+    auto delayTaps = std::make_unique<juce::AudioParameterInt>(IDs::delayTaps_id, "Taps", 1, MultiTapDelay::maximumTaps, 4);
+    auto tapSpacing = std::make_unique<juce::AudioParameterChoice>(IDs::tapSpacing_id, "Spacing", juce::StringArray("Even", "Swing", "Speeding Up", "Slowing Down"), 0);
+    auto tapDecay = std::make_unique<juce::AudioParameterFloat>(IDs::tapDecay_id, "Tap Decay", juce::NormalisableRange<float>(0.f, 1.f, 0.01f), 0.7f);
+    auto tapSpread = std::make_unique<juce::AudioParameterFloat>(IDs::tapSpread_id, "Spread", juce::NormalisableRange<float>(0.f, 1.f, 0.01f), 0.5f);
+    auto tapTone = std::make_unique<juce::AudioParameterFloat>(IDs::tapTone_id, "Tone", juce::NormalisableRange<float>(500.f, 20000.f, 1.f, 0.3f), 8000.f);
+    auto crossFeedback = std::make_unique<juce::AudioParameterFloat>(IDs::crossFeedback_id, "Cross Feedback", juce::NormalisableRange<float>(0.f, 1.f, 0.01f), 0.f);
     auto onoff = std::make_unique<juce::AudioParameterBool>(IDs::onoff_id3, "On / Off", false);
 
     auto group = std::make_unique<juce::AudioProcessorParameterGroup>("delay", "Delay", "|",
                                                                         std::move(delayDryWet),
                                                                         std::move(delayFeedback),
                                                                         std::move(delayTime),
+                                                                        std::move(delayMode),
+                                                                        std::move(delayTaps),
+                                                                        std::move(tapSpacing),
+                                                                        std::move(tapDecay),
+                                                                        std::move(tapSpread),
+                                                                        std::move(tapTone),
+                                                                        std::move(crossFeedback),
+                                                                        std::move(onoff));
+    layout.add(std::move(group));
+}
+
+void GuitarEffectAudioProcessor::addCabParameters(juce::AudioProcessorValueTreeState::ParameterLayout& layout)
+{
+    auto cabType = std::make_unique<juce::AudioParameterChoice>(IDs::cabType_id, "Cabinet", juce::StringArray("1x12 Open", "2x12 Combo", "4x12 Closed", "User IR"), 1);
+    auto cabDryWet = std::make_unique<juce::AudioParameterFloat>(IDs::cabDryWet_id, "Dry / Wet", juce::NormalisableRange<float>(0.f, 1.f, 0.01f), 1.f);
+    auto cabLevel = std::make_unique<juce::AudioParameterFloat>(IDs::cabLevel_id, "Level", juce::NormalisableRange<float>(-24.f, 12.f, 0.1f), 0.f);
+    auto onoff = std::make_unique<juce::AudioParameterBool>(IDs::onoff_id4, "On / Off", false);
+
+    auto group = std::make_unique<juce::AudioProcessorParameterGroup>("cabinet", "Cabinet", "|",
+                                                                        std::move(cabType),
+                                                                        std::move(cabDryWet),
+                                                                        std::move(cabLevel),
+                                                                        std::move(onoff));
+    layout.add(std::move(group));
+}
+
+void GuitarEffectAudioProcessor::addReverbParameters(juce::AudioProcessorValueTreeState::ParameterLayout& layout)
+{
+    auto reverbType = std::make_unique<juce::AudioParameterChoice>(IDs::reverbType_id, "Reverb", juce::StringArray("Room", "Plate", "Hall", "User IR"), 0);
+    auto reverbDryWet = std::make_unique<juce::AudioParameterFloat>(IDs::reverbDryWet_id, "Dry / Wet", juce::NormalisableRange<float>(0.f, 1.f, 0.01f), 0.25f);
+    auto onoff = std::make_unique<juce::AudioParameterBool>(IDs::onoff_id5, "On / Off", false);
+
+    auto group = std::make_unique<juce::AudioProcessorParameterGroup>("reverb", "Reverb", "|",
+                                                                        std::move(reverbType),
+                                                                        std::move(reverbDryWet),
+                                                                        std::move(onoff));
+    layout.add(std::move(group));
+}
+
+void GuitarEffectAudioProcessor::addFDNReverbParameters(juce::AudioProcessorValueTreeState::ParameterLayout& layout)
+{
+    auto size = std::make_unique<juce::AudioParameterFloat>(IDs::fdnSize_id, "Size", juce::NormalisableRange<float>(0.f, 1.f, 0.01f), 0.5f);
+    auto decay = std::make_unique<juce::AudioParameterFloat>(IDs::fdnDecay_id, "Decay", juce::NormalisableRange<float>(0.2f, 20.f, 0.01f, 0.4f), 2.5f);
+    auto damping = std::make_unique<juce::AudioParameterFloat>(IDs::fdnDamping_id, "Damping", juce::NormalisableRange<float>(0.f, 1.f, 0.01f), 0.4f);
+    auto modulation = std::make_unique<juce::AudioParameterFloat>(IDs::fdnModulation_id, "Modulation", juce::NormalisableRange<float>(0.f, 1.f, 0.01f), 0.3f);
+    auto lines = std::make_unique<juce::AudioParameterChoice>(IDs::fdnLines_id, "Density", juce::StringArray("8 Lines", "16 Lines"), 1);
+    auto freeze = std::make_unique<juce::AudioParameterBool>(IDs::fdnFreeze_id, "Freeze", false);
+    auto fdnDryWet = std::make_unique<juce::AudioParameterFloat>(IDs::fdnDryWet_id, "Dry / Wet", juce::NormalisableRange<float>(0.f, 1.f, 0.01f), 0.3f);
+    auto onoff = std::make_unique<juce::AudioParameterBool>(IDs::onoff_id6, "On / Off", false);
+
+    auto group = std::make_unique<juce::AudioProcessorParameterGroup>("fdnreverb", "FDN Reverb", "|",
+                                                                        std::move(size),
+                                                                        std::move(decay),
+                                                                        std::move(damping),
+                                                                        std::move(modulation),
+                                                                        std::move(lines),
+                                                                        std::move(freeze),
+                                                                        std::move(fdnDryWet),
+                                                                        std::move(onoff));
+    layout.add(std::move(group));
+}
+
+void GuitarEffectAudioProcessor::addEQParameters(juce::AudioProcessorValueTreeState::ParameterLayout& layout)
+{
+    auto low = std::make_unique<juce::AudioParameterFloat>(IDs::eqLow_id, "Low", juce::NormalisableRange<float>(-12.f, 12.f, 0.1f), 0.f);
+    auto midFrequency = std::make_unique<juce::AudioParameterFloat>(IDs::eqMidFrequency_id, "Mid Frequency", juce::NormalisableRange<float>(200.f, 5000.f, 1.f, 0.4f), 800.f);
+    auto midGain = std::make_unique<juce::AudioParameterFloat>(IDs::eqMidGain_id, "Mid", juce::NormalisableRange<float>(-12.f, 12.f, 0.1f), 0.f);
+    auto midQ = std::make_unique<juce::AudioParameterFloat>(IDs::eqMidQ_id, "Mid Q", juce::NormalisableRange<float>(0.3f, 5.f, 0.01f, 0.5f), 0.7f);
+    auto high = std::make_unique<juce::AudioParameterFloat>(IDs::eqHigh_id, "High", juce::NormalisableRange<float>(-12.f, 12.f, 0.1f), 0.f);
+    auto position = std::make_unique<juce::AudioParameterChoice>(IDs::eqPosition_id, "Position", juce::StringArray("Pre Overdrive", "Post Overdrive"), 1);
+    auto onoff = std::make_unique<juce::AudioParameterBool>(IDs::onoff_id7, "On / Off", false);
+
+    auto group = std::make_unique<juce::AudioProcessorParameterGroup>("eq", "EQ", "|",
+                                                                        std::move(low),
+                                                                        std::move(midFrequency),
+                                                                        std::move(midGain),
+                                                                        std::move(midQ),
+                                                                        std::move(high),
+                                                                        std::move(position),
+                                                                        std::move(onoff));
+    layout.add(std::move(group));
+}
+
+void GuitarEffectAudioProcessor::addGateParameters(juce::AudioProcessorValueTreeState::ParameterLayout& layout)
+{
+    auto threshold = std::make_unique<juce::AudioParameterFloat>(IDs::gateThreshold_id, "Threshold", juce::NormalisableRange<float>(-90.f, -10.f, 0.1f), -60.f);
+    auto hold = std::make_unique<juce::AudioParameterFloat>(IDs::gateHold_id, "Hold", juce::NormalisableRange<float>(0.f, 500.f, 1.f, 0.5f), 50.f);
+    auto release = std::make_unique<juce::AudioParameterFloat>(IDs::gateRelease_id, "Release", juce::NormalisableRange<float>(5.f, 1000.f, 1.f, 0.4f), 100.f);
+    auto onoff = std::make_unique<juce::AudioParameterBool>(IDs::onoff_id8, "On / Off", false);
+
+    auto group = std::make_unique<juce::AudioProcessorParameterGroup>("gate", "Noise Gate", "|",
+                                                                        std::move(threshold),
+                                                                        std::move(hold),
+                                                                        std::move(release),
+                                                                        std::move(onoff));
+    layout.add(std::move(group));
+}
+
+void GuitarEffectAudioProcessor::addTunerParameters(juce::AudioProcessorValueTreeState::ParameterLayout& layout)
+{
+    auto reference = std::make_unique<juce::AudioParameterFloat>(IDs::tunerReference_id, "A4", juce::NormalisableRange<float>(430.f, 450.f, 0.1f), 440.f);
+    auto mute = std::make_unique<juce::AudioParameterBool>(IDs::tunerMute_id, "Mute", true);
+    auto onoff = std::make_unique<juce::AudioParameterBool>(IDs::onoff_id9, "On / Off", false);
+
+    auto group = std::make_unique<juce::AudioProcessorParameterGroup>("tuner", "Tuner", "|",
+                                                                        std::move(reference),
+                                                                        std::move(mute),
+                                                                        std::move(onoff));
+    layout.add(std::move(group));
+}
+
+void GuitarEffectAudioProcessor::addAutoWahParameters(juce::AudioProcessorValueTreeState::ParameterLayout& layout)
+{
+    auto frequency = std::make_unique<juce::AudioParameterFloat>(IDs::wahFrequency_id, "Frequency", juce::NormalisableRange<float>(100.f, 1500.f, 1.f, 0.4f), 350.f);
+    auto range = std::make_unique<juce::AudioParameterFloat>(IDs::wahRange_id, "Range", juce::NormalisableRange<float>(0.f, 5.f, 0.01f), 3.f);
+    auto resonance = std::make_unique<juce::AudioParameterFloat>(IDs::wahResonance_id, "Resonance", juce::NormalisableRange<float>(0.5f, 10.f, 0.01f, 0.5f), 4.f);
+    auto sensitivity = std::make_unique<juce::AudioParameterFloat>(IDs::wahSensitivity_id, "Sensitivity", juce::NormalisableRange<float>(-12.f, 36.f, 0.1f), 12.f);
+    auto attack = std::make_unique<juce::AudioParameterFloat>(IDs::wahAttack_id, "Attack", juce::NormalisableRange<float>(0.5f, 100.f, 0.1f, 0.5f), 5.f);
+    auto release = std::make_unique<juce::AudioParameterFloat>(IDs::wahRelease_id, "Release", juce::NormalisableRange<float>(10.f, 1000.f, 1.f, 0.4f), 150.f);
+    auto dryWet = std::make_unique<juce::AudioParameterFloat>(IDs::dryWet_id6, "Dry/Wet", 0.f, 1.f, 1.f);
+    auto onoff = std::make_unique<juce::AudioParameterBool>(IDs::onoff_id10, "On / Off", false);
+
+    auto group = std::make_unique<juce::AudioProcessorParameterGroup>("autowah", "Auto-Wah", "|",
+                                                                        std::move(frequency),
+                                                                        std::move(range),
+                                                                        std::move(resonance),
+                                                                        std::move(sensitivity),
+                                                                        std::move(attack),
+                                                                        std::move(release),
+                                                                        std::move(dryWet),
                                                                         std::move(onoff));
     layout.add(std::move(group));
 }
@@ -119,6 +361,8 @@ GuitarEffectAudioProcessor::Chorus::Chorus (juce::AudioProcessorValueTreeState&
     jassert(mChorusFeedbackParameter);
     mChorusTypeParameter = dynamic_cast<juce::AudioParameterChoice*>(state.getParameter(IDs::chorusType_id));
     jassert(mChorusTypeParameter);
+    mChorusVoicesParameter = dynamic_cast<juce::AudioParameterInt*>(state.getParameter(IDs::chorusVoices_id));
+    jassert(mChorusVoicesParameter);
 }
 
 GuitarEffectAudioProcessor::Delay::Delay (juce::AudioProcessorValueTreeState& stateToUse) : state(stateToUse)
@@ -130,3 +374,2926 @@ GuitarEffectAudioProcessor::Delay::Delay (juce::AudioProcessorValueTreeState& st
     mDelayTimeParameter = dynamic_cast<juce::AudioParameterFloat*>(state.getParameter(IDs::delayTime_id));
     jassert(mDelayTimeParameter);
 }
+
+//==============================================================================
+class GuitarEffectAudioProcessor::AmpModel::Loader : public juce::Thread
+{
+public:
+    Loader(AmpModel& ampModelToUse) : juce::Thread("Amp model loader"), ampModel(ampModelToUse) {}
+
+    void run() override
+    {
+        // Woken up for new files, the timeout is for deleting retired engines
+        while (! threadShouldExit())
+        {
+            ampModel.runLoader();
+            wait(50);
+        }
+    }
+
+private:
+    AmpModel& ampModel;
+};
+
+GuitarEffectAudioProcessor::AmpModel::AmpModel (juce::AudioProcessorValueTreeState& stateToUse) : state(stateToUse)
+{
+    mModeParameter = dynamic_cast<juce::AudioParameterChoice*>(state.getParameter(IDs::odMode_id));
+    jassert(mModeParameter);
+    mDriveParameter = dynamic_cast<juce::AudioParameterFloat*>(state.getParameter(IDs::overdrive_id));
+    jassert(mDriveParameter);
+    mBlendParameter = dynamic_cast<juce::AudioParameterFloat*>(state.getParameter(IDs::blend_id));
+    jassert(mBlendParameter);
+    mVolumeParameter = dynamic_cast<juce::AudioParameterFloat*>(state.getParameter(IDs::volume_id));
+    jassert(mVolumeParameter);
+    mOverdriveOnOff = dynamic_cast<juce::AudioParameterBool*>(state.getParameter(IDs::onoff_id1));
+    jassert(mOverdriveOnOff);
+
+    mLoader = std::make_unique<Loader>(*this);
+    mLoader->startThread();
+}
+
+GuitarEffectAudioProcessor::AmpModel::~AmpModel()
+{
+    mLoader->stopThread(4000);
+
+    delete mPendingEngine.exchange(nullptr);
+    delete mRetiredEngine.exchange(nullptr);
+}
+
+void GuitarEffectAudioProcessor::AmpModel::prepare (double sampleRate, int maximumBlockSize, int numChannels)
+{
+    const juce::ScopedLock sl (mLoaderLock);
+
+    mNumChannels = juce::jmax(1, numChannels);
+
+    // Nothing is processing while the host prepares, so the engines can be rebuilt directly
+    delete mRetiredEngine.exchange(nullptr);
+    delete mPendingEngine.exchange(nullptr);
+    mFadingEngine.reset();
+    mEngine = makeEngine();
+
+    // A restored session may name a model file that hasn't been loaded yet
+    auto savedPath = state.state.getProperty(IDs::ampModelFile_id).toString();
+
+    if (juce::File::isAbsolutePath(savedPath) && juce::File(savedPath) != mModelFile)
+        mRequestedFile = juce::File(savedPath);
+
+    mDryBuffer.setSize(mNumChannels, juce::jmax(1, maximumBlockSize));
+    mFadingBuffer.setSize(mNumChannels, juce::jmax(1, maximumBlockSize));
+
+    mInputGain.reset(sampleRate, 0.02);
+    mFadeLength = juce::jmax(1, (int)(0.05 * sampleRate));
+    mFadePosition = 0;
+    mWasOn = false;
+
+    mLoader->notify();
+}
+
+bool GuitarEffectAudioProcessor::AmpModel::process (juce::AudioBuffer<float>& buffer)
+{
+    if (! mOverdriveOnOff->get() || mModeParameter->getIndex() != 1)
+    {
+        mWasOn = false;
+        return false;
+    }
+
+    // Only switch once the last engine has been handed back, so at most one is ever waiting to be deleted
+    if (mFadingEngine == nullptr && mRetiredEngine.load() == nullptr)
+    {
+        if (auto* pending = mPendingEngine.exchange(nullptr))
+        {
+            mFadingEngine = std::move(mEngine);
+            mEngine.reset(pending);
+            mFadePosition = 0;
+        }
+    }
+
+    if (mEngine == nullptr)
+    {
+        mWasOn = false;
+        return false;
+    }
+
+    auto inputGain = juce::Decibels::decibelsToGain(juce::jmap(getModulated(mDriveParameter), -12.f, 12.f));
+
+    // Don't carry the state from the last time the model ran into this one
+    if (! mWasOn)
+    {
+        for (auto* engine : { mEngine.get(), mFadingEngine.get() })
+            if (engine != nullptr)
+                for (auto& model : engine->channels)
+                    model->reset();
+
+        mInputGain.setCurrentAndTargetValue(inputGain);
+        mWasOn = true;
+    }
+
+    mInputGain.setTargetValue(inputGain);
+
+    auto blend = getModulated(mBlendParameter);
+    auto volume = getModulated(mVolumeParameter);
+    auto numChannels = juce::jmin(buffer.getNumChannels(), (int)mEngine->channels.size());
+
+    for (int start = 0; start < buffer.getNumSamples(); start += mDryBuffer.getNumSamples())
+    {
+        auto numSamples = juce::jmin(buffer.getNumSamples() - start, mDryBuffer.getNumSamples());
+
+        for (int channel = 0; channel < numChannels; ++channel)
+            mDryBuffer.copyFrom(channel, 0, buffer, channel, start, numSamples);
+
+        for (int i = 0; i < numSamples; ++i)
+        {
+            auto gain = mInputGain.getNextValue();
+
+            for (int channel = 0; channel < numChannels; ++channel)
+                buffer.getWritePointer(channel, start)[i] *= gain;
+        }
+
+        for (int channel = 0; channel < numChannels; ++channel)
+        {
+            auto* channelData = buffer.getWritePointer(channel, start);
+
+            if (mFadingEngine != nullptr)
+            {
+                mFadingBuffer.copyFrom(channel, 0, buffer, channel, start, numSamples);
+                mFadingEngine->channels[(size_t)channel]->process(mFadingBuffer.getReadPointer(channel), mFadingBuffer.getWritePointer(channel), numSamples);
+            }
+
+            mEngine->channels[(size_t)channel]->process(channelData, channelData, numSamples);
+        }
+
+        // The same blend and volume as the atan, so switching modes doesn't jump in level
+        auto fadeStart = mFadePosition;
+
+        for (int channel = 0; channel < numChannels; ++channel)
+        {
+            auto* channelData = buffer.getWritePointer(channel, start);
+            auto* dry = mDryBuffer.getReadPointer(channel);
+            mFadePosition = fadeStart;
+
+            for (int i = 0; i < numSamples; ++i)
+            {
+                auto y = channelData[i];
+
+                if (mFadingEngine != nullptr)
+                {
+                    auto fade = (float)juce::jmin(++mFadePosition, mFadeLength) / (float)mFadeLength;
+                    y = mFadingBuffer.getSample(channel, i) + fade * (y - mFadingBuffer.getSample(channel, i));
+                }
+
+                channelData[i] = ((y * blend + dry[i] * (1.f - blend)) / 2) * volume;
+            }
+        }
+
+        // Faded out, the loader deletes it off the audio thread
+        if (mFadingEngine != nullptr && mFadePosition >= mFadeLength)
+            mRetiredEngine = mFadingEngine.release();
+    }
+
+    return true;
+}
+
+void GuitarEffectAudioProcessor::AmpModel::loadModel (const juce::File& file)
+{
+    state.state.setProperty(IDs::ampModelFile_id, file.getFullPathName(), nullptr);
+
+    {
+        const juce::ScopedLock sl (mLoaderLock);
+        mRequestedFile = file;
+    }
+
+    mLoader->notify();
+}
+
+juce::String GuitarEffectAudioProcessor::AmpModel::getLoadError() const
+{
+    const juce::ScopedLock sl (mLoaderLock);
+    return mLoadError;
+}
+
+bool GuitarEffectAudioProcessor::AmpModel::isLoading() const
+{
+    // The loader holds the lock for as long as it's parsing, so this can't slip in between
+    const juce::ScopedLock sl (mLoaderLock);
+    return mRequestedFile != juce::File();
+}
+
+void GuitarEffectAudioProcessor::AmpModel::runLoader()
+{
+    const juce::ScopedLock sl (mLoaderLock);
+
+    delete mRetiredEngine.exchange(nullptr);
+
+    if (mRequestedFile == juce::File())
+        return;
+
+    auto file = mRequestedFile;
+    mRequestedFile = juce::File();
+
+    // A file that won't load leaves the current model playing
+    juce::String error;
+    auto model = NeuralAmpModel::load(file, error);
+
+    if (model == nullptr)
+    {
+        mLoadError = error;
+        return;
+    }
+
+    mModel = std::move(model);
+    mModelFile = file;
+    mLoadError.clear();
+
+    // One the audio thread never picked up can go straight away
+    if (mNumChannels > 0)
+        delete mPendingEngine.exchange(makeEngine().release());
+}
+
+std::unique_ptr<GuitarEffectAudioProcessor::AmpModel::Engine> GuitarEffectAudioProcessor::AmpModel::makeEngine() const
+{
+    if (mModel == nullptr)
+        return {};
+
+    auto engine = std::make_unique<Engine>();
+
+    for (int channel = 0; channel < mNumChannels; ++channel)
+        engine->channels.push_back(mModel->clone());
+
+    return engine;
+}
+
+//==============================================================================
+GuitarEffectAudioProcessor::CircuitModel::CircuitModel (juce::AudioProcessorValueTreeState& stateToUse) : state(stateToUse)
+{
+    mModeParameter = dynamic_cast<juce::AudioParameterChoice*>(state.getParameter(IDs::odMode_id));
+    jassert(mModeParameter);
+    mDriveParameter = dynamic_cast<juce::AudioParameterFloat*>(state.getParameter(IDs::overdrive_id));
+    jassert(mDriveParameter);
+    mToneParameter = dynamic_cast<juce::AudioParameterFloat*>(state.getParameter(IDs::odTone_id));
+    jassert(mToneParameter);
+    mBlendParameter = dynamic_cast<juce::AudioParameterFloat*>(state.getParameter(IDs::blend_id));
+    jassert(mBlendParameter);
+    mVolumeParameter = dynamic_cast<juce::AudioParameterFloat*>(state.getParameter(IDs::volume_id));
+    jassert(mVolumeParameter);
+    mOverdriveOnOff = dynamic_cast<juce::AudioParameterBool*>(state.getParameter(IDs::onoff_id1));
+    jassert(mOverdriveOnOff);
+}
+
+void GuitarEffectAudioProcessor::CircuitModel::prepare (double sampleRate, int numChannels)
+{
+    mChannels.clear();
+
+    for (int channel = 0; channel < juce::jmax(1, numChannels); ++channel)
+    {
+        auto* newChannel = mChannels.add(new Channel());
+        newChannel->diodeClipper.prepare(sampleRate);
+        newChannel->tubeScreamer.prepare(sampleRate);
+        newChannel->tone.prepare(sampleRate);
+    }
+
+    mTubePreamp.prepare(sampleRate, mChannels.size());
+
+    mDrive.reset(sampleRate, 0.02);
+    mTone.reset(sampleRate, 0.02);
+    mLastMode = -1;
+}
+
+void GuitarEffectAudioProcessor::CircuitModel::reset()
+{
+    for (auto* channel : mChannels)
+    {
+        channel->diodeClipper.reset();
+        channel->tubeScreamer.reset();
+        channel->tone.reset();
+    }
+
+    mTubePreamp.reset();
+
+    mDrive.setCurrentAndTargetValue(getModulated(mDriveParameter));
+    mTone.setCurrentAndTargetValue(getModulated(mToneParameter));
+
+    for (auto* channel : mChannels)
+        channel->tubeScreamer.setDrive(mDrive.getCurrentValue());
+}
+
+bool GuitarEffectAudioProcessor::CircuitModel::process (juce::AudioBuffer<float>& buffer)
+{
+    auto mode = mModeParameter->getIndex();
+
+    // Multiband is the one mode past the circuits
+    if (! mOverdriveOnOff->get() || mode < 2 || mode > 4)
+    {
+        mLastMode = -1;
+        return false;
+    }
+
+    // Switching circuits, or coming back on, starts from a discharged circuit
+    if (mode != mLastMode)
+    {
+        reset();
+        mLastMode = mode;
+    }
+
+    mDrive.setTargetValue(getModulated(mDriveParameter));
+    mTone.setTargetValue(getModulated(mToneParameter));
+
+    auto blend = getModulated(mBlendParameter);
+    auto volume = getModulated(mVolumeParameter);
+    auto numChannels = juce::jmin(buffer.getNumChannels(), mChannels.size());
+    auto isDiodeClipper = mode == 2;
+    auto isTubePreamp = mode == 4;
+
+    // Changing the drive pot means new port resistances, so it's only moved every few samples
+    constexpr int driveInterval = 32;
+
+    for (int start = 0; start < buffer.getNumSamples(); start += driveInterval)
+    {
+        auto numSamples = juce::jmin(driveInterval, buffer.getNumSamples() - start);
+        auto driveStart = mDrive.getCurrentValue();
+        auto driveEnd = mDrive.skip(numSamples);
+        auto toneStart = mTone.getCurrentValue();
+        auto toneEnd = mTone.skip(numSamples);
+
+        if (mode == 3 && driveEnd != driveStart)
+            for (int channel = 0; channel < numChannels; ++channel)
+                mChannels[channel]->tubeScreamer.setDrive(driveEnd);
+
+        // Up to +40 dB into the diode clipper, whose diodes give out at about 0.6 V, and +30 dB
+        // into the preamp, whose first grid starts to conduct at about a volt
+        auto maximumGain = isTubePreamp ? 30.f : 40.f;
+        auto gainStart = juce::Decibels::decibelsToGain(maximumGain * driveStart);
+        auto gainEnd = juce::Decibels::decibelsToGain(maximumGain * driveEnd);
+
+        for (int channel = 0; channel < numChannels; ++channel)
+        {
+            auto& circuit = *mChannels[channel];
+            auto* channelData = buffer.getWritePointer(channel, start);
+
+            for (int i = 0; i < numSamples; ++i)
+            {
+                auto cleanSignal = channelData[i];
+                auto ramp = (float)(i + 1) / (float)numSamples;
+                auto tone = toneStart + (toneEnd - toneStart) * ramp;
+
+                auto gain = gainStart + (gainEnd - gainStart) * ramp;
+                float y;
+
+                // Scaled so that clipping hard comes out near full scale, like the atan
+                if (isDiodeClipper)
+                    y = 1.6f * circuit.diodeClipper.processSample(cleanSignal * gain);
+                else if (isTubePreamp)
+                    y = mTubePreamp.processSample(channel, cleanSignal * gain);
+                else
+                    y = circuit.tubeScreamer.processSample(cleanSignal);
+
+                y = circuit.tone.processSample(y, tone);
+
+                // The same blend and volume as the atan
+                channelData[i] = ((y * blend + cleanSignal * (1.f - blend)) / 2) * volume;
+            }
+        }
+    }
+
+    return true;
+}
+
+//==============================================================================
+GuitarEffectAudioProcessor::Multiband::Multiband (juce::AudioProcessorValueTreeState& stateToUse) : state(stateToUse)
+{
+    mModeParameter = dynamic_cast<juce::AudioParameterChoice*>(state.getParameter(IDs::odMode_id));
+    jassert(mModeParameter);
+    mBandsParameter = dynamic_cast<juce::AudioParameterChoice*>(state.getParameter(IDs::odBands_id));
+    jassert(mBandsParameter);
+    mRangeParameter = dynamic_cast<juce::AudioParameterFloat*>(state.getParameter(IDs::range_id));
+    jassert(mRangeParameter);
+    mOverdriveOnOff = dynamic_cast<juce::AudioParameterBool*>(state.getParameter(IDs::onoff_id1));
+    jassert(mOverdriveOnOff);
+
+    for (int crossover = 0; crossover < MultibandOverdrive::maximumBands - 1; ++crossover)
+    {
+        mCrossoverParameters[crossover] = dynamic_cast<juce::AudioParameterFloat*>(state.getParameter(IDs::crossover_ids[crossover]));
+        jassert(mCrossoverParameters[crossover]);
+    }
+
+    for (int band = 0; band < MultibandOverdrive::maximumBands; ++band)
+    {
+        mDriveParameters[band] = dynamic_cast<juce::AudioParameterFloat*>(state.getParameter(IDs::bandDrive_ids[band]));
+        jassert(mDriveParameters[band]);
+        mBlendParameters[band] = dynamic_cast<juce::AudioParameterFloat*>(state.getParameter(IDs::bandBlend_ids[band]));
+        jassert(mBlendParameters[band]);
+        mVolumeParameters[band] = dynamic_cast<juce::AudioParameterFloat*>(state.getParameter(IDs::bandVolume_ids[band]));
+        jassert(mVolumeParameters[band]);
+    }
+}
+
+void GuitarEffectAudioProcessor::Multiband::prepare (double sampleRate, int numChannels)
+{
+    mChannels.clear();
+
+    for (int channel = 0; channel < juce::jmax(1, numChannels); ++channel)
+        mChannels.add(new MultibandOverdrive())->prepare(sampleRate);
+
+    mNumBands = -1;
+    mWasOn = false;
+}
+
+void GuitarEffectAudioProcessor::Multiband::updateCrossovers()
+{
+    auto numBands = mBandsParameter->getIndex() + 2;
+    float crossovers[MultibandOverdrive::maximumBands - 1];
+    bool changed = numBands != mNumBands;
+
+    for (int crossover = 0; crossover < MultibandOverdrive::maximumBands - 1; ++crossover)
+    {
+        crossovers[crossover] = getModulated(mCrossoverParameters[crossover]);
+        changed = changed || (crossover < numBands - 1 && crossovers[crossover] != mCrossovers[crossover]);
+    }
+
+    // Working out the coefficients means a tan() per crossover, so only when something has moved
+    if (! changed)
+        return;
+
+    for (auto* channel : mChannels)
+        channel->setCrossovers(numBands, crossovers);
+
+    mNumBands = numBands;
+    std::copy(std::begin(crossovers), std::end(crossovers), mCrossovers);
+}
+
+bool GuitarEffectAudioProcessor::Multiband::process (juce::AudioBuffer<float>& buffer)
+{
+    if (! mOverdriveOnOff->get() || mModeParameter->getIndex() != 5)
+    {
+        mWasOn = false;
+        return false;
+    }
+
+    updateCrossovers();
+
+    auto range = getModulated(mRangeParameter);
+
+    for (auto* channel : mChannels)
+    {
+        // Coming back on starts from empty filters
+        if (! mWasOn)
+            channel->reset();
+
+        for (int band = 0; band < MultibandOverdrive::maximumBands; ++band)
+            channel->setBand(band, getModulated(mDriveParameters[band]) * range, getModulated(mBlendParameters[band]),
+                             band < mNumBands ? getModulated(mVolumeParameters[band]) : 0.f);
+    }
+
+    mWasOn = true;
+
+    for (int channel = 0; channel < juce::jmin(buffer.getNumChannels(), mChannels.size()); ++channel)
+        mChannels[channel]->process(buffer.getWritePointer(channel), buffer.getNumSamples());
+
+    return true;
+}
+
+//==============================================================================
+class GuitarEffectAudioProcessor::Cabinet::Loader : public juce::Thread
+{
+public:
+    Loader(Cabinet& cabinetToUse) : juce::Thread("Cabinet IR loader"), cabinet(cabinetToUse) {}
+
+    void run() override
+    {
+        // Woken up for new files, the timeout is for freeing retired filters
+        while (! threadShouldExit())
+        {
+            cabinet.runLoader();
+            wait(50);
+        }
+    }
+
+private:
+    Cabinet& cabinet;
+};
+
+static void normaliseImpulseResponse(juce::AudioBuffer<float>& impulseResponse)
+{
+    /*
+    * Scales the IR so the loudest frequency has unity gain. Cabinet IRs come at
+    * any level, this keeps switching between them from jumping in volume.
+    */
+    auto fftSize = 2 * juce::nextPowerOfTwo(juce::jmax(64, impulseResponse.getNumSamples()));
+    int order = 0;
+
+    while ((1 << order) < fftSize)
+        ++order;
+
+    juce::dsp::FFT fft(order);
+    std::vector<float> buffer((size_t)(2 * fftSize));
+    float peak = 0.f;
+
+    for (int channel = 0; channel < impulseResponse.getNumChannels(); ++channel)
+    {
+        std::fill(buffer.begin(), buffer.end(), 0.f);
+        std::copy(impulseResponse.getReadPointer(channel), impulseResponse.getReadPointer(channel) + impulseResponse.getNumSamples(), buffer.begin());
+
+        fft.performFrequencyOnlyForwardTransform(buffer.data());
+
+        for (int bin = 0; bin <= fftSize / 2; ++bin)
+            peak = juce::jmax(peak, buffer[(size_t)bin]);
+    }
+
+    if (peak > 0.f)
+        impulseResponse.applyGain(1.f / peak);
+}
+
+static juce::AudioBuffer<float> resampleImpulseResponse(const juce::AudioBuffer<float>& impulseResponse, double impulseResponseRate, double sampleRate)
+{
+    auto ratio = impulseResponseRate / sampleRate;
+    juce::AudioBuffer<float> resampled;
+
+    if (ratio == 1.0)
+    {
+        resampled.makeCopyOf(impulseResponse);
+        return resampled;
+    }
+
+    auto length = (int)std::ceil(impulseResponse.getNumSamples() / ratio);
+    resampled.setSize(impulseResponse.getNumChannels(), length);
+
+    // The interpolator reads a few samples past the end, so give it zeros there
+    std::vector<float> padded((size_t)impulseResponse.getNumSamples() + 16, 0.f);
+
+    for (int channel = 0; channel < impulseResponse.getNumChannels(); ++channel)
+    {
+        std::copy(impulseResponse.getReadPointer(channel), impulseResponse.getReadPointer(channel) + impulseResponse.getNumSamples(), padded.begin());
+
+        juce::LagrangeInterpolator interpolator;
+        interpolator.process(ratio, padded.data(), resampled.getWritePointer(channel), length);
+    }
+
+    return resampled;
+}
+
+GuitarEffectAudioProcessor::Cabinet::Cabinet (juce::AudioProcessorValueTreeState& stateToUse) : state(stateToUse)
+{
+    mCabTypeParameter = dynamic_cast<juce::AudioParameterChoice*>(state.getParameter(IDs::cabType_id));
+    jassert(mCabTypeParameter);
+    mCabDryWetParameter = dynamic_cast<juce::AudioParameterFloat*>(state.getParameter(IDs::cabDryWet_id));
+    jassert(mCabDryWetParameter);
+    mCabLevelParameter = dynamic_cast<juce::AudioParameterFloat*>(state.getParameter(IDs::cabLevel_id));
+    jassert(mCabLevelParameter);
+    mCabOnOff = dynamic_cast<juce::AudioParameterBool*>(state.getParameter(IDs::onoff_id4));
+    jassert(mCabOnOff);
+
+    mFormatManager.registerBasicFormats();
+
+    mLoader = std::make_unique<Loader>(*this);
+    mLoader->startThread();
+}
+
+GuitarEffectAudioProcessor::Cabinet::~Cabinet()
+{
+    mLoader->stopThread(4000);
+    delete mUserFilter.exchange(nullptr);
+}
+
+void GuitarEffectAudioProcessor::Cabinet::prepare (double sampleRate, int maximumBlockSize, int numChannels)
+{
+    const juce::ScopedLock sl (mLoaderLock);
+
+    mSampleRate = sampleRate;
+
+    // The convolver lets go of every filter here, so they can all be rebuilt for the new rate
+    mConvolver.prepare(numChannels, partitionSize, (int)std::ceil(MAX_CAB_IR_TIME * sampleRate / partitionSize));
+    mConvolver.setFilter(nullptr);
+
+    mBuiltInFilters.clear();
+
+    for (int type = 0; type < mCabTypeParameter->choices.size() - 1; ++type)
+        mBuiltInFilters.push_back(makeFilter(createBuiltInImpulseResponse(type, sampleRate), sampleRate));
+
+    // Nothing is processing while the host prepares, so the user IR can be swapped directly
+    mRetiredFilters.clear();
+    delete mUserFilter.exchange(nullptr);
+
+    if (mUserImpulseResponse.getNumSamples() > 0)
+        mUserFilter = makeFilter(mUserImpulseResponse, mUserImpulseResponseRate).release();
+
+    // A restored session may name an IR file that hasn't been loaded yet
+    auto savedPath = state.state.getProperty(IDs::cabFile_id).toString();
+
+    if (juce::File::isAbsolutePath(savedPath) && juce::File(savedPath) != mUserFile)
+        mRequestedFile = juce::File(savedPath);
+
+    mDryBuffer.setSize(juce::jmax(1, numChannels), juce::jmax(1, maximumBlockSize));
+    mChannelPointers.resize((size_t)mDryBuffer.getNumChannels());
+
+    mDryWet.reset(sampleRate, 0.02);
+    mDryWet.setCurrentAndTargetValue(getModulated(mCabDryWetParameter));
+    mLevel.reset(sampleRate, 0.02);
+    mLevel.setCurrentAndTargetValue(juce::Decibels::decibelsToGain(getModulated(mCabLevelParameter)));
+
+    mWasOn = false;
+
+    publishFiltersInUse();
+    mLoader->notify();
+}
+
+void GuitarEffectAudioProcessor::Cabinet::process (juce::AudioBuffer<float>& buffer)
+{
+    if (! mCabOnOff->get() || mDryBuffer.getNumSamples() == 0)
+    {
+        mWasOn = false;
+        publishFiltersInUse();
+        return;
+    }
+
+    // Don't let the tail from the last time the cabinet was on leak back in
+    if (! mWasOn)
+    {
+        mConvolver.reset();
+        mDryWet.setCurrentAndTargetValue(getModulated(mCabDryWetParameter));
+        mLevel.setCurrentAndTargetValue(juce::Decibels::decibelsToGain(getModulated(mCabLevelParameter)));
+        mWasOn = true;
+    }
+
+    // "User IR" plays the first cabinet until a file has been loaded
+    auto type = mCabTypeParameter->getIndex();
+    const Filter* filter = type < (int)mBuiltInFilters.size() ? mBuiltInFilters[(size_t)type].get() : mUserFilter.load();
+
+    if (filter == nullptr && ! mBuiltInFilters.empty())
+        filter = mBuiltInFilters.front().get();
+
+    // A different filter fades in over the next partition
+    mConvolver.setFilter(filter);
+
+    mDryWet.setTargetValue(getModulated(mCabDryWetParameter));
+    mLevel.setTargetValue(juce::Decibels::decibelsToGain(getModulated(mCabLevelParameter)));
+
+    auto numChannels = juce::jmin(buffer.getNumChannels(), mDryBuffer.getNumChannels());
+
+    for (int start = 0; start < buffer.getNumSamples(); start += mDryBuffer.getNumSamples())
+    {
+        auto numSamples = juce::jmin(buffer.getNumSamples() - start, mDryBuffer.getNumSamples());
+
+        for (int channel = 0; channel < numChannels; ++channel)
+        {
+            mDryBuffer.copyFrom(channel, 0, buffer, channel, start, numSamples);
+            mChannelPointers[(size_t)channel] = buffer.getWritePointer(channel, start);
+        }
+
+        mConvolver.process(mChannelPointers.data(), numChannels, numSamples);
+
+        for (int i = 0; i < numSamples; ++i)
+        {
+            auto wet = mDryWet.getNextValue();
+            auto level = mLevel.getNextValue();
+
+            for (int channel = 0; channel < numChannels; ++channel)
+            {
+                auto* channelData = mChannelPointers[(size_t)channel];
+                channelData[i] = mDryBuffer.getSample(channel, i) * (1.f - wet) + channelData[i] * wet * level;
+            }
+        }
+    }
+
+    publishFiltersInUse();
+}
+
+void GuitarEffectAudioProcessor::Cabinet::loadImpulseResponse (const juce::File& file)
+{
+    state.state.setProperty(IDs::cabFile_id, file.getFullPathName(), nullptr);
+
+    {
+        const juce::ScopedLock sl (mLoaderLock);
+        mRequestedFile = file;
+    }
+
+    mLoader->notify();
+}
+
+bool GuitarEffectAudioProcessor::Cabinet::isLoading() const
+{
+    const juce::ScopedLock sl (mLoaderLock);
+    return mRequestedFile != juce::File();
+}
+
+juce::AudioBuffer<float> GuitarEffectAudioProcessor::Cabinet::createBuiltInImpulseResponse (int type, double sampleRate)
+{
+    /*
+    * A guitar cabinet is mostly a band-pass with a low resonance, a mid scoop and
+    * a presence peak, so each voicing is an impulse through a few biquads. An
+    * open back adds the back wave as a short inverted reflection.
+    */
+    struct Voicing
+    {
+        float highPass, resonance, resonanceGain, mid, midGain, presence, presenceGain, lowPass, reflection;
+    };
+
+    static const Voicing voicings[] =
+    {
+        { 70.f, 120.f, 1.4f, 400.f, 1.0f, 1800.f, 1.4f, 5500.f, 0.3f },     // 1x12 open back
+        { 80.f, 100.f, 1.8f, 400.f, 0.7f, 2500.f, 1.6f, 5000.f, 0.15f },    // 2x12 combo
+        { 60.f, 90.f,  2.0f, 500.f, 0.6f, 3000.f, 1.8f, 4200.f, 0.f },      // 4x12 closed back
+    };
+
+    auto& voicing = voicings[juce::jlimit(0, juce::numElementsInArray(voicings) - 1, type)];
+    auto lowPass = juce::jmin(voicing.lowPass, (float)(0.45 * sampleRate));
+
+    using Coefficients = juce::dsp::IIR::Coefficients<float>;
+
+    juce::dsp::IIR::Filter<float> filters[] =
+    {
+        juce::dsp::IIR::Filter<float>(Coefficients::makeHighPass(sampleRate, voicing.highPass, 0.7f)),
+        juce::dsp::IIR::Filter<float>(Coefficients::makePeakFilter(sampleRate, voicing.resonance, 1.2f, voicing.resonanceGain)),
+        juce::dsp::IIR::Filter<float>(Coefficients::makePeakFilter(sampleRate, voicing.mid, 0.8f, voicing.midGain)),
+        juce::dsp::IIR::Filter<float>(Coefficients::makePeakFilter(sampleRate, voicing.presence, 1.5f, voicing.presenceGain)),
+        juce::dsp::IIR::Filter<float>(Coefficients::makeLowPass(sampleRate, lowPass, 0.7f)),
+        juce::dsp::IIR::Filter<float>(Coefficients::makeLowPass(sampleRate, lowPass, 0.7f)),
+    };
+
+    auto length = (int)(0.04 * sampleRate);
+    auto reflectionDelay = (int)(0.0012 * sampleRate);
+    auto fadeStart = length * 3 / 4;
+
+    juce::AudioBuffer<float> impulseResponse(1, length);
+    auto* data = impulseResponse.getWritePointer(0);
+
+    for (int i = 0; i < length; ++i)
+    {
+        auto x = (i == 0 ? 1.f : 0.f) - (i == reflectionDelay ? voicing.reflection : 0.f);
+
+        for (auto& filter : filters)
+            x = filter.processSample(x);
+
+        // Fade the end out so cutting it off doesn't ring
+        if (i >= fadeStart)
+            x *= 0.5f * (1.f + std::cos(juce::MathConstants<float>::pi * (float)(i - fadeStart) / (float)(length - fadeStart)));
+
+        data[i] = x;
+    }
+
+    normaliseImpulseResponse(impulseResponse);
+    return impulseResponse;
+}
+
+//==============================================================================
+void GuitarEffectAudioProcessor::Cabinet::runLoader()
+{
+    const juce::ScopedLock sl (mLoaderLock);
+
+    if (mRequestedFile != juce::File())
+    {
+        auto file = mRequestedFile;
+        mRequestedFile = juce::File();
+
+        std::unique_ptr<juce::AudioFormatReader> reader (mFormatManager.createReaderFor(file));
+
+        if (reader != nullptr && reader->sampleRate > 0)
+        {
+            // Anything past MAX_CAB_IR_TIME is room, not cabinet
+            auto length = (int)juce::jmin(reader->lengthInSamples, (juce::int64)(MAX_CAB_IR_TIME * reader->sampleRate));
+
+            mUserImpulseResponse.setSize(juce::jmin(2, (int)reader->numChannels), length);
+            reader->read(&mUserImpulseResponse, 0, length, 0, true, true);
+            mUserImpulseResponseRate = reader->sampleRate;
+            mUserFile = file;
+
+            if (mSampleRate > 0)
+            {
+                auto* old = mUserFilter.exchange(makeFilter(mUserImpulseResponse, mUserImpulseResponseRate).release());
+
+                if (old != nullptr)
+                    mRetiredFilters.emplace_back(std::unique_ptr<Filter>(old), mInUseSequence.load());
+            }
+        }
+    }
+
+    freeRetiredFilters();
+}
+
+void GuitarEffectAudioProcessor::Cabinet::publishFiltersInUse()
+{
+    // Odd while the slots are being written
+    mInUseSequence.fetch_add(1);
+    mFiltersInUse[0] = mConvolver.getCurrentFilter();
+    mFiltersInUse[1] = mConvolver.getFadingFilter();
+    mFiltersInUse[2] = mConvolver.getPendingFilter();
+    mInUseSequence.fetch_add(1);
+}
+
+void GuitarEffectAudioProcessor::Cabinet::freeRetiredFilters()
+{
+    if (mRetiredFilters.empty())
+        return;
+
+    auto sequence = mInUseSequence.load();
+
+    // Mid publish, try again next time round
+    if ((sequence & 1) != 0)
+        return;
+
+    const Filter* inUse[] = { mFiltersInUse[0].load(), mFiltersInUse[1].load(), mFiltersInUse[2].load() };
+
+    if (mInUseSequence.load() != sequence)
+        return;
+
+    /*
+    * The block running when a filter was retired may have picked it up, the next
+    * one can't have. So once both have published (at most 4 counts later) and
+    * neither mentions the filter, nothing can reach it any more.
+    */
+    mRetiredFilters.erase(std::remove_if(mRetiredFilters.begin(), mRetiredFilters.end(), [&](const auto& retired)
+    {
+        return sequence >= retired.second + 4 && std::find(std::begin(inUse), std::end(inUse), retired.first.get()) == std::end(inUse);
+    }), mRetiredFilters.end());
+}
+
+std::unique_ptr<PartitionedConvolution::Filter> GuitarEffectAudioProcessor::Cabinet::makeFilter (const juce::AudioBuffer<float>& impulseResponse, double impulseResponseRate) const
+{
+    auto resampled = resampleImpulseResponse(impulseResponse, impulseResponseRate, mSampleRate);
+    normaliseImpulseResponse(resampled);
+
+    return std::make_unique<Filter>(resampled, partitionSize, (int)std::ceil(MAX_CAB_IR_TIME * mSampleRate / partitionSize));
+}
+
+//==============================================================================
+class GuitarEffectAudioProcessor::Reverb::Loader : public juce::Thread
+{
+public:
+    Loader(Reverb& reverbToUse) : juce::Thread("Reverb IR loader"), reverb(reverbToUse) {}
+
+    void run() override
+    {
+        // The audio thread can't wake it, so type changes and retired engines are polled for
+        while (! threadShouldExit())
+        {
+            reverb.runLoader();
+            wait(50);
+        }
+    }
+
+private:
+    Reverb& reverb;
+};
+
+static void normaliseImpulseResponseEnergy(juce::AudioBuffer<float>& impulseResponse)
+{
+    /*
+    * Reverb IRs are scaled to unit energy per channel rather than to their peak
+    * frequency, so a 2 s room and an 8 s hall come out at about the same loudness.
+    */
+    double energy = 0.0;
+
+    for (int channel = 0; channel < impulseResponse.getNumChannels(); ++channel)
+        for (int i = 0; i < impulseResponse.getNumSamples(); ++i)
+            energy += (double)impulseResponse.getSample(channel, i) * impulseResponse.getSample(channel, i);
+
+    energy /= juce::jmax(1, impulseResponse.getNumChannels());
+
+    if (energy > 0.0)
+        impulseResponse.applyGain((float)(1.0 / std::sqrt(energy)));
+}
+
+GuitarEffectAudioProcessor::Reverb::Reverb (juce::AudioProcessorValueTreeState& stateToUse) : state(stateToUse)
+{
+    mReverbTypeParameter = dynamic_cast<juce::AudioParameterChoice*>(state.getParameter(IDs::reverbType_id));
+    jassert(mReverbTypeParameter);
+    mReverbDryWetParameter = dynamic_cast<juce::AudioParameterFloat*>(state.getParameter(IDs::reverbDryWet_id));
+    jassert(mReverbDryWetParameter);
+    mReverbOnOff = dynamic_cast<juce::AudioParameterBool*>(state.getParameter(IDs::onoff_id5));
+    jassert(mReverbOnOff);
+
+    mFormatManager.registerBasicFormats();
+
+    mLoader = std::make_unique<Loader>(*this);
+    mLoader->startThread();
+}
+
+GuitarEffectAudioProcessor::Reverb::~Reverb()
+{
+    mLoader->stopThread(4000);
+
+    delete mPendingEngine.exchange(nullptr);
+    delete mRetiredEngine.exchange(nullptr);
+}
+
+void GuitarEffectAudioProcessor::Reverb::prepare (double sampleRate, int maximumBlockSize, int numChannels)
+{
+    const juce::ScopedLock sl (mLoaderLock);
+
+    auto settingsChanged = sampleRate != mSampleRate || maximumBlockSize != mMaximumBlockSize || numChannels != mNumChannels;
+
+    mSampleRate = sampleRate;
+    mMaximumBlockSize = juce::jmax(1, maximumBlockSize);
+    mNumChannels = juce::jmax(1, numChannels);
+
+    // Nothing is processing while the host prepares, so the engines can be sorted out directly
+    delete mRetiredEngine.exchange(nullptr);
+    mFadingEngine.reset();
+
+    if (auto* pending = mPendingEngine.exchange(nullptr))
+        mEngine.reset(pending);
+
+    // Re-preparing with the same settings happens a lot, building a 10 s engine doesn't need to
+    auto type = mReverbTypeParameter->getIndex();
+    mRequestedType = type;
+
+    if (settingsChanged || mEngine == nullptr || mEngine->type != type)
+        mEngine = makeEngine(type);
+    else
+        mEngine->convolution.reset();
+
+    mLoadedType = type;
+
+    // A restored session may name an IR file that hasn't been loaded yet
+    auto savedPath = state.state.getProperty(IDs::reverbFile_id).toString();
+
+    if (juce::File::isAbsolutePath(savedPath) && juce::File(savedPath) != mUserFile)
+        mRequestedFile = juce::File(savedPath);
+
+    mDryBuffer.setSize(mNumChannels, mMaximumBlockSize);
+    mFadingBuffer.setSize(mNumChannels, mMaximumBlockSize);
+    mChannelPointers.resize((size_t)mNumChannels);
+    mFadingPointers.resize((size_t)mNumChannels);
+
+    mDryWet.reset(sampleRate, 0.05);
+    mDryWet.setCurrentAndTargetValue(getModulated(mReverbDryWetParameter));
+
+    mFadeLength = juce::jmax(1, (int)(0.2 * sampleRate));
+    mFadePosition = 0;
+    mWasOn = false;
+
+    mLoader->notify();
+}
+
+void GuitarEffectAudioProcessor::Reverb::process (juce::AudioBuffer<float>& buffer, bool isNonRealtime)
+{
+    // Asked for even while off, so the engine is ready by the time the pedal goes on
+    mRequestedType = mReverbTypeParameter->getIndex();
+
+    if (! mReverbOnOff->get() || mEngine == nullptr)
+    {
+        mWasOn = false;
+        return;
+    }
+
+    // Don't let the tail from the last time the reverb was on leak back in
+    if (! mWasOn)
+    {
+        mEngine->convolution.reset();
+
+        if (mFadingEngine != nullptr)
+            mFadingEngine->convolution.reset();
+
+        mDryWet.setCurrentAndTargetValue(getModulated(mReverbDryWetParameter));
+        mWasOn = true;
+    }
+
+    // Only switch once the last engine has been handed back, so at most one is ever waiting to be deleted
+    if (mFadingEngine == nullptr && mRetiredEngine.load() == nullptr)
+    {
+        if (auto* pending = mPendingEngine.exchange(nullptr))
+        {
+            mFadingEngine = std::move(mEngine);
+            mEngine.reset(pending);
+            mFadePosition = 0;
+        }
+    }
+
+    mDryWet.setTargetValue(getModulated(mReverbDryWetParameter));
+
+    auto numChannels = juce::jmin(buffer.getNumChannels(), mDryBuffer.getNumChannels());
+
+    for (int start = 0; start < buffer.getNumSamples(); start += mDryBuffer.getNumSamples())
+    {
+        auto numSamples = juce::jmin(buffer.getNumSamples() - start, mDryBuffer.getNumSamples());
+
+        for (int channel = 0; channel < numChannels; ++channel)
+        {
+            mDryBuffer.copyFrom(channel, 0, buffer, channel, start, numSamples);
+            mChannelPointers[(size_t)channel] = buffer.getWritePointer(channel, start);
+
+            if (mFadingEngine != nullptr)
+            {
+                mFadingBuffer.copyFrom(channel, 0, buffer, channel, start, numSamples);
+                mFadingPointers[(size_t)channel] = mFadingBuffer.getWritePointer(channel);
+            }
+        }
+
+        mEngine->convolution.setNonRealtime(isNonRealtime);
+        mEngine->convolution.process(mChannelPointers.data(), numChannels, numSamples);
+
+        if (mFadingEngine != nullptr)
+        {
+            mFadingEngine->convolution.setNonRealtime(isNonRealtime);
+            mFadingEngine->convolution.process(mFadingPointers.data(), numChannels, numSamples);
+        }
+
+        for (int i = 0; i < numSamples; ++i)
+        {
+            auto wet = mDryWet.getNextValue();
+            auto fade = 1.f;
+
+            if (mFadingEngine != nullptr)
+                fade = (float)juce::jmin(++mFadePosition, mFadeLength) / (float)mFadeLength;
+
+            for (int channel = 0; channel < numChannels; ++channel)
+            {
+                auto* channelData = mChannelPointers[(size_t)channel];
+                auto y = channelData[i];
+
+                if (mFadingEngine != nullptr)
+                    y = mFadingBuffer.getSample(channel, i) + fade * (y - mFadingBuffer.getSample(channel, i));
+
+                channelData[i] = mDryBuffer.getSample(channel, i) * (1.f - wet) + y * wet;
+            }
+        }
+
+        // Faded out, the loader deletes it (and stops its workers) off the audio thread
+        if (mFadingEngine != nullptr && mFadePosition >= mFadeLength)
+            mRetiredEngine = mFadingEngine.release();
+    }
+}
+
+void GuitarEffectAudioProcessor::Reverb::loadImpulseResponse (const juce::File& file)
+{
+    state.state.setProperty(IDs::reverbFile_id, file.getFullPathName(), nullptr);
+
+    {
+        const juce::ScopedLock sl (mLoaderLock);
+        mRequestedFile = file;
+    }
+
+    mLoader->notify();
+}
+
+bool GuitarEffectAudioProcessor::Reverb::isLoading() const
+{
+    const juce::ScopedLock sl (mLoaderLock);
+    return mRequestedFile != juce::File() || (mSampleRate > 0 && mRequestedType.load() != mLoadedType);
+}
+
+juce::AudioBuffer<float> GuitarEffectAudioProcessor::Reverb::createBuiltInImpulseResponse (int type, double sampleRate)
+{
+    /*
+    * A late reverb tail is close to noise with an exponential decay, faster at
+    * high frequencies than low ones. Each channel gets its own noise so the
+    * tail comes out wide, rooms and halls add a few early reflections in front.
+    * The seeds are fixed, a preset must sound the same every time it loads.
+    */
+    struct Voicing
+    {
+        float length, decay, highDecay, crossover, preDelay, onset, earlyTime, earlyGain;
+        int numEarly;
+    };
+
+    static const Voicing voicings[] =
+    {
+        { 2.f, 1.4f, 0.6f, 2500.f, 0.004f, 0.01f,  0.04f, 0.5f, 8 },     // room
+        { 4.f, 3.0f, 2.2f, 5000.f, 0.f,    0.002f, 0.f,   0.f,  0 },     // plate, dense and bright straight away
+        { 8.f, 5.5f, 2.5f, 2000.f, 0.02f,  0.03f,  0.09f, 0.4f, 12 },    // hall
+    };
+
+    type = juce::jlimit(0, juce::numElementsInArray(voicings) - 1, type);
+    auto& voicing = voicings[type];
+
+    auto length = (int)(voicing.length * sampleRate);
+    auto fadeStart = length * 9 / 10;
+    auto lowPass = std::exp(-juce::MathConstants<float>::twoPi * voicing.crossover / (float)sampleRate);
+
+    // -60 dB after the decay time
+    auto decayRate = std::log(1000.f) / (float)sampleRate;
+
+    juce::AudioBuffer<float> impulseResponse(2, length);
+
+    for (int channel = 0; channel < impulseResponse.getNumChannels(); ++channel)
+    {
+        juce::Random random(1000 + 10 * type + channel);
+        auto* data = impulseResponse.getWritePointer(channel);
+        float low = 0.f;
+
+        for (int i = 0; i < length; ++i)
+        {
+            auto noise = random.nextFloat() * 2.f - 1.f;
+            low = noise + lowPass * (low - noise);
+
+            auto x = low * std::exp(-decayRate * (float)i / voicing.decay)
+                   + (noise - low) * std::exp(-decayRate * (float)i / voicing.highDecay);
+
+            // The diffuse tail builds up after the pre-delay rather than starting with a click
+            auto t = (float)(i / sampleRate) - voicing.preDelay;
+            x *= t <= 0.f ? 0.f : juce::jmin(1.f, t / voicing.onset);
+
+            if (i >= fadeStart)
+                x *= 0.5f * (1.f + std::cos(juce::MathConstants<float>::pi * (float)(i - fadeStart) / (float)(length - fadeStart)));
+
+            data[i] = x;
+        }
+
+        for (int reflection = 0; reflection < voicing.numEarly; ++reflection)
+        {
+            auto time = voicing.preDelay + voicing.earlyTime * random.nextFloat();
+            auto index = juce::jmin(length - 1, (int)(time * sampleRate));
+
+            data[index] += voicing.earlyGain * (1.f - time / (voicing.preDelay + voicing.earlyTime + 0.01f)) * (random.nextBool() ? 1.f : -1.f);
+        }
+    }
+
+    normaliseImpulseResponseEnergy(impulseResponse);
+    return impulseResponse;
+}
+
+//==============================================================================
+void GuitarEffectAudioProcessor::Reverb::runLoader()
+{
+    const juce::ScopedLock sl (mLoaderLock);
+
+    // Deleting it joins its worker threads, which is why it's done here
+    delete mRetiredEngine.exchange(nullptr);
+
+    auto userType = mReverbTypeParameter->choices.size() - 1;
+    auto userChanged = false;
+
+    if (mRequestedFile != juce::File())
+    {
+        auto file = mRequestedFile;
+        mRequestedFile = juce::File();
+
+        std::unique_ptr<juce::AudioFormatReader> reader (mFormatManager.createReaderFor(file));
+
+        if (reader != nullptr && reader->sampleRate > 0)
+        {
+            auto length = (int)juce::jmin(reader->lengthInSamples, (juce::int64)(MAX_REVERB_IR_TIME * reader->sampleRate));
+
+            mUserImpulseResponse.setSize(juce::jmin(2, (int)reader->numChannels), length);
+            reader->read(&mUserImpulseResponse, 0, length, 0, true, true);
+            mUserImpulseResponseRate = reader->sampleRate;
+            mUserFile = file;
+            userChanged = true;
+        }
+    }
+
+    auto type = mRequestedType.load();
+
+    if (mSampleRate > 0 && (type != mLoadedType || (userChanged && type == userType)))
+    {
+        // One the audio thread never picked up can go straight away
+        delete mPendingEngine.exchange(makeEngine(type).release());
+        mLoadedType = type;
+    }
+}
+
+std::unique_ptr<GuitarEffectAudioProcessor::Reverb::Engine> GuitarEffectAudioProcessor::Reverb::makeEngine (int type) const
+{
+    // "User IR" plays the room until a file has been loaded
+    auto builtIn = type < mReverbTypeParameter->choices.size() - 1 || mUserImpulseResponse.getNumSamples() == 0;
+    juce::AudioBuffer<float> impulseResponse;
+
+    if (builtIn)
+    {
+        impulseResponse = createBuiltInImpulseResponse(type < mReverbTypeParameter->choices.size() - 1 ? type : 0, mSampleRate);
+    }
+    else
+    {
+        impulseResponse = resampleImpulseResponse(mUserImpulseResponse, mUserImpulseResponseRate, mSampleRate);
+        normaliseImpulseResponseEnergy(impulseResponse);
+    }
+
+    return std::make_unique<Engine>(impulseResponse, mNumChannels, mMaximumBlockSize, type);
+}
+
+//==============================================================================
+GuitarEffectAudioProcessor::FDNReverb::FDNReverb (juce::AudioProcessorValueTreeState& stateToUse) : state(stateToUse)
+{
+    mSizeParameter = dynamic_cast<juce::AudioParameterFloat*>(state.getParameter(IDs::fdnSize_id));
+    jassert(mSizeParameter);
+    mDecayParameter = dynamic_cast<juce::AudioParameterFloat*>(state.getParameter(IDs::fdnDecay_id));
+    jassert(mDecayParameter);
+    mDampingParameter = dynamic_cast<juce::AudioParameterFloat*>(state.getParameter(IDs::fdnDamping_id));
+    jassert(mDampingParameter);
+    mModulationParameter = dynamic_cast<juce::AudioParameterFloat*>(state.getParameter(IDs::fdnModulation_id));
+    jassert(mModulationParameter);
+    mLinesParameter = dynamic_cast<juce::AudioParameterChoice*>(state.getParameter(IDs::fdnLines_id));
+    jassert(mLinesParameter);
+    mFreezeParameter = dynamic_cast<juce::AudioParameterBool*>(state.getParameter(IDs::fdnFreeze_id));
+    jassert(mFreezeParameter);
+    mFDNDryWetParameter = dynamic_cast<juce::AudioParameterFloat*>(state.getParameter(IDs::fdnDryWet_id));
+    jassert(mFDNDryWetParameter);
+    mFDNOnOff = dynamic_cast<juce::AudioParameterBool*>(state.getParameter(IDs::onoff_id6));
+    jassert(mFDNOnOff);
+}
+
+void GuitarEffectAudioProcessor::FDNReverb::prepare (double sampleRate, int maximumBlockSize)
+{
+    mSmallNetwork.prepare(sampleRate, maximumSize);
+    mLargeNetwork.prepare(sampleRate, maximumSize);
+
+    mWetBuffer.setSize(2, juce::jmax(1, maximumBlockSize));
+
+    mDryWet.reset(sampleRate, 0.05);
+    mDryWet.setCurrentAndTargetValue(getModulated(mFDNDryWetParameter));
+
+    mActiveLines = -1;
+    mWasOn = false;
+}
+
+void GuitarEffectAudioProcessor::FDNReverb::process (juce::AudioBuffer<float>& buffer)
+{
+    if (! mFDNOnOff->get() || mWetBuffer.getNumSamples() == 0 || buffer.getNumChannels() == 0)
+    {
+        mWasOn = false;
+        return;
+    }
+
+    auto lines = mLinesParameter->getIndex();
+
+    // Starting up, or the other network taking over: either way it starts from silence
+    if (! mWasOn || lines != mActiveLines)
+    {
+        if (lines == 0)
+            mSmallNetwork.reset();
+        else
+            mLargeNetwork.reset();
+
+        if (! mWasOn)
+            mDryWet.setCurrentAndTargetValue(getModulated(mFDNDryWetParameter));
+
+        mActiveLines = lines;
+        mWasOn = true;
+    }
+
+    auto size = juce::jmap(getModulated(mSizeParameter), 0.4f, maximumSize);
+
+    if (lines == 0)
+        mSmallNetwork.setParameters(size, getModulated(mDecayParameter), getModulated(mDampingParameter), getModulated(mModulationParameter), mFreezeParameter->get());
+    else
+        mLargeNetwork.setParameters(size, getModulated(mDecayParameter), getModulated(mDampingParameter), getModulated(mModulationParameter), mFreezeParameter->get());
+
+    mDryWet.setTargetValue(getModulated(mFDNDryWetParameter));
+
+    auto isStereo = buffer.getNumChannels() > 1;
+
+    for (int start = 0; start < buffer.getNumSamples(); start += mWetBuffer.getNumSamples())
+    {
+        auto numSamples = juce::jmin(buffer.getNumSamples() - start, mWetBuffer.getNumSamples());
+
+        auto* left = buffer.getWritePointer(0, start);
+        auto* right = isStereo ? buffer.getWritePointer(1, start) : left;
+        auto* wetLeft = mWetBuffer.getWritePointer(0);
+        auto* wetRight = mWetBuffer.getWritePointer(1);
+
+        if (lines == 0)
+            mSmallNetwork.process(left, right, wetLeft, wetRight, numSamples);
+        else
+            mLargeNetwork.process(left, right, wetLeft, wetRight, numSamples);
+
+        for (int i = 0; i < numSamples; ++i)
+        {
+            auto wet = mDryWet.getNextValue();
+
+            if (isStereo)
+            {
+                left[i] = left[i] * (1.f - wet) + wetLeft[i] * wet;
+                right[i] = right[i] * (1.f - wet) + wetRight[i] * wet;
+            }
+            else
+            {
+                left[i] = left[i] * (1.f - wet) + 0.5f * (wetLeft[i] + wetRight[i]) * wet;
+            }
+        }
+    }
+}
+
+//==============================================================================
+GuitarEffectAudioProcessor::EQ::EQ (juce::AudioProcessorValueTreeState& stateToUse) : state(stateToUse)
+{
+    mLowParameter = dynamic_cast<juce::AudioParameterFloat*>(state.getParameter(IDs::eqLow_id));
+    jassert(mLowParameter);
+    mMidFrequencyParameter = dynamic_cast<juce::AudioParameterFloat*>(state.getParameter(IDs::eqMidFrequency_id));
+    jassert(mMidFrequencyParameter);
+    mMidGainParameter = dynamic_cast<juce::AudioParameterFloat*>(state.getParameter(IDs::eqMidGain_id));
+    jassert(mMidGainParameter);
+    mMidQParameter = dynamic_cast<juce::AudioParameterFloat*>(state.getParameter(IDs::eqMidQ_id));
+    jassert(mMidQParameter);
+    mHighParameter = dynamic_cast<juce::AudioParameterFloat*>(state.getParameter(IDs::eqHigh_id));
+    jassert(mHighParameter);
+    mPositionParameter = dynamic_cast<juce::AudioParameterChoice*>(state.getParameter(IDs::eqPosition_id));
+    jassert(mPositionParameter);
+    mEQOnOff = dynamic_cast<juce::AudioParameterBool*>(state.getParameter(IDs::onoff_id7));
+    jassert(mEQOnOff);
+}
+
+void GuitarEffectAudioProcessor::EQ::prepare (double sampleRate)
+{
+    mSampleRate = sampleRate;
+
+    for (auto* value : { &mLow, &mMidFrequency, &mMidGain, &mMidQ, &mHigh })
+        value->reset(sampleRate, 0.05);
+
+    mWasOn = false;
+}
+
+bool GuitarEffectAudioProcessor::EQ::isAfterOverdrive() const
+{
+    return mEQOnOff->get() && mPositionParameter->getIndex() == 1;
+}
+
+void GuitarEffectAudioProcessor::EQ::updateCoefficients()
+{
+    mFilters.setCoefficients(0, BiquadCoefficients::lowShelf(mSampleRate, lowFrequency, shelfQ, mLow.getCurrentValue()));
+    mFilters.setCoefficients(1, BiquadCoefficients::peak(mSampleRate, mMidFrequency.getCurrentValue(), mMidQ.getCurrentValue(), mMidGain.getCurrentValue()));
+    mFilters.setCoefficients(2, BiquadCoefficients::highShelf(mSampleRate, highFrequency, shelfQ, mHigh.getCurrentValue()));
+}
+
+void GuitarEffectAudioProcessor::EQ::process (juce::AudioBuffer<float>& buffer, Position position)
+{
+    if (! mEQOnOff->get())
+    {
+        mWasOn = false;
+        return;
+    }
+
+    if (mPositionParameter->getIndex() != (int)position)
+        return;
+
+    mLow.setTargetValue(getModulated(mLowParameter));
+    mMidFrequency.setTargetValue(getModulated(mMidFrequencyParameter));
+    mMidGain.setTargetValue(getModulated(mMidGainParameter));
+    mMidQ.setTargetValue(getModulated(mMidQParameter));
+    mHigh.setTargetValue(getModulated(mHighParameter));
+
+    // Coming back on jumps straight to the settings, from empty filters
+    if (! mWasOn)
+    {
+        for (auto* value : { &mLow, &mMidFrequency, &mMidGain, &mMidQ, &mHigh })
+            value->setCurrentAndTargetValue(value->getTargetValue());
+
+        mFilters.reset();
+        updateCoefficients();
+        mWasOn = true;
+    }
+
+    auto numChannels = juce::jmin(buffer.getNumChannels(), (int)Filters::lanes);
+
+    // The coefficients are only worked out again while a control is moving, every few samples
+    constexpr int updateInterval = 32;
+
+    for (int start = 0; start < buffer.getNumSamples(); start += updateInterval)
+    {
+        auto numSamples = juce::jmin(updateInterval, buffer.getNumSamples() - start);
+        auto isMoving = false;
+
+        for (auto* value : { &mLow, &mMidFrequency, &mMidGain, &mMidQ, &mHigh })
+        {
+            isMoving = isMoving || value->isSmoothing();
+            value->skip(numSamples);
+        }
+
+        if (isMoving)
+            updateCoefficients();
+
+        mFilters.process(buffer.getArrayOfWritePointers(), numChannels, start, numSamples);
+    }
+}
+
+//==============================================================================
+GuitarEffectAudioProcessor::NoiseGate::NoiseGate (juce::AudioProcessorValueTreeState& stateToUse) : state(stateToUse)
+{
+    mThresholdParameter = dynamic_cast<juce::AudioParameterFloat*>(state.getParameter(IDs::gateThreshold_id));
+    jassert(mThresholdParameter);
+    mHoldParameter = dynamic_cast<juce::AudioParameterFloat*>(state.getParameter(IDs::gateHold_id));
+    jassert(mHoldParameter);
+    mReleaseParameter = dynamic_cast<juce::AudioParameterFloat*>(state.getParameter(IDs::gateRelease_id));
+    jassert(mReleaseParameter);
+    mGateOnOff = dynamic_cast<juce::AudioParameterBool*>(state.getParameter(IDs::onoff_id8));
+    jassert(mGateOnOff);
+}
+
+void GuitarEffectAudioProcessor::NoiseGate::prepare (double sampleRate, int maximumBlockSize, int numChannels)
+{
+    mSampleRate = sampleRate;
+    mLookahead = juce::jmax(1, juce::roundToInt(sampleRate * attackSeconds));
+
+    mDelayLine.setSize(juce::jmax(1, numChannels), mLookahead);
+    mEnvelope.assign((size_t)juce::jmax(1, maximumBlockSize), 0.f);
+    mGains.assign(mEnvelope.size(), 0.f);
+
+    mWasOn = false;
+    mSamplesClosed = 0;
+}
+
+int GuitarEffectAudioProcessor::NoiseGate::getLatencySamples() const
+{
+    return mGateOnOff->get() ? mLookahead : 0;
+}
+
+void GuitarEffectAudioProcessor::NoiseGate::process (juce::AudioBuffer<float>& buffer)
+{
+    if (! mGateOnOff->get() || mEnvelope.empty() || buffer.getNumChannels() == 0)
+    {
+        mWasOn = false;
+        mSamplesClosed = 0;
+        return;
+    }
+
+    // Coming on, the lookahead starts empty and the gate shut
+    if (! mWasOn)
+    {
+        mDelayLine.clear();
+        mWritePosition = 0;
+        mGain = 0.f;
+        mHoldRemaining = 0;
+        mWasOn = true;
+    }
+
+    // Opens at the threshold, and only lets go 6 dB under it so it doesn't chatter
+    auto openLevel = juce::Decibels::decibelsToGain(getModulated(mThresholdParameter));
+    auto closeLevel = 0.5f * openLevel;
+
+    // The hold counts from the envelope, which is the lookahead ahead of the audio
+    auto holdSamples = mLookahead + juce::roundToInt(mSampleRate * getModulated(mHoldParameter) / 1000.0);
+    auto attackStep = 1.f / (float)mLookahead;
+    auto releaseStep = 1.f / (float)juce::jmax(1.0, mSampleRate * getModulated(mReleaseParameter) / 1000.0);
+
+    auto numChannels = juce::jmin(buffer.getNumChannels(), mDelayLine.getNumChannels());
+    auto* envelope = mEnvelope.data();
+    auto* gains = mGains.data();
+
+    for (int start = 0; start < buffer.getNumSamples(); start += (int)mEnvelope.size())
+    {
+        auto numSamples = juce::jmin(buffer.getNumSamples() - start, (int)mEnvelope.size());
+
+        // The loudest channel, using the gains as scratch space
+        juce::FloatVectorOperations::abs(envelope, buffer.getReadPointer(0, start), numSamples);
+
+        for (int channel = 1; channel < numChannels; ++channel)
+        {
+            juce::FloatVectorOperations::abs(gains, buffer.getReadPointer(channel, start), numSamples);
+            juce::FloatVectorOperations::max(envelope, envelope, gains, numSamples);
+        }
+
+        for (int i = 0; i < numSamples; ++i)
+        {
+            if (envelope[i] > (mHoldRemaining > 0 ? closeLevel : openLevel))
+                mHoldRemaining = holdSamples;
+            else if (mHoldRemaining > 0)
+                --mHoldRemaining;
+
+            mGain = mHoldRemaining > 0 ? juce::jmin(1.f, mGain + attackStep) : juce::jmax(0.f, mGain - releaseStep);
+            gains[i] = mGain;
+
+            if (mGain > 0.f)
+                mSamplesClosed = 0;
+            else if (mSamplesClosed < std::numeric_limits<int>::max())
+                ++mSamplesClosed;
+        }
+
+        // Then the audio through the lookahead, with the gain it's owed
+        auto position = mWritePosition;
+
+        for (int channel = 0; channel < numChannels; ++channel)
+        {
+            auto* data = buffer.getWritePointer(channel, start);
+            auto* line = mDelayLine.getWritePointer(channel);
+            position = mWritePosition;
+
+            for (int i = 0; i < numSamples; ++i)
+            {
+                auto delayed = line[position];
+                line[position] = data[i];
+                data[i] = delayed * gains[i];
+
+                if (++position == mLookahead)
+                    position = 0;
+            }
+        }
+
+        mWritePosition = position;
+    }
+}
+
+//==============================================================================
+class GuitarEffectAudioProcessor::Tuner::Analyser : public juce::Thread
+{
+public:
+    Analyser(Tuner& tunerToUse) : juce::Thread("Tuner"), tuner(tunerToUse) {}
+
+    void run() override
+    {
+        // Polled, since the audio thread mustn't signal anything
+        while (! threadShouldExit())
+        {
+            tuner.runAnalyser();
+            wait(10);
+        }
+    }
+
+private:
+    Tuner& tuner;
+};
+
+GuitarEffectAudioProcessor::Tuner::Tuner (juce::AudioProcessorValueTreeState& stateToUse) : state(stateToUse)
+{
+    mReferenceParameter = dynamic_cast<juce::AudioParameterFloat*>(state.getParameter(IDs::tunerReference_id));
+    jassert(mReferenceParameter);
+    mMuteParameter = dynamic_cast<juce::AudioParameterBool*>(state.getParameter(IDs::tunerMute_id));
+    jassert(mMuteParameter);
+    mTunerOnOff = dynamic_cast<juce::AudioParameterBool*>(state.getParameter(IDs::onoff_id9));
+    jassert(mTunerOnOff);
+
+    mFifoBuffer.assign((size_t)fifoSize, 0.f);
+    mWindow.assign((size_t)windowSize, 0.f);
+
+    mAnalyser = std::make_unique<Analyser>(*this);
+    mAnalyser->startThread();
+}
+
+GuitarEffectAudioProcessor::Tuner::~Tuner()
+{
+    mAnalyser->stopThread(4000);
+    cancelPendingUpdate();
+}
+
+void GuitarEffectAudioProcessor::Tuner::prepare (double sampleRate)
+{
+    const juce::ScopedLock sl (mAnalyserLock);
+
+    mDecimation = juce::jmax(1, juce::roundToInt(sampleRate / analysisRate));
+
+    auto decimatedRate = sampleRate / mDecimation;
+
+    // Fourth order Butterworth, well under the decimated Nyquist
+    mAntiAliasing.setCoefficients(0, BiquadCoefficients::lowPass(sampleRate, 0.4 * decimatedRate, 0.5411961001461971));
+    mAntiAliasing.setCoefficients(1, BiquadCoefficients::lowPass(sampleRate, 0.4 * decimatedRate, 1.3065629648763766));
+
+    if (mDetector == nullptr || std::abs(decimatedRate - mDetectorRate) > 1.0e-6)
+    {
+        mDetector = std::make_unique<PitchDetector>(decimatedRate, windowSize);
+        mDetectorRate = decimatedRate;
+    }
+
+    // Nothing is being pushed while the host prepares
+    mFifo.reset();
+    std::fill(mWindow.begin(), mWindow.end(), 0.f);
+    mNewSamples = 0;
+    mWasOn = false;
+}
+
+void GuitarEffectAudioProcessor::Tuner::referTo (const juce::Value& note, const juce::Value& cents, const juce::Value& frequency)
+{
+    mNote.referTo(note);
+    mCents.referTo(cents);
+    mNoteFrequency.referTo(frequency);
+
+    handleAsyncUpdate();
+}
+
+bool GuitarEffectAudioProcessor::Tuner::process (const juce::AudioBuffer<float>& buffer)
+{
+    if (! mTunerOnOff->get() || buffer.getNumChannels() == 0)
+    {
+        mWasOn = false;
+        return false;
+    }
+
+    if (! mWasOn)
+    {
+        mAntiAliasing.reset();
+        mDecimationPhase = 0;
+        mWasOn = true;
+    }
+
+    // Room for every sample this block could keep, whatever doesn't fit is dropped
+    int start1, size1, start2, size2;
+    mFifo.prepareToWrite(buffer.getNumSamples() / mDecimation + 1, start1, size1, start2, size2);
+
+    auto numChannels = buffer.getNumChannels();
+    auto channelGain = 1.f / (float)numChannels;
+    int written = 0;
+
+    for (int i = 0; i < buffer.getNumSamples(); ++i)
+    {
+        auto sample = 0.f;
+
+        for (int channel = 0; channel < numChannels; ++channel)
+            sample += buffer.getSample(channel, i);
+
+        sample = mAntiAliasing.processSample(BiquadCascade<2>::Vec::expand(sample * channelGain)).get(0);
+
+        if (++mDecimationPhase < mDecimation)
+            continue;
+
+        mDecimationPhase = 0;
+
+        if (written < size1)
+            mFifoBuffer[(size_t)(start1 + written)] = sample;
+        else if (written < size1 + size2)
+            mFifoBuffer[(size_t)(start2 + written - size1)] = sample;
+        else
+            continue;
+
+        ++written;
+    }
+
+    mFifo.finishedWrite(written);
+
+    return mMuteParameter->get();
+}
+
+void GuitarEffectAudioProcessor::Tuner::runAnalyser()
+{
+    const juce::ScopedLock sl (mAnalyserLock);
+
+    if (! mTunerOnOff->get())
+    {
+        // Switched off, the note goes blank once
+        if (mFrequency.exchange(0.f) != 0.f)
+            triggerAsyncUpdate();
+
+        return;
+    }
+
+    int start1, size1, start2, size2;
+    auto numReady = mFifo.getNumReady();
+    mFifo.prepareToRead(numReady, start1, size1, start2, size2);
+
+    // Slides the window along by what's come in
+    auto slide = [this] (const float* samples, int numSamples)
+    {
+        if (numSamples >= windowSize)
+        {
+            std::copy(samples + numSamples - windowSize, samples + numSamples, mWindow.begin());
+        }
+        else if (numSamples > 0)
+        {
+            std::move(mWindow.begin() + numSamples, mWindow.end(), mWindow.begin());
+            std::copy(samples, samples + numSamples, mWindow.end() - numSamples);
+        }
+    };
+
+    slide(mFifoBuffer.data() + start1, size1);
+    slide(mFifoBuffer.data() + start2, size2);
+    mFifo.finishedRead(size1 + size2);
+
+    mNewSamples += size1 + size2;
+
+    // However far behind the thread got, only the latest window is worth looking at
+    if (mNewSamples < hopSize || mDetector == nullptr)
+        return;
+
+    mNewSamples = 0;
+
+    auto result = mDetector->detect(mWindow.data());
+    mFrequency = result.clarity >= minimumClarity ? result.frequency : 0.f;
+
+    triggerAsyncUpdate();
+}
+
+void GuitarEffectAudioProcessor::Tuner::handleAsyncUpdate()
+{
+    auto frequency = mFrequency.load();
+
+    if (frequency <= 0.f)
+    {
+        mNote = juce::String("-");
+        mCents = 0.0;
+        mNoteFrequency = 0.0;
+        return;
+    }
+
+    // Semitones from A4 at the reference, to the nearest note and how far off it is
+    auto semitones = 69.0 + 12.0 * std::log2(frequency / mReferenceParameter->get());
+    auto nearest = juce::roundToInt(semitones);
+
+    mNote = juce::MidiMessage::getMidiNoteName(nearest, true, true, 4);
+    mCents = std::round((semitones - nearest) * 1000.0) / 10.0;
+    mNoteFrequency = std::round(frequency * 10.0) / 10.0;
+}
+
+//==============================================================================
+class GuitarEffectAudioProcessor::Routing::Loader : public juce::Thread
+{
+public:
+    Loader(Routing& routingToUse) : juce::Thread("Routing compiler"), routing(routingToUse) {}
+
+    void run() override
+    {
+        // Woken up for new routings, the timeout is for deleting retired schedules
+        while (! threadShouldExit())
+        {
+            routing.runLoader();
+            wait(50);
+        }
+    }
+
+private:
+    Routing& routing;
+};
+
+GuitarEffectAudioProcessor::Routing::Routing (juce::AudioProcessorValueTreeState& stateToUse) : state(stateToUse)
+{
+    mLoader = std::make_unique<Loader>(*this);
+    mLoader->startThread();
+}
+
+GuitarEffectAudioProcessor::Routing::~Routing()
+{
+    mLoader->stopThread(4000);
+
+    delete mPendingSchedule.exchange(nullptr);
+    delete mRetiredSchedule.exchange(nullptr);
+}
+
+void GuitarEffectAudioProcessor::Routing::prepare (int maximumBlockSize, int numChannels)
+{
+    const juce::ScopedLock sl (mLoaderLock);
+
+    mNumChannels = juce::jmax(1, numChannels);
+    mMaximumBlockSize = juce::jmax(1, maximumBlockSize);
+
+    // Nothing is processing while the host prepares, so the schedule can be rebuilt directly
+    delete mRetiredSchedule.exchange(nullptr);
+    delete mPendingSchedule.exchange(nullptr);
+    mHasRequest = false;
+
+    auto routing = state.state.getProperty(IDs::routing_id, PedalGraph::defaultRouting).toString();
+    mSchedule = PedalGraph::compile(routing, mNumChannels, mMaximumBlockSize, mRoutingError);
+
+    // A session with a routing this build can't make sense of still plays
+    if (mSchedule == nullptr)
+    {
+        juce::String ignored;
+        mSchedule = PedalGraph::compile(PedalGraph::defaultRouting, mNumChannels, mMaximumBlockSize, ignored);
+    }
+    else
+    {
+        mRoutingError.clear();
+    }
+
+    mRouting = mSchedule->getRouting();
+}
+
+void GuitarEffectAudioProcessor::Routing::process (juce::AudioBuffer<float>& buffer, PedalGraph::Effects& effects)
+{
+    // Only switch once the last schedule has been handed back, so at most one is ever waiting to be deleted
+    if (mRetiredSchedule.load() == nullptr)
+    {
+        if (auto* pending = mPendingSchedule.exchange(nullptr))
+        {
+            mRetiredSchedule = mSchedule.release();
+            mSchedule.reset(pending);
+        }
+    }
+
+    if (mSchedule != nullptr)
+        mSchedule->process(buffer, effects);
+}
+
+bool GuitarEffectAudioProcessor::Routing::setRouting (const juce::String& routing)
+{
+    // Parsed here so a bad one never reaches the session. The buffers are made on the loader thread.
+    juce::String error;
+
+    if (PedalGraph::compile(routing, 1, 1, error) == nullptr)
+    {
+        const juce::ScopedLock sl (mLoaderLock);
+        mRoutingError = error;
+        return false;
+    }
+
+    state.state.setProperty(IDs::routing_id, routing, nullptr);
+
+    {
+        const juce::ScopedLock sl (mLoaderLock);
+        mRequestedRouting = routing;
+        mHasRequest = true;
+        mRoutingError.clear();
+    }
+
+    mLoader->notify();
+    return true;
+}
+
+juce::String GuitarEffectAudioProcessor::Routing::getRouting() const
+{
+    const juce::ScopedLock sl (mLoaderLock);
+    return mRouting;
+}
+
+juce::String GuitarEffectAudioProcessor::Routing::getRoutingError() const
+{
+    const juce::ScopedLock sl (mLoaderLock);
+    return mRoutingError;
+}
+
+std::unique_ptr<PedalGraph::Schedule> GuitarEffectAudioProcessor::Routing::compileSchedule (const juce::String& routing) const
+{
+    const juce::ScopedLock sl (mLoaderLock);
+
+    if (mNumChannels == 0)
+        return {};
+
+    juce::String error;
+    return PedalGraph::compile(routing, mNumChannels, mMaximumBlockSize, error);
+}
+
+bool GuitarEffectAudioProcessor::Routing::canSwitchSchedule() const
+{
+    return mRetiredSchedule.load() == nullptr;
+}
+
+void GuitarEffectAudioProcessor::Routing::switchSchedule (std::unique_ptr<PedalGraph::Schedule>& schedule)
+{
+    if (schedule == nullptr || ! canSwitchSchedule())
+        return;
+
+    // The loader deletes the old one, the same as for a schedule from setRouting()
+    mRetiredSchedule = mSchedule.release();
+    mSchedule = std::move(schedule);
+}
+
+void GuitarEffectAudioProcessor::Routing::setSwitchedRouting (const juce::String& routing)
+{
+    state.state.setProperty(IDs::routing_id, routing, nullptr);
+
+    {
+        const juce::ScopedLock sl (mLoaderLock);
+        mRouting = routing;
+        mRoutingError.clear();
+    }
+
+    mLoader->notify();
+}
+
+void GuitarEffectAudioProcessor::Routing::runLoader()
+{
+    const juce::ScopedLock sl (mLoaderLock);
+
+    delete mRetiredSchedule.exchange(nullptr);
+
+    // Not prepared yet, prepare() picks the routing up from the state
+    if (! mHasRequest || mNumChannels == 0)
+        return;
+
+    mHasRequest = false;
+
+    // Already checked by setRouting()
+    juce::String error;
+    auto schedule = PedalGraph::compile(mRequestedRouting, mNumChannels, mMaximumBlockSize, error);
+    jassert(schedule != nullptr);
+
+    if (schedule == nullptr)
+        return;
+
+    mRouting = schedule->getRouting();
+
+    // One the audio thread never picked up can go straight away
+    delete mPendingSchedule.exchange(schedule.release());
+}
+
+//==============================================================================
+class GuitarEffectAudioProcessor::Presets::Loader : public juce::Thread
+{
+public:
+    Loader(Presets& presetsToUse) : juce::Thread("Preset loader"), presets(presetsToUse) {}
+
+    void run() override
+    {
+        // Woken up for new presets, then keeping a close eye on the slots while one's going in
+        while (! threadShouldExit())
+        {
+            presets.runLoader();
+            wait(presets.isSwitching() ? 1 : 50);
+        }
+    }
+
+private:
+    Presets& presets;
+};
+
+GuitarEffectAudioProcessor::Presets::Presets (juce::AudioProcessorValueTreeState& stateToUse, Routing& routingToUse)
+    : state(stateToUse), mRouting(routingToUse)
+{
+    mLoader = std::make_unique<Loader>(*this);
+    mLoader->startThread();
+}
+
+GuitarEffectAudioProcessor::Presets::~Presets()
+{
+    mLoader->stopThread(4000);
+
+    delete mPendingSnapshot.exchange(nullptr);
+    delete mRetiredSnapshot.exchange(nullptr);
+}
+
+void GuitarEffectAudioProcessor::Presets::prepare (double sampleRate)
+{
+    const juce::ScopedLock sl (mLoaderLock);
+
+    mFadeSamples = juce::jmax(1, (int)(fadeSeconds * sampleRate));
+    mIsPrepared = true;
+
+    // Nothing is processing, so a waiting schedule can be swapped for one that fits the new block size and channels
+    if (auto* pending = mPendingSnapshot.load())
+        if (pending->switchesRouting)
+        {
+            pending->schedule = mRouting.compileSchedule(pending->routing);
+            pending->switchesRouting = pending->schedule != nullptr;
+        }
+}
+
+bool GuitarEffectAudioProcessor::Presets::startBlock()
+{
+    // Tells the loader audio is coming through, so it leaves the switch to this thread
+    mNumBlocksProcessed.fetch_add(1);
+
+    // Only once the last one's been handed back, so at most one is ever waiting to be deleted
+    if (mRetiredSnapshot.load() != nullptr || ! mRouting.canSwitchSchedule())
+        return false;
+
+    return mPendingSnapshot.load() != nullptr;
+}
+
+void GuitarEffectAudioProcessor::Presets::switchNow()
+{
+    if (mRetiredSnapshot.load() != nullptr)
+        return;
+
+    auto* snapshot = mPendingSnapshot.exchange(nullptr);
+
+    if (snapshot == nullptr)
+        return;
+
+    /*
+    * Only the values that change, each the way the host's automation puts one
+    * in: the value and the processor's own listeners, under JUCE's listener lock.
+    */
+    {
+        RealtimeSafety::ScopedAllowNonRealtime allowListenerLock;
+
+        for (auto& entry : snapshot->values)
+        {
+            if (entry.first->getValue() != entry.second)
+            {
+                entry.first->setValue(entry.second);
+                entry.first->sendValueChangedMessageToListeners(entry.second);
+            }
+        }
+    }
+
+    mRouting.switchSchedule(snapshot->schedule);
+
+    // The loader finishes the bookkeeping and deletes it
+    mRetiredSnapshot = snapshot;
+}
+
+void GuitarEffectAudioProcessor::Presets::load (const Preset& preset)
+{
+    {
+        const juce::ScopedLock sl (mLoaderLock);
+        mRequest = preset;
+        mHasRequest = true;
+    }
+
+    mLoader->notify();
+}
+
+juce::String GuitarEffectAudioProcessor::Presets::getCurrentName() const
+{
+    const juce::ScopedLock sl (mLoaderLock);
+    return mCurrentName;
+}
+
+bool GuitarEffectAudioProcessor::Presets::isSwitching() const
+{
+    {
+        const juce::ScopedLock sl (mLoaderLock);
+
+        if (mHasRequest)
+            return true;
+    }
+
+    return mPendingSnapshot.load() != nullptr || mRetiredSnapshot.load() != nullptr;
+}
+
+std::unique_ptr<GuitarEffectAudioProcessor::Presets::Snapshot> GuitarEffectAudioProcessor::Presets::makeSnapshot (const Preset& preset) const
+{
+    auto snapshot = std::make_unique<Snapshot>();
+    snapshot->name = preset.name;
+
+    for (auto* parameter : state.processor.getParameters())
+    {
+        auto* ranged = dynamic_cast<juce::RangedAudioParameter*>(parameter);
+
+        if (ranged == nullptr)
+            continue;
+
+        auto value = ranged->getDefaultValue();
+
+        for (auto& entry : preset.values)
+            if (entry.first == ranged->paramID)
+                value = ranged->convertTo0to1(entry.second);
+
+        snapshot->values.emplace_back(ranged, value);
+    }
+
+    // Written out the way the routing will give it back, and the default for one that doesn't make sense
+    juce::String error;
+    auto schedule = PedalGraph::compile(preset.routing.isEmpty() ? juce::String(PedalGraph::defaultRouting) : preset.routing, 1, 1, error);
+    jassert(schedule != nullptr);
+
+    snapshot->routing = schedule != nullptr ? schedule->getRouting() : juce::String(PedalGraph::defaultRouting);
+
+    // Built here for the audio thread to put straight in, only if it's a change
+    if (mRouting.getRouting() != snapshot->routing)
+    {
+        snapshot->schedule = mRouting.compileSchedule(snapshot->routing);
+        snapshot->switchesRouting = snapshot->schedule != nullptr;
+    }
+
+    return snapshot;
+}
+
+void GuitarEffectAudioProcessor::Presets::finish (Snapshot& snapshot)
+{
+    mCurrentName = snapshot.name;
+
+    if (snapshot.switchesRouting)
+        mRouting.setSwitchedRouting(snapshot.routing);
+}
+
+void GuitarEffectAudioProcessor::Presets::runLoader()
+{
+    const juce::ScopedLock sl (mLoaderLock);
+
+    // Switched on the audio thread, with only the bookkeeping left
+    if (auto* retired = mRetiredSnapshot.load())
+    {
+        std::unique_ptr<Snapshot> snapshot (retired);
+        finish(*snapshot);
+        mRetiredSnapshot = nullptr;
+    }
+
+    // A newer request replaces whatever the audio thread hasn't taken yet
+    if (mHasRequest)
+    {
+        mHasRequest = false;
+
+        auto snapshot = makeSnapshot(mRequest);
+
+        mHandedOverTime = juce::Time::getMillisecondCounter();
+        mBlocksAtHandOver = mNumBlocksProcessed.load();
+
+        delete mPendingSnapshot.exchange(snapshot.release());
+        return;
+    }
+
+    // No block at all since it was handed over, so nothing's playing and the loader can put it in itself
+    auto isIdle = mNumBlocksProcessed.load() == mBlocksAtHandOver
+                   && juce::Time::getMillisecondCounter() - mHandedOverTime > (juce::uint32)idleTimeoutMs;
+
+    if (mIsPrepared && ! isIdle)
+        return;
+
+    if (auto* pending = mPendingSnapshot.exchange(nullptr))
+    {
+        std::unique_ptr<Snapshot> snapshot (pending);
+
+        for (auto& entry : snapshot->values)
+            if (entry.first->getValue() != entry.second)
+                entry.first->setValueNotifyingHost(entry.second);
+
+        mCurrentName = snapshot->name;
+
+        if (mRouting.getRouting() != snapshot->routing)
+            mRouting.setRouting(snapshot->routing);
+    }
+}
+
+//==============================================================================
+class GuitarEffectAudioProcessor::MidiControl::Loader : public juce::Thread
+{
+public:
+    Loader(MidiControl& controlToUse) : juce::Thread("MIDI control"), control(controlToUse) {}
+
+    void run() override
+    {
+        // Nothing from the audio thread wakes it, so it looks often
+        while (! threadShouldExit())
+        {
+            control.runLoader();
+            wait(10);
+        }
+    }
+
+private:
+    MidiControl& control;
+};
+
+GuitarEffectAudioProcessor::MidiControl::MidiControl (juce::AudioProcessorValueTreeState& stateToUse)
+    : state(stateToUse)
+{
+    for (auto* parameter : state.processor.getParameters())
+        if (auto* ranged = dynamic_cast<juce::RangedAudioParameter*>(parameter))
+            mParameters.add(ranged);
+
+    for (int i = 0; i < numControllers; ++i)
+    {
+        mMappings[(size_t)i] = -1;
+        mToggles[(size_t)i] = false;
+    }
+
+    readMappings();
+    state.state.addListener(this);
+
+    mLoader = std::make_unique<Loader>(*this);
+    mLoader->startThread();
+}
+
+GuitarEffectAudioProcessor::MidiControl::~MidiControl()
+{
+    mLoader->stopThread(4000);
+    state.state.removeListener(this);
+}
+
+void GuitarEffectAudioProcessor::MidiControl::handle (const juce::MidiMessage& message, int samplePosition, Automation& automation)
+{
+    if (message.isProgramChange())
+    {
+        mPendingProgram = message.getProgramChangeNumber();
+        return;
+    }
+
+    if (! message.isController())
+        return;
+
+    auto controller = (size_t)message.getControllerNumber();
+    auto value = message.getControllerValue();
+
+    // Learning takes the first controller that moves, which then carries on as normal
+    auto learning = mLearning.exchange(-1);
+
+    if (learning >= 0)
+    {
+        mMappings[controller] = learning;
+        mToggles[controller] = mParameters[learning]->getNumSteps() == 2;
+        mMappingsChanged = true;
+    }
+
+    auto index = mMappings[controller].load();
+
+    if (index < 0)
+        return;
+
+    auto* parameter = mParameters[index];
+
+    // Footswitches toggle when they go down, whatever they send when they come back up
+    if (mToggles[controller])
+    {
+        auto isPressed = value >= 64;
+
+        if (isPressed && ! mIsPressed[controller])
+            automation.addToggle(parameter, samplePosition);
+
+        mIsPressed[controller] = isPressed;
+        return;
+    }
+
+    automation.add(parameter, (float)value / 127.f, samplePosition);
+}
+
+void GuitarEffectAudioProcessor::MidiControl::setMapping (int controller, const juce::String& parameterID, bool toggles)
+{
+    if (! juce::isPositiveAndBelow(controller, numControllers))
+        return;
+
+    mMappings[(size_t)controller] = getParameterIndex(parameterID);
+    mToggles[(size_t)controller] = toggles;
+    mMappingsChanged = true;
+
+    saveMappings();
+}
+
+juce::String GuitarEffectAudioProcessor::MidiControl::getMapping (int controller) const
+{
+    if (! juce::isPositiveAndBelow(controller, numControllers))
+        return {};
+
+    auto index = mMappings[(size_t)controller].load();
+    return index >= 0 ? mParameters[index]->paramID : juce::String();
+}
+
+bool GuitarEffectAudioProcessor::MidiControl::isToggle (int controller) const
+{
+    return juce::isPositiveAndBelow(controller, numControllers) && mToggles[(size_t)controller].load();
+}
+
+void GuitarEffectAudioProcessor::MidiControl::learn (const juce::String& parameterID)
+{
+    mLearning = getParameterIndex(parameterID);
+}
+
+bool GuitarEffectAudioProcessor::MidiControl::isLearning() const
+{
+    return mLearning.load() >= 0;
+}
+
+int GuitarEffectAudioProcessor::MidiControl::getParameterIndex (const juce::String& parameterID) const
+{
+    for (int i = 0; i < mParameters.size(); ++i)
+        if (mParameters[i]->paramID == parameterID)
+            return i;
+
+    return -1;
+}
+
+void GuitarEffectAudioProcessor::MidiControl::runLoader()
+{
+    auto program = mPendingProgram.exchange(-1);
+
+    if (program >= 0 && onProgramChange != nullptr)
+        onProgramChange(program);
+}
+
+void GuitarEffectAudioProcessor::MidiControl::saveMappings()
+{
+    if (! mMappingsChanged.exchange(false))
+        return;
+
+    mSavedMappings = writeMappings();
+    state.state.setProperty(IDs::midiMappings_id, mSavedMappings, nullptr);
+}
+
+void GuitarEffectAudioProcessor::MidiControl::readMappings()
+{
+    auto text = state.state.getProperty(IDs::midiMappings_id, getDefaultMappings()).toString();
+
+    // Our own write coming back round
+    if (text == mSavedMappings)
+        return;
+
+    mSavedMappings = text;
+
+    for (int i = 0; i < numControllers; ++i)
+        mMappings[(size_t)i] = -1;
+
+    // "controller parameter [toggle]", separated by commas
+    for (auto& mapping : juce::StringArray::fromTokens(text, ",", {}))
+    {
+        auto tokens = juce::StringArray::fromTokens(mapping.trim(), " ", {});
+        auto controller = tokens[0].getIntValue();
+
+        if (tokens.size() < 2 || ! juce::isPositiveAndBelow(controller, numControllers))
+            continue;
+
+        mMappings[(size_t)controller] = getParameterIndex(tokens[1]);
+        mToggles[(size_t)controller] = tokens[2] == "toggle";
+    }
+}
+
+juce::String GuitarEffectAudioProcessor::MidiControl::writeMappings() const
+{
+    juce::StringArray mappings;
+
+    for (int i = 0; i < numControllers; ++i)
+    {
+        auto index = mMappings[(size_t)i].load();
+
+        if (index >= 0)
+            mappings.add(juce::String(i) + " " + mParameters[index]->paramID + (mToggles[(size_t)i] ? " toggle" : ""));
+    }
+
+    return mappings.joinIntoString(", ");
+}
+
+void GuitarEffectAudioProcessor::MidiControl::valueTreePropertyChanged (juce::ValueTree& tree, const juce::Identifier& property)
+{
+    // A session being loaded, or saveMappings()
+    if (tree == state.state && property.toString() == IDs::midiMappings_id)
+        readMappings();
+}
+
+//==============================================================================
+void GuitarEffectAudioProcessor::Automation::prepare()
+{
+    mFirstEvent = 0;
+    mNumEvents = 0;
+    mTime = 0;
+
+    // Nothing in yet, so the first change doesn't have to wait
+    mLastChangeTime = std::numeric_limits<juce::int64>::min() / 2;
+}
+
+void GuitarEffectAudioProcessor::Automation::setMinimumSubBlock (int numSamples)
+{
+    mMinimumSubBlock = juce::jmax(1, numSamples);
+}
+
+bool GuitarEffectAudioProcessor::Automation::add (juce::RangedAudioParameter* parameter, float normalisedValue, int samplePosition)
+{
+    return insert({ mTime + juce::jmax(0, samplePosition), parameter, juce::jlimit(0.f, 1.f, normalisedValue) });
+}
+
+bool GuitarEffectAudioProcessor::Automation::addToggle (juce::RangedAudioParameter* parameter, int samplePosition)
+{
+    return insert({ mTime + juce::jmax(0, samplePosition), parameter, -1.f });
+}
+
+bool GuitarEffectAudioProcessor::Automation::insert (const Event& event)
+{
+    if (event.parameter == nullptr)
+        return false;
+
+    auto time = event.time;
+
+    if (mFirstEvent + mNumEvents == maximumEvents)
+    {
+        if (mFirstEvent == 0)
+            return false;
+
+        std::move(mEvents.begin() + mFirstEvent, mEvents.begin() + mFirstEvent + mNumEvents, mEvents.begin());
+        mFirstEvent = 0;
+    }
+
+    // Almost always on the end, so from the back
+    auto position = mFirstEvent + mNumEvents;
+
+    while (position > mFirstEvent && mEvents[(size_t)position - 1].time > time)
+    {
+        mEvents[(size_t)position] = mEvents[(size_t)position - 1];
+        --position;
+    }
+
+    mEvents[(size_t)position] = { time, event.parameter, event.value };
+    ++mNumEvents;
+    return true;
+}
+
+void GuitarEffectAudioProcessor::Automation::applyDueEvents()
+{
+    // Too soon after the last change, whatever's due waits
+    if (mTime < mLastChangeTime + mMinimumSubBlock)
+        return;
+
+    while (mNumEvents > 0 && mEvents[(size_t)mFirstEvent].time <= mTime)
+    {
+        auto& event = mEvents[(size_t)mFirstEvent];
+        auto* parameter = event.parameter;
+        auto value = event.value < 0.f ? (parameter->getValue() > 0.5f ? 0.f : 1.f) : event.value;
+
+        /*
+        * Like a wrapper with the host's automation: the value and the
+        * processor's own listeners, and nothing sent to the host from here.
+        * The listeners are called under JUCE's listener lock and an editor's
+        * may post to the message thread, just as for the host's automation.
+        */
+        {
+            RealtimeSafety::ScopedAllowNonRealtime allowListenerLock;
+            parameter->setValue(value);
+            parameter->sendValueChangedMessageToListeners(value);
+        }
+
+        mLastChangeTime = mTime;
+        ++mFirstEvent;
+        --mNumEvents;
+    }
+
+    if (mNumEvents == 0)
+        mFirstEvent = 0;
+}
+
+int GuitarEffectAudioProcessor::Automation::getSamplesToNextEvent (int maximumSamples) const
+{
+    if (mNumEvents == 0)
+        return maximumSamples;
+
+    auto next = juce::jmax(mEvents[(size_t)mFirstEvent].time, mLastChangeTime + mMinimumSubBlock);
+    return (int)juce::jlimit((juce::int64)1, (juce::int64)maximumSamples, next - mTime);
+}
+
+void GuitarEffectAudioProcessor::Automation::advance (int numSamples)
+{
+    mTime += numSamples;
+}
+
+//==============================================================================
+float GuitarEffectAudioProcessor::Modulated::getModulated (const juce::AudioParameterFloat* parameter) const
+{
+    auto offset = mModulation != nullptr ? mModulation->getOffset(*parameter) : 0.f;
+
+    // Unmodulated, exactly what it always read
+    if (offset == 0.f)
+        return parameter->get();
+
+    return ModulationMatrix::applyOffset(*parameter, offset);
+}
+
+//==============================================================================
+GuitarEffectAudioProcessor::ModulationMatrix::ModulationMatrix (juce::AudioProcessorValueTreeState& stateToUse)
+    : state(stateToUse)
+{
+    // Only the continuous parameters, as there's nothing between a switch's or a choice's values to move through
+    for (auto* parameter : state.processor.getParameters())
+    {
+        auto* ranged = dynamic_cast<juce::AudioParameterFloat*>(parameter);
+        mRows.push_back(ranged != nullptr ? mParameters.size() : -1);
+
+        if (ranged != nullptr)
+            mParameters.add(ranged);
+    }
+
+    mOffsets.resize((size_t)mParameters.size());
+
+    for (auto& value : mSourceValues)
+        value = 0.f;
+
+    juce::String error;
+    mConfig = parse({}, error);
+
+    state.state.addListener(this);
+}
+
+GuitarEffectAudioProcessor::ModulationMatrix::~ModulationMatrix()
+{
+    state.state.removeListener(this);
+
+    delete mPendingConfig.exchange(nullptr);
+    delete mRetiredConfig.exchange(nullptr);
+}
+
+void GuitarEffectAudioProcessor::ModulationMatrix::setControlPeriod (int numSamples)
+{
+    mControlPeriod = juce::jmax(1, numSamples);
+}
+
+void GuitarEffectAudioProcessor::ModulationMatrix::prepare (double sampleRate)
+{
+    mSampleRate = sampleRate;
+    mTime = 0;
+    mPhases = {};
+    mSources = {};
+    std::fill(mOffsets.begin(), mOffsets.end(), 0.f);
+
+    // Set again from the config at the first update
+    for (auto& follower : mFollowers)
+        follower.prepare(sampleRate, mControlPeriod);
+
+    mFollowerAttacks = {};
+    mFollowerReleases = {};
+
+    // Nothing's playing, so the session's modulation goes straight in
+    auto modulation = state.state.getProperty(IDs::modulation_id).toString();
+    juce::String error;
+    auto config = parse(modulation, error);
+
+    if (config == nullptr)
+        config = parse({}, error);
+
+    delete mPendingConfig.exchange(nullptr);
+    delete mRetiredConfig.exchange(nullptr);
+    swapConfig(std::move(config));
+
+    const juce::ScopedLock sl (mTextLock);
+    mModulation = modulation;
+}
+
+bool GuitarEffectAudioProcessor::ModulationMatrix::setModulation (const juce::String& modulation)
+{
+    juce::String error;
+    auto config = parse(modulation, error);
+
+    {
+        const juce::ScopedLock sl (mTextLock);
+        mModulationError = error;
+
+        if (config == nullptr)
+            return false;
+
+        mModulation = modulation;
+    }
+
+    // Once the audio thread's finished with the last one
+    delete mRetiredConfig.exchange(nullptr);
+    delete mPendingConfig.exchange(config.release());
+
+    state.state.setProperty(IDs::modulation_id, modulation, nullptr);
+    return true;
+}
+
+juce::String GuitarEffectAudioProcessor::ModulationMatrix::getModulation() const
+{
+    const juce::ScopedLock sl (mTextLock);
+    return mModulation;
+}
+
+juce::String GuitarEffectAudioProcessor::ModulationMatrix::getModulationError() const
+{
+    const juce::ScopedLock sl (mTextLock);
+    return mModulationError;
+}
+
+std::unique_ptr<GuitarEffectAudioProcessor::ModulationMatrix::Config> GuitarEffectAudioProcessor::ModulationMatrix::parse (const juce::String& modulation, juce::String& error) const
+{
+    auto config = std::make_unique<Config>();
+    config->shapes.fill(sine);
+    config->rates.fill(1.f);
+    config->attacks.fill(10.f);
+    config->releases.fill(200.f);
+    config->controllers.fill(-1);
+    config->depths.assign((size_t)(numSources * mParameters.size()), 0.f);
+
+    const juce::StringArray shapeNames { "sine", "triangle", "square", "saw" };
+
+    // "lfo2" to 1, or 0 for anything else
+    auto getNumber = [] (const juce::String& token, const char* prefix, int maximum)
+    {
+        if (! token.startsWith(prefix))
+            return 0;
+
+        auto number = token.substring((int)std::strlen(prefix)).getIntValue();
+        return juce::isPositiveAndNotGreaterThan(number, maximum) ? number : 0;
+    };
+
+    auto getSource = [&] (const juce::String& token)
+    {
+        if (auto lfo = getNumber(token, "lfo", numLFOs))
+            return lfo - 1;
+
+        if (auto envelope = getNumber(token, "env", numEnvelopes))
+            return numLFOs + envelope - 1;
+
+        if (auto midi = getNumber(token, "midi", numMidiSources))
+            return numLFOs + numEnvelopes + midi - 1;
+
+        return -1;
+    };
+
+    for (auto& statement : juce::StringArray::fromTokens(modulation, ",", {}))
+    {
+        auto tokens = juce::StringArray::fromTokens(statement.trim(), " ", {});
+        tokens.removeEmptyStrings();
+
+        if (tokens.isEmpty())
+            continue;
+
+        auto source = getSource(tokens[0]);
+
+        if (source < 0)
+        {
+            error = "Unknown source \"" + tokens[0] + "\"";
+            return nullptr;
+        }
+
+        if (tokens[1] == ">")
+        {
+            auto target = -1;
+
+            for (int i = 0; i < mParameters.size(); ++i)
+                if (mParameters[i]->paramID == tokens[2])
+                    target = i;
+
+            auto depth = tokens[3].getFloatValue();
+
+            if (target < 0 || tokens.size() != 4 || std::abs(depth) > 1.f)
+            {
+                error = "Can't route \"" + statement.trim() + "\"";
+                return nullptr;
+            }
+
+            config->depths[(size_t)(source * mParameters.size() + target)] = depth;
+        }
+        else if (source < numLFOs)
+        {
+            auto shape = shapeNames.indexOf(tokens[1]);
+            auto rate = tokens[2].getFloatValue();
+
+            if (shape < 0 || tokens.size() != 3 || rate < 0.01f || rate > 20.f)
+            {
+                error = "An LFO is a shape and a rate from 0.01 to 20 Hz";
+                return nullptr;
+            }
+
+            config->shapes[(size_t)source] = shape;
+            config->rates[(size_t)source] = rate;
+        }
+        else if (source < numLFOs + numEnvelopes)
+        {
+            auto attack = tokens[1].getFloatValue();
+            auto release = tokens[2].getFloatValue();
+
+            if (tokens.size() != 3 || attack < 0.1f || release < 0.1f || attack > 5000.f || release > 5000.f)
+            {
+                error = "An envelope is an attack and a release from 0.1 to 5000 ms";
+                return nullptr;
+            }
+
+            config->attacks[(size_t)(source - numLFOs)] = attack;
+            config->releases[(size_t)(source - numLFOs)] = release;
+        }
+        else
+        {
+            auto controller = tokens[1].getIntValue();
+
+            if (tokens.size() != 2 || ! juce::isPositiveAndBelow(controller, 128))
+            {
+                error = "A MIDI source is a controller number from 0 to 127";
+                return nullptr;
+            }
+
+            config->controllers[(size_t)(source - numLFOs - numEnvelopes)] = controller;
+        }
+    }
+
+    for (int target = 0; target < mParameters.size(); ++target)
+        for (int source = 0; source < numSources; ++source)
+            if (config->depths[(size_t)(source * mParameters.size() + target)] != 0.f)
+            {
+                config->targets.push_back(target);
+                break;
+            }
+
+    return config;
+}
+
+std::unique_ptr<GuitarEffectAudioProcessor::ModulationMatrix::Config> GuitarEffectAudioProcessor::ModulationMatrix::swapConfig (std::unique_ptr<Config> config)
+{
+    // Parameters that aren't modulated any more go back to where they were set
+    if (mConfig != nullptr)
+        for (auto target : mConfig->targets)
+            if (std::find(config->targets.begin(), config->targets.end(), target) == config->targets.end())
+                mOffsets[(size_t)target] = 0.f;
+
+    std::swap(mConfig, config);
+    return config;
+}
+
+void GuitarEffectAudioProcessor::ModulationMatrix::handleMidi (const juce::MidiMessage& message)
+{
+    if (! message.isController())
+        return;
+
+    for (int i = 0; i < numMidiSources; ++i)
+        if (mConfig->controllers[(size_t)i] == message.getControllerNumber())
+            mMidiValues[(size_t)i] = (float)message.getControllerValue() / 127.f;
+}
+
+int GuitarEffectAudioProcessor::ModulationMatrix::getSamplesToNextUpdate (int maximumSamples) const
+{
+    // Without routes there's nothing to split a block for
+    if (mConfig->targets.empty())
+        return maximumSamples;
+
+    return juce::jmin(maximumSamples, mControlPeriod - (int)(mTime % mControlPeriod));
+}
+
+void GuitarEffectAudioProcessor::ModulationMatrix::update (const juce::AudioBuffer<float>& input)
+{
+    // The last one goes back for the message thread to delete
+    if (mRetiredConfig.load() == nullptr)
+        if (auto* config = mPendingConfig.exchange(nullptr))
+            mRetiredConfig = swapConfig(std::unique_ptr<Config>(config)).release();
+
+    if (mConfig->targets.empty() || mTime % mControlPeriod != 0)
+        return;
+
+    updateSources(input);
+    updateTargets();
+}
+
+void GuitarEffectAudioProcessor::ModulationMatrix::advance (int numSamples)
+{
+    mTime += numSamples;
+}
+
+float GuitarEffectAudioProcessor::ModulationMatrix::getSourceValue (int source) const
+{
+    return juce::isPositiveAndBelow(source, numSources) ? mSourceValues[(size_t)source].load() : 0.f;
+}
+
+float GuitarEffectAudioProcessor::ModulationMatrix::getOffset (const juce::RangedAudioParameter& parameter) const
+{
+    auto index = parameter.getParameterIndex();
+
+    if (! juce::isPositiveAndBelow(index, (int)mRows.size()) || mRows[(size_t)index] < 0)
+        return 0.f;
+
+    return mOffsets[(size_t)mRows[(size_t)index]];
+}
+
+float GuitarEffectAudioProcessor::ModulationMatrix::applyOffset (const juce::RangedAudioParameter& parameter, float offset)
+{
+    return parameter.getNormalisableRange().convertFrom0to1(juce::jlimit(0.f, 1.f, parameter.getValue() + offset));
+}
+
+void GuitarEffectAudioProcessor::ModulationMatrix::updateSources (const juce::AudioBuffer<float>& input)
+{
+    auto& config = *mConfig;
+    auto periodSeconds = (double)mControlPeriod / mSampleRate;
+
+    for (int i = 0; i < numLFOs; ++i)
+    {
+        auto phase = mPhases[(size_t)i];
+        float value;
+
+        switch (config.shapes[(size_t)i])
+        {
+            case triangle:  value = 1.f - 4.f * (float)std::abs(phase - 0.5); break;
+            case square:    value = phase < 0.5 ? 1.f : -1.f; break;
+            case saw:       value = 2.f * (float)phase - 1.f; break;
+            default:        value = (float)std::sin(juce::MathConstants<double>::twoPi * phase); break;
+        }
+
+        mSources[(size_t)i] = value;
+        mPhases[(size_t)i] = std::fmod(phase + config.rates[(size_t)i] * periodSeconds, 1.0);
+    }
+
+    // The followers run over the period's input, a block at a time, and the source is where they end up
+    auto numSamples = juce::jmin(input.getNumSamples(), mControlPeriod);
+
+    for (int i = 0; i < numEnvelopes; ++i)
+    {
+        auto& follower = mFollowers[(size_t)i];
+
+        if (config.attacks[(size_t)i] != mFollowerAttacks[(size_t)i] || config.releases[(size_t)i] != mFollowerReleases[(size_t)i])
+        {
+            mFollowerAttacks[(size_t)i] = config.attacks[(size_t)i];
+            mFollowerReleases[(size_t)i] = config.releases[(size_t)i];
+            follower.setTimes(mFollowerAttacks[(size_t)i], mFollowerReleases[(size_t)i]);
+        }
+
+        follower.process(input.getArrayOfReadPointers(), input.getNumChannels(), numSamples);
+        mSources[(size_t)(numLFOs + i)] = follower.getLastValue();
+    }
+
+    for (int i = 0; i < numMidiSources; ++i)
+        mSources[(size_t)(numLFOs + numEnvelopes + i)] = mMidiValues[(size_t)i];
+
+    for (int i = 0; i < numSources; ++i)
+        mSourceValues[(size_t)i] = mSources[(size_t)i];
+}
+
+void GuitarEffectAudioProcessor::ModulationMatrix::updateTargets()
+{
+    auto& config = *mConfig;
+    auto numParameters = mParameters.size();
+
+    // The matrix times the sources, a column at a time, into the offsets the pedals read
+    juce::FloatVectorOperations::clear(mOffsets.data(), numParameters);
+
+    for (int source = 0; source < numSources; ++source)
+        if (mSources[(size_t)source] != 0.f)
+            juce::FloatVectorOperations::addWithMultiply(mOffsets.data(), config.depths.data() + source * numParameters, mSources[(size_t)source], numParameters);
+}
+
+void GuitarEffectAudioProcessor::ModulationMatrix::valueTreePropertyChanged (juce::ValueTree& tree, const juce::Identifier& property)
+{
+    // A session being loaded. Our own writes come back round too, with nothing changed.
+    if (tree != state.state || property.toString() != IDs::modulation_id)
+        return;
+
+    auto modulation = tree.getProperty(property).toString();
+
+    if (modulation != getModulation())
+        setModulation(modulation);
+}
+
+//==============================================================================
+GuitarEffectAudioProcessor::AutoWah::AutoWah (juce::AudioProcessorValueTreeState& stateToUse) : state(stateToUse)
+{
+    mFrequencyParameter = dynamic_cast<juce::AudioParameterFloat*>(state.getParameter(IDs::wahFrequency_id));
+    jassert(mFrequencyParameter);
+    mRangeParameter = dynamic_cast<juce::AudioParameterFloat*>(state.getParameter(IDs::wahRange_id));
+    jassert(mRangeParameter);
+    mResonanceParameter = dynamic_cast<juce::AudioParameterFloat*>(state.getParameter(IDs::wahResonance_id));
+    jassert(mResonanceParameter);
+    mSensitivityParameter = dynamic_cast<juce::AudioParameterFloat*>(state.getParameter(IDs::wahSensitivity_id));
+    jassert(mSensitivityParameter);
+    mAttackParameter = dynamic_cast<juce::AudioParameterFloat*>(state.getParameter(IDs::wahAttack_id));
+    jassert(mAttackParameter);
+    mReleaseParameter = dynamic_cast<juce::AudioParameterFloat*>(state.getParameter(IDs::wahRelease_id));
+    jassert(mReleaseParameter);
+    mDryWetParameter = dynamic_cast<juce::AudioParameterFloat*>(state.getParameter(IDs::dryWet_id6));
+    jassert(mDryWetParameter);
+    mAutoWahOnOff = dynamic_cast<juce::AudioParameterBool*>(state.getParameter(IDs::onoff_id10));
+    jassert(mAutoWahOnOff);
+}
+
+void GuitarEffectAudioProcessor::AutoWah::prepare (double sampleRate, int maximumBlockSize, int numChannels)
+{
+    juce::ignoreUnused(maximumBlockSize);
+
+    // The follower only ever gets an interval at a time
+    mSampleRate = sampleRate;
+    mFollower.prepare(sampleRate, coefficientInterval);
+
+    mInterval.setSize(juce::jmax(1, numChannels), coefficientInterval);
+    mInterval.clear();
+
+    mState1.assign((size_t)juce::jmax(1, numChannels), 0.f);
+    mState2.assign(mState1.size(), 0.f);
+
+    // The follower's times are set again at the first block
+    mAttack = mRelease = -1.f;
+    mIntervalRemaining = 0;
+    mHasCoefficients = false;
+    mWasOn = false;
+}
+
+void GuitarEffectAudioProcessor::AutoWah::process (juce::AudioBuffer<float>& buffer)
+{
+    if (! mAutoWahOnOff->get() || mState1.empty())
+    {
+        // Still counting the intervals, so they're where they'd have been if it had been on
+        mIntervalRemaining = ((mIntervalRemaining - buffer.getNumSamples()) % coefficientInterval + coefficientInterval) % coefficientInterval;
+        mWasOn = false;
+        return;
+    }
+
+    // Coming on, from a closed filter and a quiet envelope, and with coefficients for what's left of the interval
+    if (! mWasOn)
+    {
+        std::fill(mState1.begin(), mState1.end(), 0.f);
+        std::fill(mState2.begin(), mState2.end(), 0.f);
+        mFollower.reset();
+        mInterval.clear();
+        mHasCoefficients = false;
+        mWasOn = true;
+    }
+
+    auto numChannels = juce::jmin(buffer.getNumChannels(), (int)mState1.size());
+    auto numSamples = buffer.getNumSamples();
+
+    // A few pow()s, so only when they've moved
+    auto attack = getModulated(mAttackParameter);
+    auto release = getModulated(mReleaseParameter);
+
+    if (attack != mAttack || release != mRelease)
+    {
+        mAttack = attack;
+        mRelease = release;
+        mFollower.setTimes(mAttack, mRelease);
+    }
+
+    auto sensitivity = juce::Decibels::decibelsToGain(getModulated(mSensitivityParameter));
+    auto lowest = getModulated(mFrequencyParameter);
+    auto range = getModulated(mRangeParameter);
+    auto k = 1.f / getModulated(mResonanceParameter);
+    auto wet = getModulated(mDryWetParameter);
+    auto dry = 1.f - wet;
+
+    for (int start = 0; start < numSamples;)
+    {
+        // Where the envelope had got to when an interval starts sets the centre for all of it
+        if (mIntervalRemaining == 0 || ! mHasCoefficients)
+        {
+            auto amount = juce::jlimit(0.f, 1.f, mFollower.getLastValue() * sensitivity);
+            auto frequency = juce::jmin(lowest * std::exp2(range * amount), 0.45f * (float)mSampleRate);
+
+            auto g = (float)std::tan(juce::MathConstants<double>::pi * frequency / mSampleRate);
+            mK = k;
+            mA1 = 1.f / (1.f + g * (g + mK));
+            mA2 = g * mA1;
+            mA3 = g * mA2;
+
+            if (mIntervalRemaining == 0)
+                mIntervalRemaining = coefficientInterval;
+
+            mHasCoefficients = true;
+        }
+
+        auto end = juce::jmin(numSamples, start + mIntervalRemaining);
+        auto position = coefficientInterval - mIntervalRemaining;
+        auto a1 = mA1, a2 = mA2, a3 = mA3, q = mK;
+
+        for (int channel = 0; channel < numChannels; ++channel)
+        {
+            auto* channelData = buffer.getWritePointer(channel);
+            auto ic1 = mState1[(size_t)channel];
+            auto ic2 = mState2[(size_t)channel];
+
+            // The dry input, for the follower
+            mInterval.copyFrom(channel, position, channelData + start, end - start);
+
+            for (int i = start; i < end; ++i)
+            {
+                auto x = channelData[i];
+                auto v3 = x - ic2;
+                auto v1 = a1 * ic1 + a2 * v3;
+                auto v2 = ic2 + a2 * ic1 + a3 * v3;
+
+                ic1 = 2.f * v1 - ic1;
+                ic2 = 2.f * v2 - ic2;
+
+                // The band-pass, scaled to unity at its peak
+                channelData[i] = dry * x + wet * q * v1;
+            }
+
+            mState1[(size_t)channel] = ic1;
+            mState2[(size_t)channel] = ic2;
+        }
+
+        mIntervalRemaining -= end - start;
+        start = end;
+
+        // A whole interval in, so the follower has it all at once
+        if (mIntervalRemaining == 0)
+            mFollower.process(mInterval.getArrayOfReadPointers(), numChannels, coefficientInterval);
+    }
+}
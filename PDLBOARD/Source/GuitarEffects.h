@@ -11,8 +11,22 @@
 #pragma once
 
 #include <JuceHeader.h>
+#include "PartitionedConvolution.h"
+#include "NonUniformConvolution.h"
+#include "FeedbackDelayNetwork.h"
+#include "NeuralAmpModel.h"
+#include "ClippingCircuits.h"
+#include "TubePreamp.h"
+#include "MultibandOverdrive.h"
+#include "BiquadCascade.h"
+#include "PitchDetector.h"
+#include "PedalGraph.h"
+#include "EnvelopeFollower.h"
+#include "MultiTapDelay.h"
 
 #define MAX_DELAY_TIME 2
+#define MAX_CAB_IR_TIME 1
+#define MAX_REVERB_IR_TIME 10
 
 
 class GuitarEffectAudioProcessor : public juce::AudioProcessor
@@ -21,9 +35,36 @@ public:
     static void addODParameters(juce::AudioProcessorValueTreeState::ParameterLayout& layout);
     static void addDelayParameters(juce::AudioProcessorValueTreeState::ParameterLayout& layout);
     static void addChorusParameters(juce::AudioProcessorValueTreeState::ParameterLayout& layout);
+    static void addCabParameters(juce::AudioProcessorValueTreeState::ParameterLayout& layout);
+    static void addReverbParameters(juce::AudioProcessorValueTreeState::ParameterLayout& layout);
+    static void addFDNReverbParameters(juce::AudioProcessorValueTreeState::ParameterLayout& layout);
+    static void addEQParameters(juce::AudioProcessorValueTreeState::ParameterLayout& layout);
+    static void addGateParameters(juce::AudioProcessorValueTreeState::ParameterLayout& layout);
+    static void addTunerParameters(juce::AudioProcessorValueTreeState::ParameterLayout& layout);
+    static void addAutoWahParameters(juce::AudioProcessorValueTreeState::ParameterLayout& layout);
 
     GuitarEffectAudioProcessor() = default;
 
+    class ModulationMatrix;
+
+    /*
+    * For pedals reading their float parameters with the modulation matrix's
+    * offsets on top. Until they're given a matrix, and for parameters nothing
+    * is routed to, they read the parameters as they are.
+    */
+    class Modulated
+    {
+    public:
+        void setModulation(const ModulationMatrix* modulationToUse) { mModulation = modulationToUse; }
+
+    protected:
+        // Audio thread
+        float getModulated(const juce::AudioParameterFloat* parameter) const;
+
+    private:
+        const ModulationMatrix* mModulation = nullptr;
+    };
+
     class Overdrive 
     {
     public:
@@ -41,6 +82,158 @@ public:
         JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR(Overdrive);
     };
 
+    /*
+    * The overdrive's "Neural Model" mode: a captured amp or pedal run in place
+    * of the atan, with the same drive, blend, volume and on / off. Drive sets
+    * the level into the model, +-12 dB around unity, since that's what a
+    * capture was trained on. Until a model file has loaded the atan carries on.
+    */
+    class AmpModel : public Modulated
+    {
+    public:
+        AmpModel(juce::AudioProcessorValueTreeState& state);
+        ~AmpModel();
+
+        void prepare(double sampleRate, int maximumBlockSize, int numChannels);
+
+        // Returns false when the atan should run instead
+        bool process(juce::AudioBuffer<float>& buffer);
+
+        // Parses the model on the loader thread. The file is remembered in the state so it comes back with the session.
+        void loadModel(const juce::File& file);
+
+        // Why the last model file was refused, empty once one has loaded
+        juce::String getLoadError() const;
+
+        // True until the loader has taken the last file asked for, for offline renders that have to wait for it
+        bool isLoading() const;
+
+    private:
+        class Loader;
+
+        // Models have state, so every channel runs its own copy
+        struct Engine
+        {
+            std::vector<std::unique_ptr<NeuralAmpModel>> channels;
+        };
+
+        void runLoader();
+        std::unique_ptr<Engine> makeEngine() const;
+
+        juce::AudioProcessorValueTreeState& state;
+        juce::AudioParameterChoice* mModeParameter = nullptr;
+        juce::AudioParameterFloat* mDriveParameter = nullptr;
+        juce::AudioParameterFloat* mBlendParameter = nullptr;
+        juce::AudioParameterFloat* mVolumeParameter = nullptr;
+        juce::AudioParameterBool* mOverdriveOnOff = nullptr;
+
+        // Audio thread, apart from prepare
+        std::unique_ptr<Engine> mEngine, mFadingEngine;
+        juce::AudioBuffer<float> mDryBuffer, mFadingBuffer;
+        juce::SmoothedValue<float> mInputGain;
+        int mFadeLength = 0, mFadePosition = 0;
+        bool mWasOn = false;
+
+        // Handed over through single slots, the same way as the reverb's engines
+        std::atomic<Engine*> mPendingEngine { nullptr }, mRetiredEngine { nullptr };
+
+        // Everything below belongs to the loader and is guarded by mLoaderLock
+        juce::CriticalSection mLoaderLock;
+        int mNumChannels = 0;
+        juce::File mRequestedFile, mModelFile;
+        std::unique_ptr<NeuralAmpModel> mModel;
+        juce::String mLoadError;
+
+        std::unique_ptr<Loader> mLoader;
+
+        //==============================================================================
+        JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR(AmpModel)
+    };
+
+    /*
+    * The overdrive's circuit modes, "Diode Clipper" and "Tube Screamer": wave
+    * digital filter models of the pedals' clipping stages, and "Tube Preamp",
+    * two triode stages solved by the DK method. All are followed by the Tube
+    * Screamer's tone section. Drive goes to the circuit (input gain for the
+    * diode clipper and the preamp, the drive pot for the Tube Screamer), and
+    * blend, volume and on / off work as they do for the atan.
+    */
+    class CircuitModel : public Modulated
+    {
+    public:
+        CircuitModel(juce::AudioProcessorValueTreeState& state);
+
+        void prepare(double sampleRate, int numChannels);
+
+        // Returns false when the mode isn't a circuit
+        bool process(juce::AudioBuffer<float>& buffer);
+
+    private:
+        struct Channel
+        {
+            DiodeClipper diodeClipper;
+            TubeScreamerClipper tubeScreamer;
+            TubeScreamerTone tone;
+        };
+
+        void reset();
+
+        juce::AudioProcessorValueTreeState& state;
+        juce::AudioParameterChoice* mModeParameter = nullptr;
+        juce::AudioParameterFloat* mDriveParameter = nullptr;
+        juce::AudioParameterFloat* mToneParameter = nullptr;
+        juce::AudioParameterFloat* mBlendParameter = nullptr;
+        juce::AudioParameterFloat* mVolumeParameter = nullptr;
+        juce::AudioParameterBool* mOverdriveOnOff = nullptr;
+
+        juce::OwnedArray<Channel> mChannels;
+        TubePreamp mTubePreamp;
+        juce::SmoothedValue<float> mDrive, mTone;
+        int mLastMode = -1;
+
+        //==============================================================================
+        JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR(CircuitModel)
+    };
+
+    /*
+    * The overdrive's "Multiband" mode: the atan on 2 to 4 bands, each with its
+    * own drive, blend and volume, split by Linkwitz-Riley crossovers. Range
+    * and on / off are shared with the atan.
+    */
+    class Multiband : public Modulated
+    {
+    public:
+        Multiband(juce::AudioProcessorValueTreeState& state);
+
+        void prepare(double sampleRate, int numChannels);
+
+        // Returns false when the mode isn't multiband
+        bool process(juce::AudioBuffer<float>& buffer);
+
+    private:
+        void updateCrossovers();
+
+        juce::AudioProcessorValueTreeState& state;
+        juce::AudioParameterChoice* mModeParameter = nullptr;
+        juce::AudioParameterChoice* mBandsParameter = nullptr;
+        juce::AudioParameterFloat* mRangeParameter = nullptr;
+        juce::AudioParameterBool* mOverdriveOnOff = nullptr;
+        juce::AudioParameterFloat* mCrossoverParameters[MultibandOverdrive::maximumBands - 1] = {};
+        juce::AudioParameterFloat* mDriveParameters[MultibandOverdrive::maximumBands] = {};
+        juce::AudioParameterFloat* mBlendParameters[MultibandOverdrive::maximumBands] = {};
+        juce::AudioParameterFloat* mVolumeParameters[MultibandOverdrive::maximumBands] = {};
+
+        juce::OwnedArray<MultibandOverdrive> mChannels;
+
+        // What the coefficients were last worked out for
+        int mNumBands = -1;
+        float mCrossovers[MultibandOverdrive::maximumBands - 1] = {};
+        bool mWasOn = false;
+
+        //==============================================================================
+        JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR(Multiband)
+    };
+
     class Chorus
     {
     public:
@@ -56,6 +249,7 @@ public:
         juce::AudioParameterFloat* mChorusPhaseOffsetParameter = nullptr;
         juce::AudioParameterFloat* mChorusFeedbackParameter = nullptr;
         juce::AudioParameterChoice* mChorusTypeParameter = nullptr;
+        juce::AudioParameterInt* mChorusVoicesParameter = nullptr;
 
         //==============================================================================
         JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR(Chorus)
@@ -77,6 +271,826 @@ public:
         JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR(Delay)
     };
 
+    class Cabinet : public Modulated
+    {
+    public:
+        Cabinet(juce::AudioProcessorValueTreeState& state);
+        ~Cabinet();
+
+        void prepare(double sampleRate, int maximumBlockSize, int numChannels);
+        void process(juce::AudioBuffer<float>& buffer);
+
+        // Decodes, resamples and swaps in an impulse response on the loader thread.
+        // The file is remembered in the state so it comes back with the session.
+        void loadImpulseResponse(const juce::File& file);
+
+        // True until the loader has taken the last file asked for, for offline renders that have to wait for it
+        bool isLoading() const;
+
+        // The built-in cabinets are generated, so no IR files have to ship with the plugin
+        static juce::AudioBuffer<float> createBuiltInImpulseResponse(int type, double sampleRate);
+
+        static constexpr int partitionSize = 64;
+
+    private:
+        class Loader;
+
+        using Filter = PartitionedConvolution::Filter;
+
+        void runLoader();
+        void publishFiltersInUse();
+        void freeRetiredFilters();
+        std::unique_ptr<Filter> makeFilter(const juce::AudioBuffer<float>& impulseResponse, double impulseResponseRate) const;
+
+        juce::AudioProcessorValueTreeState& state;
+        juce::AudioParameterChoice* mCabTypeParameter = nullptr;
+        juce::AudioParameterFloat* mCabDryWetParameter = nullptr;
+        juce::AudioParameterFloat* mCabLevelParameter = nullptr;
+        juce::AudioParameterBool* mCabOnOff = nullptr;
+
+        PartitionedConvolution mConvolver;
+        juce::AudioBuffer<float> mDryBuffer;
+        std::vector<float*> mChannelPointers;
+        juce::SmoothedValue<float> mDryWet, mLevel;
+        bool mWasOn = false;
+
+        std::vector<std::unique_ptr<Filter>> mBuiltInFilters;
+        std::atomic<Filter*> mUserFilter { nullptr };
+
+        /*
+        * A replaced user IR can only be deleted once the audio thread can't be
+        * reading it any more. After every block the audio thread publishes the
+        * filters the convolver holds, bracketed by a sequence count like a seqlock;
+        * the loader frees a retired filter once two complete publishes since it was
+        * retired don't mention it.
+        */
+        std::atomic<const Filter*> mFiltersInUse[3] {};
+        std::atomic<juce::uint64> mInUseSequence { 0 };
+
+        // Everything below belongs to the loader and is guarded by mLoaderLock
+        juce::CriticalSection mLoaderLock;
+        std::vector<std::pair<std::unique_ptr<Filter>, juce::uint64>> mRetiredFilters;
+        double mSampleRate = 0;
+        juce::File mRequestedFile, mUserFile;
+        juce::AudioBuffer<float> mUserImpulseResponse;
+        double mUserImpulseResponseRate = 0;
+        juce::AudioFormatManager mFormatManager;
+
+        std::unique_ptr<Loader> mLoader;
+
+        //==============================================================================
+        JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR(Cabinet)
+    };
+
+    class Reverb : public Modulated
+    {
+    public:
+        Reverb(juce::AudioProcessorValueTreeState& state);
+        ~Reverb();
+
+        void prepare(double sampleRate, int maximumBlockSize, int numChannels);
+
+        // Offline renders wait for the tail workers instead of dropping late blocks
+        void process(juce::AudioBuffer<float>& buffer, bool isNonRealtime);
+
+        // Same as the cabinet's, the IR is loaded and the convolution built on the loader thread
+        void loadImpulseResponse(const juce::File& file);
+
+        // True until the loader has built the engine for the type and file asked for
+        bool isLoading() const;
+
+        // Stereo rooms made from decaying noise, so no IR files have to ship with the plugin
+        static juce::AudioBuffer<float> createBuiltInImpulseResponse(int type, double sampleRate);
+
+    private:
+        class Loader;
+
+        // A convolution is built for one IR at one rate and never changed, switching IRs means switching engines
+        struct Engine
+        {
+            Engine(const juce::AudioBuffer<float>& impulseResponse, int numChannels, int maximumBlockSize, int typeToUse)
+                : convolution(impulseResponse, numChannels, maximumBlockSize), type(typeToUse) {}
+
+            NonUniformConvolution convolution;
+            const int type;
+        };
+
+        void runLoader();
+        std::unique_ptr<Engine> makeEngine(int type) const;
+
+        juce::AudioProcessorValueTreeState& state;
+        juce::AudioParameterChoice* mReverbTypeParameter = nullptr;
+        juce::AudioParameterFloat* mReverbDryWetParameter = nullptr;
+        juce::AudioParameterBool* mReverbOnOff = nullptr;
+
+        // Audio thread, apart from prepare
+        std::unique_ptr<Engine> mEngine, mFadingEngine;
+        juce::AudioBuffer<float> mDryBuffer, mFadingBuffer;
+        std::vector<float*> mChannelPointers, mFadingPointers;
+        juce::SmoothedValue<float> mDryWet;
+        int mFadeLength = 0, mFadePosition = 0;
+        bool mWasOn = false;
+
+        /*
+        * Engines change hands through single slots: the loader puts a new one in
+        * mPendingEngine and the audio thread hands the one it has faded out back
+        * through mRetiredEngine, to be deleted (and its workers stopped) on the
+        * loader thread. The audio thread only takes a pending engine while the
+        * retired slot is empty, so it never has to hold on to two old ones.
+        */
+        std::atomic<Engine*> mPendingEngine { nullptr }, mRetiredEngine { nullptr };
+        std::atomic<int> mRequestedType { 0 };
+
+        // Everything below belongs to the loader and is guarded by mLoaderLock
+        juce::CriticalSection mLoaderLock;
+        int mLoadedType = -1;
+        double mSampleRate = 0;
+        int mMaximumBlockSize = 0, mNumChannels = 0;
+        juce::File mRequestedFile, mUserFile;
+        juce::AudioBuffer<float> mUserImpulseResponse;
+        double mUserImpulseResponseRate = 0;
+        juce::AudioFormatManager mFormatManager;
+
+        std::unique_ptr<Loader> mLoader;
+
+        //==============================================================================
+        JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR(Reverb)
+    };
+
+    class FDNReverb : public Modulated
+    {
+    public:
+        FDNReverb(juce::AudioProcessorValueTreeState& state);
+
+        void prepare(double sampleRate, int maximumBlockSize);
+        void process(juce::AudioBuffer<float>& buffer);
+
+        // The size parameter goes from 0.4 to this many times the base line lengths
+        static constexpr float maximumSize = 2.f;
+
+    private:
+        juce::AudioProcessorValueTreeState& state;
+        juce::AudioParameterFloat* mSizeParameter = nullptr;
+        juce::AudioParameterFloat* mDecayParameter = nullptr;
+        juce::AudioParameterFloat* mDampingParameter = nullptr;
+        juce::AudioParameterFloat* mModulationParameter = nullptr;
+        juce::AudioParameterChoice* mLinesParameter = nullptr;
+        juce::AudioParameterBool* mFreezeParameter = nullptr;
+        juce::AudioParameterFloat* mFDNDryWetParameter = nullptr;
+        juce::AudioParameterBool* mFDNOnOff = nullptr;
+
+        // Both sizes are kept prepared, switching just resets the one taking over
+        FeedbackDelayNetwork<8> mSmallNetwork;
+        FeedbackDelayNetwork<16> mLargeNetwork;
+
+        juce::AudioBuffer<float> mWetBuffer;
+        juce::SmoothedValue<float> mDryWet;
+        int mActiveLines = -1;
+        bool mWasOn = false;
+
+        //==============================================================================
+        JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR(FDNReverb)
+    };
+
+    /*
+    * Three band EQ for shaping the tone before or after the overdrive: low and
+    * high shelves and a sweepable mid, one BiquadCascade with the channels
+    * across its lanes. The processor calls process() at both places and it
+    * only runs at the one it's set to.
+    */
+    class EQ : public Modulated
+    {
+    public:
+        enum class Position { beforeOverdrive, afterOverdrive };
+
+        EQ(juce::AudioProcessorValueTreeState& state);
+
+        void prepare(double sampleRate);
+        void process(juce::AudioBuffer<float>& buffer, Position position);
+
+        // On, and set to run after the overdrive
+        bool isAfterOverdrive() const;
+
+    private:
+        using Filters = BiquadCascade<3>;
+
+        static constexpr double lowFrequency = 120.0;
+        static constexpr double highFrequency = 3200.0;
+        static constexpr double shelfQ = 0.7071067811865476;
+
+        void updateCoefficients();
+
+        juce::AudioProcessorValueTreeState& state;
+        juce::AudioParameterFloat* mLowParameter = nullptr;
+        juce::AudioParameterFloat* mMidFrequencyParameter = nullptr;
+        juce::AudioParameterFloat* mMidGainParameter = nullptr;
+        juce::AudioParameterFloat* mMidQParameter = nullptr;
+        juce::AudioParameterFloat* mHighParameter = nullptr;
+        juce::AudioParameterChoice* mPositionParameter = nullptr;
+        juce::AudioParameterBool* mEQOnOff = nullptr;
+
+        Filters mFilters;
+        juce::SmoothedValue<float> mLow, mMidFrequency, mMidGain, mMidQ, mHigh;
+        double mSampleRate = 44100.0;
+        bool mWasOn = false;
+
+        //==============================================================================
+        JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR(EQ)
+    };
+
+    /*
+    * Noise gate for the front of the chain, to stop the overdrive bringing up
+    * hum between phrases. The envelope is the loudest channel, worked out for a
+    * block at a time, and the gain follows it with a hold and a linear release.
+    *
+    * The audio is held back by the attack time, so the gain is already fully
+    * open when the note that opened it comes out and the pick attack isn't
+    * lost. That's latency, but only while the gate is on.
+    */
+    class NoiseGate : public Modulated
+    {
+    public:
+        NoiseGate(juce::AudioProcessorValueTreeState& state);
+
+        void prepare(double sampleRate, int maximumBlockSize, int numChannels);
+        void process(juce::AudioBuffer<float>& buffer);
+
+        // The lookahead while the gate's on, otherwise nothing
+        int getLatencySamples() const;
+
+        // How long the gate has been fully shut, up to the end of the last block.
+        // Everything it's let out in that time is silence.
+        int getSamplesClosed() const { return mSamplesClosed; }
+
+        static constexpr double attackSeconds = 0.001;
+
+    private:
+        juce::AudioProcessorValueTreeState& state;
+        juce::AudioParameterFloat* mThresholdParameter = nullptr;
+        juce::AudioParameterFloat* mHoldParameter = nullptr;
+        juce::AudioParameterFloat* mReleaseParameter = nullptr;
+        juce::AudioParameterBool* mGateOnOff = nullptr;
+
+        // The lookahead delay, one line per channel
+        juce::AudioBuffer<float> mDelayLine;
+        int mLookahead = 1, mWritePosition = 0;
+
+        // The envelope and then the gain for a block
+        std::vector<float> mEnvelope, mGains;
+
+        double mSampleRate = 44100.0;
+        float mGain = 0.f;
+        int mHoldRemaining = 0, mSamplesClosed = 0;
+        bool mWasOn = false;
+
+        //==============================================================================
+        JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR(NoiseGate)
+    };
+
+    /*
+    * Auto-wah: a resonant band-pass swept by how hard the strings are hit. At
+    * the start of every coefficientInterval samples the filter's centre is
+    * set from an EnvelopeFollower, between the frequency and range octaves
+    * above. The intervals are counted from prepare, and the follower is given
+    * the input a whole interval at a time, once it's all in, so where the
+    * host's blocks start changes nothing. The state-variable filter is the
+    * topology-preserving kind, so it stays put when its centre moves quickly.
+    */
+    class AutoWah : public Modulated
+    {
+    public:
+        AutoWah(juce::AudioProcessorValueTreeState& state);
+
+        void prepare(double sampleRate, int maximumBlockSize, int numChannels);
+        void process(juce::AudioBuffer<float>& buffer);
+
+        // Samples between working out the filter's coefficients, a third of a millisecond at 48 kHz
+        static constexpr int coefficientInterval = 16;
+
+    private:
+        juce::AudioProcessorValueTreeState& state;
+        juce::AudioParameterFloat* mFrequencyParameter = nullptr;
+        juce::AudioParameterFloat* mRangeParameter = nullptr;
+        juce::AudioParameterFloat* mResonanceParameter = nullptr;
+        juce::AudioParameterFloat* mSensitivityParameter = nullptr;
+        juce::AudioParameterFloat* mAttackParameter = nullptr;
+        juce::AudioParameterFloat* mReleaseParameter = nullptr;
+        juce::AudioParameterFloat* mDryWetParameter = nullptr;
+        juce::AudioParameterBool* mAutoWahOnOff = nullptr;
+
+        EnvelopeFollower mFollower;
+        float mAttack = -1.f, mRelease = -1.f;
+
+        // The input of the interval under way, for the follower once it's whole
+        juce::AudioBuffer<float> mInterval;
+
+        // The filter's two integrators, for each channel
+        std::vector<float> mState1, mState2;
+
+        // The coefficients for the interval under way, and how much of it is left
+        float mA1 = 0.f, mA2 = 0.f, mA3 = 0.f, mK = 1.f;
+        int mIntervalRemaining = 0;
+        bool mHasCoefficients = false;
+
+        double mSampleRate = 44100.0;
+        bool mWasOn = false;
+
+        //==============================================================================
+        JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR(AutoWah)
+    };
+
+    /*
+    * Tuner. It only listens to the input, the chain carries on untouched
+    * unless the output is muted. The audio thread low-passes the input, keeps
+    * every few samples and pushes them into a lock-free FIFO, nothing more.
+    * The analyser thread runs a PitchDetector on them and hands the note to
+    * the message thread, which sets the Values the GUI shows.
+    */
+    class Tuner : private juce::AsyncUpdater
+    {
+    public:
+        Tuner(juce::AudioProcessorValueTreeState& state);
+        ~Tuner() override;
+
+        void prepare(double sampleRate);
+
+        // Returns true when the output should be muted
+        bool process(const juce::AudioBuffer<float>& buffer);
+
+        // Note name, cents sharp or flat and frequency, set on the message thread
+        void referTo(const juce::Value& note, const juce::Value& cents, const juce::Value& frequency);
+
+        // The last pitch found, 0 when there isn't a clear note. Any thread.
+        float getFrequency() const { return mFrequency.load(); }
+
+        // The audio is decimated to about this rate, plenty for a guitar's fundamentals
+        static constexpr double analysisRate = 11025.0;
+
+        // 186 ms at the analysis rate, a new detection every 23 ms
+        static constexpr int windowSize = 2048;
+        static constexpr int hopSize = 256;
+
+        // Under this the window isn't periodic enough to call a note
+        static constexpr float minimumClarity = 0.85f;
+
+    private:
+        class Analyser;
+
+        void runAnalyser();
+        void handleAsyncUpdate() override;
+
+        juce::AudioProcessorValueTreeState& state;
+        juce::AudioParameterFloat* mReferenceParameter = nullptr;
+        juce::AudioParameterBool* mMuteParameter = nullptr;
+        juce::AudioParameterBool* mTunerOnOff = nullptr;
+
+        // Audio thread, apart from prepare
+        BiquadCascade<2> mAntiAliasing;
+        int mDecimation = 1, mDecimationPhase = 0;
+        bool mWasOn = false;
+
+        // Decimated audio on its way from the audio thread to the analyser
+        static constexpr int fifoSize = 8192;
+        juce::AbstractFifo mFifo { fifoSize };
+        std::vector<float> mFifoBuffer;
+
+        // Everything below belongs to the analyser and is guarded by mAnalyserLock
+        juce::CriticalSection mAnalyserLock;
+        std::unique_ptr<PitchDetector> mDetector;
+        double mDetectorRate = 0;
+        std::vector<float> mWindow;
+        int mNewSamples = 0;
+
+        std::atomic<float> mFrequency { 0.f };
+        juce::Value mNote, mCents, mNoteFrequency;
+
+        std::unique_ptr<Analyser> mAnalyser;
+
+        //==============================================================================
+        JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR(Tuner)
+    };
+
+    /*
+    * The order the pedals run in, as a PedalGraph routing. A new routing is
+    * compiled on the loader thread and handed to the audio thread ready to
+    * run, which only ever goes down the schedule's list of steps. The routing
+    * lives in the state tree so it comes back with the session.
+    */
+    class Routing
+    {
+    public:
+        Routing(juce::AudioProcessorValueTreeState& state);
+        ~Routing();
+
+        // Compiles the session's routing straight away, nothing's playing
+        void prepare(int maximumBlockSize, int numChannels);
+
+        void process(juce::AudioBuffer<float>& buffer, PedalGraph::Effects& effects);
+
+        // Checked straight away, then compiled on the loader thread. False, with the reason in
+        // getRoutingError(), for one that doesn't make sense, and the current one carries on.
+        bool setRouting(const juce::String& routing);
+
+        // The routing that's running, or about to be
+        juce::String getRouting() const;
+
+        // Why the last routing was refused, empty once one has been taken
+        juce::String getRoutingError() const;
+
+        // For a preset switch. Compiled on the caller's thread for the prepared layout, null before prepare().
+        std::unique_ptr<PedalGraph::Schedule> compileSchedule(const juce::String& routing) const;
+
+        // Audio thread. False, leaving the schedule with the caller, until the last one's been handed back.
+        bool canSwitchSchedule() const;
+        void switchSchedule(std::unique_ptr<PedalGraph::Schedule>& schedule);
+
+        // Once a preset's schedule is in, for the session and getRouting()
+        void setSwitchedRouting(const juce::String& routing);
+
+    private:
+        class Loader;
+
+        void runLoader();
+
+        juce::AudioProcessorValueTreeState& state;
+
+        // Audio thread, apart from prepare
+        std::unique_ptr<PedalGraph::Schedule> mSchedule;
+
+        // Handed over through single slots, the same way as the amp model's engines
+        std::atomic<PedalGraph::Schedule*> mPendingSchedule { nullptr }, mRetiredSchedule { nullptr };
+
+        // Everything below belongs to the loader and is guarded by mLoaderLock
+        juce::CriticalSection mLoaderLock;
+        int mNumChannels = 0, mMaximumBlockSize = 0;
+        juce::String mRequestedRouting, mRouting, mRoutingError;
+        bool mHasRequest = false;
+
+        std::unique_ptr<Loader> mLoader;
+
+        //==============================================================================
+        JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR(Routing)
+    };
+
+    /*
+    * Switches the whole pedalboard to a preset in one go. The loader thread
+    * works out a value for every parameter and compiles the routing, then
+    * hands the lot to the audio thread through a single slot. At the start of
+    * a block the processor renders the first few milliseconds on the old
+    * preset, the audio thread puts every value and the routing in at once,
+    * and the block is crossfaded from the old sound to the new one. No block
+    * is ever heard with half a preset in, and nothing goes quiet.
+    */
+    class Presets
+    {
+    public:
+        struct Preset
+        {
+            juce::String name;
+
+            // Plain values by parameter ID. Anything left out goes back to its default, a preset is the whole board.
+            std::vector<std::pair<juce::String, float>> values;
+
+            // Empty for the default
+            juce::String routing;
+        };
+
+        Presets(juce::AudioProcessorValueTreeState& state, Routing& routing);
+        ~Presets();
+
+        // After the routing's been prepared, as a switch waiting to go in is recompiled for the new layout
+        void prepare(double sampleRate);
+
+        // Audio thread, at the start of every block. True when a preset is waiting and switchNow() can take it.
+        bool startBlock();
+
+        // Audio thread. Every value and the routing in at once.
+        void switchNow();
+
+        // How long the processor crossfades from the old preset to the new one
+        int getFadeSamples() const { return mFadeSamples; }
+
+        // Any thread but the audio thread. Replaces a switch the audio thread hasn't taken yet.
+        void load(const Preset& preset);
+
+        // The last preset to go in
+        juce::String getCurrentName() const;
+
+        // From load() until the loader has tidied up after the switch
+        bool isSwitching() const;
+
+        // Short enough to sound instant and long enough not to click
+        static constexpr double fadeSeconds = 0.005;
+
+        // With no block at all since the snapshot was handed over, the loader puts it in itself after this long.
+        // Once audio is coming through, only the audio thread ever switches.
+        static constexpr int idleTimeoutMs = 100;
+
+    private:
+        class Loader;
+
+        // Every parameter with the normalised value it's going to, and the routing's schedule if that changes
+        struct Snapshot
+        {
+            juce::String name, routing;
+            std::vector<std::pair<juce::RangedAudioParameter*, float>> values;
+            std::unique_ptr<PedalGraph::Schedule> schedule;
+            bool switchesRouting = false;
+        };
+
+        void runLoader();
+        std::unique_ptr<Snapshot> makeSnapshot(const Preset& preset) const;
+        void finish(Snapshot& snapshot);
+
+        juce::AudioProcessorValueTreeState& state;
+        Routing& mRouting;
+
+        // Handed over through single slots, like the routing's schedules
+        std::atomic<Snapshot*> mPendingSnapshot { nullptr }, mRetiredSnapshot { nullptr };
+        std::atomic<juce::uint32> mNumBlocksProcessed { 0 };
+
+        // Set in prepare
+        int mFadeSamples = 0;
+
+        // Everything below belongs to the loader and is guarded by mLoaderLock
+        juce::CriticalSection mLoaderLock;
+        Preset mRequest;
+        bool mHasRequest = false, mIsPrepared = false;
+        juce::uint32 mHandedOverTime = 0, mBlocksAtHandOver = 0;
+        juce::String mCurrentName;
+
+        std::unique_ptr<Loader> mLoader;
+
+        //==============================================================================
+        JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR(Presets)
+    };
+
+    /*
+    * Parameter changes at the samples they're meant for, rather than whenever
+    * the next block starts. Events come from MIDI, or from anything else that
+    * knows when a change should land, and the processor runs its chain in
+    * pieces between them.
+    *
+    * A change lands on its own sample. One that comes less than a minimum
+    * sub-block after the last change went in waits until that much later and
+    * goes in with anything else due by then, so a piece between changes is
+    * never shorter than the minimum. That's counted from the changes rather
+    * than from the start of the block, so a change lands on the same sample
+    * whatever size blocks the host sends. A change for a later block waits
+    * for it.
+    *
+    * Values go in the way a plugin wrapper puts in the host's automation, with
+    * the parameter's listeners told but not the host.
+    */
+    class Automation
+    {
+    public:
+        // Short enough not to be heard, long enough for the pedals' vector loops
+        static constexpr int defaultMinimumSubBlock = 32;
+        static constexpr int maximumEvents = 1024;
+
+        // Clears anything waiting and starts counting samples again
+        void prepare();
+
+        // Before prepare
+        void setMinimumSubBlock(int numSamples);
+
+        // Audio thread, with the position in the block about to be processed. False when there's no room.
+        bool add(juce::RangedAudioParameter* parameter, float normalisedValue, int samplePosition);
+
+        // Flips an on / off, whatever it's at by then
+        bool addToggle(juce::RangedAudioParameter* parameter, int samplePosition);
+
+        // How the processor walks the block: apply what's due, process up to the next event, advance
+        void applyDueEvents();
+        int getSamplesToNextEvent(int maximumSamples) const;
+        void advance(int numSamples);
+
+        // Samples since prepare
+        juce::int64 getTime() const { return mTime; }
+
+    private:
+        struct Event
+        {
+            juce::int64 time;
+            juce::RangedAudioParameter* parameter;
+
+            // Below 0 to toggle
+            float value;
+        };
+
+        bool insert(const Event& event);
+
+        // In time order from mFirstEvent, the same time in the order they were added
+        std::array<Event, maximumEvents> mEvents;
+        int mFirstEvent = 0, mNumEvents = 0;
+
+        juce::int64 mTime = 0, mLastChangeTime = 0;
+        int mMinimumSubBlock = defaultMinimumSubBlock;
+    };
+
+    /*
+    * MIDI into the pedalboard. A controller can be mapped to any parameter,
+    * either following the controller's value or, for footswitches, toggling it
+    * on every press. Mappings are made by hand or learnt from the next
+    * controller that moves, and saved with the session. Program changes go to
+    * onProgramChange, off the audio thread.
+    *
+    * Controller changes go into the automation at the message's sample.
+    */
+    class MidiControl : private juce::ValueTree::Listener
+    {
+    public:
+        MidiControl(juce::AudioProcessorValueTreeState& state);
+        ~MidiControl() override;
+
+        // Audio thread, with the message's position in the block
+        void handle(const juce::MidiMessage& message, int samplePosition, Automation& automation);
+
+        // Controller 0 to 127 onto a parameter, replacing whatever it did before. An empty ID clears it.
+        // Not on the audio thread, it saves the mappings straight away.
+        void setMapping(int controller, const juce::String& parameterID, bool toggles);
+
+        // The parameter a controller moves, empty when there isn't one
+        juce::String getMapping(int controller) const;
+        bool isToggle(int controller) const;
+
+        // The next controller that moves is mapped to the parameter. An empty ID stops learning.
+        void learn(const juce::String& parameterID);
+        bool isLearning() const;
+
+        // Footswitches sending general purpose controllers 5 to 7 toggle the first three pedals
+        static const char* getDefaultMappings() { return "80 onoff1 toggle, 81 onoff2 toggle, 82 onoff3 toggle"; }
+
+        // Learnt mappings are only made on the audio thread, this puts them in the state tree. Before saving the session.
+        void saveMappings();
+
+        // Called on the loader thread with the program number
+        std::function<void(int)> onProgramChange;
+
+    private:
+        class Loader;
+
+        static constexpr int numControllers = 128;
+
+        void runLoader();
+        void readMappings();
+        juce::String writeMappings() const;
+        int getParameterIndex(const juce::String& parameterID) const;
+
+        void valueTreePropertyChanged(juce::ValueTree& tree, const juce::Identifier& property) override;
+
+        juce::AudioProcessorValueTreeState& state;
+
+        // Fixed at construction, the mappings are indices into it
+        juce::Array<juce::RangedAudioParameter*> mParameters;
+
+        // Shared with the audio thread. -1 for nothing.
+        std::array<std::atomic<int>, numControllers> mMappings;
+        std::array<std::atomic<bool>, numControllers> mToggles;
+        std::atomic<int> mLearning { -1 }, mPendingProgram { -1 };
+        std::atomic<bool> mMappingsChanged { false };
+
+        // Audio thread, so a footswitch toggles once per press
+        std::array<bool, numControllers> mIsPressed {};
+
+        // The state tree's text for the mappings, last read or written
+        juce::String mSavedMappings;
+
+        std::unique_ptr<Loader> mLoader;
+
+        //==============================================================================
+        JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR(MidiControl)
+    };
+
+    /*
+    * LFOs, envelope followers and MIDI controllers moving parameters. Sources
+    * are worked out every control period, not every sample, and the routes
+    * are a matrix of depths, one column of every parameter for each source,
+    * so all the targets are found with a multiply-add per source.
+    *
+    * A route never moves its parameter, so the host, the session and the
+    * parameter's listeners only see where it was set. The offsets go in a
+    * buffer of their own, one for every float parameter, and the pedals read
+    * their parameters with it on top. The pedals that smooth a parameter
+    * smooth its modulation too, the delay time glides from one period to the
+    * next, and the rest step once a period. Anything that moves a modulated
+    * parameter moves the centre it's modulated around. Switches and choices
+    * can't be routed to.
+    *
+    * Set as text, saved with the session:
+    *
+    *   lfo1 sine 2              shape (sine, triangle, square, saw) and rate in Hz, lfo1 to lfo4
+    *   env1 10 200              attack and release in ms, env1 and env2, following the input
+    *   midi1 1                  the controller number, midi1 to midi4
+    *   lfo1 > delaytime 0.25    a route, with its depth, -1 to 1 of the parameter's range
+    *
+    * separated by commas.
+    */
+    class ModulationMatrix : private juce::ValueTree::Listener
+    {
+    public:
+        enum Shape { sine, triangle, square, saw };
+
+        static constexpr int numLFOs = 4, numEnvelopes = 2, numMidiSources = 4;
+        static constexpr int numSources = numLFOs + numEnvelopes + numMidiSources;
+
+        // 1.5 kHz at 48 kHz, plenty for anything a foot or an LFO does
+        static constexpr int defaultControlPeriod = 32;
+
+        ModulationMatrix(juce::AudioProcessorValueTreeState& state);
+        ~ModulationMatrix() override;
+
+        // Before prepare
+        void setControlPeriod(int numSamples);
+        int getControlPeriod() const { return mControlPeriod; }
+
+        void prepare(double sampleRate);
+
+        // Checked and put in straight away. False, with the reason in getModulationError(),
+        // for text that doesn't make sense, and the current modulation carries on.
+        bool setModulation(const juce::String& modulation);
+        juce::String getModulation() const;
+        juce::String getModulationError() const;
+
+        // Audio thread, for the MIDI sources
+        void handleMidi(const juce::MidiMessage& message);
+
+        // Audio thread. Periods are counted from prepare, like the automation's grid.
+        int getSamplesToNextUpdate(int maximumSamples) const;
+
+        // At the start of every piece of the block, with the rest of the block's input for the envelope followers
+        void update(const juce::AudioBuffer<float>& input);
+        void advance(int numSamples);
+
+        // The last value of a source, -1 to 1 for LFOs and 0 to 1 for the others
+        float getSourceValue(int source) const;
+
+        // Audio thread. How far a parameter is modulated, normalised, and 0 when nothing's routed to it.
+        float getOffset(const juce::RangedAudioParameter& parameter) const;
+
+        // A parameter in its own range with an offset on top, not snapped to the parameter's interval
+        static float applyOffset(const juce::RangedAudioParameter& parameter, float offset);
+
+    private:
+        struct Config
+        {
+            std::array<int, numLFOs> shapes;
+            std::array<float, numLFOs> rates;
+            std::array<float, numEnvelopes> attacks, releases;
+            std::array<int, numMidiSources> controllers;
+
+            // numSources columns of every parameter's depth
+            std::vector<float> depths;
+
+            // Parameters with any route to them
+            std::vector<int> targets;
+        };
+
+        std::unique_ptr<Config> parse(const juce::String& modulation, juce::String& error) const;
+        // Returns the one it replaces
+        std::unique_ptr<Config> swapConfig(std::unique_ptr<Config> config);
+        void updateSources(const juce::AudioBuffer<float>& input);
+        void updateTargets();
+
+        void valueTreePropertyChanged(juce::ValueTree& tree, const juce::Identifier& property) override;
+
+        juce::AudioProcessorValueTreeState& state;
+
+        // The float parameters, fixed at construction, the matrix has a row for each
+        juce::Array<juce::RangedAudioParameter*> mParameters;
+
+        // Each of the processor's parameters' row, or -1
+        std::vector<int> mRows;
+
+        // Audio thread, apart from prepare
+        std::unique_ptr<Config> mConfig;
+        std::array<EnvelopeFollower, numEnvelopes> mFollowers;
+        std::array<float, numEnvelopes> mFollowerAttacks {}, mFollowerReleases {};
+        std::array<float, numSources> mSources {};
+        std::array<double, numLFOs> mPhases {};
+        std::vector<float> mOffsets;
+        juce::int64 mTime = 0;
+        double mSampleRate = 44100.0;
+        int mControlPeriod = defaultControlPeriod;
+
+        // Written by handleMidi
+        std::array<float, numMidiSources> mMidiValues {};
+
+        // For the GUI
+        std::array<std::atomic<float>, numSources> mSourceValues;
+
+        // Handed over through single slots, the same way as the routing's schedules
+        std::atomic<Config*> mPendingConfig { nullptr }, mRetiredConfig { nullptr };
+
+        // Message thread
+        juce::CriticalSection mTextLock;
+        juce::String mModulation, mModulationError;
+
+        //==============================================================================
+        JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR(ModulationMatrix)
+    };
+
 private:
     JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR(GuitarEffectAudioProcessor)
 };
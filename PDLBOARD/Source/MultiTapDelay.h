@@ -0,0 +1,347 @@
+/*
+  ==============================================================================
+
+    MultiTapDelay.h
+
+  ==============================================================================
+*/
+
+#pragma once
+
+#include <JuceHeader.h>
+
+//==============================================================================
+/**
+    Up to maximumTaps taps off one delay line per channel, each with its own
+    time, gain, pan and one-pole low-pass. The longest tap feeds back, either
+    into its own side, across into the other, or some of each, and ping-pong
+    sends the input into the left line only and the feedback straight across.
+
+    Taps sit one to a SIMD lane, like the chorus ensemble's voices. A sample
+    costs fetching the two samples either side of each tap lane by lane, then
+    the interpolation, filters, pan gains and sum a register at a time.
+
+    New taps are glided to over glideSeconds rather than jumped to, however
+    many process() calls that spans: every tap's delay, gains and filter move
+    a step a sample, taps that go fade out where they are and taps that arrive
+    fade in where they land, and the feedback crossfades if the longest tap
+    changes. New taps part way through a glide glide on from wherever it's
+    got to. Steady settings skip the stepping altogether, and come out the
+    same whatever the block size.
+*/
+class MultiTapDelay
+{
+public:
+    using Vec = juce::dsp::SIMDRegister<float>;
+
+    static constexpr int lanes = (int)Vec::SIMDNumElements;
+    static constexpr int maximumTaps = 16;
+    static constexpr int numRegisters = (maximumTaps + lanes - 1) / lanes;
+
+    // Long enough not to click, short enough to follow a knob
+    static constexpr double glideSeconds = 0.02;
+
+    struct Tap
+    {
+        float time = 0.25f;         // Seconds
+        float gain = 1.f;
+        float pan = 0.f;            // -1 left to 1 right
+        float cutoff = 20000.f;     // Hz, the low-pass on what the tap reads
+    };
+
+    struct Settings
+    {
+        float feedback = 0.3f;
+        float crossFeedback = 0.f;  // How much of each side's feedback goes to the other
+        bool pingPong = false;
+        float dryWet = 0.5f;
+    };
+
+    void prepare(double newSampleRate) noexcept
+    {
+        sampleRate = newSampleRate;
+        glideLength = juce::jmax(1, (int)(glideSeconds * sampleRate));
+        reset();
+    }
+
+    void reset() noexcept
+    {
+        std::fill(std::begin(filterStates[0]), std::end(filterStates[0]), 0.f);
+        std::fill(std::begin(filterStates[1]), std::end(filterStates[1]), 0.f);
+        feedback[0] = feedback[1] = 0.f;
+        hasTaps = false;
+    }
+
+    // Cheap enough for the audio thread, a few exp()s and cos()s a tap. Glided to over glideSeconds.
+    // The same taps again, as every block sends them, leave a glide that's under way alone.
+    void setTaps(const Tap* newTaps, int newNumTaps) noexcept
+    {
+        numTaps = juce::jlimit(0, maximumTaps, newNumTaps);
+
+        auto isChanged = false;
+        auto setTarget = [&isChanged] (float& target, float value)
+        {
+            isChanged = isChanged || target != value;
+            target = value;
+        };
+
+        // Anything dropped fades out where it is, or where it was already going
+        for (int t = numTaps; t < maximumTaps; ++t)
+        {
+            setTarget(targetLeftGains[t], 0.f);
+            setTarget(targetRightGains[t], 0.f);
+        }
+
+        auto longest = 0.f;
+        auto newFeedbackTap = 0;
+
+        for (int t = 0; t < numTaps; ++t)
+        {
+            auto& tap = newTaps[t];
+            auto time = juce::jmax(0.f, tap.time);
+
+            if (time > longest)
+            {
+                longest = time;
+                newFeedbackTap = t;
+            }
+
+            setTarget(targetDelays[t], (float)(time * sampleRate));
+
+            // Constant power, and unity either side of the middle
+            auto angle = (juce::jlimit(-1.f, 1.f, tap.pan) + 1.f) * juce::MathConstants<float>::pi * 0.25f;
+            setTarget(targetLeftGains[t], tap.gain * juce::MathConstants<float>::sqrt2 * std::cos(angle));
+            setTarget(targetRightGains[t], tap.gain * juce::MathConstants<float>::sqrt2 * std::sin(angle));
+
+            auto cutoff = juce::jlimit(20.f, 0.49f * (float)sampleRate, tap.cutoff);
+            setTarget(targetCoefficients[t], 1.f - (float)std::exp(-juce::MathConstants<double>::twoPi * cutoff / sampleRate));
+
+            // A new tap starts silent, already where it's going
+            if (t >= numActiveTaps)
+            {
+                delays[t] = targetDelays[t];
+                coefficients[t] = targetCoefficients[t];
+                filterStates[0][t] = filterStates[1][t] = 0.f;
+            }
+        }
+
+        numActiveTaps = juce::jmax(numActiveTaps, numTaps);
+
+        // Over from whichever tap was feeding back, from the start
+        if (newFeedbackTap != feedbackTap)
+        {
+            previousFeedbackTap = feedbackTap;
+            feedbackTap = newFeedbackTap;
+            feedbackFade = 0.f;
+            isChanged = true;
+        }
+
+        // Straight there after a reset, as there's nothing to glide from
+        if (! hasTaps)
+        {
+            finishGlide();
+            hasTaps = true;
+            return;
+        }
+
+        if (! isChanged)
+            return;
+
+        // From wherever everything is now, a step a sample for the whole glide
+        auto scale = 1.f / (float)glideLength;
+
+        for (int t = 0; t < numActiveTaps; ++t)
+        {
+            delaySteps[t] = (targetDelays[t] - delays[t]) * scale;
+            leftSteps[t] = (targetLeftGains[t] - leftGains[t]) * scale;
+            rightSteps[t] = (targetRightGains[t] - rightGains[t]) * scale;
+            coefficientSteps[t] = (targetCoefficients[t] - coefficients[t]) * scale;
+        }
+
+        glideRemaining = glideLength;
+    }
+
+    int getNumTaps() const noexcept                 { return numTaps; }
+
+    // The first one or two channels, the lines shared with the single tap delay and its write head
+    void process(float* const* channels, int numChannels, int numSamples,
+                  float* const* lines, int length, int& writeHead, const Settings& settings) noexcept
+    {
+        auto numSides = juce::jmin(numChannels, 2);
+
+        if (numSides <= 0 || numSamples <= 0 || numActiveTaps == 0 || length <= 2)
+            return;
+
+        auto numActiveRegisters = (numActiveTaps + lanes - 1) / lanes;
+
+        // In a mono layout each tap's pan comes down to its gain
+        alignas(Vec::SIMDRegisterSize) float monoGains[numRegisters * lanes] = {};
+
+        auto setMonoGains = [&]
+        {
+            for (int t = 0; t < numActiveTaps; ++t)
+                monoGains[t] = 0.5f * (leftGains[t] + rightGains[t]);
+        };
+
+        setMonoGains();
+
+        const float* gains[] = { numSides > 1 ? leftGains : monoGains, rightGains };
+
+        // A delay of whole + fraction reads between whole + 1 and whole samples back
+        int offsets[numRegisters * lanes] = {};
+        alignas(Vec::SIMDRegisterSize) float farWeights[numRegisters * lanes] = {};
+        alignas(Vec::SIMDRegisterSize) float nearWeights[numRegisters * lanes] = {};
+
+        auto setReadPositions = [&]
+        {
+            for (int t = 0; t < numActiveTaps; ++t)
+            {
+                auto delay = juce::jlimit(0.f, (float)(length - 2), delays[t]);
+                auto whole = (int)delay;
+
+                offsets[t] = whole + 1;
+                farWeights[t] = delay - (float)whole;
+                nearWeights[t] = 1.f - farWeights[t];
+            }
+        };
+
+        setReadPositions();
+
+        auto cross = settings.pingPong ? 1.f : juce::jlimit(0.f, 1.f, settings.crossFeedback);
+        auto dry = 1.f - settings.dryWet;
+        auto wet = settings.dryWet;
+
+        alignas(Vec::SIMDRegisterSize) float before[lanes];
+        alignas(Vec::SIMDRegisterSize) float after[lanes];
+        alignas(Vec::SIMDRegisterSize) float filtered[numRegisters * lanes];
+
+        for (int i = 0; i < numSamples; ++i)
+        {
+            float inputs[2] = { channels[0][i], numSides > 1 ? channels[1][i] : 0.f };
+
+            if (numSides > 1)
+            {
+                auto left = settings.pingPong ? 0.5f * (inputs[0] + inputs[1]) : inputs[0];
+                auto right = settings.pingPong ? 0.f : inputs[1];
+
+                lines[0][writeHead] = left + (1.f - cross) * feedback[0] + cross * feedback[1];
+                lines[1][writeHead] = right + (1.f - cross) * feedback[1] + cross * feedback[0];
+            }
+            else
+            {
+                lines[0][writeHead] = inputs[0] + feedback[0];
+            }
+
+            // Over to the new longest tap's feedback across the glide
+            auto isFading = feedbackTap != previousFeedbackTap;
+
+            if (isFading)
+                feedbackFade = juce::jmin(1.f, feedbackFade + 1.f / (float)glideLength);
+
+            for (int side = 0; side < numSides; ++side)
+            {
+                auto* line = lines[side];
+                auto* states = filterStates[side];
+                auto sum = Vec::expand(0.f);
+
+                for (int r = 0; r < numActiveRegisters; ++r)
+                {
+                    auto first = r * lanes;
+
+                    for (int k = 0; k < lanes; ++k)
+                    {
+                        auto x = writeHead - offsets[first + k];
+
+                        if (x < 0)
+                            x += length;
+
+                        before[k] = line[x];
+                        after[k] = line[x + 1 < length ? x + 1 : 0];
+                    }
+
+                    auto read = Vec::fromRawArray(before) * Vec::fromRawArray(farWeights + first)
+                              + Vec::fromRawArray(after) * Vec::fromRawArray(nearWeights + first);
+
+                    auto state = Vec::fromRawArray(states + first);
+                    state += Vec::fromRawArray(coefficients + first) * (read - state);
+                    state.copyToRawArray(states + first);
+                    state.copyToRawArray(filtered + first);
+
+                    sum += state * Vec::fromRawArray(gains[side] + first);
+                }
+
+                auto tapOutput = isFading ? filtered[previousFeedbackTap] + feedbackFade * (filtered[feedbackTap] - filtered[previousFeedbackTap])
+                                          : filtered[feedbackTap];
+                feedback[side] = tapOutput * settings.feedback;
+                channels[side][i] = inputs[side] * dry + sum.sum() * wet;
+            }
+
+            if (glideRemaining > 0)
+            {
+                // Exactly there on the last step, whatever the steps added up to
+                if (--glideRemaining == 0)
+                {
+                    finishGlide();
+                }
+                else
+                {
+                    for (int t = 0; t < numActiveTaps; ++t)
+                    {
+                        delays[t] += delaySteps[t];
+                        leftGains[t] += leftSteps[t];
+                        rightGains[t] += rightSteps[t];
+                        coefficients[t] += coefficientSteps[t];
+                    }
+                }
+
+                if (numSides == 1)
+                    setMonoGains();
+
+                setReadPositions();
+            }
+
+            if (++writeHead >= length)
+                writeHead = 0;
+        }
+    }
+
+private:
+    void finishGlide() noexcept
+    {
+        std::copy(std::begin(targetDelays), std::end(targetDelays), delays);
+        std::copy(std::begin(targetLeftGains), std::end(targetLeftGains), leftGains);
+        std::copy(std::begin(targetRightGains), std::end(targetRightGains), rightGains);
+        std::copy(std::begin(targetCoefficients), std::end(targetCoefficients), coefficients);
+
+        numActiveTaps = numTaps;
+        previousFeedbackTap = feedbackTap;
+        feedbackFade = 1.f;
+        glideRemaining = 0;
+    }
+
+    // Where each tap is now, and where setTaps() last asked it to be
+    alignas(Vec::SIMDRegisterSize) float delays[numRegisters * lanes] = {};
+    alignas(Vec::SIMDRegisterSize) float leftGains[numRegisters * lanes] = {};
+    alignas(Vec::SIMDRegisterSize) float rightGains[numRegisters * lanes] = {};
+    alignas(Vec::SIMDRegisterSize) float coefficients[numRegisters * lanes] = {};
+    alignas(Vec::SIMDRegisterSize) float targetDelays[numRegisters * lanes] = {};
+    alignas(Vec::SIMDRegisterSize) float targetLeftGains[numRegisters * lanes] = {};
+    alignas(Vec::SIMDRegisterSize) float targetRightGains[numRegisters * lanes] = {};
+    alignas(Vec::SIMDRegisterSize) float targetCoefficients[numRegisters * lanes] = {};
+    alignas(Vec::SIMDRegisterSize) float filterStates[2][numRegisters * lanes] = {};
+
+    // What every tap moves by each sample, for as many samples as are left of the glide
+    float delaySteps[numRegisters * lanes] = {};
+    float leftSteps[numRegisters * lanes] = {};
+    float rightSteps[numRegisters * lanes] = {};
+    float coefficientSteps[numRegisters * lanes] = {};
+    int glideLength = 1, glideRemaining = 0;
+    float feedbackFade = 1.f;
+
+    double sampleRate = 44100.0;
+    int numTaps = 0, numActiveTaps = 0, feedbackTap = 0, previousFeedbackTap = 0;
+    bool hasTaps = false;
+    float feedback[2] = {};
+
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR(MultiTapDelay)
+};
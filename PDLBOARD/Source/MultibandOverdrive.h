@@ -0,0 +1,193 @@
+/*
+  ==============================================================================
+
+    MultibandOverdrive.h
+
+  ==============================================================================
+*/
+
+#pragma once
+
+#include <JuceHeader.h>
+#include "BiquadCascade.h"
+
+//==============================================================================
+/**
+    The overdrive's atan run separately on up to four bands, so the low end can
+    stay clean while the top is driven hard.
+
+    The bands are split by 4th order Linkwitz-Riley crossovers, and each band is
+    a lane of one SIMD register. Rather than splitting one band off after
+    another, every band is the same BiquadCascade of six biquads, two per
+    crossover, with its own coefficients in its own lane:
+
+        band below crossover k      low-pass at k, all-pass at the ones above
+        band above crossover k      high-pass at k
+
+    The all-passes are what the low-pass and high-pass sum to, so the bands
+    add back up to one all-pass whatever the gains, with no dips at the
+    crossovers. One pass through the cascade filters all four bands at once,
+    and the filter states are registers, one per biquad, holding every band.
+    Unused lanes have zero coefficients.
+
+    The atan is done on a block of band samples at a time, four bands to a
+    sample, by a polynomial the compiler can vectorise.
+*/
+class MultibandOverdrive
+{
+public:
+    static constexpr int maximumBands = 4;
+    static constexpr int numStages = 2 * (maximumBands - 1);
+
+    using Vec = BiquadCascade<numStages>::Vec;
+    static constexpr int lanes = BiquadCascade<numStages>::lanes;
+
+    static_assert (lanes >= maximumBands, "Every band needs its own lane");
+
+    MultibandOverdrive()
+    {
+        setCrossovers(2, nullptr);
+    }
+
+    void prepare(double newSampleRate)
+    {
+        sampleRate = newSampleRate;
+        setCrossovers(numBands, frequencies);
+        reset();
+    }
+
+    void reset() noexcept
+    {
+        filters.reset();
+    }
+
+    /*
+    * newNumBands - 1 crossover frequencies in Hz, in any order. Recomputes the
+    * coefficients, so call it when they change rather than every block.
+    */
+    void setCrossovers(int newNumBands, const float* newFrequencies) noexcept
+    {
+        numBands = juce::jlimit(1, maximumBands, newNumBands);
+
+        if (newFrequencies != nullptr && newFrequencies != frequencies)
+            std::copy(newFrequencies, newFrequencies + numBands - 1, frequencies);
+
+        std::sort(frequencies, frequencies + numBands - 1);
+
+        for (int lane = 0; lane < lanes; ++lane)
+        {
+            for (int crossover = 0; crossover < maximumBands - 1; ++crossover)
+            {
+                auto first = 2 * crossover, second = first + 1;
+                auto frequency = (double)frequencies[crossover];
+
+                // Butterworth, twice over makes the Linkwitz-Riley
+                BiquadCoefficients firstStage, secondStage;
+
+                if (lane >= numBands)
+                {
+                    firstStage = secondStage = BiquadCoefficients::silence();
+                }
+                else if (crossover >= numBands - 1)
+                {
+                    // Past the last crossover in use, the stages pass straight through
+                }
+                else if (lane == crossover)
+                {
+                    firstStage = secondStage = BiquadCoefficients::lowPass(sampleRate, frequency, butterworthQ);
+                }
+                else if (lane > crossover)
+                {
+                    firstStage = secondStage = BiquadCoefficients::highPass(sampleRate, frequency, butterworthQ);
+                }
+                else
+                {
+                    // The all-pass the pair sums to only needs one biquad
+                    firstStage = BiquadCoefficients::allPass(sampleRate, frequency, butterworthQ);
+                }
+
+                filters.setCoefficients(first, lane, firstStage);
+                filters.setCoefficients(second, lane, secondStage);
+            }
+        }
+    }
+
+    // The same drive (already times range), blend and volume as the atan overdrive, per band
+    void setBand(int band, float drive, float blend, float volume) noexcept
+    {
+        jassert(band >= 0 && band < maximumBands);
+
+        drives[band] = drive;
+        blends[band] = blend;
+        volumes[band] = volume;
+    }
+
+    int getNumBands() const noexcept        { return numBands; }
+
+    void process(float* samples, int numSamples) noexcept
+    {
+        alignas(Vec::SIMDRegisterSize) float bands[chunkSize * lanes];
+
+        for (int start = 0; start < numSamples; start += chunkSize)
+        {
+            auto count = juce::jmin(chunkSize, numSamples - start);
+
+            // The crossovers, every band at once
+            for (int i = 0; i < count; ++i)
+                filters.processSample(Vec::expand(samples[start + i])).copyToRawArray(bands + i * lanes);
+
+            // Each band through the atan, and back together
+            for (int i = 0; i < count; ++i)
+            {
+                float shaped[lanes];
+
+                for (int lane = 0; lane < lanes; ++lane)
+                {
+                    auto clean = bands[i * lanes + lane];
+                    auto driven = twoOverPi * fastAtan(clean * drives[lane]);
+                    shaped[lane] = ((driven * blends[lane] + clean * (1.f - blends[lane])) / 2) * volumes[lane];
+                }
+
+                auto sum = 0.f;
+
+                for (int lane = 0; lane < lanes; ++lane)
+                    sum += shaped[lane];
+
+                samples[start + i] = sum;
+            }
+        }
+    }
+
+    /*
+    * atan to within 1e-5, with no calls and no branches the compiler can't turn
+    * into selects: the argument is folded into [0, 1] by atan(x) = pi / 2 -
+    * atan(1 / x), then a polynomial (Abramowitz and Stegun 4.4.49).
+    */
+    static float fastAtan(float x) noexcept
+    {
+        auto magnitude = std::abs(x);
+        auto folded = std::min(magnitude, 1.f) / std::max(magnitude, 1.f);
+        auto f2 = folded * folded;
+
+        auto angle = folded * (0.9998660f + f2 * (-0.3302995f + f2 * (0.1801410f + f2 * (-0.0851330f + f2 * 0.0208351f))));
+        angle = magnitude > 1.f ? juce::MathConstants<float>::halfPi - angle : angle;
+
+        return std::copysign(angle, x);
+    }
+
+private:
+    static constexpr int chunkSize = 32;
+    static constexpr double butterworthQ = 0.7071067811865476;
+    static constexpr float twoOverPi = 2.f / juce::MathConstants<float>::pi;
+
+    double sampleRate = 44100.0;
+    int numBands = 2;
+    float frequencies[maximumBands - 1] = { 200.f, 800.f, 2500.f };
+
+    BiquadCascade<numStages> filters;
+
+    // Lanes past the last band have a volume of 0
+    float drives[lanes] = {}, blends[lanes] = {}, volumes[lanes] = {};
+
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR(MultibandOverdrive)
+};
@@ -0,0 +1,711 @@
+/*
+  ==============================================================================
+
+    NeuralAmpModel.cpp
+
+  ==============================================================================
+*/
+
+#include "NeuralAmpModel.h"
+
+namespace
+{
+    using Vec = juce::dsp::SIMDRegister<float>;
+
+    constexpr int lanes = (int)Vec::SIMDNumElements;
+
+    constexpr int roundUpToRegister(int size)
+    {
+        return (size + lanes - 1) / lanes * lanes;
+    }
+
+    //==============================================================================
+    /*
+    * y = W x + b for a fixed size W. The weights are stored a column at a time,
+    * each column padded to whole registers, so every input is broadcast across
+    * a register and multiply-added into one accumulator per register of rows.
+    * The rows run down the lanes and there is no horizontal sum at the end.
+    *
+    * The rows are done a few registers at a time, so the accumulators stay in
+    * registers for the whole pass over the columns instead of going back to
+    * the stack for every input.
+    */
+    template <int rows, int columns>
+    struct MatrixVector
+    {
+        static constexpr int paddedRows = roundUpToRegister(rows);
+        static constexpr int numRegisters = paddedRows / lanes;
+        static constexpr int tileSize = 4;
+
+        void setWeight(int row, int column, float weight) noexcept
+        {
+            weights[column * paddedRows + row] = weight;
+        }
+
+        // The input doesn't have to be aligned, the output needs paddedRows aligned floats
+        void process(const float* input, float* output) const noexcept
+        {
+            for (int first = 0; first + tileSize <= numRegisters; first += tileSize)
+                processTile<tileSize> (first, input, output);
+
+            if constexpr(numRegisters % tileSize != 0)
+                processTile<numRegisters % tileSize> (numRegisters - numRegisters % tileSize, input, output);
+        }
+
+        alignas(Vec::SIMDRegisterSize) float weights[columns * paddedRows] = {};
+        alignas(Vec::SIMDRegisterSize) float bias[paddedRows] = {};
+
+    private:
+        template <int count>
+        void processTile(int first, const float* input, float* output) const noexcept
+        {
+            Vec sums[count];
+
+            for (int r = 0; r < count; ++r)
+                sums[r] = Vec::fromRawArray(bias + (first + r) * lanes);
+
+            for (int column = 0; column < columns; ++column)
+            {
+                auto x = Vec::expand(input[column]);
+                auto* w = weights + column * paddedRows + first * lanes;
+
+                for (int r = 0; r < count; ++r)
+                    sums[r] = Vec::multiplyAdd(sums[r], Vec::fromRawArray(w + r * lanes), x);
+            }
+
+            for (int r = 0; r < count; ++r)
+                sums[r].copyToRawArray(output + (first + r) * lanes);
+        }
+    };
+
+    /*
+    * tanh over an array by a Pade approximant, within 1e-4 of std::tanh once
+    * the input is clamped to +-5 and many times cheaper. SIMDRegister has no
+    * divide, so the numerators and denominators are worked out a register at a
+    * time and the divide is a loop of its own, which the compiler vectorises.
+    * (It won't vectorise the clamp from scalar code without fast-math.)
+    *
+    * The sigmoid is 0.5 + 0.5 tanh (x / 2). size has to be whole registers.
+    */
+    template <int size, bool isSigmoid>
+    void activate(float* values, float* denominators) noexcept
+    {
+        static_assert (size % lanes == 0, "Activations are applied to whole registers");
+
+        for (int i = 0; i < size; i += lanes)
+        {
+            auto x = Vec::fromRawArray(values + i);
+
+            if constexpr(isSigmoid)
+                x = x * 0.5f;
+
+            x = Vec::min(Vec::expand(5.f), Vec::max(Vec::expand(-5.f), x));
+            auto x2 = x * x;
+
+            (x * (x2 * (x2 * (x2 + 378.f) + 17325.f) + 135135.f)).copyToRawArray(values + i);
+            (x2 * (x2 * (x2 * 28.f + 3150.f) + 62370.f) + 135135.f).copyToRawArray(denominators + i);
+        }
+
+        for (int i = 0; i < size; ++i)
+        {
+            if constexpr(isSigmoid)
+                values[i] = 0.5f + 0.5f * values[i] / denominators[i];
+            else
+                values[i] /= denominators[i];
+        }
+    }
+
+    // Both arrays padded to whole registers, with zeros past the end
+    template <int size>
+    inline float dotProduct(const float* a, const float* b) noexcept
+    {
+        auto sum = Vec::expand(0.f);
+
+        for (int i = 0; i < roundUpToRegister(size); i += lanes)
+            sum = Vec::multiplyAdd(sum, Vec::fromRawArray(a + i), Vec::fromRawArray(b + i));
+
+        return sum.sum();
+    }
+
+    //==============================================================================
+    // Flattens nested JSON arrays of numbers, row-major like PyTorch stores tensors
+    bool readNumbers(const juce::var& value, std::vector<float>& numbers)
+    {
+        if (auto* array = value.getArray())
+        {
+            for (auto& element : *array)
+                if (! readNumbers(element, numbers))
+                    return false;
+
+            return true;
+        }
+
+        if (! (value.isDouble() || value.isInt() || value.isInt64()))
+            return false;
+
+        auto number = (double)value;
+
+        if (! std::isfinite(number))
+            return false;
+
+        numbers.push_back((float)number);
+        return true;
+    }
+
+    bool readTensor(const juce::var& dictionary, const juce::String& name, int expectedSize, std::vector<float>& tensor, juce::String& error)
+    {
+        tensor.clear();
+
+        if (! readNumbers(dictionary[juce::Identifier(name)], tensor) || (int)tensor.size() != expectedSize)
+        {
+            error = name + " is missing or isn't " + juce::String(expectedSize) + " numbers";
+            return false;
+        }
+
+        return true;
+    }
+
+    // Calls create with a std::integral_constant for whichever of the built-in sizes matches
+    template <int... sizes, typename Create>
+    std::unique_ptr<NeuralAmpModel> createForSize(int size, Create&& create)
+    {
+        std::unique_ptr<NeuralAmpModel> model;
+        (void)((size == sizes ? (model = create(std::integral_constant<int, sizes>()), true) : false) || ...);
+        return model;
+    }
+
+    juce::String listSizes(std::initializer_list<int> sizes)
+    {
+        juce::StringArray list;
+
+        for (auto size : sizes)
+            list.add(juce::String(size));
+
+        return list.joinIntoString(", ");
+    }
+
+    //==============================================================================
+    /*
+    * PyTorch's LSTM, one layer, then a linear layer down to one output. The
+    * input and hidden products are one matrix-vector product: the input is
+    * kept as an extra element after the hidden state and its weights as an
+    * extra column, and the two biases are summed. Gates are in PyTorch's
+    * order: input, forget, cell, output, each starting on a register boundary
+    * so a whole gate can be activated at once.
+    */
+    template <int hiddenSize>
+    class LSTMModel final : public NeuralAmpModel
+    {
+    public:
+        static std::unique_ptr<NeuralAmpModel> create(const juce::var& stateDict, bool skip, juce::String& error)
+        {
+            auto model = std::make_unique<LSTMModel>();
+
+            if (! model->setWeights(stateDict, error))
+                return {};
+
+            model->skip = skip;
+            return model;
+        }
+
+        std::unique_ptr<NeuralAmpModel> clone() const override
+        {
+            auto copy = std::make_unique<LSTMModel> (*this);
+            copy->reset();
+            return copy;
+        }
+
+        void reset() noexcept override
+        {
+            std::fill(std::begin(state), std::end(state), 0.f);
+            std::fill(std::begin(cell), std::end(cell), 0.f);
+        }
+
+        void process(const float* input, float* output, int numSamples) noexcept override
+        {
+            for (int i = 0; i < numSamples; ++i)
+            {
+                auto x = input[i];
+
+                state[hiddenSize] = x;
+                gates.process(state, gateValues);
+
+                activate<2 * paddedHidden, true> (gateValues, scratch);
+                activate<paddedHidden, false> (gateValues + 2 * paddedHidden, scratch);
+                activate<paddedHidden, true> (gateValues + 3 * paddedHidden, scratch);
+
+                for (int j = 0; j < paddedHidden; j += lanes)
+                {
+                    auto c = Vec::fromRawArray(gateValues + paddedHidden + j) * Vec::fromRawArray(cell + j)
+                           + Vec::fromRawArray(gateValues + j) * Vec::fromRawArray(gateValues + 2 * paddedHidden + j);
+
+                    c.copyToRawArray(cell + j);
+                    c.copyToRawArray(scratch + j);
+                }
+
+                activate<paddedHidden, false> (scratch, scratch + paddedHidden);
+
+                // Padding units have all-zero weights, their cell and output stay at zero
+                for (int j = 0; j < paddedHidden; j += lanes)
+                    (Vec::fromRawArray(gateValues + 3 * paddedHidden + j) * Vec::fromRawArray(scratch + j)).copyToRawArray(state + j);
+
+                // The input sitting after the hidden state meets a zero weight here
+                output[i] = dotProduct<hiddenSize + 1> (linearWeights, state) + linearBias + (skip ? x : 0.f);
+            }
+        }
+
+        juce::String getDescription() const override
+        {
+            return "LSTM " + juce::String(hiddenSize);
+        }
+
+    private:
+        bool setWeights(const juce::var& stateDict, juce::String& error)
+        {
+            std::vector<float> inputWeights, hiddenWeights, inputBias, hiddenBias, outputWeights, outputBias;
+
+            if (! readTensor(stateDict, "rec.weight_ih_l0", 4 * hiddenSize, inputWeights, error)
+             || ! readTensor(stateDict, "rec.weight_hh_l0", 4 * hiddenSize * hiddenSize, hiddenWeights, error)
+             || ! readTensor(stateDict, "rec.bias_ih_l0", 4 * hiddenSize, inputBias, error)
+             || ! readTensor(stateDict, "rec.bias_hh_l0", 4 * hiddenSize, hiddenBias, error)
+             || ! readTensor(stateDict, "lin.weight", hiddenSize, outputWeights, error)
+             || ! readTensor(stateDict, "lin.bias", 1, outputBias, error))
+                return false;
+
+            for (int row = 0; row < 4 * hiddenSize; ++row)
+            {
+                auto paddedRow = row / hiddenSize * paddedHidden + row % hiddenSize;
+
+                for (int column = 0; column < hiddenSize; ++column)
+                    gates.setWeight(paddedRow, column, hiddenWeights[(size_t)(row * hiddenSize + column)]);
+
+                gates.setWeight(paddedRow, hiddenSize, inputWeights[(size_t)row]);
+                gates.bias[paddedRow] = inputBias[(size_t)row] + hiddenBias[(size_t)row];
+            }
+
+            std::copy(outputWeights.begin(), outputWeights.end(), linearWeights);
+            linearBias = outputBias[0];
+
+            return true;
+        }
+
+        static constexpr int paddedHidden = roundUpToRegister(hiddenSize);
+        static constexpr int stateSize = roundUpToRegister(hiddenSize + 1);
+
+        MatrixVector<4 * paddedHidden, hiddenSize + 1> gates;
+        alignas(Vec::SIMDRegisterSize) float linearWeights[stateSize] = {};
+        float linearBias = 0.f;
+        bool skip = false;
+
+        alignas(Vec::SIMDRegisterSize) float state[stateSize] = {};
+        alignas(Vec::SIMDRegisterSize) float cell[paddedHidden] = {};
+        alignas(Vec::SIMDRegisterSize) float gateValues[4 * paddedHidden] = {};
+        alignas(Vec::SIMDRegisterSize) float scratch[4 * paddedHidden] = {};
+    };
+
+    //==============================================================================
+    /*
+    * PyTorch's GRU, one layer, then a linear layer. The new gate scales the
+    * hidden product by the reset gate before adding the input's, so the two
+    * products are kept apart here; the input one is only a column times the
+    * input sample. Gates are in PyTorch's order: reset, update, new, each
+    * starting on a register boundary like the LSTM's.
+    */
+    template <int hiddenSize>
+    class GRUModel final : public NeuralAmpModel
+    {
+    public:
+        static std::unique_ptr<NeuralAmpModel> create(const juce::var& stateDict, bool skip, juce::String& error)
+        {
+            auto model = std::make_unique<GRUModel>();
+
+            if (! model->setWeights(stateDict, error))
+                return {};
+
+            model->skip = skip;
+            return model;
+        }
+
+        std::unique_ptr<NeuralAmpModel> clone() const override
+        {
+            auto copy = std::make_unique<GRUModel> (*this);
+            copy->reset();
+            return copy;
+        }
+
+        void reset() noexcept override
+        {
+            std::fill(std::begin(state), std::end(state), 0.f);
+        }
+
+        void process(const float* input, float* output, int numSamples) noexcept override
+        {
+            for (int i = 0; i < numSamples; ++i)
+            {
+                hiddenGates.process(state, hiddenValues);
+
+                auto x = Vec::expand(input[i]);
+
+                for (int j = 0; j < 2 * paddedHidden; j += lanes)
+                    (Vec::fromRawArray(inputWeights + j) * x + Vec::fromRawArray(inputBias + j) + Vec::fromRawArray(hiddenValues + j)).copyToRawArray(gateValues + j);
+
+                activate<2 * paddedHidden, true> (gateValues, scratch);
+
+                for (int j = 2 * paddedHidden; j < 3 * paddedHidden; j += lanes)
+                    (Vec::fromRawArray(inputWeights + j) * x + Vec::fromRawArray(inputBias + j)
+                      + Vec::fromRawArray(gateValues + j - 2 * paddedHidden) * Vec::fromRawArray(hiddenValues + j)).copyToRawArray(gateValues + j);
+
+                activate<paddedHidden, false> (gateValues + 2 * paddedHidden, scratch);
+
+                // Padding units have all-zero weights and stay at zero
+                for (int j = 0; j < paddedHidden; j += lanes)
+                {
+                    auto candidate = Vec::fromRawArray(gateValues + 2 * paddedHidden + j);
+                    auto update = Vec::fromRawArray(gateValues + paddedHidden + j);
+
+                    (candidate + update * (Vec::fromRawArray(state + j) - candidate)).copyToRawArray(state + j);
+                }
+
+                output[i] = dotProduct<hiddenSize> (linearWeights, state) + linearBias + (skip ? input[i] : 0.f);
+            }
+        }
+
+        juce::String getDescription() const override
+        {
+            return "GRU " + juce::String(hiddenSize);
+        }
+
+    private:
+        bool setWeights(const juce::var& stateDict, juce::String& error)
+        {
+            std::vector<float> weightsIn, hiddenWeights, biasIn, hiddenBias, outputWeights, outputBias;
+
+            if (! readTensor(stateDict, "rec.weight_ih_l0", 3 * hiddenSize, weightsIn, error)
+             || ! readTensor(stateDict, "rec.weight_hh_l0", 3 * hiddenSize * hiddenSize, hiddenWeights, error)
+             || ! readTensor(stateDict, "rec.bias_ih_l0", 3 * hiddenSize, biasIn, error)
+             || ! readTensor(stateDict, "rec.bias_hh_l0", 3 * hiddenSize, hiddenBias, error)
+             || ! readTensor(stateDict, "lin.weight", hiddenSize, outputWeights, error)
+             || ! readTensor(stateDict, "lin.bias", 1, outputBias, error))
+                return false;
+
+            for (int row = 0; row < 3 * hiddenSize; ++row)
+            {
+                auto paddedRow = row / hiddenSize * paddedHidden + row % hiddenSize;
+
+                for (int column = 0; column < hiddenSize; ++column)
+                    hiddenGates.setWeight(paddedRow, column, hiddenWeights[(size_t)(row * hiddenSize + column)]);
+
+                hiddenGates.bias[paddedRow] = hiddenBias[(size_t)row];
+                inputWeights[paddedRow] = weightsIn[(size_t)row];
+                inputBias[paddedRow] = biasIn[(size_t)row];
+            }
+
+            std::copy(outputWeights.begin(), outputWeights.end(), linearWeights);
+            linearBias = outputBias[0];
+
+            return true;
+        }
+
+        static constexpr int paddedHidden = roundUpToRegister(hiddenSize);
+
+        MatrixVector<3 * paddedHidden, hiddenSize> hiddenGates;
+        alignas(Vec::SIMDRegisterSize) float inputWeights[3 * paddedHidden] = {};
+        alignas(Vec::SIMDRegisterSize) float inputBias[3 * paddedHidden] = {};
+        alignas(Vec::SIMDRegisterSize) float linearWeights[paddedHidden] = {};
+        float linearBias = 0.f;
+        bool skip = false;
+
+        alignas(Vec::SIMDRegisterSize) float state[paddedHidden] = {};
+        alignas(Vec::SIMDRegisterSize) float hiddenValues[3 * paddedHidden] = {};
+        alignas(Vec::SIMDRegisterSize) float gateValues[3 * paddedHidden] = {};
+        alignas(Vec::SIMDRegisterSize) float scratch[2 * paddedHidden] = {};
+    };
+
+    //==============================================================================
+    /*
+    * A WaveNet stack like PedalNet's. A 1x1 convolution takes the input up to
+    * `channels` channels, then every layer is a causal dilated convolution to
+    * twice that, a gated activation tanh(a) * sigmoid(b), and a 1x1 residual
+    * convolution added back onto the layer's input. The gated outputs of all
+    * the layers are summed and a 1x1 head takes the sum down to the output.
+    *
+    * "weights" is every parameter flattened in PyTorch's layouts, in this order:
+    *
+    *     input.weight [channels], input.bias [channels]
+    *     then for each dilation:
+    *         conv.weight [2 * channels][channels][kernel_size], conv.bias [2 * channels]
+    *         residual.weight [channels][channels], residual.bias [channels]
+    *     head.weight [channels], head.bias [1]
+    *
+    * Each layer keeps a ring of its past input frames, a power of two long, and
+    * gathers the kernel's taps out of it into one vector, so the convolution is
+    * a single matrix-vector product over all the taps.
+    */
+    template <int channels, int kernelSize>
+    class WaveNetModel final : public NeuralAmpModel
+    {
+    public:
+        static std::unique_ptr<NeuralAmpModel> create(const juce::var& json, juce::String& error)
+        {
+            auto model = std::make_unique<WaveNetModel>();
+
+            if (! model->setWeights(json, error))
+                return {};
+
+            return model;
+        }
+
+        std::unique_ptr<NeuralAmpModel> clone() const override
+        {
+            auto copy = std::make_unique<WaveNetModel> (*this);
+            copy->reset();
+            return copy;
+        }
+
+        void reset() noexcept override
+        {
+            for (auto& layer : layers)
+                std::fill(layer.history.begin(), layer.history.end(), 0.f);
+
+            position = 0;
+        }
+
+        void process(const float* input, float* output, int numSamples) noexcept override
+        {
+            for (int i = 0; i < numSamples; ++i)
+            {
+                auto x = Vec::expand(input[i]);
+
+                for (int r = 0; r < paddedChannels; r += lanes)
+                {
+                    (Vec::fromRawArray(inputBias + r) + Vec::fromRawArray(inputWeights + r) * x).copyToRawArray(frame + r);
+                    Vec::expand(0.f).copyToRawArray(skipSum + r);
+                }
+
+                for (auto& layer : layers)
+                {
+                    std::copy(frame, frame + channels, layer.history.data() + (position & layer.mask) * channels);
+
+                    // The oldest tap first, that's kernel index 0 in PyTorch's causal convolution
+                    for (int k = 0; k < kernelSize; ++k)
+                    {
+                        auto tap = (position - (juce::uint32)((kernelSize - 1 - k) * layer.dilation)) & layer.mask;
+                        std::copy_n(layer.history.data() + tap * channels, channels, taps + k * channels);
+                    }
+
+                    layer.convolution.process(taps, convolved);
+
+                    activate<paddedChannels, false> (convolved, scratch);
+                    activate<paddedChannels, true> (convolved + paddedChannels, scratch);
+
+                    for (int r = 0; r < paddedChannels; r += lanes)
+                    {
+                        auto g = Vec::fromRawArray(convolved + r) * Vec::fromRawArray(convolved + paddedChannels + r);
+
+                        g.copyToRawArray(gated + r);
+                        (Vec::fromRawArray(skipSum + r) + g).copyToRawArray(skipSum + r);
+                    }
+
+                    layer.residual.process(gated, mixed);
+
+                    for (int r = 0; r < paddedChannels; r += lanes)
+                        (Vec::fromRawArray(frame + r) + Vec::fromRawArray(mixed + r)).copyToRawArray(frame + r);
+                }
+
+                output[i] = dotProduct<channels> (headWeights, skipSum) + headBias;
+                ++position;
+            }
+        }
+
+        juce::String getDescription() const override
+        {
+            return "WaveNet " + juce::String(channels) + "x" + juce::String(kernelSize) + ", " + juce::String((int)layers.size()) + " layers";
+        }
+
+    private:
+        static constexpr int paddedChannels = roundUpToRegister(channels);
+
+        struct Layer
+        {
+            MatrixVector<2 * paddedChannels, kernelSize * channels> convolution;
+            MatrixVector<paddedChannels, channels> residual;
+            std::vector<float> history;
+            juce::uint32 dilation = 1, mask = 0;
+        };
+
+        bool setWeights(const juce::var& json, juce::String& error)
+        {
+            auto* dilations = json["dilations"].getArray();
+
+            if (dilations == nullptr || dilations->isEmpty() || dilations->size() > maximumLayers)
+            {
+                error = "dilations must list 1 to " + juce::String(maximumLayers) + " layers";
+                return false;
+            }
+
+            layers.resize((size_t)dilations->size());
+
+            for (int l = 0; l < dilations->size(); ++l)
+            {
+                auto dilation = (int)dilations->getReference(l);
+
+                if (dilation < 1 || dilation > maximumDilation)
+                {
+                    error = "dilations must be from 1 to " + juce::String(maximumDilation);
+                    return false;
+                }
+
+                auto& layer = layers[(size_t)l];
+                layer.dilation = (juce::uint32)dilation;
+                layer.mask = (juce::uint32)juce::nextPowerOfTwo((kernelSize - 1) * dilation + 1) - 1;
+                layer.history.assign((size_t)(layer.mask + 1) * channels, 0.f);
+            }
+
+            auto layerSize = 2 * channels * channels * kernelSize + 2 * channels + channels * channels + channels;
+            auto expectedSize = 2 * channels + (int)layers.size() * layerSize + channels + 1;
+
+            std::vector<float> weights;
+
+            if (! readTensor(json, "weights", expectedSize, weights, error))
+                return false;
+
+            auto next = weights.begin();
+
+            for (int j = 0; j < channels; ++j)  inputWeights[j] = *next++;
+            for (int j = 0; j < channels; ++j)  inputBias[j] = *next++;
+
+            for (auto& layer : layers)
+            {
+                // The tanh half and the sigmoid half each start on a register boundary
+                for (int out = 0; out < 2 * channels; ++out)
+                    for (int in = 0; in < channels; ++in)
+                        for (int k = 0; k < kernelSize; ++k)
+                            layer.convolution.setWeight(getConvolutionRow(out), k * channels + in, *next++);
+
+                for (int out = 0; out < 2 * channels; ++out)
+                    layer.convolution.bias[getConvolutionRow(out)] = *next++;
+
+                for (int out = 0; out < channels; ++out)
+                    for (int in = 0; in < channels; ++in)
+                        layer.residual.setWeight(out, in, *next++);
+
+                for (int out = 0; out < channels; ++out)
+                    layer.residual.bias[out] = *next++;
+            }
+
+            for (int j = 0; j < channels; ++j)  headWeights[j] = *next++;
+            headBias = *next++;
+
+            jassert(next == weights.end());
+            return true;
+        }
+
+        static int getConvolutionRow(int out) noexcept
+        {
+            return out < channels ? out : paddedChannels + out - channels;
+        }
+
+        static constexpr int maximumLayers = 32;
+        static constexpr int maximumDilation = 4096;
+
+        std::vector<Layer> layers;
+        juce::uint32 position = 0;
+
+        alignas(Vec::SIMDRegisterSize) float inputWeights[paddedChannels] = {};
+        alignas(Vec::SIMDRegisterSize) float inputBias[paddedChannels] = {};
+        alignas(Vec::SIMDRegisterSize) float headWeights[paddedChannels] = {};
+        float headBias = 0.f;
+
+        alignas(Vec::SIMDRegisterSize) float frame[paddedChannels] = {};
+        alignas(Vec::SIMDRegisterSize) float taps[kernelSize * channels] = {};
+        alignas(Vec::SIMDRegisterSize) float convolved[2 * paddedChannels] = {};
+        alignas(Vec::SIMDRegisterSize) float gated[paddedChannels] = {};
+        alignas(Vec::SIMDRegisterSize) float mixed[paddedChannels] = {};
+        alignas(Vec::SIMDRegisterSize) float skipSum[paddedChannels] = {};
+        alignas(Vec::SIMDRegisterSize) float scratch[paddedChannels] = {};
+    };
+}
+
+//==============================================================================
+std::unique_ptr<NeuralAmpModel> NeuralAmpModel::load (const juce::File& file, juce::String& error)
+{
+    auto json = juce::JSON::parse(file);
+
+    if (! json.isObject())
+    {
+        error = file.getFileName() + " isn't a JSON model file";
+        return {};
+    }
+
+    return fromJSON(json, error);
+}
+
+std::unique_ptr<NeuralAmpModel> NeuralAmpModel::fromJSON (const juce::var& json, juce::String& error)
+{
+    std::unique_ptr<NeuralAmpModel> model;
+
+    if (json["architecture"].toString() == "WaveNet")
+    {
+        auto numChannels = (int)json["channels"];
+        auto kernelSize = (int)json["kernel_size"];
+
+        if (kernelSize != 2 && kernelSize != 3)
+        {
+            error = "WaveNet kernel_size must be 2 or 3";
+            return {};
+        }
+
+        model = createForSize<4, 8, 12, 16> (numChannels, [&] (auto size) -> std::unique_ptr<NeuralAmpModel>
+        {
+            constexpr int channels = decltype (size)::value;
+
+            return kernelSize == 2 ? WaveNetModel<channels, 2>::create(json, error)
+                                   : WaveNetModel<channels, 3>::create(json, error);
+        });
+
+        if (model == nullptr && error.isEmpty())
+            error = "WaveNet channels must be one of " + listSizes({ 4, 8, 12, 16 });
+
+        return model;
+    }
+
+    auto modelData = json["model_data"];
+    auto stateDict = json["state_dict"];
+
+    if (! modelData.isObject() || ! stateDict.isObject())
+    {
+        error = "Not a model file: no WaveNet architecture, model_data or state_dict";
+        return {};
+    }
+
+    auto unitType = modelData["unit_type"].toString();
+
+    if (unitType != "LSTM" && unitType != "GRU")
+    {
+        error = "unit_type must be LSTM or GRU";
+        return {};
+    }
+
+    if ((int)modelData.getProperty("input_size", 1) != 1 || (int)modelData.getProperty("output_size", 1) != 1
+         || (int)modelData.getProperty("num_layers", 1) != 1)
+    {
+        error = "Only one input, one output and one recurrent layer are supported";
+        return {};
+    }
+
+    auto isLSTM = unitType == "LSTM";
+    auto skip = (int)modelData.getProperty("skip", 0) != 0;
+
+    model = createForSize<8, 12, 16, 20, 24, 32, 40, 64> ((int)modelData["hidden_size"], [&] (auto size) -> std::unique_ptr<NeuralAmpModel>
+    {
+        constexpr int hiddenSize = decltype (size)::value;
+
+        return isLSTM ? LSTMModel<hiddenSize>::create(stateDict, skip, error)
+                      : GRUModel<hiddenSize>::create(stateDict, skip, error);
+    });
+
+    if (model == nullptr && error.isEmpty())
+        error = "hidden_size must be one of " + listSizes({ 8, 12, 16, 20, 24, 32, 40, 64 });
+
+    return model;
+}
@@ -0,0 +1,67 @@
+/*
+  ==============================================================================
+
+    NeuralAmpModel.h
+
+  ==============================================================================
+*/
+
+#pragma once
+
+#include <JuceHeader.h>
+
+//==============================================================================
+/**
+    A captured amp or pedal: a small neural network run sample by sample.
+
+    Two kinds of model file are read, both JSON:
+
+    - Recurrent models in the layout GuitarML's Automated-GuitarAmpModelling
+      exports: "model_data" with unit_type LSTM or GRU, hidden_size and skip,
+      and "state_dict" with the PyTorch rec.* and lin.* tensors. One recurrent
+      layer, one input and one output.
+
+    - WaveNet style models: {"architecture": "WaveNet", "channels", "kernel_size",
+      "dilations": [...], "weights": [...]}, a stack of gated dilated
+      convolutions. The weight order is documented in NeuralAmpModel.cpp.
+
+    Every layer size is a template argument, so the weights are fixed size
+    arrays and the inner loops have constant trip counts. The matrix-vector
+    products are written with juce::dsp::SIMDRegister. Only the sizes listed
+    in the .cpp are built in, a model of any other size is refused when it
+    loads. Nothing is allocated after load, process() is safe on the audio
+    thread.
+
+    A model has state, so every channel needs its own instance: load one, then
+    clone() it for the rest. Models are run at the host rate whatever rate
+    they were trained at.
+*/
+class NeuralAmpModel
+{
+public:
+    virtual ~NeuralAmpModel() = default;
+
+    // Returns nullptr, with the reason in error, if the model can't be used
+    static std::unique_ptr<NeuralAmpModel> load(const juce::File& file, juce::String& error);
+    static std::unique_ptr<NeuralAmpModel> fromJSON(const juce::var& json, juce::String& error);
+
+    // The same weights with cleared state
+    virtual std::unique_ptr<NeuralAmpModel> clone() const = 0;
+
+    virtual void reset() noexcept = 0;
+
+    // The input and output may be the same buffer
+    virtual void process(const float* input, float* output, int numSamples) noexcept = 0;
+
+    // e.g. "LSTM 40", for the GUI and logs
+    virtual juce::String getDescription() const = 0;
+
+protected:
+    NeuralAmpModel() = default;
+    NeuralAmpModel(const NeuralAmpModel&) = default;
+
+private:
+    NeuralAmpModel& operator= (const NeuralAmpModel&) = delete;
+
+    JUCE_LEAK_DETECTOR(NeuralAmpModel)
+};
@@ -0,0 +1,402 @@
+/*
+  ==============================================================================
+
+    NonUniformConvolution.cpp
+
+  ==============================================================================
+*/
+
+#include "NonUniformConvolution.h"
+
+static int getFFTOrder(int fftSize)
+{
+    int order = 0;
+
+    while ((1 << order) < fftSize)
+        ++order;
+
+    return order;
+}
+
+//==============================================================================
+/*
+* One stretch of the IR convolved with a single partition size on its own thread.
+*
+* The audio thread writes input into a ring of blocks and publishes how many
+* blocks are complete. The worker polls for that, computes each block's output
+* and marks the ring slot with the block it holds, so the audio thread can tell
+* a finished block from one left over from the last lap of the ring. Nothing here ever
+* locks or signals from the audio thread.
+*/
+class NonUniformConvolution::Segment : private juce::Thread
+{
+public:
+    Segment(const juce::AudioBuffer<float>& impulseResponse, int offset, int end, int partitionSize, int numChannels)
+        : juce::Thread("Reverb tail " + juce::String(partitionSize)),
+          partitionSize(partitionSize), numBins(partitionSize + 1), delayBlocks(offset / partitionSize),
+          numChannels(numChannels), fft(getFFTOrder(2 * partitionSize))
+    {
+        // The worker gets delayBlocks - 1 blocks of time, the ring has to outlast that comfortably
+        jassert(offset % partitionSize == 0 && delayBlocks >= 2 && delayBlocks < ringBlocks / 2);
+
+        numPartitions = juce::jmax(1, (end - offset + partitionSize - 1) / partitionSize);
+
+        frame.assign((size_t)(4 * partitionSize), 0.f);
+        accumulator.assign((size_t)(2 * numBins), 0.f);
+
+        frame[0] = 1.f;
+        fft.performRealOnlyForwardTransform(frame.data(), true);
+        fft.performRealOnlyInverseTransform(frame.data());
+        inverseScale = 1.f / frame[0];
+
+        auto irChannels = juce::jmax(1, impulseResponse.getNumChannels());
+        spectra.resize((size_t)irChannels);
+
+        for (int channel = 0; channel < irChannels; ++channel)
+        {
+            auto& channelSpectra = spectra[(size_t)channel];
+            channelSpectra.assign((size_t)(numPartitions * 2 * numBins), 0.f);
+
+            if (channel >= impulseResponse.getNumChannels())
+                continue;
+
+            auto* source = impulseResponse.getReadPointer(channel);
+
+            for (int partition = 0; partition < numPartitions; ++partition)
+            {
+                std::fill(frame.begin(), frame.end(), 0.f);
+
+                auto start = offset + partition * partitionSize;
+                std::copy(source + start, source + juce::jmin(start + partitionSize, end), frame.begin());
+
+                fft.performRealOnlyForwardTransform(frame.data(), true);
+                toSplitComplex(channelSpectra.data() + partition * 2 * numBins);
+            }
+        }
+
+        channels.resize((size_t)numChannels);
+
+        for (auto& state : channels)
+        {
+            state.inputRing.assign((size_t)(ringBlocks * partitionSize), 0.f);
+            state.outputRing.assign((size_t)(ringBlocks * partitionSize), 0.f);
+            state.previous.assign((size_t)partitionSize, 0.f);
+            state.fdl.assign((size_t)(numPartitions * 2 * numBins), 0.f);
+        }
+
+        for (auto& index : outputIndex)
+            index = -1;
+
+        // Above the message thread, the deadlines are tens of milliseconds
+        startThread(8);
+    }
+
+    ~Segment() override
+    {
+        stopThread(2000);
+    }
+
+    void signalExit()   { signalThreadShouldExit(); }
+
+    int getPartitionSize() const noexcept   { return partitionSize; }
+
+    //==============================================================================
+    // Audio thread. Drops everything before position, which must be on a block boundary.
+    void reset(juce::int64 position) noexcept
+    {
+        jassert(position % partitionSize == 0);
+
+        clearBefore = position / partitionSize;
+        blocksWritten.store(clearBefore, std::memory_order_release);
+        outputValid = false;
+    }
+
+    // Audio thread. Feeds the input and adds this segment's output, position is the first sample's.
+    void process(const float* const* input, float* const* output, int numChannelsToUse, int numSamples,
+                  juce::int64 position, bool waitForWorker, std::atomic<int>& numDeadlineMisses) noexcept
+    {
+        numChannelsToUse = juce::jmin(numChannelsToUse, numChannels);
+        int done = 0;
+
+        while (done < numSamples)
+        {
+            auto block = (position + done) / partitionSize;
+            auto blockPos = (int)((position + done) % partitionSize);
+            auto num = juce::jmin(numSamples - done, partitionSize - blockPos);
+
+            // The output due now was computed from the block delayBlocks back
+            auto outputBlock = block - delayBlocks;
+
+            if (blockPos == 0 && outputBlock >= clearBefore)
+            {
+                outputValid = isOutputReady(outputBlock);
+
+                // Its input went in long ago, so this only ever waits on the worker, give up after a second
+                for (int tries = 0; waitForWorker && ! outputValid && tries < 1000; ++tries)
+                {
+                    juce::Thread::sleep(1);
+                    outputValid = isOutputReady(outputBlock);
+                }
+
+                if (! outputValid)
+                    ++numDeadlineMisses;
+            }
+
+            auto inputOffset = (int)(block % ringBlocks) * partitionSize + blockPos;
+            auto outputOffset = (int)(outputBlock % ringBlocks) * partitionSize + blockPos;
+
+            for (int channel = 0; channel < numChannelsToUse; ++channel)
+            {
+                auto& state = channels[(size_t)channel];
+                std::copy(input[channel] + done, input[channel] + done + num, state.inputRing.data() + inputOffset);
+
+                if (outputValid)
+                    juce::FloatVectorOperations::add(output[channel] + done, state.outputRing.data() + outputOffset, num);
+            }
+
+            done += num;
+
+            if (blockPos + num == partitionSize)
+                blocksWritten.store(block + 1, std::memory_order_release);
+        }
+    }
+
+private:
+    static constexpr int ringBlocks = 16;
+
+    struct ChannelState
+    {
+        std::vector<float> inputRing, outputRing;   // ringBlocks blocks each, written by the audio thread and the worker
+        std::vector<float> previous;                // last input block, for the overlap-save frame
+        std::vector<float> fdl;                     // numPartitions input spectra
+    };
+
+    bool isOutputReady(juce::int64 block) const noexcept
+    {
+        return outputIndex[block % ringBlocks].load(std::memory_order_acquire) == block;
+    }
+
+    void run() override
+    {
+        juce::int64 nextBlock = 0, clearedBefore = 0;
+
+        while (! threadShouldExit())
+        {
+            auto written = blocksWritten.load(std::memory_order_acquire);
+
+            // The audio thread reset, the FDL holds input that isn't there any more
+            if (clearBefore > clearedBefore)
+            {
+                clearState();
+                clearedBefore = clearBefore;
+                nextBlock = juce::jmax(nextBlock, clearedBefore);
+            }
+
+            // So far behind the input ring is about to be overwritten: start again from the newest block
+            if (written - nextBlock > ringBlocks / 2)
+            {
+                clearState();
+                nextBlock = written - 1;
+            }
+
+            while (nextBlock < written && ! threadShouldExit())
+                computeBlock(nextBlock++);
+
+            // Polling, because waking a thread isn't something the audio thread can do safely
+            wait(1);
+        }
+    }
+
+    void computeBlock(juce::int64 block) noexcept
+    {
+        auto slot = (int)(block % ringBlocks) * partitionSize;
+        fdlHead = (fdlHead + 1) % numPartitions;
+
+        for (int channel = 0; channel < numChannels; ++channel)
+        {
+            auto& state = channels[(size_t)channel];
+            auto* input = state.inputRing.data() + slot;
+
+            std::copy(state.previous.begin(), state.previous.end(), frame.begin());
+            std::copy(input, input + partitionSize, frame.begin() + partitionSize);
+            std::copy(input, input + partitionSize, state.previous.begin());
+            std::fill(frame.begin() + 2 * partitionSize, frame.end(), 0.f);
+
+            fft.performRealOnlyForwardTransform(frame.data(), true);
+            toSplitComplex(state.fdl.data() + fdlHead * 2 * numBins);
+        }
+
+        // Like a seqlock reader: if the audio thread has come round to this slot again the copy may be torn
+        std::atomic_thread_fence(std::memory_order_acquire);
+
+        if (blocksWritten.load(std::memory_order_relaxed) >= block + ringBlocks)
+        {
+            clearState();
+            return;
+        }
+
+        for (int channel = 0; channel < numChannels; ++channel)
+        {
+            auto& state = channels[(size_t)channel];
+            auto& channelSpectra = spectra[(size_t)juce::jmin(channel, (int)spectra.size() - 1)];
+
+            auto* accRe = accumulator.data();
+            auto* accIm = accRe + numBins;
+            std::fill(accumulator.begin(), accumulator.end(), 0.f);
+
+            // Partition p meets the input spectrum from p blocks ago
+            for (int partition = 0; partition < numPartitions; ++partition)
+            {
+                auto fdlSlot = (fdlHead - partition + numPartitions) % numPartitions;
+
+                auto* xRe = state.fdl.data() + fdlSlot * 2 * numBins;
+                auto* xIm = xRe + numBins;
+                auto* hRe = channelSpectra.data() + partition * 2 * numBins;
+                auto* hIm = hRe + numBins;
+
+                for (int bin = 0; bin < numBins; ++bin)
+                {
+                    accRe[bin] += xRe[bin] * hRe[bin] - xIm[bin] * hIm[bin];
+                    accIm[bin] += xRe[bin] * hIm[bin] + xIm[bin] * hRe[bin];
+                }
+            }
+
+            for (int bin = 0; bin < numBins; ++bin)
+            {
+                frame[(size_t)(2 * bin)] = accRe[bin];
+                frame[(size_t)(2 * bin + 1)] = accIm[bin];
+            }
+
+            std::fill(frame.begin() + 2 * numBins, frame.end(), 0.f);
+            fft.performRealOnlyInverseTransform(frame.data());
+
+            // Overlap-save keeps the second half
+            auto* destination = state.outputRing.data() + slot;
+
+            for (int i = 0; i < partitionSize; ++i)
+                destination[i] = frame[(size_t)(partitionSize + i)] * inverseScale;
+        }
+
+        outputIndex[block % ringBlocks].store(block, std::memory_order_release);
+    }
+
+    void clearState() noexcept
+    {
+        for (auto& state : channels)
+        {
+            std::fill(state.previous.begin(), state.previous.end(), 0.f);
+            std::fill(state.fdl.begin(), state.fdl.end(), 0.f);
+        }
+
+        fdlHead = 0;
+    }
+
+    void toSplitComplex(float* destination) const noexcept
+    {
+        for (int bin = 0; bin < numBins; ++bin)
+        {
+            destination[bin] = frame[(size_t)(2 * bin)];
+            destination[numBins + bin] = frame[(size_t)(2 * bin + 1)];
+        }
+    }
+
+    const int partitionSize, numBins, delayBlocks, numChannels;
+    int numPartitions = 1;
+
+    juce::dsp::FFT fft;
+    float inverseScale = 1.f;
+    std::vector<float> frame, accumulator;
+
+    // Partitions per IR channel, numBins real parts then numBins imaginary parts each
+    std::vector<std::vector<float>> spectra;
+    std::vector<ChannelState> channels;
+    int fdlHead = 0;
+
+    std::atomic<juce::int64> blocksWritten { 0 }, clearBefore { 0 };
+    std::atomic<juce::int64> outputIndex[ringBlocks];
+
+    // Audio thread only
+    bool outputValid = false;
+
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR(Segment)
+};
+
+//==============================================================================
+NonUniformConvolution::NonUniformConvolution (const juce::AudioBuffer<float>& impulseResponse, int numChannelsToUse, int maximumBlockSize)
+    : length(impulseResponse.getNumSamples()), numChannels(juce::jmax(1, numChannelsToUse)),
+      headFilter(impulseResponse, headPartitionSize, headLength / headPartitionSize)
+{
+    head.prepare(numChannels, headPartitionSize, headLength / headPartitionSize);
+    head.setFilter(&headFilter);
+
+    /*
+    * Each segment starts at four of its partitions, so its worker always has three
+    * blocks of time. The middle one keeps the 4096 partitions from having to
+    * start past 16384 on their own.
+    */
+    struct Layout { int partitionSize, offset, end; };
+
+    const Layout layouts[] =
+    {
+        { 512,  headLength, 16384 },
+        { 4096, 16384,      std::numeric_limits<int>::max() },
+    };
+
+    for (auto& layout : layouts)
+        if (length > layout.offset)
+            segments.push_back(std::make_unique<Segment> (impulseResponse, layout.offset, juce::jmin(layout.end, length),
+                                                           layout.partitionSize, numChannels));
+
+    input.setSize(numChannels, juce::jmax(1, maximumBlockSize));
+    inputPointers.resize((size_t)numChannels);
+}
+
+NonUniformConvolution::~NonUniformConvolution()
+{
+    // Let them all start winding down before waiting on any one of them
+    for (auto& segment : segments)
+        segment->signalExit();
+
+    segments.clear();
+}
+
+void NonUniformConvolution::reset() noexcept
+{
+    head.reset();
+
+    // Segment blocks are counted from the first sample, so jump to where all of them have a boundary
+    juce::int64 alignment = 1;
+
+    for (auto& segment : segments)
+        alignment = juce::jmax(alignment, (juce::int64)segment->getPartitionSize());
+
+    position = (position + alignment - 1) / alignment * alignment;
+
+    for (auto& segment : segments)
+        segment->reset(position);
+
+    numDeadlineMisses = 0;
+}
+
+void NonUniformConvolution::process (float* const* channels, int numChannelsToUse, int numSamples) noexcept
+{
+    numChannelsToUse = juce::jmin(numChannelsToUse, numChannels);
+
+    for (int start = 0; start < numSamples; start += input.getNumSamples())
+    {
+        auto num = juce::jmin(numSamples - start, input.getNumSamples());
+
+        for (int channel = 0; channel < numChannelsToUse; ++channel)
+        {
+            input.copyFrom(channel, 0, channels[channel] + start, num);
+            inputPointers[(size_t)channel] = channels[channel] + start;
+        }
+
+        head.process(inputPointers.data(), numChannelsToUse, num);
+
+        for (auto& segment : segments)
+            segment->process(input.getArrayOfReadPointers(), inputPointers.data(), numChannelsToUse, num, position, nonRealtime, numDeadlineMisses);
+
+        position += num;
+    }
+}
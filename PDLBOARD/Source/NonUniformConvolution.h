@@ -0,0 +1,76 @@
+/*
+  ==============================================================================
+
+    NonUniformConvolution.h
+
+  ==============================================================================
+*/
+
+#pragma once
+
+#include <JuceHeader.h>
+#include "PartitionedConvolution.h"
+
+//==============================================================================
+/**
+    Zero latency convolution for long impulse responses (reverbs of several seconds).
+
+    The IR is split into segments that use bigger partitions the further out they are:
+
+        [0, 2048)           64 sample partitions, on the audio thread (PartitionedConvolution)
+        [2048, 16384)       512 sample partitions, on a worker thread
+        [16384, end)        4096 sample partitions, on another worker thread
+
+    A segment that starts at offset O with partition size L only needs input that
+    is at least O samples old. Each time the audio thread completes an L sample
+    input block it hands it to the segment's worker, and the result isn't played
+    until O - L samples later. Every segment starts at 4 L, so a worker has three
+    of its own blocks to finish. That deadline is checked when the result is due.
+    A late block is left out and counted, and the audio thread never waits.
+
+    The audio thread's cost per sample is the same for a 2 s IR as for a 10 s
+    one. Only the workers' share grows with the length.
+*/
+class NonUniformConvolution
+{
+public:
+    // Builds everything and starts the workers. The IR must be at the processing sample rate.
+    NonUniformConvolution(const juce::AudioBuffer<float>& impulseResponse, int numChannels, int maximumBlockSize);
+    ~NonUniformConvolution();
+
+    // Audio thread safe, the workers drop what they have and start from silence
+    void reset() noexcept;
+
+    // Replaces the samples with the convolution. Audio thread only.
+    void process(float* const* channels, int numChannels, int numSamples) noexcept;
+
+    // Offline, a late block is waited for instead of left out
+    void setNonRealtime(bool shouldWait) noexcept  { nonRealtime = shouldWait; }
+
+    // Blocks a worker didn't finish in time since the last reset
+    int getNumDeadlineMisses() const noexcept   { return numDeadlineMisses.load(); }
+
+    int getLength() const noexcept              { return length; }
+
+    static constexpr int headPartitionSize = 64;
+    static constexpr int headLength = 2048;
+
+private:
+    class Segment;
+
+    int length, numChannels;
+
+    PartitionedConvolution::Filter headFilter;
+    PartitionedConvolution head;
+
+    std::vector<std::unique_ptr<Segment>> segments;
+
+    juce::AudioBuffer<float> input;
+    std::vector<float*> inputPointers;
+    juce::int64 position = 0;
+    bool nonRealtime = false;
+
+    std::atomic<int> numDeadlineMisses { 0 };
+
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR(NonUniformConvolution)
+};
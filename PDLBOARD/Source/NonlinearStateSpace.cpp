@@ -0,0 +1,728 @@
+/*
+  ==============================================================================
+
+    NonlinearStateSpace.cpp
+
+  ==============================================================================
+*/
+
+#include "NonlinearStateSpace.h"
+
+namespace
+{
+    // Dense, double precision, only used while building
+    struct Matrix
+    {
+        Matrix(int numRows = 0, int numColumns = 0) : rows(numRows), columns(numColumns), values((size_t)(numRows * numColumns), 0.0) {}
+
+        double& operator() (int row, int column)            { return values[(size_t)(row * columns + column)]; }
+        double operator() (int row, int column) const       { return values[(size_t)(row * columns + column)]; }
+
+        int rows, columns;
+        std::vector<double> values;
+    };
+
+    Matrix operator* (const Matrix& a, const Matrix& b)
+    {
+        jassert(a.columns == b.rows);
+        Matrix result(a.rows, b.columns);
+
+        for (int row = 0; row < a.rows; ++row)
+            for (int k = 0; k < a.columns; ++k)
+                for (int column = 0; column < b.columns; ++column)
+                    result(row, column) += a(row, k) * b(k, column);
+
+        return result;
+    }
+
+    Matrix operator- (const Matrix& a, const Matrix& b)
+    {
+        auto result = a;
+
+        for (size_t n = 0; n < result.values.size(); ++n)
+            result.values[n] -= b.values[n];
+
+        return result;
+    }
+
+    Matrix identity(int size)
+    {
+        Matrix result(size, size);
+
+        for (int n = 0; n < size; ++n)
+            result(n, n) = 1.0;
+
+        return result;
+    }
+
+    // Gauss-Jordan with partial pivoting. A singular matrix means a node with nothing connecting it to ground.
+    Matrix inverse(Matrix m)
+    {
+        jassert(m.rows == m.columns);
+
+        auto size = m.rows;
+        auto result = identity(size);
+
+        for (int column = 0; column < size; ++column)
+        {
+            auto pivot = column;
+
+            for (int row = column + 1; row < size; ++row)
+                if (std::abs(m(row, column)) > std::abs(m(pivot, column)))
+                    pivot = row;
+
+            jassert(m(pivot, column) != 0.0);
+
+            for (int k = 0; k < size; ++k)
+            {
+                std::swap(m(column, k), m(pivot, k));
+                std::swap(result(column, k), result(pivot, k));
+            }
+
+            auto scale = 1.0 / m(column, column);
+
+            for (int k = 0; k < size; ++k)
+            {
+                m(column, k) *= scale;
+                result(column, k) *= scale;
+            }
+
+            for (int row = 0; row < size; ++row)
+            {
+                if (row == column || m(row, column) == 0.0)
+                    continue;
+
+                auto factor = m(row, column);
+
+                for (int k = 0; k < size; ++k)
+                {
+                    m(row, k) -= factor * m(column, k);
+                    result(row, k) -= factor * result(column, k);
+                }
+            }
+        }
+
+        return result;
+    }
+
+    std::vector<float> toFloat(const Matrix& m)
+    {
+        return std::vector<float> (m.values.begin(), m.values.end());
+    }
+
+    std::vector<float> column(const Matrix& m, int index)
+    {
+        std::vector<float> result;
+
+        for (int row = 0; row < m.rows; ++row)
+            result.push_back((float)m(row, index));
+
+        return result;
+    }
+}
+
+//==============================================================================
+void NonlinearStateSpace::Circuit::addResistor (int node1, int node2, double resistance)      { resistors.push_back({ node1, node2, resistance }); }
+void NonlinearStateSpace::Circuit::addCapacitor (int node1, int node2, double capacitance)    { capacitors.push_back({ node1, node2, capacitance }); }
+void NonlinearStateSpace::Circuit::addSupply (int positive, int negative, double voltage)     { sources.push_back({ positive, negative, voltage }); }
+void NonlinearStateSpace::Circuit::addNonlinearPort (int positive, int negative)              { ports.push_back({ positive, negative, 0.0 }); }
+void NonlinearStateSpace::Circuit::setNonlinearity (Nonlinearity function)                    { nonlinearity = std::move (function); }
+
+void NonlinearStateSpace::Circuit::addInput (int positive, int negative)
+{
+    jassert(inputSource < 0);
+
+    inputSource = (int)sources.size();
+    sources.push_back({ positive, negative, 0.0 });
+}
+
+void NonlinearStateSpace::Circuit::setOutput (int positive, int negative)
+{
+    outputPositive = positive;
+    outputNegative = negative;
+}
+
+int NonlinearStateSpace::Circuit::getNumNodes() const
+{
+    int highest = juce::jmax(outputPositive, outputNegative);
+
+    for (auto* elements : { &resistors, &capacitors, &sources, &ports })
+        for (auto& element : *elements)
+            highest = juce::jmax(highest, element.node1, element.node2);
+
+    return highest;
+}
+
+//==============================================================================
+struct NonlinearStateSpace::Solver
+{
+    int numStates = 0, numPorts = 0, numSources = 0, inputSource = 0;
+
+    // B, E and H have a column per source, the input's and the supplies'
+    Matrix A, B, C, D, E, F, G, H, K;
+    std::vector<double> supplies;
+    Circuit::Nonlinearity nonlinearity;
+
+    // The DC operating point
+    std::vector<double> x0, v0, i0, p0;
+    double y0 = 0.0;
+
+    /*
+    * v = p + K f(v) by Newton, starting from whatever is in v. Steps that make
+    * things worse are halved, which keeps it from flying off up the exponentials.
+    */
+    bool solve(const Matrix& coupling, const double* p, double* v, double* i) const
+    {
+        double jacobian[maximumPorts * maximumPorts], residual[maximumPorts], step[maximumPorts];
+        double trialV[maximumPorts], trialI[maximumPorts], trialJacobian[maximumPorts * maximumPorts];
+
+        auto evaluate = [&] (const double* voltages, double* currents, double* derivatives, double* r)
+        {
+            nonlinearity(voltages, currents, derivatives);
+            auto norm = 0.0;
+
+            for (int row = 0; row < numPorts; ++row)
+            {
+                r[row] = p[row] - voltages[row];
+
+                for (int k = 0; k < numPorts; ++k)
+                    r[row] += coupling(row, k) * currents[k];
+
+                norm += r[row] * r[row];
+            }
+
+            return norm;
+        };
+
+        auto norm = evaluate(v, i, jacobian, residual);
+
+        for (int iteration = 0; iteration < 200; ++iteration)
+        {
+            // (K J - I) step = -residual, small enough for elimination in place
+            double m[maximumPorts][maximumPorts + 1];
+
+            for (int row = 0; row < numPorts; ++row)
+            {
+                for (int k = 0; k < numPorts; ++k)
+                {
+                    m[row][k] = row == k ? -1.0 : 0.0;
+
+                    for (int n = 0; n < numPorts; ++n)
+                        m[row][k] += coupling(row, n) * jacobian[n * numPorts + k];
+                }
+
+                m[row][numPorts] = -residual[row];
+            }
+
+            for (int k = 0; k < numPorts; ++k)
+            {
+                auto pivot = k;
+
+                for (int row = k + 1; row < numPorts; ++row)
+                    if (std::abs(m[row][k]) > std::abs(m[pivot][k]))
+                        pivot = row;
+
+                for (int n = 0; n <= numPorts; ++n)
+                    std::swap(m[k][n], m[pivot][n]);
+
+                for (int row = k + 1; row < numPorts; ++row)
+                {
+                    auto factor = m[row][k] / m[k][k];
+
+                    for (int n = k; n <= numPorts; ++n)
+                        m[row][n] -= factor * m[k][n];
+                }
+            }
+
+            for (int k = numPorts; --k >= 0;)
+            {
+                step[k] = m[k][numPorts];
+
+                for (int n = k + 1; n < numPorts; ++n)
+                    step[k] -= m[k][n] * step[n];
+
+                step[k] /= m[k][k];
+            }
+
+            auto scale = 1.0, trialNorm = 0.0;
+
+            for (int halving = 0; halving < 30; ++halving, scale *= 0.5)
+            {
+                for (int k = 0; k < numPorts; ++k)
+                    trialV[k] = v[k] + scale * step[k];
+
+                trialNorm = evaluate(trialV, trialI, trialJacobian, residual);
+
+                if (std::isfinite(trialNorm) && trialNorm <= norm)
+                    break;
+            }
+
+            auto largestStep = 0.0, largestVoltage = 1.0;
+
+            for (int k = 0; k < numPorts; ++k)
+            {
+                largestStep = juce::jmax(largestStep, std::abs(scale * step[k]));
+                largestVoltage = juce::jmax(largestVoltage, std::abs(v[k]));
+
+                v[k] = trialV[k];
+                i[k] = trialI[k];
+            }
+
+            std::copy(trialJacobian, trialJacobian + numPorts * numPorts, jacobian);
+            norm = trialNorm;
+
+            if (largestStep < 1.0e-12 * largestVoltage)
+                return true;
+        }
+
+        return false;
+    }
+
+    // One sample of the whole circuit. v carries the last solution over as the next starting point.
+    double step(std::vector<double>& x, double* v, double input) const
+    {
+        double p[maximumPorts], i[maximumPorts];
+
+        for (int row = 0; row < numPorts; ++row)
+        {
+            p[row] = H(row, inputSource) * input;
+
+            for (int source = 0; source < numSources; ++source)
+                p[row] += H(row, source) * supplies[(size_t)source];
+
+            for (int k = 0; k < numStates; ++k)
+                p[row] += G(row, k) * x[(size_t)k];
+        }
+
+        solve(K, p, v, i);
+
+        auto y = E(0, inputSource) * input;
+
+        for (int source = 0; source < numSources; ++source)
+            y += E(0, source) * supplies[(size_t)source];
+
+        for (int k = 0; k < numStates; ++k)
+            y += D(0, k) * x[(size_t)k];
+
+        for (int k = 0; k < numPorts; ++k)
+            y += F(0, k) * i[k];
+
+        auto next = x;
+
+        for (int row = 0; row < numStates; ++row)
+        {
+            next[(size_t)row] = B(row, inputSource) * input;
+
+            for (int source = 0; source < numSources; ++source)
+                next[(size_t)row] += B(row, source) * supplies[(size_t)source];
+
+            for (int k = 0; k < numStates; ++k)
+                next[(size_t)row] += A(row, k) * x[(size_t)k];
+
+            for (int k = 0; k < numPorts; ++k)
+                next[(size_t)row] += C(row, k) * i[k];
+        }
+
+        x = next;
+        return y;
+    }
+};
+
+//==============================================================================
+NonlinearStateSpace::NonlinearStateSpace (const Circuit& circuit, double sampleRate, double maximumInput, int tableSizeToUse)
+    : solver(std::make_unique<Solver>()), tableSize(tableSizeToUse)
+{
+    jassert(circuit.inputSource >= 0 && circuit.nonlinearity != nullptr);
+    jassert(! circuit.ports.empty() && (int)circuit.ports.size() <= maximumPorts);
+
+    auto& s = *solver;
+    auto numNodes = circuit.getNumNodes();
+    auto numSources = (int)circuit.sources.size();
+    auto size = numNodes + numSources;
+
+    numStates = s.numStates = (int)circuit.capacitors.size();
+    numPorts = s.numPorts = (int)circuit.ports.size();
+    s.numSources = numSources;
+    s.inputSource = circuit.inputSource;
+    s.nonlinearity = circuit.nonlinearity;
+
+    for (auto& source : circuit.sources)
+        s.supplies.push_back(source.value);
+
+    /*
+    * Modified nodal analysis, unknowns are the node voltages then the sources'
+    * currents. A trapezoidal capacitor is a conductance 2C fs with a current
+    * source x across it, and next sample's x is 2 (2C fs) v - x.
+    */
+    Matrix system(size, size), stateIn(size, numStates), sourceIn(size, numSources), portIn(size, numPorts);
+    Matrix stateOut(numStates, size), portOut(numPorts, size), output(1, size);
+
+    // Node n is row n - 1, ground has no row
+    auto stamp = [] (Matrix& m, int node1, int node2, int column, double value)
+    {
+        if (node1 > 0) m(node1 - 1, column) += value;
+        if (node2 > 0) m(node2 - 1, column) -= value;
+    };
+
+    auto stampConductance = [&] (int node1, int node2, double conductance)
+    {
+        if (node1 > 0) stamp(system, node1, node2, node1 - 1, conductance);
+        if (node2 > 0) stamp(system, node1, node2, node2 - 1, -conductance);
+    };
+
+    for (auto& resistor : circuit.resistors)
+        stampConductance(resistor.node1, resistor.node2, 1.0 / resistor.value);
+
+    std::vector<double> capacitorConductances;
+
+    for (int k = 0; k < numStates; ++k)
+    {
+        auto& capacitor = circuit.capacitors[(size_t)k];
+        auto conductance = 2.0 * capacitor.value * sampleRate;
+
+        stampConductance(capacitor.node1, capacitor.node2, conductance);
+        stamp(stateIn, capacitor.node1, capacitor.node2, k, 1.0);
+        capacitorConductances.push_back(conductance);
+
+        if (capacitor.node1 > 0) stateOut(k, capacitor.node1 - 1) += 1.0;
+        if (capacitor.node2 > 0) stateOut(k, capacitor.node2 - 1) -= 1.0;
+    }
+
+    for (int k = 0; k < numSources; ++k)
+    {
+        auto& source = circuit.sources[(size_t)k];
+
+        stamp(system, source.node1, source.node2, numNodes + k, 1.0);
+
+        if (source.node1 > 0) system(numNodes + k, source.node1 - 1) += 1.0;
+        if (source.node2 > 0) system(numNodes + k, source.node2 - 1) -= 1.0;
+
+        sourceIn(numNodes + k, k) = 1.0;
+    }
+
+    // A port's current leaves its positive node
+    for (int k = 0; k < numPorts; ++k)
+    {
+        auto& port = circuit.ports[(size_t)k];
+
+        stamp(portIn, port.node1, port.node2, k, -1.0);
+
+        if (port.node1 > 0) portOut(k, port.node1 - 1) += 1.0;
+        if (port.node2 > 0) portOut(k, port.node2 - 1) -= 1.0;
+    }
+
+    if (circuit.outputPositive > 0) output(0, circuit.outputPositive - 1) += 1.0;
+    if (circuit.outputNegative > 0) output(0, circuit.outputNegative - 1) -= 1.0;
+
+    auto systemInverse = inverse(system);
+
+    // x[n+1] = 2 Gc vc - x
+    auto capacitorVoltages = stateOut * systemInverse;
+
+    for (int row = 0; row < numStates; ++row)
+        for (int column = 0; column < size; ++column)
+            capacitorVoltages(row, column) *= 2.0 * capacitorConductances[(size_t)row];
+
+    s.A = capacitorVoltages * stateIn - identity(numStates);
+    s.B = capacitorVoltages * sourceIn;
+    s.C = capacitorVoltages * portIn;
+
+    auto outputRow = output * systemInverse;
+    s.D = outputRow * stateIn;
+    s.E = outputRow * sourceIn;
+    s.F = outputRow * portIn;
+
+    auto portRows = portOut * systemInverse;
+    s.G = portRows * stateIn;
+    s.H = portRows * sourceIn;
+    s.K = portRows * portIn;
+
+    /*
+    * The operating point. At DC x = A x + B u + C i, so x = (I - A)^-1 (B u + C i)
+    * and the ports see v = p + K i with p and K folded through that, which is one
+    * more Newton solve rather than simulating until the capacitors charge.
+    */
+    auto settle = inverse(identity(numStates) - s.A);
+    auto dcCoupling = s.G * settle * s.C;
+    auto dcSupply = s.G * settle * s.B;
+
+    for (int row = 0; row < numPorts; ++row)
+        for (int k = 0; k < numPorts; ++k)
+            dcCoupling(row, k) += s.K(row, k);
+
+    double dcP[maximumPorts] = {}, v[maximumPorts] = {}, i[maximumPorts] = {};
+
+    for (int row = 0; row < numPorts; ++row)
+        for (int source = 0; source < numSources; ++source)
+            dcP[row] += (dcSupply(row, source) + s.H(row, source)) * s.supplies[(size_t)source];
+
+    auto converged = s.solve(dcCoupling, dcP, v, i);
+    jassert(converged);
+    juce::ignoreUnused(converged);
+
+    s.v0.assign(v, v + numPorts);
+    s.i0.assign(i, i + numPorts);
+    s.x0.assign((size_t)numStates, 0.0);
+    s.p0.assign((size_t)numPorts, 0.0);
+
+    for (int row = 0; row < numStates; ++row)
+    {
+        for (int source = 0; source < numSources; ++source)
+            for (int k = 0; k < numStates; ++k)
+                s.x0[(size_t)row] += settle(row, k) * s.B(k, source) * s.supplies[(size_t)source];
+
+        for (int n = 0; n < numPorts; ++n)
+            for (int k = 0; k < numStates; ++k)
+                s.x0[(size_t)row] += settle(row, k) * s.C(k, n) * i[n];
+    }
+
+    for (int row = 0; row < numPorts; ++row)
+    {
+        for (int source = 0; source < numSources; ++source)
+            s.p0[(size_t)row] += s.H(row, source) * s.supplies[(size_t)source];
+
+        for (int k = 0; k < numStates; ++k)
+            s.p0[(size_t)row] += s.G(row, k) * s.x0[(size_t)k];
+    }
+
+    {
+        auto x = s.x0;
+        double vDC[maximumPorts];
+        std::copy(v, v + numPorts, vDC);
+        s.y0 = s.step(x, vDC, 0.0);
+    }
+
+    /*
+    * The table's extent: every p a loud sweep reaches, from 30 Hz to 15 kHz and
+    * back down, then a quarter of the span again either side.
+    */
+    double low[maximumPorts], high[maximumPorts];
+    std::copy(s.p0.begin(), s.p0.end(), low);
+    std::copy(s.p0.begin(), s.p0.end(), high);
+
+    {
+        auto x = s.x0;
+        double vSweep[maximumPorts];
+        std::copy(v, v + numPorts, vSweep);
+
+        auto length = (int)(0.5 * sampleRate);
+        auto phase = 0.0;
+
+        for (int n = 0; n < 2 * length; ++n)
+        {
+            auto t = (double)(n < length ? n : 2 * length - n) / length;
+            phase += juce::MathConstants<double>::twoPi * 30.0 * std::pow(500.0, t) / sampleRate;
+
+            for (int row = 0; row < numPorts; ++row)
+            {
+                auto p = s.H(row, s.inputSource) * maximumInput * std::sin(phase);
+
+                for (int source = 0; source < numSources; ++source)
+                    p += s.H(row, source) * s.supplies[(size_t)source];
+
+                for (int k = 0; k < numStates; ++k)
+                    p += s.G(row, k) * x[(size_t)k];
+
+                low[row] = juce::jmin(low[row], p);
+                high[row] = juce::jmax(high[row], p);
+            }
+
+            s.step(x, vSweep, maximumInput * std::sin(phase));
+        }
+    }
+
+    /*
+    * How the currents follow p near the operating point: with J the Jacobian
+    * there, di = J (dp + K di), so di = (I - J K)^-1 J dp. The table only keeps
+    * what's left over, so a quiet signal is exact and interpolation only
+    * approximates the curvature.
+    */
+    Matrix jacobian(numPorts, numPorts), currentsAtV0(numPorts, 1);
+    s.nonlinearity(v, currentsAtV0.values.data(), jacobian.values.data());
+    auto linearResponse = inverse(identity(numPorts) - jacobian * s.K) * jacobian;
+
+    for (int row = 0; row < numPorts; ++row)
+    {
+        auto margin = juce::jmax(0.25 * (high[row] - low[row]), 1.0e-3);
+
+        auto scale = (tableSize - 1) / (high[row] - low[row] + 2.0 * margin);
+
+        // Stored relative to the operating point, like everything else on the audio thread, which sits on a point so silence is exact
+        tableLow[row] = (float)(std::floor((low[row] - margin - s.p0[(size_t)row]) * scale) / scale);
+        tableScale[row] = (float)scale;
+    }
+
+    // Filled point by point, each solve starting from a neighbour's answer
+    auto numPoints = 1;
+
+    for (int row = 0; row < numPorts; ++row)
+    {
+        tableStride[row] = numPoints;
+        numPoints *= tableSize;
+    }
+
+    table.resize((size_t)(numPoints * numPorts));
+    std::vector<double> voltages((size_t)(numPoints * numPorts));
+
+    for (int point = 0; point < numPoints; ++point)
+    {
+        double p[maximumPorts], guess[maximumPorts], currents[maximumPorts];
+        auto neighbour = -1;
+
+        for (int row = 0; row < numPorts; ++row)
+        {
+            auto index = (point / tableStride[row]) % tableSize;
+            p[row] = s.p0[(size_t)row] + tableLow[row] + index / (double)tableScale[row];
+
+            if (neighbour < 0 && index > 0)
+                neighbour = point - tableStride[row];
+        }
+
+        if (neighbour >= 0)
+            std::copy(voltages.begin() + neighbour * numPorts, voltages.begin() + (neighbour + 1) * numPorts, guess);
+        else
+            std::copy(v, v + numPorts, guess);
+
+        converged = s.solve(s.K, p, guess, currents);
+        jassert(converged);
+
+        std::copy(guess, guess + numPorts, voltages.begin() + point * numPorts);
+
+        for (int row = 0; row < numPorts; ++row)
+        {
+            auto linear = 0.0;
+
+            for (int k = 0; k < numPorts; ++k)
+                linear += linearResponse(row, k) * (p[k] - s.p0[(size_t)k]);
+
+            table[(size_t)(point * numPorts + row)] = (float)(currents[row] - s.i0[(size_t)row] - linear);
+        }
+    }
+
+    A = toFloat(s.A);
+    C = toFloat(s.C);
+    D = toFloat(s.D);
+    F = toFloat(s.F);
+    G = toFloat(s.G);
+    L = toFloat(linearResponse);
+    B = column(s.B, s.inputSource);
+    E = column(s.E, s.inputSource);
+    H = column(s.H, s.inputSource);
+}
+
+NonlinearStateSpace::~NonlinearStateSpace() = default;
+
+void NonlinearStateSpace::lookUp (const float* p, float* currents) const noexcept
+{
+    int base = 0;
+    float fractions[maximumPorts];
+
+    for (int row = 0; row < numPorts; ++row)
+    {
+        auto position = juce::jlimit(0.f, (float)(tableSize - 1) - 1.0e-3f, (p[row] - tableLow[row]) * tableScale[row]);
+        auto index = (int)position;
+
+        base += index * tableStride[row];
+        fractions[row] = position - (float)index;
+    }
+
+    for (int row = 0; row < numPorts; ++row)
+    {
+        currents[row] = 0.f;
+
+        for (int k = 0; k < numPorts; ++k)
+            currents[row] += L[(size_t)(row * numPorts + k)] * p[k];
+    }
+
+    // Every corner of the cell round p, weighted by how close p is to it
+    for (int corner = 0; corner < (1 << numPorts); ++corner)
+    {
+        auto weight = 1.f;
+        auto point = base;
+
+        for (int row = 0; row < numPorts; ++row)
+        {
+            if ((corner & (1 << row)) != 0)
+            {
+                weight *= fractions[row];
+                point += tableStride[row];
+            }
+            else
+            {
+                weight *= 1.f - fractions[row];
+            }
+        }
+
+        for (int row = 0; row < numPorts; ++row)
+            currents[row] += weight * table[(size_t)(point * numPorts + row)];
+    }
+}
+
+std::vector<double> NonlinearStateSpace::simulate (const std::vector<double>& input) const
+{
+    auto x = solver->x0;
+    double v[maximumPorts];
+    std::copy(solver->v0.begin(), solver->v0.end(), v);
+
+    std::vector<double> output;
+
+    for (auto sample : input)
+        output.push_back(solver->step(x, v, sample) - solver->y0);
+
+    return output;
+}
+
+//==============================================================================
+NonlinearStateSpace::Channel::Channel (const NonlinearStateSpace& modelToUse)
+    : model(modelToUse),
+      state((size_t)modelToUse.numStates, 0.f),
+      nextState((size_t)modelToUse.numStates, 0.f)
+{
+}
+
+void NonlinearStateSpace::Channel::reset() noexcept
+{
+    std::fill(state.begin(), state.end(), 0.f);
+}
+
+float NonlinearStateSpace::Channel::processSample (float input) noexcept
+{
+    auto numStates = model.numStates;
+    auto numPorts = model.numPorts;
+
+    float p[maximumPorts] = {}, i[maximumPorts] = {};
+
+    for (int row = 0; row < numPorts; ++row)
+    {
+        p[row] = model.H[(size_t)row] * input;
+
+        for (int k = 0; k < numStates; ++k)
+            p[row] += model.G[(size_t)(row * numStates + k)] * state[(size_t)k];
+    }
+
+    model.lookUp(p, i);
+
+    auto y = model.E[0] * input;
+
+    for (int k = 0; k < numStates; ++k)
+        y += model.D[(size_t)k] * state[(size_t)k];
+
+    for (int k = 0; k < numPorts; ++k)
+        y += model.F[(size_t)k] * i[k];
+
+    for (int row = 0; row < numStates; ++row)
+    {
+        auto x = model.B[(size_t)row] * input;
+
+        for (int k = 0; k < numStates; ++k)
+            x += model.A[(size_t)(row * numStates + k)] * state[(size_t)k];
+
+        for (int k = 0; k < numPorts; ++k)
+            x += model.C[(size_t)(row * numPorts + k)] * i[k];
+
+        nextState[(size_t)row] = x;
+    }
+
+    std::swap(state, nextState);
+    return y;
+}
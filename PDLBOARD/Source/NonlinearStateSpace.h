@@ -0,0 +1,138 @@
+/*
+  ==============================================================================
+
+    NonlinearStateSpace.h
+
+  ==============================================================================
+*/
+
+#pragma once
+
+#include <JuceHeader.h>
+
+//==============================================================================
+/**
+    Circuits with their nonlinearity solved ahead of time, by the DK method.
+
+    A circuit is described as a netlist: resistors, capacitors, the input,
+    fixed supplies, and nonlinear ports, each a current between two nodes that
+    depends on the port voltages (a triode is two of them, grid and plate).
+    Nodal analysis with trapezoidal capacitors turns that into
+
+        x[n+1] = A x + B u + C i        the capacitors' states
+        y      = D x + E u + F i        the output
+        v      = G x + H u + K i        the ports' voltages, with i = f(v)
+
+    so all the nonlinear solving is v = p + K f(v), where p = G x + H u. Its
+    solution depends on p alone, which is what makes it possible to solve it
+    once for every p the circuit can reach, at prepare time, with Newton, and
+    keep the currents in a table. The audio thread only works out p, reads
+    the table with multilinear interpolation, and does the small matrix
+    products. The ports are coupled through K however they need to be, which is
+    what a WDF can't do without its own iterations.
+
+    The table has one dimension per port, so it's limited to maximumPorts.
+    Its extent is found by running the circuit, with Newton, on a loud sweep,
+    and p is clamped to it.
+
+    Everything the audio thread keeps is a difference from the DC operating
+    point, so none of float's precision goes on the supply voltages.
+*/
+class NonlinearStateSpace
+{
+public:
+    static constexpr int maximumPorts = 3;
+
+    //==============================================================================
+    // A netlist. Node 0 is ground, the others are numbered from 1 in any order.
+    class Circuit
+    {
+    public:
+        void addResistor(int node1, int node2, double resistance);
+        void addCapacitor(int node1, int node2, double capacitance);
+
+        // The signal in, a voltage source
+        void addInput(int positive, int negative);
+        void addSupply(int positive, int negative, double voltage);
+
+        // A current that flows from positive to negative through the device and depends on the port voltages
+        void addNonlinearPort(int positive, int negative);
+
+        void setOutput(int positive, int negative);
+
+        // From the port voltages, in the order the ports were added, the currents and d current[i] / d voltage[j] at [i * numPorts + j]
+        using Nonlinearity = std::function<void(const double* voltages, double* currents, double* jacobian)>;
+        void setNonlinearity(Nonlinearity function);
+
+    private:
+        friend class NonlinearStateSpace;
+
+        struct Element { int node1, node2; double value; };
+
+        std::vector<Element> resistors, capacitors, sources, ports;
+        int inputSource = -1;
+        int outputPositive = 0, outputNegative = 0;
+        Nonlinearity nonlinearity;
+
+        int getNumNodes() const;
+    };
+
+    //==============================================================================
+    /*
+    * Solves the circuit at this sample rate and tabulates its nonlinearity. This
+    * is the expensive part, a few hundred milliseconds, so build it off the audio
+    * thread and share it between channels. maximumInput is the loudest input,
+    * in volts, the table has to cover. tableSize is the points per dimension.
+    */
+    NonlinearStateSpace(const Circuit& circuit, double sampleRate, double maximumInput, int tableSize);
+    ~NonlinearStateSpace();
+
+    int getNumStates() const noexcept       { return numStates; }
+    int getNumPorts() const noexcept        { return numPorts; }
+
+    //==============================================================================
+    // One channel's state
+    class Channel
+    {
+    public:
+        explicit Channel(const NonlinearStateSpace& model);
+
+        void reset() noexcept;
+
+        // The input and output are differences from their DC values
+        float processSample(float input) noexcept;
+
+    private:
+        const NonlinearStateSpace& model;
+        std::vector<float> state, nextState;
+
+        JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR(Channel)
+    };
+
+    //==============================================================================
+    /*
+    * Steps the full circuit at double precision with Newton every sample,
+    * what the table stands in for. For tests and benchmarks, it allocates.
+    */
+    std::vector<double> simulate(const std::vector<double>& input) const;
+
+private:
+    struct Solver;
+
+    // The double precision model the table was built from, kept for simulate()
+    std::unique_ptr<Solver> solver;
+
+    int numStates = 0, numPorts = 0, tableSize = 0;
+
+    // The matrices, row major, with the input's column of B, E and H only. L is the currents' linear response to p.
+    std::vector<float> A, B, C, D, E, F, G, H, L;
+
+    // The ports' currents, less the operating point's and L p, on a tableSize^numPorts grid over p
+    std::vector<float> table;
+    float tableLow[maximumPorts] = {}, tableScale[maximumPorts] = {};
+    int tableStride[maximumPorts] = {};
+
+    void lookUp(const float* p, float* currents) const noexcept;
+
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR(NonlinearStateSpace)
+};
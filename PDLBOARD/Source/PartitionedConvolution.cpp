@@ -0,0 +1,342 @@
+/*
+  ==============================================================================
+
+    PartitionedConvolution.cpp
+
+  ==============================================================================
+*/
+
+#include "PartitionedConvolution.h"
+
+static int getFFTOrder(int fftSize)
+{
+    int order = 0;
+
+    while ((1 << order) < fftSize)
+        ++order;
+
+    return order;
+}
+
+//==============================================================================
+PartitionedConvolution::Filter::Filter (const juce::AudioBuffer<float>& impulseResponse, int newPartitionSize, int maxPartitions)
+    : partitionSize(newPartitionSize), numBins(newPartitionSize + 1)
+{
+    jassert(juce::isPowerOfTwo(partitionSize));
+
+    auto length = juce::jmin(impulseResponse.getNumSamples(), juce::jmax(1, maxPartitions) * partitionSize);
+
+    numPartitions = juce::jmax(1, (length + partitionSize - 1) / partitionSize);
+    numChannels = juce::jmax(1, impulseResponse.getNumChannels());
+
+    head.setSize(numChannels, partitionSize);
+    head.clear();
+    spectra.resize((size_t)numChannels);
+
+    juce::dsp::FFT fft(getFFTOrder(2 * partitionSize));
+    std::vector<float> buffer((size_t)(4 * partitionSize));
+
+    for (int channel = 0; channel < numChannels; ++channel)
+    {
+        auto* source = channel < impulseResponse.getNumChannels() ? impulseResponse.getReadPointer(channel) : nullptr;
+        auto* reversed = head.getWritePointer(channel);
+
+        if (source != nullptr)
+            for (int i = 0; i < juce::jmin(partitionSize, length); ++i)
+                reversed[partitionSize - 1 - i] = source[i];
+
+        auto& channelSpectra = spectra[(size_t)channel];
+        channelSpectra.assign((size_t)((numPartitions - 1) * 2 * numBins), 0.f);
+
+        for (int partition = 1; partition < numPartitions && source != nullptr; ++partition)
+        {
+            // Each partition zero padded to the FFT size, as overlap-save needs
+            std::fill(buffer.begin(), buffer.end(), 0.f);
+
+            auto start = partition * partitionSize;
+            std::copy(source + start, source + juce::jmin(start + partitionSize, length), buffer.begin());
+
+            fft.performRealOnlyForwardTransform(buffer.data(), true);
+
+            auto* re = channelSpectra.data() + (partition - 1) * 2 * numBins;
+            auto* im = re + numBins;
+
+            for (int bin = 0; bin < numBins; ++bin)
+            {
+                re[bin] = buffer[(size_t)(2 * bin)];
+                im[bin] = buffer[(size_t)(2 * bin + 1)];
+            }
+        }
+    }
+}
+
+const float* PartitionedConvolution::Filter::getHead (int channel) const
+{
+    return head.getReadPointer(juce::jmin(channel, numChannels - 1));
+}
+
+const float* PartitionedConvolution::Filter::getSpectrum (int channel, int partition) const
+{
+    return spectra[(size_t)juce::jmin(channel, numChannels - 1)].data() + (partition - 1) * 2 * numBins;
+}
+
+//==============================================================================
+void PartitionedConvolution::prepare (int numChannels, int newPartitionSize, int newMaxPartitions)
+{
+    jassert(juce::isPowerOfTwo(newPartitionSize));
+
+    partitionSize = newPartitionSize;
+    fftSize = 2 * partitionSize;
+    numBins = partitionSize + 1;
+    maxPartitions = juce::jmax(1, newMaxPartitions);
+
+    fft = std::make_unique<juce::dsp::FFT> (getFFTOrder(fftSize));
+    fftBuffer.assign((size_t)(2 * fftSize), 0.f);
+    accumulator.assign((size_t)(2 * numBins), 0.f);
+
+    // FFT engines don't agree on how the inverse is scaled, so measure it
+    fftBuffer[0] = 1.f;
+    fft->performRealOnlyForwardTransform(fftBuffer.data(), true);
+    fft->performRealOnlyInverseTransform(fftBuffer.data());
+    inverseScale = 1.f / fftBuffer[0];
+
+    states.resize((size_t)juce::jmax(1, numChannels));
+
+    for (auto& state : states)
+    {
+        state.history.assign((size_t)(2 * partitionSize), 0.f);
+        state.inputBlock.assign((size_t)(2 * partitionSize), 0.f);
+        state.fdl.assign((size_t)(maxPartitions * 2 * numBins), 0.f);
+        state.tail.assign((size_t)partitionSize, 0.f);
+        state.fadingTail.assign((size_t)partitionSize, 0.f);
+    }
+
+    reset();
+}
+
+void PartitionedConvolution::reset()
+{
+    for (auto& state : states)
+    {
+        std::fill(state.history.begin(), state.history.end(), 0.f);
+        std::fill(state.inputBlock.begin(), state.inputBlock.end(), 0.f);
+        std::fill(state.fdl.begin(), state.fdl.end(), 0.f);
+        std::fill(state.tail.begin(), state.tail.end(), 0.f);
+        std::fill(state.fadingTail.begin(), state.fadingTail.end(), 0.f);
+    }
+
+    historyPos = blockPos = fdlHead = 0;
+
+    if (hasPendingFilter)
+        currentFilter = pendingFilter;
+
+    fadingFilter = pendingFilter = nullptr;
+    hasPendingFilter = isFading = false;
+    isSilent = true;
+}
+
+void PartitionedConvolution::setFilter (const Filter* newFilter) noexcept
+{
+    jassert(newFilter == nullptr || newFilter->getPartitionSize() == partitionSize);
+
+    // Nothing has gone in since the reset, so there is nothing to fade from
+    if (isSilent)
+    {
+        currentFilter = newFilter;
+        pendingFilter = nullptr;
+        hasPendingFilter = false;
+        return;
+    }
+
+    if (newFilter == currentFilter)
+    {
+        pendingFilter = nullptr;
+        hasPendingFilter = false;
+        return;
+    }
+
+    pendingFilter = newFilter;
+    hasPendingFilter = true;
+}
+
+//==============================================================================
+void PartitionedConvolution::process (float* const* channels, int numChannels, int numSamples) noexcept
+{
+    jassert(numChannels <= (int)states.size());
+    numChannels = juce::jmin(numChannels, (int)states.size());
+
+    int done = 0;
+
+    while (done < numSamples)
+    {
+        // Work up to the next partition boundary at most
+        auto num = juce::jmin(numSamples - done, partitionSize - blockPos);
+
+        for (int channel = 0; channel < numChannels; ++channel)
+        {
+            auto& state = states[(size_t)channel];
+            auto* data = channels[channel] + done;
+
+            auto* history = state.history.data();
+            auto* input = state.inputBlock.data() + partitionSize + blockPos;
+            auto* currentHead = currentFilter != nullptr ? currentFilter->getHead(channel) : nullptr;
+            auto* fadingHead = isFading && fadingFilter != nullptr ? fadingFilter->getHead(channel) : nullptr;
+
+            auto position = historyPos;
+
+            for (int i = 0; i < num; ++i)
+            {
+                auto x = data[i];
+
+                history[position] = x;
+                history[position + partitionSize] = x;
+                input[i] = x;
+
+                // Oldest to newest input, lined up with the reversed first partition
+                auto* window = history + position + 1;
+
+                auto y = currentHead != nullptr ? dot(window, currentHead, partitionSize) + state.tail[(size_t)(blockPos + i)] : 0.f;
+
+                if (isFading)
+                {
+                    auto faded = fadingHead != nullptr ? dot(window, fadingHead, partitionSize) + state.fadingTail[(size_t)(blockPos + i)] : 0.f;
+                    auto gain = (float)(blockPos + i + 1) / (float)partitionSize;
+
+                    y = faded + gain * (y - faded);
+                }
+
+                data[i] = y;
+
+                if (++position == partitionSize)
+                    position = 0;
+            }
+        }
+
+        historyPos = (historyPos + num) % partitionSize;
+        blockPos += num;
+        done += num;
+        isSilent = false;
+
+        if (blockPos == partitionSize)
+        {
+            advanceBlock();
+            blockPos = 0;
+        }
+    }
+}
+
+void PartitionedConvolution::advanceBlock() noexcept
+{
+    /*
+    * A full input block is in. Its spectrum goes into the FDL, and the frequency
+    * domain part of the next output block is computed from it and the older ones.
+    * Filter changes take effect here so the crossfade covers a whole block.
+    */
+    fdlHead = (fdlHead + 1) % maxPartitions;
+
+    isFading = false;
+    fadingFilter = nullptr;
+
+    if (hasPendingFilter)
+    {
+        fadingFilter = currentFilter;
+        currentFilter = pendingFilter;
+        pendingFilter = nullptr;
+        hasPendingFilter = false;
+        isFading = true;
+    }
+
+    for (int channel = 0; channel < (int)states.size(); ++channel)
+    {
+        auto& state = states[(size_t)channel];
+
+        std::copy(state.inputBlock.begin(), state.inputBlock.end(), fftBuffer.begin());
+        std::fill(fftBuffer.begin() + fftSize, fftBuffer.end(), 0.f);
+        fft->performRealOnlyForwardTransform(fftBuffer.data(), true);
+
+        auto* re = state.fdl.data() + fdlHead * 2 * numBins;
+        auto* im = re + numBins;
+
+        for (int bin = 0; bin < numBins; ++bin)
+        {
+            re[bin] = fftBuffer[(size_t)(2 * bin)];
+            im[bin] = fftBuffer[(size_t)(2 * bin + 1)];
+        }
+
+        // The current block becomes the previous one for the next overlap-save frame
+        std::copy(state.inputBlock.begin() + partitionSize, state.inputBlock.end(), state.inputBlock.begin());
+
+        if (currentFilter != nullptr)
+            computeTail(state, channel, *currentFilter, state.tail.data());
+        else
+            std::fill(state.tail.begin(), state.tail.end(), 0.f);
+
+        if (fadingFilter != nullptr)
+            computeTail(state, channel, *fadingFilter, state.fadingTail.data());
+    }
+}
+
+void PartitionedConvolution::computeTail (ChannelState& state, int channel, const Filter& filter, float* destination) noexcept
+{
+    auto numPartitions = juce::jmin(filter.getNumPartitions(), maxPartitions);
+
+    if (numPartitions < 2)
+    {
+        std::fill(destination, destination + partitionSize, 0.f);
+        return;
+    }
+
+    auto* accRe = accumulator.data();
+    auto* accIm = accRe + numBins;
+    std::fill(accumulator.begin(), accumulator.end(), 0.f);
+
+    // Partition p meets the input spectrum from p blocks ago, the newest one is p = 1
+    for (int partition = 1; partition < numPartitions; ++partition)
+    {
+        auto slot = (fdlHead - (partition - 1) + maxPartitions) % maxPartitions;
+
+        auto* xRe = state.fdl.data() + slot * 2 * numBins;
+        auto* xIm = xRe + numBins;
+        auto* hRe = filter.getSpectrum(channel, partition);
+        auto* hIm = hRe + numBins;
+
+        for (int bin = 0; bin < numBins; ++bin)
+        {
+            accRe[bin] += xRe[bin] * hRe[bin] - xIm[bin] * hIm[bin];
+            accIm[bin] += xRe[bin] * hIm[bin] + xIm[bin] * hRe[bin];
+        }
+    }
+
+    for (int bin = 0; bin < numBins; ++bin)
+    {
+        fftBuffer[(size_t)(2 * bin)] = accRe[bin];
+        fftBuffer[(size_t)(2 * bin + 1)] = accIm[bin];
+    }
+
+    std::fill(fftBuffer.begin() + 2 * numBins, fftBuffer.end(), 0.f);
+    fft->performRealOnlyInverseTransform(fftBuffer.data());
+
+    // Overlap-save keeps the second half, the first is circular wrap-around
+    for (int i = 0; i < partitionSize; ++i)
+        destination[i] = fftBuffer[(size_t)(partitionSize + i)] * inverseScale;
+}
+
+float PartitionedConvolution::dot (const float* a, const float* b, int num) noexcept
+{
+    // Four independent sums so the compiler can keep them in vector registers
+    float sum0 = 0.f, sum1 = 0.f, sum2 = 0.f, sum3 = 0.f;
+    int i = 0;
+
+    for (; i + 4 <= num; i += 4)
+    {
+        sum0 += a[i]     * b[i];
+        sum1 += a[i + 1] * b[i + 1];
+        sum2 += a[i + 2] * b[i + 2];
+        sum3 += a[i + 3] * b[i + 3];
+    }
+
+    for (; i < num; ++i)
+        sum0 += a[i] * b[i];
+
+    return (sum0 + sum1) + (sum2 + sum3);
+}
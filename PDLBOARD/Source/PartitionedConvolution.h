@@ -0,0 +1,115 @@
+/*
+  ==============================================================================
+
+    PartitionedConvolution.h
+
+  ==============================================================================
+*/
+
+#pragma once
+
+#include <JuceHeader.h>
+
+//==============================================================================
+/**
+    Zero latency, uniformly partitioned convolution.
+
+    The impulse response is cut into partitions of partitionSize samples. The first
+    partition is convolved directly in the time domain, sample by sample, so the
+    output has no extra latency. Every later partition only needs input that is at
+    least one partition old, so those are done in the frequency domain once per
+    partition: the spectrum of each completed input block is pushed into a
+    frequency-domain delay line (FDL) and multiplied with the partition spectra.
+
+    Cost per sample is partitionSize multiply-adds for the direct part plus
+    (numPartitions - 1) complex multiply-adds per bin per partitionSize samples,
+    instead of one multiply-add per IR sample for a plain FIR.
+
+    Filters are built off the audio thread and handed over with setFilter(). The
+    switch happens on the next partition boundary with a one partition crossfade,
+    and because the FDL only holds input it carries straight over to the new filter.
+*/
+class PartitionedConvolution
+{
+public:
+    //==============================================================================
+    // An impulse response cut into partitions and transformed, ready to convolve with.
+    class Filter
+    {
+    public:
+        // The impulse response must already be at the sample rate it will be used at.
+        Filter(const juce::AudioBuffer<float>& impulseResponse, int partitionSize, int maxPartitions);
+
+        int getNumChannels() const      { return numChannels; }
+        int getNumPartitions() const    { return numPartitions; }
+        int getPartitionSize() const    { return partitionSize; }
+        int getLength() const           { return numPartitions * partitionSize; }
+
+    private:
+        friend class PartitionedConvolution;
+
+        const float* getHead(int channel) const;
+        const float* getSpectrum(int channel, int partition) const;
+
+        int partitionSize, numBins, numPartitions, numChannels;
+
+        // First partition per channel, time reversed so the direct part is a plain dot product
+        juce::AudioBuffer<float> head;
+
+        // Partitions 1 .. numPartitions - 1 per channel, each numBins real parts then numBins imaginary parts
+        std::vector<std::vector<float>> spectra;
+
+        JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR(Filter)
+    };
+
+    //==============================================================================
+    PartitionedConvolution() = default;
+
+    // Allocates everything. maxPartitions limits the IR length filters may have.
+    void prepare(int numChannels, int partitionSize, int maxPartitions);
+    void reset();
+
+    // Audio thread. The filter must stay alive while it is the current or the previous filter.
+    void setFilter(const Filter* newFilter) noexcept;
+
+    // Every filter the convolver may still read from: current, fading out and waiting for a boundary.
+    const Filter* getCurrentFilter() const noexcept     { return currentFilter; }
+    const Filter* getFadingFilter() const noexcept      { return isFading ? fadingFilter : nullptr; }
+    const Filter* getPendingFilter() const noexcept     { return hasPendingFilter ? pendingFilter : nullptr; }
+
+    // Replaces the samples with the convolution. With no filter set the output is silent.
+    void process(float* const* channels, int numChannels, int numSamples) noexcept;
+
+    int getPartitionSize() const noexcept   { return partitionSize; }
+
+private:
+    struct ChannelState
+    {
+        std::vector<float> history;         // last partitionSize inputs, stored twice so any window is contiguous
+        std::vector<float> inputBlock;      // previous and current input block, overlap-save
+        std::vector<float> fdl;             // maxPartitions input spectra
+        std::vector<float> tail;            // frequency domain part of the current output block
+        std::vector<float> fadingTail;      // same for the filter being faded out
+    };
+
+    void advanceBlock() noexcept;
+    void computeTail(ChannelState& state, int channel, const Filter& filter, float* destination) noexcept;
+
+    static float dot(const float* a, const float* b, int num) noexcept;
+
+    std::unique_ptr<juce::dsp::FFT> fft;
+    std::vector<float> fftBuffer, accumulator;
+    float inverseScale = 1.f;
+
+    std::vector<ChannelState> states;
+
+    int partitionSize = 0, fftSize = 0, numBins = 0, maxPartitions = 0;
+    int historyPos = 0, blockPos = 0, fdlHead = 0;
+
+    const Filter* currentFilter = nullptr;
+    const Filter* fadingFilter = nullptr;
+    const Filter* pendingFilter = nullptr;
+    bool hasPendingFilter = false, isFading = false, isSilent = true;
+
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR(PartitionedConvolution)
+};
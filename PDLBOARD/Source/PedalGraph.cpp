@@ -0,0 +1,342 @@
+/*
+  ==============================================================================
+
+    PedalGraph.cpp
+
+  ==============================================================================
+*/
+
+#include "PedalGraph.h"
+
+const char* const PedalGraph::defaultRouting = "autowah > overdrive > chorus > delay > cabinet > reverb > fdnreverb";
+
+const char* PedalGraph::getName (Pedal pedal) noexcept
+{
+    switch (pedal)
+    {
+        case Pedal::overdrive:  return "overdrive";
+        case Pedal::chorus:     return "chorus";
+        case Pedal::delay:      return "delay";
+        case Pedal::cabinet:    return "cabinet";
+        case Pedal::reverb:     return "reverb";
+        case Pedal::fdnReverb:  return "fdnreverb";
+        case Pedal::autoWah:    return "autowah";
+    }
+
+    return "";
+}
+
+//==============================================================================
+/*
+* Parses the routing into a tree of chains and splits, then walks it once to
+* write out the steps. A split copies its input into a spare buffer for every
+* branch after the first, runs each branch on its own buffer, then adds them
+* back and scales by the number of branches. Branches run one after another,
+* so a nested split can reuse the same spare buffers in every branch.
+*/
+class PedalGraph::Compiler
+{
+public:
+    Compiler(const juce::String& routingToUse) : text(routingToUse.toLowerCase()) {}
+
+    std::unique_ptr<Schedule> compile(int numChannels, int maximumBlockSize, juce::String& error)
+    {
+        Chain chain;
+
+        if (! parseChain(chain))
+        {
+            error = message;
+            return {};
+        }
+
+        skipWhitespace();
+
+        if (position < text.length())
+        {
+            error = "Unexpected \"" + text.substring(position, position + 1) + "\" at character " + juce::String(position + 1);
+            return {};
+        }
+
+        std::unique_ptr<Schedule> schedule(new Schedule());
+        int numBuffers = 1;
+
+        emitChain(chain, 0, 1, *schedule, numBuffers);
+
+        for (int i = 1; i < numBuffers; ++i)
+            schedule->buffers.emplace_back(juce::jmax(1, numChannels), juce::jmax(1, maximumBlockSize));
+
+        schedule->maximumBlockSize = juce::jmax(1, maximumBlockSize);
+        schedule->routing = toString(chain);
+
+        return schedule;
+    }
+
+private:
+    struct Node;
+    using Chain = std::vector<Node>;
+
+    // A pedal, or a split when it has branches
+    struct Node
+    {
+        Pedal pedal = Pedal::overdrive;
+        std::vector<Chain> branches;
+    };
+
+    //==============================================================================
+    bool parseChain(Chain& chain)
+    {
+        skipWhitespace();
+
+        // Nothing at all is a valid chain, the signal goes straight through
+        if (position >= text.length() || peek() == ']' || peek() == '|')
+            return true;
+
+        for (;;)
+        {
+            Node node;
+
+            if (! parseNode(node))
+                return false;
+
+            chain.push_back(std::move(node));
+            skipWhitespace();
+
+            if (peek() != '>')
+                return true;
+
+            ++position;
+        }
+    }
+
+    bool parseNode(Node& node)
+    {
+        skipWhitespace();
+
+        if (peek() == '[')
+        {
+            ++position;
+
+            for (;;)
+            {
+                Chain branch;
+
+                if (! parseChain(branch))
+                    return false;
+
+                node.branches.push_back(std::move(branch));
+                skipWhitespace();
+
+                if (peek() == '|')
+                {
+                    ++position;
+                    continue;
+                }
+
+                if (peek() == ']')
+                {
+                    ++position;
+                    return true;
+                }
+
+                return fail("Missing \"]\"");
+            }
+        }
+
+        auto start = position;
+
+        while (position < text.length() && juce::CharacterFunctions::isLetter(text[position]))
+            ++position;
+
+        auto name = text.substring(start, position);
+
+        if (name.isEmpty())
+            return fail("Expected a pedal at character " + juce::String(start + 1));
+
+        for (int i = 0; i < numPedals; ++i)
+        {
+            if (name == getName((Pedal)i))
+            {
+                if (used[i])
+                    return fail("\"" + name + "\" is in the routing twice");
+
+                used[i] = true;
+                node.pedal = (Pedal)i;
+                return true;
+            }
+        }
+
+        return fail("Unknown pedal \"" + name + "\"");
+    }
+
+    //==============================================================================
+    void emitChain(const Chain& chain, int buffer, int firstSpare, Schedule& schedule, int& numBuffers)
+    {
+        for (size_t n = 0; n < chain.size(); ++n)
+        {
+            auto& node = chain[n];
+
+            if (isClassicChain(chain, n))
+            {
+                schedule.steps.push_back({ Schedule::Operation::processClassic, Pedal::overdrive, buffer, buffer, 1.f });
+                n += 2;
+                continue;
+            }
+
+            if (node.branches.empty())
+            {
+                schedule.steps.push_back({ Schedule::Operation::process, node.pedal, buffer, buffer, 1.f });
+                continue;
+            }
+
+            // A split with one branch is just that branch
+            if (node.branches.size() == 1)
+            {
+                emitChain(node.branches.front(), buffer, firstSpare, schedule, numBuffers);
+                continue;
+            }
+
+            auto numSpares = (int)node.branches.size() - 1;
+            auto nextSpare = firstSpare + numSpares;
+            numBuffers = juce::jmax(numBuffers, nextSpare);
+
+            for (int branch = 1; branch <= numSpares; ++branch)
+                schedule.steps.push_back({ Schedule::Operation::copy, Pedal::overdrive, buffer, firstSpare + branch - 1, 1.f });
+
+            emitChain(node.branches.front(), buffer, nextSpare, schedule, numBuffers);
+
+            for (int branch = 1; branch <= numSpares; ++branch)
+                emitChain(node.branches[(size_t)branch], firstSpare + branch - 1, nextSpare, schedule, numBuffers);
+
+            for (int branch = 1; branch <= numSpares; ++branch)
+                schedule.steps.push_back({ Schedule::Operation::add, Pedal::overdrive, firstSpare + branch - 1, buffer, 1.f });
+
+            schedule.steps.push_back({ Schedule::Operation::scale, Pedal::overdrive, buffer, buffer, 1.f / (float)node.branches.size() });
+        }
+    }
+
+    // Overdrive, chorus and delay straight after each other from here
+    static bool isClassicChain(const Chain& chain, size_t start)
+    {
+        const Pedal classic[] = { Pedal::overdrive, Pedal::chorus, Pedal::delay };
+
+        if (start + 3 > chain.size())
+            return false;
+
+        for (size_t i = 0; i < 3; ++i)
+            if (! chain[start + i].branches.empty() || chain[start + i].pedal != classic[i])
+                return false;
+
+        return true;
+    }
+
+    static juce::String toString(const Chain& chain)
+    {
+        juce::StringArray items;
+
+        for (auto& node : chain)
+        {
+            if (node.branches.empty())
+            {
+                items.add(getName(node.pedal));
+                continue;
+            }
+
+            juce::StringArray branches;
+
+            for (auto& branch : node.branches)
+                branches.add(toString(branch));
+
+            items.add("[" + branches.joinIntoString(" | ") + "]");
+        }
+
+        return items.joinIntoString(" > ");
+    }
+
+    //==============================================================================
+    void skipWhitespace()
+    {
+        while (position < text.length() && juce::CharacterFunctions::isWhitespace(text[position]))
+            ++position;
+    }
+
+    juce::juce_wchar peek() const
+    {
+        return position < text.length() ? text[position] : 0;
+    }
+
+    bool fail(const juce::String& reason)
+    {
+        message = reason;
+        return false;
+    }
+
+    const juce::String text;
+    int position = 0;
+    bool used[numPedals] = {};
+    juce::String message;
+};
+
+std::unique_ptr<PedalGraph::Schedule> PedalGraph::compile (const juce::String& routing, int numChannels, int maximumBlockSize, juce::String& error)
+{
+    return Compiler(routing).compile(numChannels, maximumBlockSize, error);
+}
+
+//==============================================================================
+void PedalGraph::Schedule::process (juce::AudioBuffer<float>& buffer, Effects& effects) noexcept
+{
+    for (int start = 0; start < buffer.getNumSamples(); start += maximumBlockSize)
+        run(buffer, start, juce::jmin(maximumBlockSize, buffer.getNumSamples() - start), effects);
+}
+
+void PedalGraph::Schedule::run (juce::AudioBuffer<float>& buffer, int startSample, int numSamples, Effects& effects) noexcept
+{
+    auto numChannels = buffer.getNumChannels();
+
+    if (! buffers.empty())
+        numChannels = juce::jmin(numChannels, buffers.front().getNumChannels());
+
+    // Views of this stretch of every buffer. They only point at the samples, nothing's allocated.
+    auto getView = [&] (int index)
+    {
+        if (index == 0)
+            return juce::AudioBuffer<float> (buffer.getArrayOfWritePointers(), buffer.getNumChannels(), startSample, numSamples);
+
+        return juce::AudioBuffer<float> (buffers[(size_t)index - 1].getArrayOfWritePointers(), numChannels, numSamples);
+    };
+
+    for (auto& step : steps)
+    {
+        auto destination = getView(step.destination);
+
+        switch (step.operation)
+        {
+            case Operation::process:
+                effects.processPedal(step.pedal, destination);
+                break;
+
+            case Operation::processClassic:
+                effects.processClassicChain(destination);
+                break;
+
+            case Operation::copy:
+            case Operation::add:
+            {
+                auto source = getView(step.source);
+
+                for (int channel = 0; channel < numChannels; ++channel)
+                {
+                    if (step.operation == Operation::copy)
+                        destination.copyFrom(channel, 0, source, channel, 0, numSamples);
+                    else
+                        destination.addFrom(channel, 0, source, channel, 0, numSamples);
+                }
+
+                break;
+            }
+
+            case Operation::scale:
+                destination.applyGain(step.gain);
+                break;
+        }
+    }
+}
@@ -0,0 +1,107 @@
+/*
+  ==============================================================================
+
+    PedalGraph.h
+
+  ==============================================================================
+*/
+
+#pragma once
+
+#include <JuceHeader.h>
+
+//==============================================================================
+/**
+    The order the pedals run in, with parallel splits, written as text:
+
+        overdrive > [chorus | delay > reverb] > cabinet
+
+    ">" chains pedals in series. "[a | b]" splits the signal, runs every
+    branch on its own copy and mixes them back at equal levels. Branches are
+    chains themselves, so splits can nest. Every pedal can appear once, and a
+    pedal left out of the routing doesn't run.
+
+    compile() turns a routing into a Schedule: a flat list of steps (run a
+    pedal on a buffer, copy, add, scale) and the buffers the branches need,
+    all allocated up front. Compiling parses and allocates, so it belongs on a
+    background thread. Running a schedule only goes down its list of steps.
+*/
+class PedalGraph
+{
+public:
+    enum class Pedal { overdrive, chorus, delay, cabinet, reverb, fdnReverb, autoWah };
+
+    static constexpr int numPedals = 7;
+
+    // The names routings use, "overdrive", "chorus", "delay", "cabinet", "reverb", "fdnreverb" and "autowah"
+    static const char* getName(Pedal pedal) noexcept;
+
+    // The chain as it always used to be, with the auto-wah in front
+    static const char* const defaultRouting;
+
+    // Whatever actually runs the pedals
+    struct Effects
+    {
+        virtual ~Effects() = default;
+        virtual void processPedal(Pedal pedal, juce::AudioBuffer<float>& buffer) = 0;
+
+        /*
+        * Overdrive, chorus then delay, wherever a routing has the three in a
+        * row. They run one after another unless the effects know better: the
+        * processor interleaves them a sample at a time on one delay line,
+        * which is how the chain sounded before it could be rerouted.
+        */
+        virtual void processClassicChain(juce::AudioBuffer<float>& buffer)
+        {
+            processPedal(Pedal::overdrive, buffer);
+            processPedal(Pedal::chorus, buffer);
+            processPedal(Pedal::delay, buffer);
+        }
+    };
+
+    //==============================================================================
+    class Schedule
+    {
+    public:
+        // Runs the steps over the buffer. Blocks longer than the buffers were made for are split up.
+        void process(juce::AudioBuffer<float>& buffer, Effects& effects) noexcept;
+
+        int getNumSteps() const noexcept        { return (int)steps.size(); }
+
+        // Counting the one being processed
+        int getNumBuffers() const noexcept      { return (int)buffers.size() + 1; }
+
+        // The routing written out again, tidied up
+        const juce::String& getRouting() const noexcept     { return routing; }
+
+    private:
+        friend class PedalGraph;
+        Schedule() = default;
+
+        enum class Operation { process, processClassic, copy, add, scale };
+
+        // Buffer 0 is the one being processed, branches get the rest
+        struct Step
+        {
+            Operation operation;
+            Pedal pedal;
+            int source, destination;
+            float gain;
+        };
+
+        void run(juce::AudioBuffer<float>& buffer, int startSample, int numSamples, Effects& effects) noexcept;
+
+        std::vector<Step> steps;
+        std::vector<juce::AudioBuffer<float>> buffers;
+        int maximumBlockSize = 0;
+        juce::String routing;
+
+        JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR(Schedule)
+    };
+
+    // nullptr with the reason in error when the routing doesn't make sense
+    static std::unique_ptr<Schedule> compile(const juce::String& routing, int numChannels, int maximumBlockSize, juce::String& error);
+
+private:
+    class Compiler;
+};
@@ -0,0 +1,130 @@
+/*
+  ==============================================================================
+
+    PitchDetector.cpp
+
+  ==============================================================================
+*/
+
+#include "PitchDetector.h"
+
+static int getFFTOrder(int fftSize)
+{
+    int order = 0;
+
+    while ((1 << order) < fftSize)
+        ++order;
+
+    return order;
+}
+
+//==============================================================================
+PitchDetector::PitchDetector (double sampleRateToUse, int windowSizeToUse)
+    : sampleRate(sampleRateToUse), windowSize(windowSizeToUse),
+      maximumLag(juce::jmin(windowSizeToUse / 2, (int)std::ceil(sampleRateToUse / minimumFrequency))),
+      minimumLag(juce::jmax(2, (int)(sampleRateToUse / maximumFrequency))),
+      fft(getFFTOrder(2 * windowSizeToUse))
+{
+    // Zero padded to twice the window, so the autocorrelation doesn't wrap round
+    frame.assign((size_t)(2 * fft.getSize()), 0.f);
+    nsdf.assign((size_t)maximumLag + 1, 0.f);
+
+    // Whatever scaling this FFT's inverse has, measured rather than assumed
+    frame[0] = 1.f;
+    fft.performRealOnlyForwardTransform(frame.data(), true);
+    fft.performRealOnlyInverseTransform(frame.data());
+    inverseScale = 1.f / frame[0];
+}
+
+PitchDetector::Result PitchDetector::detect (const float* samples) noexcept
+{
+    // Autocorrelation, as the inverse of the power spectrum
+    std::fill(frame.begin(), frame.end(), 0.f);
+    std::copy(samples, samples + windowSize, frame.begin());
+
+    fft.performRealOnlyForwardTransform(frame.data(), true);
+
+    for (int bin = 0; bin <= fft.getSize() / 2; ++bin)
+    {
+        auto re = frame[(size_t)(2 * bin)];
+        auto im = frame[(size_t)(2 * bin + 1)];
+
+        frame[(size_t)(2 * bin)] = re * re + im * im;
+        frame[(size_t)(2 * bin + 1)] = 0.f;
+    }
+
+    fft.performRealOnlyInverseTransform(frame.data());
+
+    // Then normalised by the energy of the two overlapping parts at every lag,
+    // which drops by the two samples leaving the overlap each time
+    auto energy = 2.0 * frame[0] * inverseScale;
+
+    if (energy <= 1.0e-12)
+        return {};
+
+    for (int lag = 0; lag <= maximumLag; ++lag)
+    {
+        if (lag > 0)
+        {
+            auto leaving = (double)samples[lag - 1];
+            auto leavingEnd = (double)samples[windowSize - lag];
+            energy -= leaving * leaving + leavingEnd * leavingEnd;
+        }
+
+        nsdf[(size_t)lag] = energy > 1.0e-12 ? (float)(2.0 * frame[(size_t)lag] * inverseScale / energy) : 0.f;
+    }
+
+    // The highest point between each upward and downward zero crossing is a key maximum.
+    // The period is the first of them close enough to the highest.
+    int lag = 1;
+
+    while (lag <= maximumLag && nsdf[(size_t)lag] > 0.f)
+        ++lag;
+
+    int keyMaxima[64];
+    int numKeyMaxima = 0;
+    auto highest = 0.f;
+
+    while (lag <= maximumLag && numKeyMaxima < (int)juce::numElementsInArray(keyMaxima))
+    {
+        while (lag <= maximumLag && nsdf[(size_t)lag] <= 0.f)
+            ++lag;
+
+        auto best = -1;
+
+        while (lag <= maximumLag && nsdf[(size_t)lag] > 0.f)
+        {
+            if (best < 0 || nsdf[(size_t)lag] > nsdf[(size_t)best])
+                best = lag;
+
+            ++lag;
+        }
+
+        // A peak still rising at the end of the range isn't a peak
+        if (best < 0 || best >= maximumLag || best < minimumLag)
+            continue;
+
+        keyMaxima[numKeyMaxima++] = best;
+        highest = juce::jmax(highest, nsdf[(size_t)best]);
+    }
+
+    for (int i = 0; i < numKeyMaxima; ++i)
+    {
+        auto peak = keyMaxima[i];
+
+        if (nsdf[(size_t)peak] < peakThreshold * highest)
+            continue;
+
+        // A parabola through the peak and its neighbours
+        auto left = nsdf[(size_t)peak - 1], centre = nsdf[(size_t)peak], right = nsdf[(size_t)peak + 1];
+        auto curvature = left - 2.f * centre + right;
+        auto offset = curvature < 0.f ? 0.5f * (left - right) / curvature : 0.f;
+
+        Result result;
+        result.frequency = (float)(sampleRate / ((double)peak + offset));
+        result.clarity = centre - 0.25f * (left - right) * offset;
+        return result;
+    }
+
+    return {};
+}
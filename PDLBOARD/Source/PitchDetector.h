@@ -0,0 +1,61 @@
+/*
+  ==============================================================================
+
+    PitchDetector.h
+
+  ==============================================================================
+*/
+
+#pragma once
+
+#include <JuceHeader.h>
+
+//==============================================================================
+/**
+    Monophonic pitch detection by the McLeod Pitch Method (McLeod and Wyvill,
+    "A Smarter Way to Find Pitch", 2005).
+
+    The normalised square difference function of a window is worked out from
+    its autocorrelation, which is done with an FFT rather than a lag at a time,
+    so a window costs two transforms instead of windowSize squared
+    multiply-adds. The period is the first peak that comes close to the highest
+    one, which is what keeps a strong second harmonic from reading as the
+    octave above. A parabola through the peak gets it between samples.
+
+    Allocates everything up front, and detect() doesn't allocate, but it's
+    meant for a background thread: the tuner runs it on decimated audio.
+*/
+class PitchDetector
+{
+public:
+    struct Result
+    {
+        float frequency = 0.f;      // 0 when no pitch was found
+        float clarity = 0.f;        // height of the chosen peak, 1 for a perfectly periodic window
+    };
+
+    PitchDetector(double sampleRate, int windowSize);
+
+    // The last windowSize samples, oldest first
+    Result detect(const float* samples) noexcept;
+
+    int getWindowSize() const noexcept      { return windowSize; }
+
+    // Lowest and highest pitches looked for: a drop tuned low B up to the top frets
+    static constexpr double minimumFrequency = 30.0;
+    static constexpr double maximumFrequency = 1500.0;
+
+    // How close to the highest peak the first one has to come to be the period
+    static constexpr float peakThreshold = 0.9f;
+
+private:
+    const double sampleRate;
+    const int windowSize, maximumLag, minimumLag;
+
+    juce::dsp::FFT fft;
+    float inverseScale = 1.f;
+
+    std::vector<float> frame, nsdf;
+
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR(PitchDetector)
+};
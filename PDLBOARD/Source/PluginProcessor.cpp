@@ -7,6 +7,9 @@
 */
 
 #include "PluginProcessor.h"
+#include "RealtimeSafety.h"
+#include "CircularDelay.h"
+#include "SessionState.h"
 
 //==============================================================================
 juce::AudioProcessorValueTreeState::ParameterLayout PDLBOARDAudioProcessor::createParameterLayout() 
@@ -22,9 +25,26 @@ juce::AudioProcessorValueTreeState::ParameterLayout PDLBOARDAudioProcessor::crea
     GuitarEffectAudioProcessor::addODParameters(layout);
     GuitarEffectAudioProcessor::addChorusParameters(layout);
     GuitarEffectAudioProcessor::addDelayParameters(layout);
+    GuitarEffectAudioProcessor::addCabParameters(layout);
+    GuitarEffectAudioProcessor::addReverbParameters(layout);
+    GuitarEffectAudioProcessor::addFDNReverbParameters(layout);
+    GuitarEffectAudioProcessor::addEQParameters(layout);
+    GuitarEffectAudioProcessor::addGateParameters(layout);
+    GuitarEffectAudioProcessor::addTunerParameters(layout);
+    GuitarEffectAudioProcessor::addAutoWahParameters(layout);
     return layout;
 }
 
+float PDLBOARDAudioProcessor::atanOverdrive(float sample, float drive, float range, float blend, float volume)
+{
+    // Soft clipping by atan, scaled back to +-1, blended with the clean signal
+    auto cleanSignal = sample;
+
+    sample *= drive * range;
+
+    return (((((2.f / juce::float_Pi) * atan(sample)) * blend) + (cleanSignal * (1.f - blend))) / 2) * volume;
+}
+
 float PDLBOARDAudioProcessor::lin_interp(float sample_x, float sample_x1, float inPhase)
 {
     /*
@@ -37,40 +57,234 @@ float PDLBOARDAudioProcessor::lin_interp(float sample_x, float sample_x1, float
 
 //==============================================================================
 PDLBOARDAudioProcessor::PDLBOARDAudioProcessor()
-: treeState(*this, nullptr, ProjectInfo::projectName, createParameterLayout())
+: treeState(*this, nullptr, ProjectInfo::projectName, createParameterLayout()),
+  mTuner(treeState),
+  mGate(treeState),
+  mAutoWah(treeState),
+  mEQ(treeState),
+  mAmpModel(treeState),
+  mCircuitModel(treeState),
+  mMultiband(treeState),
+  mCabinet(treeState),
+  mReverb(treeState),
+  mFDNReverb(treeState),
+  mRouting(treeState),
+  mPresets(treeState, mRouting),
+  mMidiControl(treeState),
+  mModulation(treeState)
 {
     // Load the GUI theme from the xml in the resources.
     magicState.setGuiValueTree(BinaryData::theme_copy_xml, BinaryData::theme_copy_xmlSize);
 
+    // The tuner's readout, for labels in the GUI to show
+    mTuner.referTo(magicState.getPropertyAsValue("tuner:note"),
+                   magicState.getPropertyAsValue("tuner:cents"),
+                   magicState.getPropertyAsValue("tuner:frequency"));
+
     // Call functions to push effect parameters into the treeState.
     GuitarEffectAudioProcessor::Overdrive::Overdrive(treeState);
     GuitarEffectAudioProcessor::Chorus::Chorus(treeState);
     GuitarEffectAudioProcessor::Delay::Delay(treeState);
 
     // Initialise data to default values.
-    mCircularBufferLeft = nullptr;
-    mCircularBufferRight = nullptr;
-    mCircularBufferWriteHead = 0;
     mCircularBufferLength = 0;
 
-    mFeedbackLeft = 0;
-    mFeedbackRight = 0;
-
     mDelayTimeInSamples = 0;
     mDelayReadHead = 0;
 
     mLFOPhase = 0;
+
+    mDriveParameter = getCachedParameter("overdrive");
+    mRangeParameter = getCachedParameter("range");
+    mBlendParameter = getCachedParameter("blend");
+    mVolumeParameter = getCachedParameter("volume");
+    mChorusDryWetParameter = getCachedParameter("dry/wet1");
+    mChorusDepthParameter = getCachedParameter("depth");
+    mChorusRateParameter = getCachedParameter("rate");
+    mChorusOffsetParameter = getCachedParameter("offset");
+    mChorusFeedbackParameter = getCachedParameter("feedback1");
+    mDelayDryWetParameter = getCachedParameter("dry/wet2");
+    mDelayFeedbackParameter = getCachedParameter("feedback2");
+    mDelayTimeParameter = getCachedParameter("delaytime");
+    mTapDecayParameter = getCachedParameter("tapdecay");
+    mTapSpreadParameter = getCachedParameter("tapspread");
+    mTapToneParameter = getCachedParameter("taptone");
+    mCrossFeedbackParameter = getCachedParameter("crossfeed");
+
+    // The pedals read their parameters through the modulation's offsets
+    for (auto* pedal : std::initializer_list<GuitarEffectAudioProcessor::Modulated*> { &mGate, &mAutoWah, &mEQ, &mAmpModel, &mCircuitModel,
+                                                                                        &mMultiband, &mCabinet, &mReverb, &mFDNReverb })
+        pedal->setModulation(&mModulation);
+
+    treeState.addParameterListener("onoff8", this);
+
+    // Worked out again whenever one of these changes, rather than for every piece of every block
+    for (auto* id : tailParameterIDs)
+        treeState.addParameterListener(id, this);
+
+    mDownstreamTailSeconds = getDownstreamTailSeconds();
+
+    // From the MIDI loader thread, never the audio thread
+    mMidiControl.onProgramChange = [this] (int program) { setCurrentProgram(program); };
+
+    startTimer(50);
 }
 
 PDLBOARDAudioProcessor::~PDLBOARDAudioProcessor()
 {
+    stopTimer();
+    treeState.removeParameterListener("onoff8", this);
+
+    for (auto* id : tailParameterIDs)
+        treeState.removeParameterListener(id, this);
 }
 
 //==============================================================================
 
 double PDLBOARDAudioProcessor::getTailLengthSeconds() const
 {
-    return 0.0;
+    // Everything rings on after the gate, so the whole chain's tail is the downstream one. A frozen FDN or feedback
+    // close to one would have the host render for ever, or for the best part of an hour.
+    return juce::jmin(mDownstreamTailSeconds.load(), maximumTailSeconds);
+}
+
+void PDLBOARDAudioProcessor::getStateInformation (juce::MemoryBlock& destData)
+{
+    mMidiControl.saveMappings();
+    SessionState::write(treeState, destData);
+}
+
+void PDLBOARDAudioProcessor::setStateInformation (const void* data, int sizeInBytes)
+{
+    // Sessions saved before the binary format, or anything else that isn't one, go through the ValueTree as they always did
+    if (! SessionState::read(treeState, data, sizeInBytes))
+        foleys::MagicProcessor::setStateInformation(data, sizeInBytes);
+}
+
+void PDLBOARDAudioProcessor::setEmbedFilesInState(bool shouldEmbed)
+{
+    treeState.state.setProperty(SessionState::embedFilesProperty, shouldEmbed, nullptr);
+}
+
+int PDLBOARDAudioProcessor::getNumPrograms()
+{
+    const juce::ScopedLock sl (mPresetBankLock);
+    return mPresetBank != nullptr ? juce::jmax(1, mPresetBank->getNumPresets()) : 1;
+}
+
+int PDLBOARDAudioProcessor::getCurrentProgram()
+{
+    return mCurrentProgram;
+}
+
+void PDLBOARDAudioProcessor::setCurrentProgram (int index)
+{
+    const juce::ScopedLock sl (mPresetBankLock);
+
+    // Straight to the preset's record, nothing else in the bank is read
+    if (mPresetBank == nullptr || ! juce::isPositiveAndBelow(index, mPresetBank->getNumPresets()))
+        return;
+
+    mCurrentProgram = index;
+    mPresets.load(mPresetBank->getPreset(index));
+}
+
+const juce::String PDLBOARDAudioProcessor::getProgramName (int index)
+{
+    const juce::ScopedLock sl (mPresetBankLock);
+    return mPresetBank != nullptr ? mPresetBank->getName(index) : juce::String();
+}
+
+void PDLBOARDAudioProcessor::changeProgramName (int index, const juce::String& newName)
+{
+    // The bank's read only, renaming happens when it's rebuilt
+    juce::ignoreUnused(index, newName);
+}
+
+bool PDLBOARDAudioProcessor::loadPresetBank(const juce::File& file)
+{
+    auto bank = std::make_unique<PresetBank>(file);
+
+    if (! bank->isValid())
+        return false;
+
+    {
+        const juce::ScopedLock sl (mPresetBankLock);
+        mPresetBank = std::move(bank);
+        mCurrentProgram = 0;
+    }
+
+    updateHostDisplay();
+    return true;
+}
+
+void PDLBOARDAudioProcessor::parameterChanged(const juce::String& parameterID, float newValue)
+{
+    juce::ignoreUnused(newValue);
+
+    if (parameterID != "onoff8")
+    {
+        mDownstreamTailSeconds = getDownstreamTailSeconds();
+        return;
+    }
+
+    /*
+    * The host gets told about latency changes under a lock, so that's only
+    * done from the message thread, and never from inside processBlock, which
+    * an offline render can call there. Automation, MIDI and the host's own
+    * parameter changes come in on the audio thread and leave it to the timer.
+    */
+    if (juce::MessageManager::existsAndIsCurrentThread() && ! mIsProcessing)
+        setLatencySamples(mGate.getLatencySamples());
+    else
+        mLatencyChanged = true;
+}
+
+void PDLBOARDAudioProcessor::timerCallback()
+{
+    if (mLatencyChanged.exchange(false))
+        setLatencySamples(mGate.getLatencySamples());
+}
+
+double PDLBOARDAudioProcessor::getDownstreamTailSeconds() const
+{
+    // Down to -100 dB, from full scale
+    const double silence = 1.0e-5;
+
+    // Echoes until the feedback has taken them under silence
+    auto getRepeats = [silence] (float feedback)
+    {
+        return feedback > 0.f ? std::ceil(std::log(silence) / std::log((double)feedback)) : 0.0;
+    };
+
+    auto isOn = [this] (const char* id) { return *treeState.getRawParameterValue(id) > 0.5f; };
+
+    // The EQ and the overdrive circuits' filters die away well inside this
+    auto tail = 0.05;
+
+    // Longest chorus delay, then the delay itself, each for every repeat
+    if (isOn("onoff2"))
+        tail += 0.03 * (getRepeats(*treeState.getRawParameterValue("feedback1")) + 1.0);
+
+    if (isOn("onoff3"))
+        tail += *treeState.getRawParameterValue("delaytime") * (getRepeats(*treeState.getRawParameterValue("feedback2")) + 1.0);
+
+    if (isOn("onoff4"))
+        tail += MAX_CAB_IR_TIME;
+
+    if (isOn("onoff5"))
+        tail += MAX_REVERB_IR_TIME;
+
+    // The decay is the T60, and frozen it never stops
+    if (isOn("onoff6"))
+    {
+        if (*treeState.getRawParameterValue("fdnfreeze") > 0.5f)
+            return std::numeric_limits<double>::infinity();
+
+        tail += *treeState.getRawParameterValue("fdndecay") * 100.0 / 60.0 + 0.5;
+    }
+
+    return tail;
 }
 
 //==============================================================================
@@ -82,27 +296,43 @@ void PDLBOARDAudioProcessor::prepareToPlay (double sampleRate, int samplesPerBlo
 
     // Initialise the phase;
     mLFOPhase = 0;
-
-    // Initialise the writehead
-    mCircularBufferWriteHead = 0;
+    mDelayTimeTarget = -1.f;
+    mChorusEnsemble.prepare(sampleRate);
+    mMultiTap.prepare(sampleRate);
 
     // Calculate the circular buffer length
-    mCircularBufferLength = sampleRate * MAX_DELAY_TIME;
-
-    // Initialise the left buffer
-    if (mCircularBufferLeft == nullptr) {
-        mCircularBufferLeft = new float[mCircularBufferLength];
-    }
-
-    // Clear any junk data in the buffer
-    juce::zeromem(mCircularBufferLeft, mCircularBufferLength * sizeof(float));
+    mCircularBufferLength = (int)(sampleRate * MAX_DELAY_TIME);
 
-    // Same for the right buffer
-    if (mCircularBufferRight == nullptr) {
-        mCircularBufferRight = new float[mCircularBufferLength];
+    // Hosts can call prepareToPlay again with a different sample rate. The buffers are
+    // cleared, and the write heads and feedback reset, so a re-prepared processor starts
+    // from silence.
+    for (auto* line : { &mChorusLine, &mDelayLine })
+    {
+        line->left.assign((size_t)mCircularBufferLength, 0.f);
+        line->right.assign((size_t)mCircularBufferLength, 0.f);
+        line->writeHead = 0;
+        line->feedbackLeft = 0;
+        line->feedbackRight = 0;
     }
 
-    juce::zeromem(mCircularBufferRight, mCircularBufferLength * sizeof(float));
+    // The cabinet builds its impulse responses for this sample rate
+    mAmpModel.prepare(sampleRate, samplesPerBlock, juce::jmax(getTotalNumInputChannels(), getTotalNumOutputChannels()));
+    mCircuitModel.prepare(sampleRate, juce::jmax(getTotalNumInputChannels(), getTotalNumOutputChannels()));
+    mMultiband.prepare(sampleRate, juce::jmax(getTotalNumInputChannels(), getTotalNumOutputChannels()));
+    mCabinet.prepare(sampleRate, samplesPerBlock, juce::jmax(getTotalNumInputChannels(), getTotalNumOutputChannels()));
+    mReverb.prepare(sampleRate, samplesPerBlock, juce::jmax(getTotalNumInputChannels(), getTotalNumOutputChannels()));
+    mFDNReverb.prepare(sampleRate, samplesPerBlock);
+    mEQ.prepare(sampleRate);
+    mTuner.prepare(sampleRate);
+    mGate.prepare(sampleRate, samplesPerBlock, juce::jmax(getTotalNumInputChannels(), getTotalNumOutputChannels()));
+    mAutoWah.prepare(sampleRate, samplesPerBlock, juce::jmax(getTotalNumInputChannels(), getTotalNumOutputChannels()));
+    mRouting.prepare(samplesPerBlock, juce::jmax(getTotalNumInputChannels(), getTotalNumOutputChannels()));
+    mPresets.prepare(sampleRate);
+    mPresetFadeBuffer.setSize(juce::jmax(getTotalNumInputChannels(), getTotalNumOutputChannels()), samplesPerBlock);
+    mAutomation.prepare();
+    mModulation.prepare(sampleRate);
+
+    setLatencySamples(mGate.getLatencySamples());
 }
 
 void PDLBOARDAudioProcessor::releaseResources()
@@ -142,218 +372,554 @@ void PDLBOARDAudioProcessor::processBlock (juce::AudioBuffer<float>& buffer, juc
     * are processed and where the digital signal processing can occur.
     */
 
+    // Lets the test host catch anything in here that could block the audio thread.
+    RealtimeSafety::ScopedAudioThread audioThread;
+
+    // Latency changes from in here wait for the timer
+    mIsProcessing = true;
+
     juce::ScopedNoDenormals noDenormals;
     auto totalNumInputChannels  = getTotalNumInputChannels();
     auto totalNumOutputChannels = getTotalNumOutputChannels();
 
-    // Get parameters for overdrive.
-    auto drive = treeState.getRawParameterValue("overdrive");
-    auto range = treeState.getRawParameterValue("range");
-    auto blend = treeState.getRawParameterValue("blend");
-    auto volume = treeState.getRawParameterValue("volume");
-    auto overdriveOnOff = treeState.getParameterAsValue("onoff1");
-
-    // Get parameters for chorus.
-    auto cDryWet = treeState.getRawParameterValue("dry/wet1");
-    auto cDepth = treeState.getRawParameterValue("depth");
-    auto cRate = treeState.getRawParameterValue("rate");
-    auto cOffset = treeState.getRawParameterValue("offset");
-    auto cFeedback = treeState.getRawParameterValue("feedback1");
-    auto cType = treeState.getRawParameterValue("type");
-    auto chorusOnOff = treeState.getParameterAsValue("onoff2");
-
-    // Get parameters for delay.
-    auto dDryWet = treeState.getRawParameterValue("dry/wet2");
-    auto dFeedback = treeState.getRawParameterValue("feedback2");
-    auto dDelayTime = treeState.getRawParameterValue("delaytime");
-    auto delayOnOff = treeState.getParameterAsValue("onoff3");
-
-    
     for (auto i = totalNumInputChannels; i < totalNumOutputChannels; ++i)
         buffer.clear (i, 0, buffer.getNumSamples());
 
-    // Iterate through the audio channels.
-    for (int channel = 0; channel < totalNumInputChannels; ++channel)
+    for (const auto metadata : midiMessages)
+    {
+        auto message = metadata.getMessage();
+        mMidiControl.handle(message, metadata.samplePosition, mAutomation);
+        mModulation.handleMidi(message);
+    }
+
+    /*
+    * A preset waiting to go in: the start of the block on the old one, then
+    * every value and the routing switched at once and the whole block on the
+    * new one, crossfaded over the first few milliseconds. The pedals hear
+    * those few milliseconds twice, which only moves their tails along by as
+    * much. A block shorter than the fade crossfades over what there is.
+    */
+    auto fadeLength = 0;
+
+    if (mPresets.startBlock())
+    {
+        auto numChannels = juce::jmin(buffer.getNumChannels(), mPresetFadeBuffer.getNumChannels());
+        fadeLength = juce::jmin(mPresets.getFadeSamples(), buffer.getNumSamples(), mPresetFadeBuffer.getNumSamples());
+
+        juce::AudioBuffer<float> oldOutput (mPresetFadeBuffer.getArrayOfWritePointers(), numChannels, 0, fadeLength);
+
+        for (int channel = 0; channel < numChannels; ++channel)
+            oldOutput.copyFrom(channel, 0, buffer, channel, 0, fadeLength);
+
+        processChain(oldOutput);
+        mPresets.switchNow();
+    }
+
+    processChainAutomated(buffer);
+
+    for (int channel = 0; channel < juce::jmin(buffer.getNumChannels(), mPresetFadeBuffer.getNumChannels()) && fadeLength > 0; ++channel)
+    {
+        buffer.applyGainRamp(channel, 0, fadeLength, 0.f, 1.f);
+        buffer.addFromWithRamp(channel, 0, mPresetFadeBuffer.getReadPointer(channel), fadeLength, 1.f, 0.f);
+    }
+
+    mIsProcessing = false;
+}
+
+void PDLBOARDAudioProcessor::processChainAutomated(juce::AudioBuffer<float>& buffer)
+{
+    auto numSamples = buffer.getNumSamples();
+
+    /*
+    * Everything before an automation event or a modulation update runs on the
+    * old values, everything from it on the new ones. With neither due in the
+    * block, it goes through in one piece.
+    */
+    for (int start = 0; start < numSamples;)
+    {
+        mAutomation.applyDueEvents();
+
+        juce::AudioBuffer<float> rest (buffer.getArrayOfWritePointers(), buffer.getNumChannels(), start, numSamples - start);
+        mModulation.update(rest);
+
+        auto length = juce::jmin(mAutomation.getSamplesToNextEvent(numSamples - start), mModulation.getSamplesToNextUpdate(numSamples - start));
+        juce::AudioBuffer<float> piece (buffer.getArrayOfWritePointers(), buffer.getNumChannels(), start, length);
+
+        processChain(piece);
+        mAutomation.advance(length);
+        mModulation.advance(length);
+        start += length;
+    }
+}
+
+void PDLBOARDAudioProcessor::processChain(juce::AudioBuffer<float>& buffer)
+{
+    // Tuning, the chain carries on as it was unless the output's muted
+    if (mTuner.process(buffer))
     {
-        // Obtain the audiodata pointers for single channel for distortion algorithm
-        float* channelData = buffer.getWritePointer(channel);
+        buffer.clear();
+        return;
+    }
+
+    mGate.process(buffer);
 
-        // Obtain the audio data pointers for left and right channel for delay effects
-        float* leftChannel = buffer.getWritePointer(0);
-        float* rightChannel = buffer.getWritePointer(1);
+    // Shut for this whole block and longer than anything after the gate rings on, so the rest of the chain would only be working on silence
+    if (mGate.getSamplesClosed() >= buffer.getNumSamples() + mDownstreamTailSeconds.load() * getSampleRate())
+        return;
+
+    // Then the pedals, in whatever order they're routed in. Each checks its own on / off.
+    mRouting.process(buffer, *this);
+}
+
+void PDLBOARDAudioProcessor::processPedal(PedalGraph::Pedal pedal, juce::AudioBuffer<float>& buffer)
+{
+    switch (pedal)
+    {
+        case PedalGraph::Pedal::autoWah:    mAutoWah.process(buffer); break;
+        case PedalGraph::Pedal::overdrive:  processOverdrive(buffer); break;
+        case PedalGraph::Pedal::chorus:     processChorus(buffer); break;
+        case PedalGraph::Pedal::delay:      processDelay(buffer); break;
+        case PedalGraph::Pedal::cabinet:    mCabinet.process(buffer); break;
+        case PedalGraph::Pedal::reverb:     mReverb.process(buffer, isNonRealtime()); break;
+        case PedalGraph::Pedal::fdnReverb:  mFDNReverb.process(buffer); break;
+    }
+}
+
+void PDLBOARDAudioProcessor::processOverdrive(juce::AudioBuffer<float>& buffer)
+{
+    // Get parameters for overdrive.
+    auto drive = getParameterValue(mDriveParameter);
+    auto range = getParameterValue(mRangeParameter);
+    auto blend = getParameterValue(mBlendParameter);
+    auto volume = getParameterValue(mVolumeParameter);
+    auto overdriveOnOff = treeState.getRawParameterValue("onoff1");
+
+    mEQ.process(buffer, GuitarEffectAudioProcessor::EQ::Position::beforeOverdrive);
+
+    // In neural mode, with a model loaded, in the circuit modes or in multiband, the atan is replaced
+    bool overdriveDone = mAmpModel.process(buffer) || mCircuitModel.process(buffer) || mMultiband.process(buffer);
+
+    if (*overdriveOnOff > 0.5f && ! overdriveDone)
+    {
+        for (int channel = 0; channel < buffer.getNumChannels(); ++channel)
+        {
+            auto* channelData = buffer.getWritePointer(channel);
+
+            for (int i = 0; i < buffer.getNumSamples(); ++i)
+                channelData[i] = atanOverdrive(channelData[i], drive, range, blend, volume);
+        }
+    }
+
+    mEQ.process(buffer, GuitarEffectAudioProcessor::EQ::Position::afterOverdrive);
+}
+
+void PDLBOARDAudioProcessor::processClassicChain(juce::AudioBuffer<float>& buffer)
+{
+    auto drive = getParameterValue(mDriveParameter);
+    auto range = getParameterValue(mRangeParameter);
+    auto blend = getParameterValue(mBlendParameter);
+    auto volume = getParameterValue(mVolumeParameter);
+    auto overdriveOnOff = treeState.getRawParameterValue("onoff1");
+    auto chorusOnOff = treeState.getRawParameterValue("onoff2");
+    auto delayOnOff = treeState.getRawParameterValue("onoff3");
+
+    // The ensemble and the multi-tap modes came later, and only ever ran a block at a time
+    if (*treeState.getRawParameterValue("chorusvoices") > 1.5f || *treeState.getRawParameterValue("delaymode") > 0.5f)
+    {
+        processOverdrive(buffer);
+        processChorus(buffer);
+        processDelay(buffer);
+        return;
+    }
+
+    mEQ.process(buffer, GuitarEffectAudioProcessor::EQ::Position::beforeOverdrive);
+
+    // In neural mode, with a model loaded, in the circuit modes or in multiband, the atan is replaced at the front of the chain
+    bool overdriveDone = mAmpModel.process(buffer) || mCircuitModel.process(buffer) || mMultiband.process(buffer);
+
+    // The EQ after the atan needs the atan done first, so then it's run over the block here rather than in the loop below
+    if (mEQ.isAfterOverdrive() && *overdriveOnOff > 0.5f && ! overdriveDone)
+    {
+        for (int channel = 0; channel < buffer.getNumChannels(); ++channel)
+        {
+            auto* channelData = buffer.getWritePointer(channel);
+
+            for (int i = 0; i < buffer.getNumSamples(); ++i)
+                channelData[i] = atanOverdrive(channelData[i], drive, range, blend, volume);
+        }
+
+        overdriveDone = true;
+    }
+
+    mEQ.process(buffer, GuitarEffectAudioProcessor::EQ::Position::afterOverdrive);
+
+    auto chorus = getChorusSettings();
+    auto delay = getDelaySettings();
+    setDelayTimeTarget(delay.time);
+    auto rampSamplesLeft = mDelayTimeRampLeft;
+
+    /*
+    * The way the chain always ran: a pass over the block for every channel,
+    * each sample of it overdriven then put through the chorus and the delay
+    * on both sides. The chorus and the delay share the chorus's line, write
+    * head and feedback between them.
+    */
+    for (int channel = 0; channel < buffer.getNumChannels(); ++channel)
+    {
+        auto* channelData = buffer.getWritePointer(channel);
+
+        // Every channel's pass glides the same way
+        mDelayTimeInSamples = mDelayTime;
+        rampSamplesLeft = mDelayTimeRampLeft;
 
-        // Set the delay time based on sample rate and delay parameter
-        mDelayTimeInSamples = getSampleRate() * *dDelayTime;
-        
-        // Iterate through the audio buffer
         for (int i = 0; i < buffer.getNumSamples(); i++)
         {
-            // Process Overdrive if button is turned on.
-            if (overdriveOnOff == true)
-            {
-                auto cleanSignal = *channelData;
-
-                *channelData *= *drive * *range;
+            if (*overdriveOnOff > 0.5f && ! overdriveDone)
+                channelData[i] = atanOverdrive(channelData[i], drive, range, blend, volume);
 
-                *channelData = (((((2.f / juce::float_Pi) * atan(*channelData)) * *blend) + (cleanSignal * (1.f - *blend))) / 2) * *volume;
-
-                channelData++;
-            }
-
-            //===========================================================================
+            if (*chorusOnOff > 0.5f)
+                processChorusSample(mChorusLine, buffer, i, chorus);
 
-            // Process Chorus if button is on.
-            if (chorusOnOff == true)
-            {
-                // Write into the circular buffer
-                mCircularBufferLeft[mCircularBufferWriteHead] = leftChannel[i] + mFeedbackLeft;
-                mCircularBufferRight[mCircularBufferWriteHead] = rightChannel[i] + mFeedbackRight;
+            if (*delayOnOff > 0.5f)
+                processDelaySample(mChorusLine, buffer, i, delay);
 
-                // Generate the left LFO output. LFO = Low Frequency Oscillator which is used to manipulate the waveform
-                float lfoOutLeft = sin(2 * juce::MathConstants<float>::pi * mLFOPhase);
-
-                // Calculate the right channel lfo phase
-                float lfoPhaseRight = mLFOPhase + *cOffset;
+            stepDelayTime(rampSamplesLeft);
+        }
+    }
 
-                // Check the phase is not greater than 1
-                if (lfoPhaseRight > 1)
-                {
-                    lfoPhaseRight -= 1;
-                }
+    mDelayTime = mDelayTimeInSamples;
+    mDelayTimeRampLeft = rampSamplesLeft;
+}
 
-                // Generate the left LFO output
-                float lfoOutRight = sin(2 * juce::MathConstants<float>::pi * lfoPhaseRight);
+PDLBOARDAudioProcessor::ChorusSettings PDLBOARDAudioProcessor::getChorusSettings() const
+{
+    ChorusSettings settings;
+    settings.dryWet = getParameterValue(mChorusDryWetParameter);
+    settings.depth = getParameterValue(mChorusDepthParameter);
+    settings.rate = getParameterValue(mChorusRateParameter);
+    settings.offset = getParameterValue(mChorusOffsetParameter);
+    settings.feedback = getParameterValue(mChorusFeedbackParameter);
+    settings.isFlanger = *treeState.getRawParameterValue("type") != 0;
+    return settings;
+}
 
-                // Moving the LFO phase forward
-                mLFOPhase += *cRate / getSampleRate();
+PDLBOARDAudioProcessor::DelaySettings PDLBOARDAudioProcessor::getDelaySettings() const
+{
+    DelaySettings settings;
+    settings.dryWet = getParameterValue(mDelayDryWetParameter);
+    settings.feedback = getParameterValue(mDelayFeedbackParameter);
+    settings.time = getParameterValue(mDelayTimeParameter);
+    return settings;
+}
 
-                if (mLFOPhase > 1)
-                {
-                    mLFOPhase -= 1;
-                }
+PDLBOARDAudioProcessor::CachedParameter PDLBOARDAudioProcessor::getCachedParameter(juce::StringRef id)
+{
+    CachedParameter cached;
+    cached.parameter = treeState.getParameter(id);
+    cached.value = treeState.getRawParameterValue(id);
+    jassert(cached.parameter != nullptr && cached.value != nullptr);
+    return cached;
+}
 
-                // Control depth of LFO by multiplying by the depth parameter which is attatched to the depth slider
-                lfoOutLeft *= *cDepth;
-                lfoOutRight *= *cDepth;
+float PDLBOARDAudioProcessor::getParameterValue(const CachedParameter& cached) const
+{
+    auto offset = mModulation.getOffset(*cached.parameter);
 
-                float lfoOutMappedLeft = 0;
-                float lfoOutMappedRight = 0;
+    // Unmodulated, exactly what was always read
+    if (offset == 0.f)
+        return *cached.value;
 
-                // Map the LFO output to our desired delay times. 
+    return GuitarEffectAudioProcessor::ModulationMatrix::applyOffset(*cached.parameter, offset);
+}
 
-                // Chorus
-                if (*cType == 0)
-                {
-                    lfoOutMappedLeft = juce::jmap(lfoOutLeft, -1.f, 1.f, 0.005f, 0.03f);
-                    lfoOutMappedRight = juce::jmap(lfoOutRight, -1.f, 1.f, 0.005f, 0.03f);
-                }
-                else //Flanger
-                {
-                    lfoOutMappedLeft = juce::jmap(lfoOutLeft, -1.f, 1.f, 0.001f, 0.005f);
-                    lfoOutMappedRight = juce::jmap(lfoOutRight, -1.f, 1.f, 0.001f, 0.005f);
-                }
+void PDLBOARDAudioProcessor::setDelayTimeTarget(float seconds)
+{
+    auto target = (float)(getSampleRate() * seconds);
 
-                // Calculate the delay lengths and samples for whatever delay times are chosen. i.e. Chorus or flanger
-                float delayTimeSamplesLeft = getSampleRate() * lfoOutMappedLeft;
-                float delayTimeSamplesRight = getSampleRate() * lfoOutMappedRight;
+    // The first piece since prepare starts there
+    if (mDelayTimeTarget < 0.f)
+    {
+        mDelayTime = target;
+        mDelayTimeRampLeft = 0;
+    }
+    else if (target != mDelayTimeTarget)
+    {
+        mDelayTimeRampLeft = mModulation.getControlPeriod();
+        mDelayTimeStep = (target - mDelayTime) / (float)mDelayTimeRampLeft;
+    }
 
-                // Calculate the left read head position
-                float delayReadHeadLeft = mCircularBufferWriteHead - delayTimeSamplesLeft;
+    mDelayTimeTarget = target;
+}
 
-                if (delayReadHeadLeft < 0) {
-                    delayReadHeadLeft += mCircularBufferLength;
-                }
+void PDLBOARDAudioProcessor::stepDelayTime(int& rampSamplesLeft)
+{
+    if (rampSamplesLeft <= 0)
+        return;
 
-                // Calculate the right read head position
-                float delayReadHeadRight = mCircularBufferWriteHead - delayTimeSamplesRight;
+    // Landing exactly on the target, whatever the rounding on the way
+    mDelayTimeInSamples = --rampSamplesLeft > 0 ? mDelayTimeInSamples + mDelayTimeStep : mDelayTimeTarget;
+}
 
-                if (delayReadHeadRight < 0) {
-                    delayReadHeadRight += mCircularBufferLength;
-                }
+void PDLBOARDAudioProcessor::processChorus(juce::AudioBuffer<float>& buffer)
+{
+    auto cVoices = treeState.getRawParameterValue("chorusvoices");
+    auto chorusOnOff = treeState.getRawParameterValue("onoff2");
 
-                // Calculate the linear interpolation points for the left channel for smooth parameter changes
-                int readHeadLeft_x = (int)delayReadHeadLeft;
-                int readHeadLeft_x1 = readHeadLeft_x + 1;
-                float readHeadFloatLeft = delayReadHeadLeft - readHeadLeft_x;
+    if (*chorusOnOff <= 0.5f)
+        return;
 
-                if (readHeadLeft_x1 >= mCircularBufferLength)
-                {
-                    readHeadLeft_x1 -= mCircularBufferLength;
-                }
+    auto settings = getChorusSettings();
 
-                // Same for right channel
-                int readHeadRight_x = (int)delayReadHeadRight;
-                int readHeadRight_x1 = readHeadRight_x + 1;
-                float readHeadFloatRight = delayReadHeadRight - readHeadRight_x;
+    // More than one voice is the ensemble, every voice reading the same lines a SIMD lane each. See ChorusEnsemble.h
+    if (*cVoices > 1.5f)
+    {
+        ChorusEnsemble::Settings ensemble;
+        ensemble.numVoices = juce::roundToInt(cVoices->load());
+        ensemble.rate = settings.rate;
+        ensemble.depth = settings.depth;
+        ensemble.offset = settings.offset;
+        ensemble.feedback = settings.feedback;
+        ensemble.dryWet = settings.dryWet;
+
+        if (settings.isFlanger)
+        {
+            ensemble.minimumDelay = 0.001f;
+            ensemble.maximumDelay = 0.005f;
+        }
+
+        float* lines[] = { mChorusLine.left.data(), mChorusLine.right.data() };
+        mChorusEnsemble.process(buffer.getArrayOfWritePointers(), buffer.getNumChannels(), buffer.getNumSamples(),
+                                lines, mCircularBufferLength, mChorusLine.writeHead, mLFOPhase, ensemble);
+        return;
+    }
 
-                if (readHeadRight_x1 >= mCircularBufferLength)
-                {
-                    readHeadRight_x1 -= mCircularBufferLength;
-                }
+    // Both sides go through once for every channel, as they always have, so the sound doesn't change
+    for (int channel = 0; channel < buffer.getNumChannels(); ++channel)
+        for (int i = 0; i < buffer.getNumSamples(); i++)
+            processChorusSample(mChorusLine, buffer, i, settings);
+}
 
-                // Generate the output samples. See lin_interp() at the top of the code.
-                float delay_sample_left = lin_interp(mCircularBufferLeft[readHeadLeft_x], mCircularBufferLeft[readHeadLeft_x1], readHeadFloatLeft);
-                float delay_sample_right = lin_interp(mCircularBufferRight[readHeadRight_x], mCircularBufferRight[readHeadRight_x1], readHeadFloatRight);
+void PDLBOARDAudioProcessor::processChorusSample(DelayLine& line, juce::AudioBuffer<float>& buffer, int i, const ChorusSettings& settings)
+{
+    // Obtain the audio data pointers for left and right channel.
+    // A mono layout uses its only channel for both sides.
+    bool isStereo = buffer.getNumChannels() > 1;
+    float* leftChannel = buffer.getWritePointer(0);
+    float* rightChannel = isStereo ? buffer.getWritePointer(1) : leftChannel;
 
-                // Feedback from output that can be modified using the sliders that is then added to the start of the circular buffer at the start of the process block
-                mFeedbackLeft = delay_sample_left * *cFeedback;
-                mFeedbackRight = delay_sample_right * *cFeedback;
+    // Write into the circular buffer
+    line.left[(size_t)line.writeHead] = leftChannel[i] + line.feedbackLeft;
+    line.right[(size_t)line.writeHead] = rightChannel[i] + line.feedbackRight;
 
-                mCircularBufferWriteHead++;
+    // Generate the left LFO output. LFO = Low Frequency Oscillator which is used to manipulate the waveform
+    float lfoOutLeft = sin(2 * juce::MathConstants<float>::pi * mLFOPhase);
 
-                if (mCircularBufferWriteHead >= mCircularBufferLength) {
-                    mCircularBufferWriteHead = 0;
-                }
+    // Calculate the right channel lfo phase
+    float lfoPhaseRight = mLFOPhase + settings.offset;
 
-                float dryAmount = 1 - *cDryWet;
-                float wetAmount = *cDryWet;
+    // Check the phase is not greater than 1
+    if (lfoPhaseRight > 1)
+    {
+        lfoPhaseRight -= 1;
+    }
 
-                buffer.setSample(0, i, buffer.getSample(0, i) * dryAmount + delay_sample_left * wetAmount);
-                buffer.setSample(1, i, buffer.getSample(1, i) * dryAmount + delay_sample_right * wetAmount);
-               
-            } // end if for chorus
+    // Generate the left LFO output
+    float lfoOutRight = sin(2 * juce::MathConstants<float>::pi * lfoPhaseRight);
 
-            //===========================================================================
+    // Moving the LFO phase forward
+    mLFOPhase += settings.rate / getSampleRate();
 
-            // Process Dekay if button is on.
-            if (delayOnOff == true)
-            {
-                mCircularBufferLeft[mCircularBufferWriteHead] = leftChannel[i] + mFeedbackLeft;
-                mCircularBufferRight[mCircularBufferWriteHead] = rightChannel[i] + mFeedbackRight;
+    if (mLFOPhase > 1)
+    {
+        mLFOPhase -= 1;
+    }
 
-                mDelayReadHead = mCircularBufferWriteHead - mDelayTimeInSamples;
+    // Control depth of LFO by multiplying by the depth parameter which is attatched to the depth slider
+    lfoOutLeft *= settings.depth;
+    lfoOutRight *= settings.depth;
 
-                if (mDelayReadHead < 0) {
-                    mDelayReadHead += mCircularBufferLength;
-                }
+    float lfoOutMappedLeft = 0;
+    float lfoOutMappedRight = 0;
 
-                int readHead_x = (int)mDelayReadHead;
-                int readHead_x1 = readHead_x + 1;
-                float readHeadFloat = mDelayReadHead - readHead_x;
+    // Map the LFO output to our desired delay times. 
 
-                if (readHead_x1 >= mCircularBufferLength)
-                {
-                    readHead_x1 -= mCircularBufferLength;
-                }
+    // Chorus
+    if (! settings.isFlanger)
+    {
+        lfoOutMappedLeft = juce::jmap(lfoOutLeft, -1.f, 1.f, 0.005f, 0.03f);
+        lfoOutMappedRight = juce::jmap(lfoOutRight, -1.f, 1.f, 0.005f, 0.03f);
+    }
+    else //Flanger
+    {
+        lfoOutMappedLeft = juce::jmap(lfoOutLeft, -1.f, 1.f, 0.001f, 0.005f);
+        lfoOutMappedRight = juce::jmap(lfoOutRight, -1.f, 1.f, 0.001f, 0.005f);
+    }
+
+    // Calculate the delay lengths and samples for whatever delay times are chosen. i.e. Chorus or flanger
+    float delayTimeSamplesLeft = getSampleRate() * lfoOutMappedLeft;
+    float delayTimeSamplesRight = getSampleRate() * lfoOutMappedRight;
+
+    // Read both sides that far behind the write head, linearly interpolated. See CircularDelay.h
+    float delay_sample_left = CircularDelay::read(line.left.data(), mCircularBufferLength, line.writeHead, delayTimeSamplesLeft);
+    float delay_sample_right = CircularDelay::read(line.right.data(), mCircularBufferLength, line.writeHead, delayTimeSamplesRight);
+
+    // Feedback from output that can be modified using the sliders that is then added to the start of the circular buffer
+    line.feedbackLeft = delay_sample_left * settings.feedback;
+    line.feedbackRight = delay_sample_right * settings.feedback;
+
+    line.writeHead++;
+
+    if (line.writeHead >= mCircularBufferLength) {
+        line.writeHead = 0;
+    }
+
+    float dryAmount = 1 - settings.dryWet;
+    float wetAmount = settings.dryWet;
+
+    buffer.setSample(0, i, buffer.getSample(0, i) * dryAmount + delay_sample_left * wetAmount);
+
+    if (isStereo)
+    {
+        buffer.setSample(1, i, buffer.getSample(1, i) * dryAmount + delay_sample_right * wetAmount);
+    }
+}
+
+void PDLBOARDAudioProcessor::processDelay(juce::AudioBuffer<float>& buffer)
+{
+    auto dMode = treeState.getRawParameterValue("delaymode");
+    auto delayOnOff = treeState.getRawParameterValue("onoff3");
 
-                float delay_sample_left = lin_interp(mCircularBufferLeft[readHead_x], mCircularBufferLeft[readHead_x1], readHeadFloat);
-                float delay_sample_right = lin_interp(mCircularBufferRight[readHead_x], mCircularBufferRight[readHead_x1], readHeadFloat);
+    if (*delayOnOff <= 0.5f)
+        return;
 
-                mFeedbackLeft = delay_sample_left * *dFeedback;
-                mFeedbackRight = delay_sample_right * *dFeedback;
-
-                mCircularBufferWriteHead++;
+    if (*dMode > 0.5f)
+    {
+        processMultiTap(buffer);
+        return;
+    }
 
-                if (mCircularBufferWriteHead >= mCircularBufferLength) {
-                    mCircularBufferWriteHead = 0;
-                }
+    auto settings = getDelaySettings();
+    setDelayTimeTarget(settings.time);
+    auto rampSamplesLeft = mDelayTimeRampLeft;
 
-                buffer.setSample(0, i, buffer.getSample(0, i) * (1 - *dDryWet) + delay_sample_left * *dDryWet);
-                buffer.setSample(1, i, buffer.getSample(1, i) * (1 - *dDryWet) + delay_sample_right * *dDryWet);  
-            }// end if for delay
+    // Once for every channel, like the chorus, each gliding the same way
+    for (int channel = 0; channel < buffer.getNumChannels(); ++channel)
+    {
+        mDelayTimeInSamples = mDelayTime;
+        rampSamplesLeft = mDelayTimeRampLeft;
 
-        }// end buffer loop
+        for (int i = 0; i < buffer.getNumSamples(); i++)
+        {
+            processDelaySample(mDelayLine, buffer, i, settings);
+            stepDelayTime(rampSamplesLeft);
+        }
     }
+
+    mDelayTime = mDelayTimeInSamples;
+    mDelayTimeRampLeft = rampSamplesLeft;
+}
+
+void PDLBOARDAudioProcessor::processDelaySample(DelayLine& line, juce::AudioBuffer<float>& buffer, int i, const DelaySettings& settings)
+{
+    // A mono layout uses its only channel for both sides.
+    bool isStereo = buffer.getNumChannels() > 1;
+    float* leftChannel = buffer.getWritePointer(0);
+    float* rightChannel = isStereo ? buffer.getWritePointer(1) : leftChannel;
+
+    line.left[(size_t)line.writeHead] = leftChannel[i] + line.feedbackLeft;
+    line.right[(size_t)line.writeHead] = rightChannel[i] + line.feedbackRight;
+
+    mDelayReadHead = line.writeHead - mDelayTimeInSamples;
+
+    if (mDelayReadHead < 0) {
+        mDelayReadHead += mCircularBufferLength;
+    }
+
+    int readHead_x = (int)mDelayReadHead;
+    float readHeadFloat = mDelayReadHead - readHead_x;
+
+    if (readHead_x >= mCircularBufferLength)
+    {
+        readHead_x -= mCircularBufferLength;
+    }
+
+    int readHead_x1 = readHead_x + 1;
+
+    if (readHead_x1 >= mCircularBufferLength)
+    {
+        readHead_x1 -= mCircularBufferLength;
+    }
+
+    float delay_sample_left = lin_interp(line.left[(size_t)readHead_x], line.left[(size_t)readHead_x1], readHeadFloat);
+    float delay_sample_right = lin_interp(line.right[(size_t)readHead_x], line.right[(size_t)readHead_x1], readHeadFloat);
+
+    line.feedbackLeft = delay_sample_left * settings.feedback;
+    line.feedbackRight = delay_sample_right * settings.feedback;
+
+    line.writeHead++;
+
+    if (line.writeHead >= mCircularBufferLength) {
+        line.writeHead = 0;
+    }
+
+    buffer.setSample(0, i, buffer.getSample(0, i) * (1 - settings.dryWet) + delay_sample_left * settings.dryWet);
+
+    if (isStereo)
+    {
+        buffer.setSample(1, i, buffer.getSample(1, i) * (1 - settings.dryWet) + delay_sample_right * settings.dryWet);
+    }
+}
+
+void PDLBOARDAudioProcessor::processMultiTap(juce::AudioBuffer<float>& buffer)
+{
+    // Get parameters for the multi-tap and ping-pong modes. The delay time is where the last tap lands.
+    auto dDryWet = getParameterValue(mDelayDryWetParameter);
+    auto dFeedback = getParameterValue(mDelayFeedbackParameter);
+    auto dDelayTime = getParameterValue(mDelayTimeParameter);
+    auto dMode = treeState.getRawParameterValue("delaymode");
+    auto dTaps = treeState.getRawParameterValue("delaytaps");
+    auto dSpacing = treeState.getRawParameterValue("tapspacing");
+    auto dDecay = getParameterValue(mTapDecayParameter);
+    auto dSpread = getParameterValue(mTapSpreadParameter);
+    auto dTone = getParameterValue(mTapToneParameter);
+    auto dCrossFeedback = getParameterValue(mCrossFeedbackParameter);
+
+    auto numTaps = juce::jlimit(1, MultiTapDelay::maximumTaps, juce::roundToInt(dTaps->load()));
+    std::array<MultiTapDelay::Tap, MultiTapDelay::maximumTaps> taps;
+
+    for (int t = 0; t < numTaps; ++t)
+    {
+        auto position = (float)(t + 1) / (float)numTaps;
+
+        switch (juce::roundToInt(dSpacing->load()))
+        {
+            // Every other tap a third of a step late
+            case 1:  if (t % 2 == 0 && t + 1 < numTaps) position += 1.f / (3.f * (float)numTaps); break;
+            case 2:  position = std::pow(position, 0.6f); break;
+            case 3:  position = std::pow(position, 1.6f); break;
+            default: break;
+        }
+
+        // Each tap quieter and darker than the one before, alternating sides
+        taps[(size_t)t].time = dDelayTime * position;
+        taps[(size_t)t].gain = std::pow(dDecay, (float)t);
+        taps[(size_t)t].pan = (t % 2 == 0 ? -1.f : 1.f) * dSpread;
+        taps[(size_t)t].cutoff = dTone * std::pow(0.85f, (float)t);
+    }
+
+    mMultiTap.setTaps(taps.data(), numTaps);
+
+    MultiTapDelay::Settings settings;
+    settings.feedback = dFeedback;
+    settings.crossFeedback = dCrossFeedback;
+    settings.pingPong = *dMode > 1.5f;
+    settings.dryWet = dDryWet;
+
+    auto& line = mDelayLine;
+    float* lines[] = { line.left.data(), line.right.data() };
+
+    mMultiTap.process(buffer.getArrayOfWritePointers(), buffer.getNumChannels(), buffer.getNumSamples(),
+                      lines, mCircularBufferLength, line.writeHead, settings);
 }
 
 //==============================================================================
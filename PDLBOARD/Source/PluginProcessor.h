@@ -10,11 +10,16 @@
 
 #include <JuceHeader.h>
 #include "GuitarEffects.h"
+#include "PresetBank.h"
+#include "ChorusEnsemble.h"
 
 //==============================================================================
 /**
 */
-class PDLBOARDAudioProcessor  : public foleys::MagicProcessor
+class PDLBOARDAudioProcessor  : public foleys::MagicProcessor,
+                                private juce::AudioProcessorValueTreeState::Listener,
+                                private juce::Timer,
+                                private PedalGraph::Effects
 {
 public:
     //==============================================================================
@@ -34,23 +39,181 @@ public:
     //==============================================================================
     double getTailLengthSeconds() const override;
 
+    // In the compact binary format, see SessionState.h
+    void getStateInformation (juce::MemoryBlock& destData) override;
+    void setStateInformation (const void* data, int sizeInBytes) override;
+
+    // Copies the amp model and IR files into saved sessions, for moving them between machines
+    void setEmbedFilesInState(bool shouldEmbed);
+
+    // The host's programs are the preset bank's presets, one program when there's no bank
+    int getNumPrograms() override;
+    int getCurrentProgram() override;
+    void setCurrentProgram (int index) override;
+    const juce::String getProgramName (int index) override;
+    void changeProgramName (int index, const juce::String& newName) override;
+
+    // False, keeping the bank there was, when the file isn't one
+    bool loadPresetBank(const juce::File& file);
+
     // Personal functions.
     juce::AudioProcessorValueTreeState::ParameterLayout createParameterLayout();
     float lin_interp(float sample_x, float sample_x1, float inPhase);
+    static float atanOverdrive(float sample, float drive, float range, float blend, float volume);
+
+    GuitarEffectAudioProcessor::AmpModel& getAmpModel() { return mAmpModel; }
+    GuitarEffectAudioProcessor::Cabinet& getCabinet() { return mCabinet; }
+    GuitarEffectAudioProcessor::Reverb& getReverb() { return mReverb; }
+    GuitarEffectAudioProcessor::Tuner& getTuner() { return mTuner; }
+    GuitarEffectAudioProcessor::Routing& getRouting() { return mRouting; }
+    GuitarEffectAudioProcessor::Presets& getPresets() { return mPresets; }
+    GuitarEffectAudioProcessor::MidiControl& getMidiControl() { return mMidiControl; }
+    GuitarEffectAudioProcessor::Automation& getAutomation() { return mAutomation; }
+    GuitarEffectAudioProcessor::ModulationMatrix& getModulation() { return mModulation; }
+    // For the browser, on the message thread like loadPresetBank. Null without a bank.
+    const PresetBank* getPresetBank() const { return mPresetBank.get(); }
+    juce::AudioProcessorValueTreeState& getValueTreeState() { return treeState; }
 
 private:
     //==============================================================================
+    // The gate's lookahead comes and goes with its on / off
+    void parameterChanged(const juce::String& parameterID, float newValue) override;
+
+    // Passes on a latency change that came in off the message thread
+    void timerCallback() override;
+
+    // How long everything after the gate can ring on once its input stops
+    double getDownstreamTailSeconds() const;
+
+    // Everything getDownstreamTailSeconds() reads
+    static constexpr const char* tailParameterIDs[] = { "onoff2", "onoff3", "onoff4", "onoff5", "onoff6",
+                                                        "feedback1", "feedback2", "delaytime", "fdnfreeze", "fdndecay" };
+
+    // The most that's reported to the host
+    static constexpr double maximumTailSeconds = 30.0;
+
+    // Tuner, gate and the routed pedals
+    void processChain(juce::AudioBuffer<float>& buffer);
+
+    // The chain in pieces between automation events and modulation updates
+    void processChainAutomated(juce::AudioBuffer<float>& buffer);
+
+    // The routing's schedule calls back in here for each pedal, on its own buffer
+    void processPedal(PedalGraph::Pedal pedal, juce::AudioBuffer<float>& buffer) override;
+
+    // Overdrive > chorus > delay in the routing, run sample by sample as they were before it
+    void processClassicChain(juce::AudioBuffer<float>& buffer) override;
+
+    void processOverdrive(juce::AudioBuffer<float>& buffer);
+    void processChorus(juce::AudioBuffer<float>& buffer);
+    void processDelay(juce::AudioBuffer<float>& buffer);
+    void processMultiTap(juce::AudioBuffer<float>& buffer);
+
+    // The parameters the single voice chorus and the plain delay hold for a block
+    struct ChorusSettings
+    {
+        float dryWet, depth, rate, offset, feedback;
+        bool isFlanger;
+    };
+
+    struct DelaySettings
+    {
+        float dryWet, feedback, time;
+    };
+
+    ChorusSettings getChorusSettings() const;
+    DelaySettings getDelaySettings() const;
+
+    // One of the processor's own pedals' parameters, looked up once so the audio thread never searches by name
+    struct CachedParameter
+    {
+        juce::RangedAudioParameter* parameter = nullptr;
+        std::atomic<float>* value = nullptr;
+    };
+
+    CachedParameter getCachedParameter(juce::StringRef id);
+
+    // A parameter as the processor's own pedals read it, with any modulation on top
+    float getParameterValue(const CachedParameter& cached) const;
+
+    // Heads for the delay time at the start of a piece. The plain delay glides
+    // there over a control period, so modulating it doesn't zipper.
+    void setDelayTimeTarget(float seconds);
+    void stepDelayTime(int& rampSamplesLeft);
+
+    // One sample of each, on both sides, written back into the buffer
+    struct DelayLine;
+    void processChorusSample(DelayLine& line, juce::AudioBuffer<float>& buffer, int i, const ChorusSettings& settings);
+    void processDelaySample(DelayLine& line, juce::AudioBuffer<float>& buffer, int i, const DelaySettings& settings);
+
     juce::AudioProcessorValueTreeState treeState;
 
-    // Circular buffer data
-    float* mCircularBufferLeft;
-    float* mCircularBufferRight;
+    // Listens to the input before anything else touches it
+    GuitarEffectAudioProcessor::Tuner mTuner;
 
-    int mCircularBufferLength;
-    int mCircularBufferWriteHead;
+    // At the front of the chain, and idles everything after it once it's shut
+    GuitarEffectAudioProcessor::NoiseGate mGate;
+    std::atomic<bool> mLatencyChanged { false }, mIsProcessing { false };
+
+    // Kept up to date by parameterChanged()
+    std::atomic<double> mDownstreamTailSeconds { 0.0 };
+
+    // Before the overdrive, following the pick
+    GuitarEffectAudioProcessor::AutoWah mAutoWah;
+
+    // Either side of the overdrive
+    GuitarEffectAudioProcessor::EQ mEQ;
+
+    // Run in the overdrive's place
+    GuitarEffectAudioProcessor::AmpModel mAmpModel;
+    GuitarEffectAudioProcessor::CircuitModel mCircuitModel;
+    GuitarEffectAudioProcessor::Multiband mMultiband;
+
+    GuitarEffectAudioProcessor::Cabinet mCabinet;
+    GuitarEffectAudioProcessor::Reverb mReverb;
+    GuitarEffectAudioProcessor::FDNReverb mFDNReverb;
+
+    // The order all of the above run in, after the gate
+    GuitarEffectAudioProcessor::Routing mRouting;
+
+    // Switches everything above at once, crossfading from what the old preset made of the start of the block
+    GuitarEffectAudioProcessor::Presets mPresets;
+    juce::AudioBuffer<float> mPresetFadeBuffer;
+
+    // Where the programs come from, swapped under the lock
+    std::unique_ptr<PresetBank> mPresetBank;
+    juce::CriticalSection mPresetBankLock;
+    std::atomic<int> mCurrentProgram { 0 };
+
+    // Parameter changes at their samples, from MIDI or anywhere else
+    GuitarEffectAudioProcessor::Automation mAutomation;
 
-    float mFeedbackLeft;
-    float mFeedbackRight;
+    // Controllers onto parameters, and program changes onto the bank
+    GuitarEffectAudioProcessor::MidiControl mMidiControl;
+
+    // LFOs, envelopes and controllers moving parameters at the control rate
+    GuitarEffectAudioProcessor::ModulationMatrix mModulation;
+
+    // Circular buffer data. The chorus and the delay have a buffer each, so either can go anywhere in the routing.
+    struct DelayLine
+    {
+        std::vector<float> left, right;
+        int writeHead = 0;
+
+        float feedbackLeft = 0;
+        float feedbackRight = 0;
+    };
+
+    DelayLine mChorusLine;
+    DelayLine mDelayLine;
+
+    // The chorus with more than one voice, reading mChorusLine
+    ChorusEnsemble mChorusEnsemble;
+
+    // The delay's multi-tap and ping-pong modes, reading mDelayLine
+    MultiTapDelay mMultiTap;
+
+    int mCircularBufferLength;
 
     // LFO data
     float mLFOPhase;
@@ -58,5 +221,14 @@ private:
     float mDelayTimeInSamples;
     float mDelayReadHead;
 
+    // What getParameterValue() reads for the overdrive, the chorus and the delay
+    CachedParameter mDriveParameter, mRangeParameter, mBlendParameter, mVolumeParameter;
+    CachedParameter mChorusDryWetParameter, mChorusDepthParameter, mChorusRateParameter, mChorusOffsetParameter, mChorusFeedbackParameter;
+    CachedParameter mDelayDryWetParameter, mDelayFeedbackParameter, mDelayTimeParameter, mTapDecayParameter, mTapSpreadParameter, mTapToneParameter, mCrossFeedbackParameter;
+
+    // Where the plain delay's time glide is between pieces, the target -1 until the first one
+    float mDelayTimeTarget = -1.f, mDelayTimeStep = 0.f, mDelayTime = 0.f;
+    int mDelayTimeRampLeft = 0;
+
     JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR (PDLBOARDAudioProcessor)
 };
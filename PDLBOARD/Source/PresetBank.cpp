@@ -0,0 +1,410 @@
+/*
+  ==============================================================================
+
+    PresetBank.cpp
+
+  ==============================================================================
+*/
+
+#include "PresetBank.h"
+#include "SessionState.h"
+
+static const char bankMagic[4] = { 'P', 'D', 'L', 'K' };
+
+// All of them are words
+static constexpr int headerWords = 12, presetWords = 5, tagWords = 3;
+
+// Which on / off switches which effect bit
+static const std::pair<const char*, int> effectSwitches[] = {
+    { "onoff1", PresetBank::overdrive }, { "onoff2", PresetBank::chorus }, { "onoff3", PresetBank::delay },
+    { "onoff4", PresetBank::cabinet }, { "onoff5", PresetBank::reverb }, { "onoff6", PresetBank::fdnReverb },
+    { "onoff7", PresetBank::eq }, { "onoff8", PresetBank::gate },
+    { "onoff10", PresetBank::autoWah }
+};
+
+//==============================================================================
+bool PresetBank::write (const juce::File& file, const std::vector<Entry>& entries)
+{
+    auto& table = SessionState::getParameterTable();
+    auto numEntries = (int)entries.size();
+
+    // Every string once, the first one empty so offset 0 means nothing
+    juce::MemoryOutputStream strings;
+    std::map<juce::String, juce::uint32> stringOffsets;
+
+    auto addString = [&] (const juce::String& text) -> juce::uint32
+    {
+        if (text.isEmpty())
+            return 0;
+
+        auto found = stringOffsets.find(text);
+
+        if (found != stringOffsets.end())
+            return found->second;
+
+        auto offset = (juce::uint32)strings.getDataSize();
+        strings.writeString(text);
+        stringOffsets[text] = offset;
+        return offset;
+    };
+
+    strings.writeByte(0);
+
+    // Tags in name order, with their members in program order
+    juce::StringArray tagNames;
+
+    for (auto& entry : entries)
+        for (auto& tag : entry.tags)
+            tagNames.addIfNotAlreadyThere(tag, true);
+
+    std::sort(tagNames.begin(), tagNames.end(), [] (const juce::String& a, const juce::String& b) { return a.compareIgnoreCase(b) < 0; });
+
+    std::vector<std::vector<juce::uint32>> members((size_t)tagNames.size());
+    std::vector<std::vector<juce::uint32>> presetTags((size_t)numEntries);
+
+    for (int preset = 0; preset < numEntries; ++preset)
+    {
+        for (auto& tag : entries[(size_t)preset].tags)
+        {
+            auto index = (juce::uint32)tagNames.indexOf(tag, true);
+
+            if (std::find(presetTags[(size_t)preset].begin(), presetTags[(size_t)preset].end(), index) != presetTags[(size_t)preset].end())
+                continue;
+
+            members[index].push_back((juce::uint32)preset);
+            presetTags[(size_t)preset].push_back(index);
+        }
+    }
+
+    std::vector<juce::uint32> nameIndex((size_t)numEntries);
+
+    for (int i = 0; i < numEntries; ++i)
+        nameIndex[(size_t)i] = (juce::uint32)i;
+
+    std::stable_sort(nameIndex.begin(), nameIndex.end(), [&] (juce::uint32 a, juce::uint32 b)
+    {
+        return entries[a].preset.name.compareIgnoreCase(entries[b].preset.name) < 0;
+    });
+
+    //==============================================================================
+    juce::MemoryOutputStream presets, values, tags, tagLists;
+    juce::uint32 numTagListWords = 0;
+
+    for (int tag = 0; tag < tagNames.size(); ++tag)
+    {
+        tags.writeInt((int)addString(tagNames[tag]));
+        tags.writeInt((int)numTagListWords);
+        tags.writeInt((int)members[(size_t)tag].size());
+
+        for (auto preset : members[(size_t)tag])
+            tagLists.writeInt((int)preset);
+
+        numTagListWords += (juce::uint32)members[(size_t)tag].size();
+    }
+
+    for (int preset = 0; preset < numEntries; ++preset)
+    {
+        auto& entry = entries[(size_t)preset];
+        int effects = 0;
+
+        for (auto& effectSwitch : effectSwitches)
+            for (auto& value : entry.preset.values)
+                if (value.first == effectSwitch.first && value.second > 0.5f)
+                    effects |= effectSwitch.second;
+
+        presets.writeInt((int)addString(entry.preset.name));
+        presets.writeInt((int)addString(entry.preset.routing));
+        presets.writeInt((int)numTagListWords);
+        presets.writeInt((int)presetTags[(size_t)preset].size());
+        presets.writeInt(effects);
+
+        for (auto tag : presetTags[(size_t)preset])
+            tagLists.writeInt((int)tag);
+
+        numTagListWords += (juce::uint32)presetTags[(size_t)preset].size();
+
+        for (auto& id : table)
+        {
+            auto value = std::numeric_limits<float>::quiet_NaN();
+
+            for (auto& entryValue : entry.preset.values)
+                if (entryValue.first == id)
+                    value = entryValue.second;
+
+            values.writeFloat(value);
+        }
+    }
+
+    juce::MemoryOutputStream nameIndexStream;
+
+    for (auto preset : nameIndex)
+        nameIndexStream.writeInt((int)preset);
+
+    while (strings.getDataSize() % 4 != 0)
+        strings.writeByte(0);
+
+    //==============================================================================
+    juce::MemoryOutputStream bank;
+    auto offset = (juce::uint32)(headerWords * 4);
+
+    auto presetsOffset = offset;      offset += (juce::uint32)presets.getDataSize();
+    auto valuesOffset = offset;       offset += (juce::uint32)values.getDataSize();
+    auto nameIndexOffset = offset;    offset += (juce::uint32)nameIndexStream.getDataSize();
+    auto tagsOffset = offset;         offset += (juce::uint32)tags.getDataSize();
+    auto tagListsOffset = offset;     offset += (juce::uint32)tagLists.getDataSize();
+    auto stringsOffset = offset;
+
+    bank.write(bankMagic, sizeof (bankMagic));
+
+    for (auto word : { (juce::uint32)version, (juce::uint32)numEntries, (juce::uint32)table.size(), (juce::uint32)tagNames.size(),
+                       presetsOffset, valuesOffset, nameIndexOffset, tagsOffset, tagListsOffset, stringsOffset, (juce::uint32)strings.getDataSize() })
+        bank.writeInt((int)word);
+
+    for (auto* section : { &presets, &values, &nameIndexStream, &tags, &tagLists, &strings })
+        bank.write(section->getData(), section->getDataSize());
+
+    return file.replaceWithData(bank.getData(), bank.getDataSize());
+}
+
+//==============================================================================
+PresetBank::PresetBank (const juce::File& file)
+{
+    auto mapped = std::make_unique<juce::MemoryMappedFile> (file, juce::MemoryMappedFile::readOnly);
+    auto* bytes = static_cast<const char*> (mapped->getData());
+    auto size = (juce::uint64)mapped->getSize();
+
+    if (bytes == nullptr || size < (juce::uint64)headerWords * 4 || std::memcmp(bytes, bankMagic, sizeof (bankMagic)) != 0)
+        return;
+
+    data = bytes;
+
+    if (readWord(4) != (juce::uint32)version)
+    {
+        data = nullptr;
+        return;
+    }
+
+    juce::uint64 header[11];
+
+    for (int i = 0; i < 11; ++i)
+        header[i] = readWord(4 + (size_t)i * 4);
+
+    auto presets = header[1], valuesPerPreset = header[2], tagCount = header[3];
+    auto fits = [size] (juce::uint64 offset, juce::uint64 length) { return offset % 4 == 0 && offset <= size && length <= size - offset; };
+
+    // Everything has to be inside the file before anything's read from it
+    bool isWhole = fits(header[4], presets * presetWords * 4)
+                && fits(header[5], presets * valuesPerPreset * 4)
+                && fits(header[6], presets * 4)
+                && fits(header[7], tagCount * tagWords * 4)
+                && header[8] <= header[9] && fits(header[8], header[9] - header[8])
+                && fits(header[9], header[10]) && header[10] > 0
+                && bytes[header[9] + header[10] - 1] == 0;
+
+    if (! isWhole)
+    {
+        data = nullptr;
+        return;
+    }
+
+    numPresets = (int)presets;
+    numValues = (int)valuesPerPreset;
+    numTags = (int)tagCount;
+    presetsOffset = (size_t)header[4];
+    valuesOffset = (size_t)header[5];
+    nameIndexOffset = (size_t)header[6];
+    tagsOffset = (size_t)header[7];
+    tagListsOffset = (size_t)header[8];
+    stringsOffset = (size_t)header[9];
+    stringsSize = (size_t)header[10];
+
+    auto numTagListWords = (juce::uint64)(stringsOffset - tagListsOffset) / 4;
+
+    // Then every offset and number in the records has to point somewhere real
+    for (int i = 0; i < numPresets && isWhole; ++i)
+    {
+        auto record = getRecord(i);
+
+        isWhole = readWord(record) < stringsSize && readWord(record + 4) < stringsSize
+               && (juce::uint64)readWord(record + 8) + readWord(record + 12) <= numTagListWords
+               && readWord(nameIndexOffset + (size_t)i * 4) < (juce::uint32)numPresets;
+
+        for (juce::uint32 t = 0; t < readWord(record + 12) && isWhole; ++t)
+            isWhole = readWord(tagListsOffset + (size_t)(readWord(record + 8) + t) * 4) < (juce::uint32)numTags;
+    }
+
+    for (int tag = 0; tag < numTags && isWhole; ++tag)
+    {
+        auto record = tagsOffset + (size_t)tag * tagWords * 4;
+
+        isWhole = readWord(record) < stringsSize
+               && (juce::uint64)readWord(record + 4) + readWord(record + 8) <= numTagListWords;
+
+        for (juce::uint32 m = 0; m < readWord(record + 8) && isWhole; ++m)
+            isWhole = readWord(tagListsOffset + (size_t)(readWord(record + 4) + m) * 4) < (juce::uint32)numPresets;
+    }
+
+    if (! isWhole)
+    {
+        data = nullptr;
+        numPresets = numValues = numTags = 0;
+        return;
+    }
+
+    map = std::move(mapped);
+}
+
+juce::uint32 PresetBank::readWord (size_t offset) const noexcept
+{
+    return juce::ByteOrder::littleEndianInt(data + offset);
+}
+
+const char* PresetBank::getString (juce::uint32 offset) const noexcept
+{
+    return data + stringsOffset + offset;
+}
+
+size_t PresetBank::getRecord (int index) const noexcept
+{
+    return presetsOffset + (size_t)index * presetWords * 4;
+}
+
+//==============================================================================
+juce::String PresetBank::getName (int index) const
+{
+    if (! juce::isPositiveAndBelow(index, numPresets))
+        return {};
+
+    return juce::String(juce::CharPointer_UTF8(getString(readWord(getRecord(index)))));
+}
+
+juce::StringArray PresetBank::getTags (int index) const
+{
+    juce::StringArray tags;
+
+    if (! juce::isPositiveAndBelow(index, numPresets))
+        return tags;
+
+    auto record = getRecord(index);
+
+    for (juce::uint32 t = 0; t < readWord(record + 12); ++t)
+    {
+        auto tag = readWord(tagListsOffset + (size_t)(readWord(record + 8) + t) * 4);
+        tags.add(juce::CharPointer_UTF8(getString(readWord(tagsOffset + (size_t)tag * tagWords * 4))));
+    }
+
+    return tags;
+}
+
+int PresetBank::getEffects (int index) const noexcept
+{
+    return juce::isPositiveAndBelow(index, numPresets) ? (int)readWord(getRecord(index) + 16) : 0;
+}
+
+GuitarEffectAudioProcessor::Presets::Preset PresetBank::getPreset (int index) const
+{
+    GuitarEffectAudioProcessor::Presets::Preset preset;
+
+    if (! juce::isPositiveAndBelow(index, numPresets))
+        return preset;
+
+    auto record = getRecord(index);
+    preset.name = juce::CharPointer_UTF8(getString(readWord(record)));
+    preset.routing = juce::CharPointer_UTF8(getString(readWord(record + 4)));
+
+    // A bank from before a parameter existed leaves it at its default, one from after has values this build skips
+    auto& table = SessionState::getParameterTable();
+    auto values = valuesOffset + (size_t)index * (size_t)numValues * 4;
+
+    for (int i = 0; i < juce::jmin(numValues, table.size()); ++i)
+    {
+        auto word = readWord(values + (size_t)i * 4);
+        float value;
+        std::memcpy(&value, &word, sizeof (value));
+
+        if (! std::isnan(value))
+            preset.values.emplace_back(table[i], value);
+    }
+
+    return preset;
+}
+
+int PresetBank::findByName (const juce::String& name) const
+{
+    int low = 0, high = numPresets;
+
+    while (low < high)
+    {
+        auto middle = (low + high) / 2;
+        auto preset = (int)readWord(nameIndexOffset + (size_t)middle * 4);
+        auto comparison = juce::CharacterFunctions::compareIgnoreCase(juce::CharPointer_UTF8(getString(readWord(getRecord(preset)))), name.getCharPointer());
+
+        if (comparison == 0)
+            return preset;
+
+        if (comparison < 0)
+            low = middle + 1;
+        else
+            high = middle;
+    }
+
+    return -1;
+}
+
+int PresetBank::findTag (const juce::String& tag) const
+{
+    int low = 0, high = numTags;
+
+    while (low < high)
+    {
+        auto middle = (low + high) / 2;
+        auto comparison = juce::CharacterFunctions::compareIgnoreCase(juce::CharPointer_UTF8(getString(readWord(tagsOffset + (size_t)middle * tagWords * 4))), tag.getCharPointer());
+
+        if (comparison == 0)
+            return middle;
+
+        if (comparison < 0)
+            low = middle + 1;
+        else
+            high = middle;
+    }
+
+    return -1;
+}
+
+juce::Array<int> PresetBank::findByTag (const juce::String& tag) const
+{
+    juce::Array<int> presets;
+    auto index = findTag(tag);
+
+    if (index < 0)
+        return presets;
+
+    auto record = tagsOffset + (size_t)index * tagWords * 4;
+
+    for (juce::uint32 m = 0; m < readWord(record + 8); ++m)
+        presets.add((int)readWord(tagListsOffset + (size_t)(readWord(record + 4) + m) * 4));
+
+    return presets;
+}
+
+juce::Array<int> PresetBank::findByEffects (int effects) const
+{
+    juce::Array<int> presets;
+
+    for (int i = 0; i < numPresets; ++i)
+        if ((getEffects(i) & effects) == effects)
+            presets.add(i);
+
+    return presets;
+}
+
+juce::StringArray PresetBank::getAllTags() const
+{
+    juce::StringArray tags;
+
+    for (int tag = 0; tag < numTags; ++tag)
+        tags.add(juce::CharPointer_UTF8(getString(readWord(tagsOffset + (size_t)tag * tagWords * 4))));
+
+    return tags;
+}
@@ -0,0 +1,104 @@
+/*
+  ==============================================================================
+
+    PresetBank.h
+
+  ==============================================================================
+*/
+
+#pragma once
+
+#include <JuceHeader.h>
+#include "GuitarEffects.h"
+
+//==============================================================================
+/**
+    A library of presets in one file, memory mapped and read in place.
+
+    Every preset is a fixed size record: where its name and routing are, which
+    effects it turns on, and a plain value for every slot in SessionState's
+    parameter table (NaN for values the preset leaves at their defaults). So a
+    preset is found by its number without reading any of the others, and
+    nothing is parsed until it's asked for.
+
+    The file also holds an index of names in case-insensitive order, and for
+    every tag a sorted list of the presets that have it. Looking a preset up by
+    name or tag is a binary search, by effect a scan over one word per preset.
+
+        header          "PDLK", version, counts and section offsets
+        presets         name, routing, first tag, number of tags, effects
+        values          presets x values, floats
+        name index      preset numbers in name order
+        tags            name, first member, number of members, in name order
+        tag lists       preset numbers for every tag, then tag numbers for every preset
+        strings         null terminated UTF-8
+
+    Integers and floats are little-endian, every section is 4 byte aligned.
+*/
+class PresetBank
+{
+public:
+    // Bits in a preset's effects, for whichever pedals it switches on
+    enum Effect
+    {
+        overdrive   = 1 << 0,
+        chorus      = 1 << 1,
+        delay       = 1 << 2,
+        cabinet     = 1 << 3,
+        reverb      = 1 << 4,
+        fdnReverb   = 1 << 5,
+        eq          = 1 << 6,
+        gate        = 1 << 7,
+        autoWah     = 1 << 8
+    };
+
+    struct Entry
+    {
+        GuitarEffectAudioProcessor::Presets::Preset preset;
+        juce::StringArray tags;
+    };
+
+    static constexpr int version = 1;
+
+    // Builds a bank. Presets keep the order they're given in, which is their program number.
+    static bool write(const juce::File& file, const std::vector<Entry>& entries);
+
+    //==============================================================================
+    // Maps the file. Check isValid(), a file that isn't a whole bank is left unmapped.
+    explicit PresetBank(const juce::File& file);
+
+    bool isValid() const noexcept                       { return map != nullptr; }
+    int getNumPresets() const noexcept                  { return numPresets; }
+
+    juce::String getName(int index) const;
+    juce::StringArray getTags(int index) const;
+    int getEffects(int index) const noexcept;
+
+    // Everything the preset engine needs to switch to it
+    GuitarEffectAudioProcessor::Presets::Preset getPreset(int index) const;
+
+    // -1 when there isn't one. Case doesn't matter.
+    int findByName(const juce::String& name) const;
+
+    // In program order
+    juce::Array<int> findByTag(const juce::String& tag) const;
+
+    // Presets using every one of the effects
+    juce::Array<int> findByEffects(int effects) const;
+
+    // Every tag in the bank, in name order
+    juce::StringArray getAllTags() const;
+
+private:
+    juce::uint32 readWord(size_t offset) const noexcept;
+    const char* getString(juce::uint32 offset) const noexcept;
+    size_t getRecord(int index) const noexcept;
+    int findTag(const juce::String& tag) const;
+
+    std::unique_ptr<juce::MemoryMappedFile> map;
+    const char* data = nullptr;
+    int numPresets = 0, numValues = 0, numTags = 0;
+    size_t presetsOffset = 0, valuesOffset = 0, nameIndexOffset = 0, tagsOffset = 0, tagListsOffset = 0, stringsOffset = 0, stringsSize = 0;
+
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR(PresetBank)
+};
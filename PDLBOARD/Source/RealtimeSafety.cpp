@@ -0,0 +1,554 @@
+/*
+  ==============================================================================
+
+    RealtimeSafety.cpp
+
+  ==============================================================================
+*/
+
+#include "RealtimeSafety.h"
+
+juce::String RealtimeSafety::toString (Violation type)
+{
+    switch (type)
+    {
+        case Violation::allocation:     return "allocation";
+        case Violation::deallocation:   return "deallocation";
+        case Violation::lock:           return "lock";
+        case Violation::blockingCall:   return "blocking call";
+    }
+
+    return {};
+}
+
+juce::String RealtimeSafety::Report::toString() const
+{
+    return RealtimeSafety::toString(type) + " in " + function + " on the audio thread" + juce::newLine
+         + stackTrace.joinIntoString(juce::newLine);
+}
+
+#if PDLBOARD_REALTIME_SAFETY_CHECKS
+
+#if JUCE_LINUX || JUCE_MAC
+ #include <dlfcn.h>
+ #include <execinfo.h>
+ #include <pthread.h>
+ #include <semaphore.h>
+ #include <unistd.h>
+ #include <poll.h>
+ #include <sys/select.h>
+ #include <sys/socket.h>
+ #include <cerrno>
+#endif
+
+#include <new>
+
+#if JUCE_WINDOWS
+ #include <windows.h>
+ #include <dbghelp.h>
+ #include <crtdbg.h>
+ #include <malloc.h>
+ #pragma comment(lib, "dbghelp.lib")
+#endif
+
+namespace RealtimeSafety
+{
+    namespace
+    {
+        /*
+        * Reports are written by the interceptors, so recording one must not
+        * allocate or lock. The raw frames go into a fixed table and are only
+        * symbolised later by getReports().
+        */
+        struct RawReport
+        {
+            Violation type;
+            const char* function;
+            int numFrames;
+            void* frames[48];
+        };
+
+        constexpr int maxStoredReports = 64;
+
+        RawReport rawReports[maxStoredReports];
+        std::atomic<int> numViolations { 0 };
+
+        thread_local int audioThreadDepth = 0;
+        thread_local int allowedDepth = 0;
+        thread_local bool isReporting = false;
+
+        int captureStack(void** frames, int maxFrames) noexcept
+        {
+           #if JUCE_WINDOWS
+            return (int)CaptureStackBackTrace(2, (DWORD)maxFrames, frames, nullptr);
+           #elif JUCE_LINUX || JUCE_MAC
+            return backtrace(frames, maxFrames);
+           #else
+            juce::ignoreUnused(frames, maxFrames);
+            return 0;
+           #endif
+        }
+
+        juce::StringArray symbolise(void* const* frames, int numFrames)
+        {
+            juce::StringArray lines;
+
+           #if JUCE_WINDOWS
+            auto process = GetCurrentProcess();
+            SymInitialize(process, nullptr, TRUE);
+
+            alignas(SYMBOL_INFO) char storage[sizeof(SYMBOL_INFO) + 256];
+            auto* symbol = reinterpret_cast<SYMBOL_INFO*>(storage);
+
+            for (int i = 0; i < numFrames; ++i)
+            {
+                juce::zerostruct(storage);
+                symbol->SizeOfStruct = sizeof(SYMBOL_INFO);
+                symbol->MaxNameLen = 255;
+
+                DWORD64 displacement = 0;
+
+                if (SymFromAddr(process, (DWORD64)frames[i], &displacement, symbol))
+                    lines.add(juce::String(i) + ": " + juce::String(symbol->Name) + " + " + juce::String((juce::int64)displacement));
+                else
+                    lines.add(juce::String(i) + ": " + juce::String::toHexString((juce::pointer_sized_int)frames[i]));
+            }
+           #elif JUCE_LINUX || JUCE_MAC
+            if (auto** symbols = backtrace_symbols(frames, numFrames))
+            {
+                for (int i = 0; i < numFrames; ++i)
+                    lines.add(juce::String(i) + ": " + juce::String(symbols[i]));
+
+                ::free(symbols);
+            }
+           #else
+            juce::ignoreUnused(frames, numFrames);
+           #endif
+
+            return lines;
+        }
+
+        /*
+        * The first backtrace() call loads the unwinder, which allocates.
+        * Do it up front so it never happens inside an interceptor.
+        */
+        struct Primer
+        {
+            Primer()
+            {
+                void* frames[4];
+                captureStack(frames, 4);
+            }
+        };
+
+        Primer primer;
+    }
+
+    void enterAudioThread() noexcept        { ++audioThreadDepth; }
+    void exitAudioThread() noexcept         { --audioThreadDepth; }
+    void enterAllowedSection() noexcept     { ++allowedDepth; }
+    void exitAllowedSection() noexcept      { --allowedDepth; }
+
+    void reportViolation(Violation type, const char* function) noexcept
+    {
+        if (audioThreadDepth == 0 || allowedDepth > 0 || isReporting)
+            return;
+
+        // Anything the capture itself calls must not be reported again
+        isReporting = true;
+
+        auto index = numViolations++;
+
+        if (index < maxStoredReports)
+        {
+            auto& report = rawReports[index];
+            report.type = type;
+            report.function = function;
+            report.numFrames = captureStack(report.frames, (int)juce::numElementsInArray(report.frames));
+        }
+
+        isReporting = false;
+    }
+
+    int getNumViolations() noexcept
+    {
+        return numViolations.load();
+    }
+
+    juce::Array<Report> getReports()
+    {
+        juce::Array<Report> reports;
+
+        for (int i = 0; i < juce::jmin(numViolations.load(), maxStoredReports); ++i)
+        {
+            auto& raw = rawReports[i];
+            reports.add({ raw.type, juce::String(raw.function), symbolise(raw.frames, raw.numFrames) });
+        }
+
+        return reports;
+    }
+
+    void clearReports() noexcept
+    {
+        numViolations = 0;
+    }
+
+    juce::String getInterceptedCalls()
+    {
+       #if JUCE_LINUX
+        return "malloc family, pthread locks and waits, semaphores, sleeps, file and socket I/O";
+       #elif JUCE_WINDOWS && defined (_DEBUG)
+        return "operator new/delete, CRT heap (debug CRT alloc hook)";
+       #else
+        return "operator new/delete";
+       #endif
+    }
+}
+
+using RealtimeSafety::Violation;
+
+//==============================================================================
+#if JUCE_LINUX
+/*
+* On Linux the executable's own definitions win symbol resolution, so defining
+* these here intercepts every caller in the process. Heap calls forward to glibc's
+* internal entry points, everything else to the next definition found by dlsym.
+*/
+extern "C"
+{
+    void* __libc_malloc(size_t);
+    void* __libc_calloc(size_t, size_t);
+    void* __libc_realloc(void*, size_t);
+    void* __libc_memalign(size_t, size_t);
+    void __libc_free(void*);
+
+    void* malloc(size_t size) noexcept
+    {
+        RealtimeSafety::reportViolation(Violation::allocation, "malloc");
+        return __libc_malloc(size);
+    }
+
+    void* calloc(size_t num, size_t size) noexcept
+    {
+        RealtimeSafety::reportViolation(Violation::allocation, "calloc");
+        return __libc_calloc(num, size);
+    }
+
+    void* realloc(void* ptr, size_t size) noexcept
+    {
+        RealtimeSafety::reportViolation(Violation::allocation, "realloc");
+        return __libc_realloc(ptr, size);
+    }
+
+    void* memalign(size_t alignment, size_t size) noexcept
+    {
+        RealtimeSafety::reportViolation(Violation::allocation, "memalign");
+        return __libc_memalign(alignment, size);
+    }
+
+    void* aligned_alloc(size_t alignment, size_t size) noexcept
+    {
+        RealtimeSafety::reportViolation(Violation::allocation, "aligned_alloc");
+        return __libc_memalign(alignment, size);
+    }
+
+    int posix_memalign(void** result, size_t alignment, size_t size) noexcept
+    {
+        RealtimeSafety::reportViolation(Violation::allocation, "posix_memalign");
+
+        if (auto* ptr = __libc_memalign(alignment, size))
+        {
+            *result = ptr;
+            return 0;
+        }
+
+        return ENOMEM;
+    }
+
+    void free(void* ptr) noexcept
+    {
+        if (ptr != nullptr)
+            RealtimeSafety::reportViolation(Violation::deallocation, "free");
+
+        __libc_free(ptr);
+    }
+}
+
+// No function-local statics here: their guards can take a lock, which would come straight back in.
+#define PDLBOARD_FORWARD(name, type, ...) \
+    static void* next_##name = nullptr; \
+    if (next_##name == nullptr) \
+        next_##name = dlsym(RTLD_NEXT, #name); \
+    return reinterpret_cast<type>(next_##name)(__VA_ARGS__);
+
+extern "C"
+{
+    int pthread_mutex_lock(pthread_mutex_t* mutex) noexcept
+    {
+        RealtimeSafety::reportViolation(Violation::lock, "pthread_mutex_lock");
+        PDLBOARD_FORWARD(pthread_mutex_lock, int(*)(pthread_mutex_t*), mutex)
+    }
+
+    int pthread_rwlock_rdlock(pthread_rwlock_t* lock) noexcept
+    {
+        RealtimeSafety::reportViolation(Violation::lock, "pthread_rwlock_rdlock");
+        PDLBOARD_FORWARD(pthread_rwlock_rdlock, int(*)(pthread_rwlock_t*), lock)
+    }
+
+    int pthread_rwlock_wrlock(pthread_rwlock_t* lock) noexcept
+    {
+        RealtimeSafety::reportViolation(Violation::lock, "pthread_rwlock_wrlock");
+        PDLBOARD_FORWARD(pthread_rwlock_wrlock, int(*)(pthread_rwlock_t*), lock)
+    }
+
+    int pthread_cond_wait(pthread_cond_t* condition, pthread_mutex_t* mutex)
+    {
+        RealtimeSafety::reportViolation(Violation::lock, "pthread_cond_wait");
+        PDLBOARD_FORWARD(pthread_cond_wait, int(*)(pthread_cond_t*, pthread_mutex_t*), condition, mutex)
+    }
+
+    int pthread_cond_timedwait(pthread_cond_t* condition, pthread_mutex_t* mutex, const struct timespec* time)
+    {
+        RealtimeSafety::reportViolation(Violation::lock, "pthread_cond_timedwait");
+        PDLBOARD_FORWARD(pthread_cond_timedwait, int(*)(pthread_cond_t*, pthread_mutex_t*, const struct timespec*), condition, mutex, time)
+    }
+
+    int sem_wait(sem_t* semaphore)
+    {
+        RealtimeSafety::reportViolation(Violation::lock, "sem_wait");
+        PDLBOARD_FORWARD(sem_wait, int(*)(sem_t*), semaphore)
+    }
+
+    int nanosleep(const struct timespec* request, struct timespec* remaining)
+    {
+        RealtimeSafety::reportViolation(Violation::blockingCall, "nanosleep");
+        PDLBOARD_FORWARD(nanosleep, int(*)(const struct timespec*, struct timespec*), request, remaining)
+    }
+
+    int usleep(useconds_t microseconds)
+    {
+        RealtimeSafety::reportViolation(Violation::blockingCall, "usleep");
+        PDLBOARD_FORWARD(usleep, int(*)(useconds_t), microseconds)
+    }
+
+    unsigned int sleep(unsigned int seconds)
+    {
+        RealtimeSafety::reportViolation(Violation::blockingCall, "sleep");
+        PDLBOARD_FORWARD(sleep, unsigned int(*)(unsigned int), seconds)
+    }
+
+    ssize_t read(int fd, void* buffer, size_t size)
+    {
+        RealtimeSafety::reportViolation(Violation::blockingCall, "read");
+        PDLBOARD_FORWARD(read, ssize_t(*)(int, void*, size_t), fd, buffer, size)
+    }
+
+    ssize_t write(int fd, const void* buffer, size_t size)
+    {
+        RealtimeSafety::reportViolation(Violation::blockingCall, "write");
+        PDLBOARD_FORWARD(write, ssize_t(*)(int, const void*, size_t), fd, buffer, size)
+    }
+
+    int fsync(int fd)
+    {
+        RealtimeSafety::reportViolation(Violation::blockingCall, "fsync");
+        PDLBOARD_FORWARD(fsync, int(*)(int), fd)
+    }
+
+    int poll(struct pollfd* fds, nfds_t numFds, int timeout)
+    {
+        RealtimeSafety::reportViolation(Violation::blockingCall, "poll");
+        PDLBOARD_FORWARD(poll, int(*)(struct pollfd*, nfds_t, int), fds, numFds, timeout)
+    }
+
+    int select(int numFds, fd_set* readFds, fd_set* writeFds, fd_set* exceptFds, struct timeval* timeout)
+    {
+        RealtimeSafety::reportViolation(Violation::blockingCall, "select");
+        PDLBOARD_FORWARD(select, int(*)(int, fd_set*, fd_set*, fd_set*, struct timeval*), numFds, readFds, writeFds, exceptFds, timeout)
+    }
+
+    ssize_t send(int socket, const void* buffer, size_t size, int flags)
+    {
+        RealtimeSafety::reportViolation(Violation::blockingCall, "send");
+        PDLBOARD_FORWARD(send, ssize_t(*)(int, const void*, size_t, int), socket, buffer, size, flags)
+    }
+
+    ssize_t recv(int socket, void* buffer, size_t size, int flags)
+    {
+        RealtimeSafety::reportViolation(Violation::blockingCall, "recv");
+        PDLBOARD_FORWARD(recv, ssize_t(*)(int, void*, size_t, int), socket, buffer, size, flags)
+    }
+}
+
+#undef PDLBOARD_FORWARD
+
+#else
+//==============================================================================
+/*
+* Elsewhere the C library can't be replaced from inside the executable, so the
+* global allocation operators are replaced instead. That still catches every
+* C++ allocation, which is where nearly all of them come from in JUCE code.
+*/
+void* operator new (size_t size)
+{
+    RealtimeSafety::reportViolation(Violation::allocation, "operator new");
+
+    if (auto* ptr = std::malloc(size == 0 ? 1 : size))
+        return ptr;
+
+    throw std::bad_alloc();
+}
+
+void* operator new[] (size_t size)
+{
+    RealtimeSafety::reportViolation(Violation::allocation, "operator new[]");
+
+    if (auto* ptr = std::malloc(size == 0 ? 1 : size))
+        return ptr;
+
+    throw std::bad_alloc();
+}
+
+void* operator new (size_t size, const std::nothrow_t&) noexcept
+{
+    RealtimeSafety::reportViolation(Violation::allocation, "operator new");
+    return std::malloc(size == 0 ? 1 : size);
+}
+
+void* operator new[] (size_t size, const std::nothrow_t&) noexcept
+{
+    RealtimeSafety::reportViolation(Violation::allocation, "operator new[]");
+    return std::malloc(size == 0 ? 1 : size);
+}
+
+void operator delete (void* ptr) noexcept
+{
+    if (ptr != nullptr)
+        RealtimeSafety::reportViolation(Violation::deallocation, "operator delete");
+
+    std::free(ptr);
+}
+
+void operator delete[] (void* ptr) noexcept
+{
+    if (ptr != nullptr)
+        RealtimeSafety::reportViolation(Violation::deallocation, "operator delete[]");
+
+    std::free(ptr);
+}
+
+void operator delete (void* ptr, size_t) noexcept      { operator delete (ptr); }
+void operator delete[] (void* ptr, size_t) noexcept    { operator delete[] (ptr); }
+
+//==============================================================================
+// The over-aligned forms, which C++17 uses for anything declared with alignas larger than the default
+namespace
+{
+    void* allocateAligned(size_t size, std::align_val_t alignment) noexcept
+    {
+        auto bytes = size == 0 ? 1 : size;
+        auto align = juce::jmax((size_t)alignment, sizeof(void*));
+
+       #if JUCE_WINDOWS
+        return _aligned_malloc(bytes, align);
+       #else
+        void* ptr = nullptr;
+        return posix_memalign(&ptr, align, bytes) == 0 ? ptr : nullptr;
+       #endif
+    }
+
+    void freeAligned(void* ptr) noexcept
+    {
+       #if JUCE_WINDOWS
+        _aligned_free(ptr);
+       #else
+        std::free(ptr);
+       #endif
+    }
+}
+
+void* operator new (size_t size, std::align_val_t alignment)
+{
+    RealtimeSafety::reportViolation(Violation::allocation, "operator new");
+
+    if (auto* ptr = allocateAligned(size, alignment))
+        return ptr;
+
+    throw std::bad_alloc();
+}
+
+void* operator new[] (size_t size, std::align_val_t alignment)
+{
+    RealtimeSafety::reportViolation(Violation::allocation, "operator new[]");
+
+    if (auto* ptr = allocateAligned(size, alignment))
+        return ptr;
+
+    throw std::bad_alloc();
+}
+
+void* operator new (size_t size, std::align_val_t alignment, const std::nothrow_t&) noexcept
+{
+    RealtimeSafety::reportViolation(Violation::allocation, "operator new");
+    return allocateAligned(size, alignment);
+}
+
+void* operator new[] (size_t size, std::align_val_t alignment, const std::nothrow_t&) noexcept
+{
+    RealtimeSafety::reportViolation(Violation::allocation, "operator new[]");
+    return allocateAligned(size, alignment);
+}
+
+void operator delete (void* ptr, std::align_val_t) noexcept
+{
+    if (ptr != nullptr)
+        RealtimeSafety::reportViolation(Violation::deallocation, "operator delete");
+
+    freeAligned(ptr);
+}
+
+void operator delete[] (void* ptr, std::align_val_t) noexcept
+{
+    if (ptr != nullptr)
+        RealtimeSafety::reportViolation(Violation::deallocation, "operator delete[]");
+
+    freeAligned(ptr);
+}
+
+void operator delete (void* ptr, size_t, std::align_val_t alignment) noexcept      { operator delete (ptr, alignment); }
+void operator delete[] (void* ptr, size_t, std::align_val_t alignment) noexcept    { operator delete[] (ptr, alignment); }
+
+#if JUCE_WINDOWS && defined (_DEBUG)
+/*
+* The debug CRT calls this for every heap operation, including plain malloc.
+* Allocations that came through operator new above are reported twice, which
+* doesn't matter for a pass/fail check.
+*/
+namespace
+{
+    int __cdecl crtAllocHook(int allocType, void*, size_t, int blockType, long, const unsigned char*, int)
+    {
+        // Allocations made by the CRT for its own bookkeeping are not ours to report
+        if (blockType != _CRT_BLOCK)
+        {
+            if (allocType == _HOOK_FREE)
+                RealtimeSafety::reportViolation(Violation::deallocation, "free");
+            else
+                RealtimeSafety::reportViolation(Violation::allocation, allocType == _HOOK_REALLOC ? "realloc" : "malloc");
+        }
+
+        return TRUE;
+    }
+
+    struct CrtHookInstaller
+    {
+        CrtHookInstaller()  { _CrtSetAllocHook(crtAllocHook); }
+    };
+
+    CrtHookInstaller crtHookInstaller;
+}
+#endif
+
+#endif
+
+#endif
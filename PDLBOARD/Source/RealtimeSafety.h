@@ -0,0 +1,102 @@
+/*
+  ==============================================================================
+
+    RealtimeSafety.h
+
+  ==============================================================================
+*/
+
+#pragma once
+
+#include <JuceHeader.h>
+
+// Set to 1 in test builds only. It replaces malloc/free and friends for the whole
+// executable, so it must never be switched on in the plugin itself.
+#ifndef PDLBOARD_REALTIME_SAFETY_CHECKS
+ #define PDLBOARD_REALTIME_SAFETY_CHECKS 0
+#endif
+
+/*
+* Detects calls on the audio thread that can block: heap allocation and release,
+* mutex locks and blocking system calls.
+*
+* processBlock marks its thread with a ScopedAudioThread. With the checks switched
+* on, every intercepted call made while that marker is alive is recorded along with
+* its call stack, so a test host can fail when processBlock stops being realtime safe.
+* With the checks off everything here compiles away.
+*
+* What can be intercepted depends on the platform:
+*   Linux    malloc family, pthread mutex/rwlock/condition/semaphore waits, sleeps, file and socket I/O
+*   macOS    operator new/delete
+*   Windows  operator new/delete, plus every CRT heap call in debug builds
+*/
+namespace RealtimeSafety
+{
+    enum class Violation
+    {
+        allocation,
+        deallocation,
+        lock,
+        blockingCall
+    };
+
+    struct Report
+    {
+        Violation type;
+        juce::String function;
+        juce::StringArray stackTrace;
+
+        juce::String toString() const;
+    };
+
+    juce::String toString(Violation type);
+
+   #if PDLBOARD_REALTIME_SAFETY_CHECKS
+    void enterAudioThread() noexcept;
+    void exitAudioThread() noexcept;
+
+    void enterAllowedSection() noexcept;
+    void exitAllowedSection() noexcept;
+
+    // Called by the interceptors. Records the call if the current thread is marked as the audio thread.
+    void reportViolation(Violation type, const char* function) noexcept;
+
+    // Total number of violations since the last clearReports(), including ones too late to be stored.
+    int getNumViolations() noexcept;
+
+    // The first violations with their symbolised call stacks. Call when no audio thread is running.
+    juce::Array<Report> getReports();
+    void clearReports() noexcept;
+
+    // The calls that are intercepted in this build, for the test log.
+    juce::String getInterceptedCalls();
+   #endif
+
+    //==============================================================================
+    // Marks the current thread as the audio thread while in scope.
+    struct ScopedAudioThread
+    {
+       #if PDLBOARD_REALTIME_SAFETY_CHECKS
+        ScopedAudioThread() noexcept    { enterAudioThread(); }
+        ~ScopedAudioThread() noexcept   { exitAudioThread(); }
+       #else
+        ScopedAudioThread() noexcept {}
+       #endif
+
+        JUCE_DECLARE_NON_COPYABLE(ScopedAudioThread)
+    };
+
+    // Lets calls through without a report while in scope, e.g. a host callback
+    // that is known to be outside the plugin's responsibility.
+    struct ScopedAllowNonRealtime
+    {
+       #if PDLBOARD_REALTIME_SAFETY_CHECKS
+        ScopedAllowNonRealtime() noexcept   { enterAllowedSection(); }
+        ~ScopedAllowNonRealtime() noexcept  { exitAllowedSection(); }
+       #else
+        ScopedAllowNonRealtime() noexcept {}
+       #endif
+
+        JUCE_DECLARE_NON_COPYABLE(ScopedAllowNonRealtime)
+    };
+}
@@ -0,0 +1,287 @@
+/*
+  ==============================================================================
+
+    SessionState.cpp
+
+  ==============================================================================
+*/
+
+#include "SessionState.h"
+
+namespace SessionState
+{
+    static const char magic[4] = { 'P', 'D', 'L', 'B' };
+
+    const juce::StringArray& getParameterTable()
+    {
+        // Append only. Moving or removing one would load every older session into the wrong parameters.
+        static const juce::StringArray table {
+            "overdrive", "range", "blend", "volume", "odmode", "odtone", "onoff1",
+            "odbands", "crossover1", "crossover2", "crossover3",
+            "banddrive1", "bandblend1", "bandvolume1", "banddrive2", "bandblend2", "bandvolume2",
+            "banddrive3", "bandblend3", "bandvolume3", "banddrive4", "bandblend4", "bandvolume4",
+            "dry/wet1", "depth", "rate", "offset", "feedback1", "type", "onoff2",
+            "dry/wet2", "feedback2", "delaytime", "onoff3",
+            "cabinet", "dry/wet3", "cablevel", "onoff4",
+            "reverb", "dry/wet4", "onoff5",
+            "fdnsize", "fdndecay", "fdndamping", "fdnmod", "fdnlines", "fdnfreeze", "dry/wet5", "onoff6",
+            "eqlow", "eqmidfreq", "eqmid", "eqmidq", "eqhigh", "eqposition", "onoff7",
+            "gatethreshold", "gatehold", "gaterelease", "onoff8",
+            "tunerref", "tunermute", "onoff9",
+            "wahfreq", "wahrange", "wahq", "wahsens", "wahattack", "wahrelease", "dry/wet6", "onoff10",
+            "chorusvoices",
+            "delaymode", "delaytaps", "tapspacing", "tapdecay", "tapspread", "taptone", "crossfeed"
+        };
+
+        return table;
+    }
+
+    juce::File getDefaultEmbeddedFolder()
+    {
+        return juce::File::getSpecialLocation(juce::File::userApplicationDataDirectory).getChildFile("PDLBOARD").getChildFile("Embedded");
+    }
+
+    //==============================================================================
+    // Bounds checked reads straight out of the host's data, nothing is copied
+    struct Reader
+    {
+        const char* data;
+        size_t size, position = 0;
+        bool failed = false;
+
+        const char* readBytes(size_t numBytes)
+        {
+            if (failed || numBytes > size - position)
+            {
+                failed = true;
+                return nullptr;
+            }
+
+            auto* bytes = data + position;
+            position += numBytes;
+            return bytes;
+        }
+
+        int readInt()
+        {
+            auto* bytes = readBytes(4);
+            return bytes != nullptr ? (int)juce::ByteOrder::littleEndianInt(bytes) : 0;
+        }
+
+        juce::int64 readInt64()
+        {
+            auto* bytes = readBytes(8);
+            return bytes != nullptr ? (juce::int64)juce::ByteOrder::littleEndianInt64(bytes) : 0;
+        }
+
+        float readFloat()
+        {
+            union { juce::uint32 asInt; float asFloat; } value;
+            value.asInt = (juce::uint32)readInt();
+            return value.asFloat;
+        }
+
+        // Points into the data, up to and including the terminator
+        const char* readText()
+        {
+            if (failed)
+                return nullptr;
+
+            auto* end = static_cast<const char*>(std::memchr(data + position, 0, size - position));
+
+            if (end == nullptr)
+            {
+                failed = true;
+                return nullptr;
+            }
+
+            return readBytes((size_t)(end - (data + position)) + 1);
+        }
+    };
+
+    // Named by their contents, so the same file embedded in many sessions is unpacked once
+    static juce::File getEmbeddedFile(const juce::File& folder, const juce::String& originalPath, const void* data, size_t size)
+    {
+        // FNV-1a
+        juce::uint64 hash = 14695981039346656037ull;
+
+        for (size_t i = 0; i < size; ++i)
+            hash = (hash ^ static_cast<const juce::uint8*>(data)[i]) * 1099511628211ull;
+
+        auto original = juce::File::createFileWithoutCheckingPath(originalPath);
+        return folder.getChildFile(original.getFileNameWithoutExtension() + "-" + juce::String::toHexString((juce::int64)hash) + original.getFileExtension());
+    }
+
+    static bool unpack(const char* compressed, int compressedSize, juce::int64 size, juce::MemoryBlock& destData)
+    {
+        juce::MemoryInputStream source(compressed, (size_t)compressedSize, false);
+        juce::GZIPDecompressorInputStream decompressor(source);
+
+        destData.setSize((size_t)size);
+        return decompressor.read(destData.getData(), (int)size) == (int)size;
+    }
+
+    //==============================================================================
+    void write(juce::AudioProcessorValueTreeState& state, juce::MemoryBlock& destData)
+    {
+        juce::MemoryOutputStream stream(destData, false);
+
+        stream.write(magic, sizeof(magic));
+        stream.writeInt(version);
+
+        auto& table = getParameterTable();
+        stream.writeInt(table.size());
+
+        for (auto& id : table)
+        {
+            auto* parameter = state.getParameter(id);
+            stream.writeFloat(parameter != nullptr ? parameter->getValue() : 0.f);
+        }
+
+        auto& properties = state.state;
+        stream.writeInt(properties.getNumProperties());
+
+        for (int i = 0; i < properties.getNumProperties(); ++i)
+        {
+            auto name = properties.getPropertyName(i);
+            stream.writeString(name.toString());
+            stream.writeString(properties[name].toString());
+        }
+
+        // Any property naming a file, when the session asks for them
+        juce::Array<juce::File> files;
+        juce::StringArray fileProperties;
+
+        if ((bool)properties.getProperty(embedFilesProperty, false))
+        {
+            for (int i = 0; i < properties.getNumProperties(); ++i)
+            {
+                auto path = properties[properties.getPropertyName(i)].toString();
+
+                if (! juce::File::isAbsolutePath(path))
+                    continue;
+
+                juce::File file(path);
+
+                if (file.existsAsFile() && file.getSize() <= maximumEmbeddedFileSize)
+                {
+                    files.add(file);
+                    fileProperties.add(properties.getPropertyName(i).toString());
+                }
+            }
+        }
+
+        stream.writeInt(files.size());
+
+        for (int i = 0; i < files.size(); ++i)
+        {
+            juce::MemoryBlock contents, compressed;
+            files[i].loadFileAsData(contents);
+
+            {
+                juce::MemoryOutputStream compressedStream(compressed, false);
+                juce::GZIPCompressorOutputStream compressor(compressedStream, 9);
+                compressor.write(contents.getData(), contents.getSize());
+            }
+
+            stream.writeString(fileProperties[i]);
+            stream.writeInt64((juce::int64)contents.getSize());
+            stream.writeInt((int)compressed.getSize());
+            stream.write(compressed.getData(), compressed.getSize());
+        }
+    }
+
+    bool read(juce::AudioProcessorValueTreeState& state, const void* data, int sizeInBytes, const juce::File& embeddedFolder)
+    {
+        if (data == nullptr || sizeInBytes < (int)sizeof(magic) + 4 || std::memcmp(data, magic, sizeof(magic)) != 0)
+            return false;
+
+        /*
+        * Once to check it's all there, then again to load it, so a session cut
+        * short doesn't leave the processor half loaded.
+        */
+        for (auto apply : { false, true })
+        {
+            Reader reader { static_cast<const char*>(data), (size_t)sizeInBytes };
+            reader.readBytes(sizeof(magic));
+
+            // A newer build's session could have anything in it
+            if (reader.readInt() > version)
+                return false;
+
+            auto& table = getParameterTable();
+            auto numValues = reader.readInt();
+
+            if (numValues < 0)
+                return false;
+
+            for (int i = 0; i < juce::jmax(numValues, table.size()) && ! reader.failed; ++i)
+            {
+                // Parameters newer than the session get their defaults, ones this build doesn't know are skipped
+                auto value = i < numValues ? reader.readFloat() : -1.f;
+                auto* parameter = i < table.size() ? state.getParameter(table[i]) : nullptr;
+
+                if (apply && parameter != nullptr)
+                    parameter->setValueNotifyingHost(value >= 0.f ? juce::jlimit(0.f, 1.f, value) : parameter->getDefaultValue());
+            }
+
+            // The session's properties replace whatever this instance had
+            if (apply)
+                state.state.removeAllProperties(nullptr);
+
+            auto numProperties = reader.readInt();
+
+            for (int i = 0; i < numProperties && ! reader.failed; ++i)
+            {
+                auto* name = reader.readText();
+                auto* value = reader.readText();
+
+                if (apply && name != nullptr && *name != 0 && value != nullptr)
+                    state.state.setProperty(juce::Identifier(juce::CharPointer_UTF8(name)), juce::String(juce::CharPointer_UTF8(value)), nullptr);
+            }
+
+            auto numFiles = reader.readInt();
+
+            for (int i = 0; i < numFiles && ! reader.failed; ++i)
+            {
+                auto* name = reader.readText();
+                auto size = reader.readInt64();
+                auto compressedSize = reader.readInt();
+                auto* compressed = reader.readBytes((size_t)juce::jmax(0, compressedSize));
+
+                if (size < 0 || size > maximumEmbeddedFileSize)
+                    return false;
+
+                // Only needed where the file isn't where it was saved from
+                if (! apply || compressed == nullptr || *name == 0)
+                    continue;
+
+                juce::Identifier property { juce::CharPointer_UTF8(name) };
+                auto path = state.state[property].toString();
+
+                if (juce::File::isAbsolutePath(path) && juce::File(path).existsAsFile())
+                    continue;
+
+                juce::MemoryBlock contents;
+
+                if (! unpack(compressed, compressedSize, size, contents))
+                    continue;
+
+                auto file = getEmbeddedFile(embeddedFolder, path, contents.getData(), contents.getSize());
+
+                if (! file.existsAsFile() || file.getSize() != size)
+                {
+                    embeddedFolder.createDirectory();
+                    file.replaceWithData(contents.getData(), contents.getSize());
+                }
+
+                state.state.setProperty(property, file.getFullPathName(), nullptr);
+            }
+
+            if (reader.failed)
+                return false;
+        }
+
+        return true;
+    }
+}
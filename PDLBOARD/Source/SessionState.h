@@ -0,0 +1,53 @@
+/*
+  ==============================================================================
+
+    SessionState.h
+
+  ==============================================================================
+*/
+
+#pragma once
+
+#include <JuceHeader.h>
+
+/*
+* The processor's state as the host saves it, in a small binary format that
+* loads without going through a ValueTree.
+*
+*   "PDLB", then the version                              4 + 4 bytes
+*   every parameter's normalised value, in table order    4 + 4 per value
+*   the state tree's properties, name then value          4 + null terminated UTF-8
+*   optionally, files the properties point to, gzipped    4 + name, size, data
+*
+* The parameter table is fixed: a value's place in it says which parameter
+* it belongs to, so no IDs are stored. New parameters only ever go on the
+* end, and a session from before one existed gives it its default.
+*
+* A file that a property points to can be embedded, for sessions that move
+* between machines. When the path doesn't exist where the session is loaded,
+* the file is unpacked into embeddedFolder and the property points there.
+*
+* Integers and floats are little-endian.
+*/
+namespace SessionState
+{
+    constexpr int version = 1;
+
+    // Set on the state tree to embed the files
+    constexpr const char* embedFilesProperty = "embedfiles";
+
+    // Bigger files stay where they are
+    constexpr juce::int64 maximumEmbeddedFileSize = 32 * 1024 * 1024;
+
+    // The parameter IDs in table order
+    const juce::StringArray& getParameterTable();
+
+    // In the user's application data folder
+    juce::File getDefaultEmbeddedFolder();
+
+    void write(juce::AudioProcessorValueTreeState& state, juce::MemoryBlock& destData);
+
+    // False, with nothing changed, for data that isn't a whole session in this format
+    bool read(juce::AudioProcessorValueTreeState& state, const void* data, int sizeInBytes,
+               const juce::File& embeddedFolder = getDefaultEmbeddedFolder());
+}
@@ -0,0 +1,113 @@
+/*
+  ==============================================================================
+
+    TubePreamp.cpp
+
+  ==============================================================================
+*/
+
+#include "TubePreamp.h"
+
+namespace
+{
+    // log(1 + e^x) without overflowing, and its derivative, the logistic function
+    double softPlus(double x)      { return x > 30.0 ? x : std::log1p(std::exp(x)); }
+    double logistic(double x)      { return 1.0 / (1.0 + std::exp(-x)); }
+
+    /*
+    * 12AX7, Dempwolf and Zölzer's fitted values. The cathode current follows a
+    * smoothed 3/2 power law in vgk + vak / mu, the grid conducts like a diode
+    * once it goes positive, and the plate gets what's left.
+    */
+    void triode(const double* voltages, double* currents, double* jacobian)
+    {
+        constexpr double G = 2.242e-3, C = 3.40, mu = 103.2, gamma = 1.26;
+        constexpr double Gg = 6.177e-4, Cg = 9.901, xi = 1.314, Ig0 = 8.025e-8;
+
+        auto vgk = voltages[0];
+        auto vak = voltages[1];
+
+        auto s = softPlus(C * (vak / mu + vgk)) / C;
+        auto cathode = G * std::pow(s, gamma);
+        auto dCathode = s > 0.0 ? G * gamma * std::pow(s, gamma - 1.0) * logistic(C * (vak / mu + vgk)) : 0.0;
+
+        auto sg = softPlus(Cg * vgk) / Cg;
+        auto grid = Gg * std::pow(sg, xi) + Ig0;
+        auto dGrid = sg > 0.0 ? Gg * xi * std::pow(sg, xi - 1.0) * logistic(Cg * vgk) : 0.0;
+
+        currents[0] = grid;
+        currents[1] = cathode - grid;
+
+        jacobian[0] = dGrid;
+        jacobian[1] = 0.0;
+        jacobian[2] = dCathode - dGrid;
+        jacobian[3] = dCathode / mu;
+    }
+}
+
+NonlinearStateSpace::Circuit TubePreamp::createStage()
+{
+    enum { ground, input, grid, plate, cathode, supply, output };
+
+    NonlinearStateSpace::Circuit circuit;
+
+    circuit.addInput(input, ground);
+    circuit.addResistor(input, grid, 68.0e3);
+
+    circuit.addSupply(supply, ground, 250.0);
+    circuit.addResistor(supply, plate, 100.0e3);
+
+    circuit.addResistor(cathode, ground, 1.5e3);
+    circuit.addCapacitor(cathode, ground, 22.0e-6);
+
+    // Grid to plate, inside the valve
+    circuit.addCapacitor(grid, plate, 1.7e-12);
+
+    circuit.addCapacitor(plate, output, 22.0e-9);
+    circuit.addResistor(output, ground, 1.0e6);
+
+    circuit.addNonlinearPort(grid, cathode);
+    circuit.addNonlinearPort(plate, cathode);
+    circuit.setNonlinearity(triode);
+    circuit.setOutput(output, ground);
+
+    return circuit;
+}
+
+void TubePreamp::prepare (double sampleRate, int numChannels)
+{
+    if (mModel == nullptr || sampleRate != mSampleRate)
+    {
+        mFirstStages.clear();
+        mSecondStages.clear();
+
+        mModel = std::make_unique<NonlinearStateSpace> (createStage(), sampleRate, maximumInput, 256);
+        mSampleRate = sampleRate;
+    }
+
+    while (mFirstStages.size() < numChannels)
+    {
+        mFirstStages.add(new NonlinearStateSpace::Channel(*mModel));
+        mSecondStages.add(new NonlinearStateSpace::Channel(*mModel));
+    }
+
+    reset();
+}
+
+void TubePreamp::reset() noexcept
+{
+    for (auto* stage : mFirstStages)
+        stage->reset();
+
+    for (auto* stage : mSecondStages)
+        stage->reset();
+}
+
+float TubePreamp::processSample (int channel, float input) noexcept
+{
+    // Each stage inverts, so the pair doesn't
+    auto firstPlate = mFirstStages.getUnchecked(channel)->processSample(input);
+    auto secondPlate = mSecondStages.getUnchecked(channel)->processSample(interstageGain * firstPlate);
+
+    return outputGain * secondPlate;
+}
@@ -0,0 +1,61 @@
+/*
+  ==============================================================================
+
+    TubePreamp.h
+
+  ==============================================================================
+*/
+
+#pragma once
+
+#include <JuceHeader.h>
+#include "NonlinearStateSpace.h"
+
+//==============================================================================
+/**
+    Two 12AX7 common cathode gain stages, the front of most valve amps, solved
+    with NonlinearStateSpace.
+
+    Each stage is a grid stopper into the triode, a 100k plate load off a 250 V
+    supply, a bypassed cathode resistor, and a coupling capacitor into the next
+    stage's 1M grid leak. The grid-plate capacitance is in as well, so the
+    grid and plate ports are coupled both ways, which is the Miller effect
+    rounding off the top as the stage works harder. The triode is Dempwolf and
+    Zölzer's model ("A Physically-Motivated Triode Model for Circuit
+    Simulations", DAFx 2011), grid current included.
+
+    Both stages share one model. The second stage is modelled as if nothing
+    loads the first beyond the 1M it's built with, and there's a fixed divider
+    between them, where an amp would have its gain pot.
+
+    Samples are volts at the first grid.
+*/
+class TubePreamp
+{
+public:
+    TubePreamp() = default;
+
+    // Builds the model for this rate if it hasn't been already, a few hundred milliseconds. Not on the audio thread.
+    void prepare(double sampleRate, int numChannels);
+    void reset() noexcept;
+
+    float processSample(int channel, float input) noexcept;
+
+    // The circuit of one stage, input at node 1, output across the grid leak at node 6
+    static NonlinearStateSpace::Circuit createStage();
+
+    // The loudest the second stage sees, which the model's table has to cover
+    static constexpr double maximumInput = 20.0;
+
+private:
+    // From the first plate to the second grid, and from the second plate to roughly full scale
+    static constexpr float interstageGain = 0.08f;
+    static constexpr float outputGain = 1.f / 90.f;
+
+    std::unique_ptr<NonlinearStateSpace> mModel;
+    double mSampleRate = 0.0;
+
+    juce::OwnedArray<NonlinearStateSpace::Channel> mFirstStages, mSecondStages;
+
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR(TubePreamp)
+};
@@ -0,0 +1,360 @@
+/*
+  ==============================================================================
+
+    WaveDigitalFilter.h
+
+  ==============================================================================
+*/
+
+#pragma once
+
+#include <JuceHeader.h>
+
+/*
+* Wave digital filters, for modelling circuits part by part.
+*
+* Every element is a one-port described by waves rather than by voltage and
+* current: a = v + Ri goes into it, b = v - Ri comes back out, with R the port
+* resistance. Adaptors join ports in series or parallel and have one port of
+* their own facing up the tree, whose resistance is picked so that what it
+* reflects doesn't depend on what comes in. That makes the whole tree explicit,
+* and the one element that can't be adapted, a diode or a source, sits at the
+* root. Each sample the root asks the tree for its reflected wave, works out
+* its own answer and sends it back down.
+*
+* Adaptors are templated on the types of their children and hold them by
+* reference, so a circuit is one nested type that the compiler flattens into
+* straight line code: no virtual calls and no parent pointers. Whoever changes
+* a resistance calls updateImpedance() on the root afterwards, which walks the
+* tree once. Every element is also templated on its sample type.
+*
+* Capacitors use the bilinear transform, so everything here is as accurate as a
+* trapezoidal-rule solve of the same circuit, with no iterations.
+*/
+namespace WDF
+{
+    //==============================================================================
+    /*
+    * The Wright omega function, the w that solves w + log(w) = x. Diodes in a
+    * WDF have a closed form answer in terms of it.
+    *
+    * Above x = -2 this starts from omega3 in D'Angelo, Gabrielli and Turchet,
+    * "Fast Approximation of the Lambert W Function for Virtual Analog
+    * Modelling" (DAFx 2019), a cubic over the knee and x - log(x) past it, then
+    * takes one Newton step on w + log(w) = x. Below it w is close to e^x and the
+    * series e^x - e^2x + ... is used instead, because that's where a diode sits
+    * when it's barely conducting and the paper's own step there is a few
+    * percent out. One exp() or one or two log()s, and the error stays under
+    * 3e-3, a fraction of a millivolt at a diode.
+    */
+    template <typename T>
+    T wrightOmega(T x) noexcept
+    {
+        if (x < (T) -2)
+        {
+            auto z = std::exp(x);
+            return z * ((T) 1 - z * ((T) 1 - z * ((T) 1.5 - z * (T) (8.0 / 3.0))));
+        }
+
+        auto y = x < (T) 8 ? (T) 6.313183464296682e-1 + x * ((T) 3.631952663804445e-1 + x * ((T) 4.775931364975583e-2 + x * (T) -1.314293149877800e-3))
+                           : x - std::log(x);
+
+        return y - (y + std::log(y) - x) * y / (y + (T) 1);
+    }
+
+    //==============================================================================
+    // The waves and resistance every port has
+    template <typename T>
+    struct Port
+    {
+        using SampleType = T;
+
+        T voltage() const noexcept      { return (a + b) * (T) 0.5; }
+        T current() const noexcept      { return (a - b) / (resistance + resistance); }
+
+        T resistance = (T) 1;
+        T a = {}, b = {};
+    };
+
+    //==============================================================================
+    template <typename T>
+    class Resistor : public Port<T>
+    {
+    public:
+        explicit Resistor(T value) noexcept                { this->resistance = value; }
+
+        void setResistance(T value) noexcept               { this->resistance = value; }
+
+        void prepare(double)noexcept {}
+        void reset() noexcept {}
+        void updateImpedance() noexcept {}
+
+        T reflected() noexcept                              { return this->b = {}; }
+        void incident(T wave) noexcept                     { this->a = wave; }
+    };
+
+    //==============================================================================
+    // Bilinear transform, R = T / 2C. What comes back is whatever went in one sample ago.
+    template <typename T>
+    class Capacitor : public Port<T>
+    {
+    public:
+        explicit Capacitor(T value) noexcept : capacitance(value) {}
+
+        void prepare(double sampleRate) noexcept
+        {
+            this->resistance = (T) (1.0 / (2.0 * (double)capacitance * sampleRate));
+        }
+
+        void reset() noexcept                               { state = {}; this->a = {}; this->b = {}; }
+        void updateImpedance() noexcept {}
+
+        T reflected() noexcept                              { return this->b = state; }
+        void incident(T wave) noexcept                     { this->a = wave; state = wave; }
+
+    private:
+        T capacitance;
+        T state = {};
+    };
+
+    //==============================================================================
+    // A voltage source with a resistor in series, e.g. the signal into a circuit
+    template <typename T>
+    class ResistiveVoltageSource : public Port<T>
+    {
+    public:
+        explicit ResistiveVoltageSource(T value) noexcept  { this->resistance = value; }
+
+        void setResistance(T value) noexcept               { this->resistance = value; }
+        void setVoltage(T value) noexcept                  { sourceVoltage = value; }
+
+        void prepare(double)noexcept {}
+        void reset() noexcept                               { sourceVoltage = {}; }
+        void updateImpedance() noexcept {}
+
+        T reflected() noexcept                              { return this->b = sourceVoltage; }
+        void incident(T wave) noexcept                     { this->a = wave; }
+
+    private:
+        T sourceVoltage = {};
+    };
+
+    //==============================================================================
+    // A current source with a resistor across it, e.g. an op-amp pushing current through its feedback network
+    template <typename T>
+    class ResistiveCurrentSource : public Port<T>
+    {
+    public:
+        explicit ResistiveCurrentSource(T value) noexcept  { this->resistance = value; }
+
+        void setResistance(T value) noexcept               { this->resistance = value; }
+        void setCurrent(T value) noexcept                  { sourceCurrent = value; }
+
+        void prepare(double)noexcept {}
+        void reset() noexcept                               { sourceCurrent = {}; }
+        void updateImpedance() noexcept {}
+
+        T reflected() noexcept                              { return this->b = this->resistance * sourceCurrent; }
+        void incident(T wave) noexcept                     { this->a = wave; }
+
+    private:
+        T sourceCurrent = {};
+    };
+
+    //==============================================================================
+    // Two ports in series, adapted upwards: R = R1 + R2
+    template <typename Port1, typename Port2>
+    class Series : public Port<typename Port1::SampleType>
+    {
+    public:
+        using T = typename Port1::SampleType;
+
+        Series(Port1& first, Port2& second) noexcept : port1(first), port2(second) {}
+
+        void prepare(double sampleRate) noexcept           { port1.prepare(sampleRate); port2.prepare(sampleRate); }
+        void reset() noexcept                               { port1.reset(); port2.reset(); }
+
+        void updateImpedance() noexcept
+        {
+            port1.updateImpedance();
+            port2.updateImpedance();
+
+            this->resistance = port1.resistance + port2.resistance;
+            port1Reflection = port1.resistance / this->resistance;
+        }
+
+        T reflected() noexcept
+        {
+            return this->b = -(port1.reflected() + port2.reflected());
+        }
+
+        void incident(T wave) noexcept
+        {
+            // The same current flows through both, so the loop's total voltage is split by resistance
+            auto sum = wave + port1.b + port2.b;
+            auto b1 = port1.b - port1Reflection * sum;
+
+            port1.incident(b1);
+            port2.incident(-(wave + b1));
+            this->a = wave;
+        }
+
+    private:
+        Port1& port1;
+        Port2& port2;
+        T port1Reflection = {};
+    };
+
+    //==============================================================================
+    // Two ports in parallel, adapted upwards: G = G1 + G2
+    template <typename Port1, typename Port2>
+    class Parallel : public Port<typename Port1::SampleType>
+    {
+    public:
+        using T = typename Port1::SampleType;
+
+        Parallel(Port1& first, Port2& second) noexcept : port1(first), port2(second) {}
+
+        void prepare(double sampleRate) noexcept           { port1.prepare(sampleRate); port2.prepare(sampleRate); }
+        void reset() noexcept                               { port1.reset(); port2.reset(); }
+
+        void updateImpedance() noexcept
+        {
+            port1.updateImpedance();
+            port2.updateImpedance();
+
+            auto g1 = (T) 1 / port1.resistance;
+            auto g2 = (T) 1 / port2.resistance;
+
+            this->resistance = (T) 1 / (g1 + g2);
+            port1Share = g1 * this->resistance;
+        }
+
+        T reflected() noexcept
+        {
+            auto b1 = port1.reflected();
+            auto b2 = port2.reflected();
+
+            return this->b = b2 + port1Share * (b1 - b2);
+        }
+
+        void incident(T wave) noexcept
+        {
+            // Both ports see the same voltage, and twice that is the wave in plus the wave that went up
+            auto twiceVoltage = wave + this->b;
+
+            port1.incident(twiceVoltage - port1.b);
+            port2.incident(twiceVoltage - port2.b);
+            this->a = wave;
+        }
+
+    private:
+        Port1& port1;
+        Port2& port2;
+        T port1Share = {};
+    };
+
+    //==============================================================================
+    /*
+    * Roots. Each one owns a tree, and process() runs it for one sample: up
+    * from the leaves, the root's own reflection, and back down again. The
+    * root's a and b are the waves at the top of the tree, so voltage() and
+    * current() are the root element's.
+    */
+
+    // Nothing connected, so no current flows: b = a
+    template <typename Child>
+    class OpenCircuit : public Port<typename Child::SampleType>
+    {
+    public:
+        explicit OpenCircuit(Child& tree) noexcept : child(tree) {}
+
+        void prepare(double sampleRate) noexcept           { child.prepare(sampleRate); updateImpedance(); }
+        void reset() noexcept                               { child.reset(); this->a = {}; this->b = {}; }
+        void updateImpedance() noexcept                     { child.updateImpedance(); this->resistance = child.resistance; }
+
+        void process() noexcept
+        {
+            this->a = child.reflected();
+            this->b = this->a;
+            child.incident(this->b);
+        }
+
+    private:
+        Child& child;
+    };
+
+    // Forces the voltage across the tree, e.g. an op-amp input holding a node at a voltage
+    template <typename Child>
+    class IdealVoltageSource : public Port<typename Child::SampleType>
+    {
+    public:
+        using T = typename Child::SampleType;
+
+        explicit IdealVoltageSource(Child& tree) noexcept : child(tree) {}
+
+        void setVoltage(T value) noexcept                  { sourceVoltage = value; }
+
+        void prepare(double sampleRate) noexcept           { child.prepare(sampleRate); updateImpedance(); }
+        void reset() noexcept                               { child.reset(); sourceVoltage = {}; this->a = {}; this->b = {}; }
+        void updateImpedance() noexcept                     { child.updateImpedance(); this->resistance = child.resistance; }
+
+        void process() noexcept
+        {
+            this->a = child.reflected();
+            this->b = sourceVoltage + sourceVoltage - this->a;
+            child.incident(this->b);
+        }
+
+    private:
+        Child& child;
+        T sourceVoltage = {};
+    };
+
+    /*
+    * Two identical diodes back to back, the usual clipping pair. Solved with
+    * the Wright omega function as in Werner, Nangia, Smith and Abel,
+    * "Resolving Wave Digital Filters with Multiple/Multiport Nonlinearities"
+    * (DAFx 2015), taking only the diode that's conducting into account. The
+    * other one passes at most its saturation current, nanoamps.
+    */
+    template <typename Child>
+    class DiodePair : public Port<typename Child::SampleType>
+    {
+    public:
+        using T = typename Child::SampleType;
+
+        // idealityFactor times the thermal voltage, about 26 mV at room temperature
+        DiodePair(Child& tree, T saturationCurrent, T idealityFactor, T thermalVoltage = (T) 25.85e-3) noexcept
+            : child(tree), Is(saturationCurrent), Vt(idealityFactor * thermalVoltage)
+        {
+        }
+
+        void prepare(double sampleRate) noexcept           { child.prepare(sampleRate); updateImpedance(); }
+        void reset() noexcept                               { child.reset(); this->a = {}; this->b = {}; }
+
+        void updateImpedance() noexcept
+        {
+            child.updateImpedance();
+            this->resistance = child.resistance;
+
+            RIs = this->resistance * Is;
+            omegaOffset = std::log(RIs / Vt) + RIs / Vt;
+        }
+
+        void process() noexcept
+        {
+            auto a = child.reflected();
+            auto sign = a < (T) 0 ? (T) -1 : (T) 1;
+
+            this->a = a;
+            this->b = a + (T) 2 * sign * (RIs - Vt * wrightOmega(omegaOffset + sign * a / Vt));
+            child.incident(this->b);
+        }
+
+    private:
+        Child& child;
+        T Is, Vt;
+        T RIs = {}, omegaOffset = {};
+    };
+}
@@ -0,0 +1,104 @@
+/*
+  ==============================================================================
+
+    HeadlessChain.cpp
+
+  ==============================================================================
+*/
+
+#include "HeadlessChain.h"
+
+HeadlessChain::HeadlessChain (double rate, int blockSize, int channels)
+    : sampleRate(rate), maxBlockSize(blockSize), numChannels(channels)
+{
+    for (auto* parameter : processor.getParameters())
+        if (auto* ranged = dynamic_cast<juce::RangedAudioParameter*>(parameter))
+            parameters[ranged->paramID] = ranged;
+
+    // Nothing here runs against a deadline, so the reverb should wait for its tail rather than drop it
+    processor.setNonRealtime(true);
+    processor.setPlayConfigDetails(numChannels, numChannels, sampleRate, maxBlockSize);
+    processor.prepareToPlay(sampleRate, maxBlockSize);
+}
+
+void HeadlessChain::reset()
+{
+    processor.prepareToPlay(sampleRate, maxBlockSize);
+}
+
+void HeadlessChain::process (float* const* channels, int numSamples)
+{
+    for (int start = 0; start < numSamples; start += maxBlockSize)
+    {
+        auto num = juce::jmin(maxBlockSize, numSamples - start);
+
+        // Refers to the caller's memory, no allocation or copy
+        juce::AudioBuffer<float> block(channels, numChannels, start, num);
+        processor.processBlock(block, midi);
+    }
+}
+
+//==============================================================================
+juce::StringArray HeadlessChain::getParameterIDs() const
+{
+    // In layout order, not map order
+    juce::StringArray ids;
+
+    for (auto* parameter : processor.getParameters())
+        if (auto* ranged = dynamic_cast<juce::RangedAudioParameter*>(parameter))
+            ids.add(ranged->paramID);
+
+    return ids;
+}
+
+bool HeadlessChain::hasParameter (const juce::String& id) const
+{
+    return parameters.find(id) != parameters.end();
+}
+
+juce::RangedAudioParameter& HeadlessChain::getRangedParameter (const juce::String& id) const
+{
+    auto it = parameters.find(id);
+    jassert(it != parameters.end());
+    return *it->second;
+}
+
+float HeadlessChain::getParameter (const juce::String& id) const
+{
+    auto& parameter = getRangedParameter(id);
+    return parameter.convertFrom0to1(parameter.getValue());
+}
+
+void HeadlessChain::setParameter (const juce::String& id, float value)
+{
+    auto& parameter = getRangedParameter(id);
+    parameter.setValueNotifyingHost(parameter.convertTo0to1(value));
+}
+
+float HeadlessChain::getParameterNormalised (const juce::String& id) const
+{
+    return getRangedParameter(id).getValue();
+}
+
+void HeadlessChain::setParameterNormalised (const juce::String& id, float value)
+{
+    getRangedParameter(id).setValueNotifyingHost(juce::jlimit(0.f, 1.f, value));
+}
+
+juce::NormalisableRange<float> HeadlessChain::getParameterRange (const juce::String& id) const
+{
+    return getRangedParameter(id).getNormalisableRange();
+}
+
+//==============================================================================
+juce::MemoryBlock HeadlessChain::getState()
+{
+    juce::MemoryBlock state;
+    processor.getStateInformation(state);
+    return state;
+}
+
+void HeadlessChain::setState (const void* data, int size)
+{
+    processor.setStateInformation(data, size);
+}
@@ -0,0 +1,70 @@
+/*
+  ==============================================================================
+
+    HeadlessChain.h
+
+  ==============================================================================
+*/
+
+#pragma once
+
+#include <JuceHeader.h>
+#include "../../Source/PluginProcessor.h"
+
+//==============================================================================
+/**
+    The PDLBOARD effect chain without a host or an editor.
+
+    Wraps one processor instance so that tools can process caller owned memory
+    in place and read/write parameters by the IDs used in createParameterLayout().
+    One instance must only be used from one thread at a time, use several
+    instances to process in parallel.
+*/
+class HeadlessChain
+{
+public:
+    HeadlessChain(double sampleRate, int maxBlockSize, int numChannels = 2);
+
+    // Clears the delay lines, feedback and LFO.
+    void reset();
+
+    // Processes numSamples samples in place, split into blocks of at most maxBlockSize.
+    // The channel pointers are used directly, nothing is copied.
+    void process(float* const* channels, int numSamples);
+
+    double getSampleRate() const    { return sampleRate; }
+    int getMaxBlockSize() const     { return maxBlockSize; }
+    int getNumChannels() const      { return numChannels; }
+
+    //==============================================================================
+    juce::StringArray getParameterIDs() const;
+    bool hasParameter(const juce::String& id) const;
+
+    // Plain (unnormalised) values, e.g. 0..300 for "range".
+    float getParameter(const juce::String& id) const;
+    void setParameter(const juce::String& id, float value);
+
+    float getParameterNormalised(const juce::String& id) const;
+    void setParameterNormalised(const juce::String& id, float value);
+
+    juce::NormalisableRange<float> getParameterRange(const juce::String& id) const;
+
+    //==============================================================================
+    juce::MemoryBlock getState();
+    void setState(const void* data, int size);
+
+    PDLBOARDAudioProcessor& getProcessor()  { return processor; }
+
+private:
+    juce::RangedAudioParameter& getRangedParameter(const juce::String& id) const;
+
+    PDLBOARDAudioProcessor processor;
+    std::map<juce::String, juce::RangedAudioParameter*> parameters;
+    juce::MidiBuffer midi;
+
+    double sampleRate;
+    int maxBlockSize;
+    int numChannels;
+
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR(HeadlessChain)
+};
@@ -0,0 +1,122 @@
+/*
+  ==============================================================================
+
+    DatasetShard.cpp
+
+  ==============================================================================
+*/
+
+#include "DatasetShard.h"
+
+DatasetShard::DatasetShard (const juce::File& fileToWrite, double rate, int channels, int length,
+                            int parameters, int inputs, int examples)
+    : file(fileToWrite),
+      tempFile(fileToWrite.withFileExtension(".tmp")),
+      sampleRate(rate),
+      numChannels(channels),
+      segmentLength(length),
+      numParameters(parameters),
+      numInputs(inputs),
+      numExamples(examples)
+{
+    tempFile.deleteFile();
+    stream = std::make_unique<juce::FileOutputStream>(tempFile, 1 << 20);
+
+    if (openedOk())
+        writeHeader();
+}
+
+DatasetShard::~DatasetShard()
+{
+    // A shard that was never finished is incomplete, don't leave it around
+    if (stream != nullptr)
+    {
+        stream.reset();
+        tempFile.deleteFile();
+    }
+}
+
+juce::int64 DatasetShard::getExampleStride() const
+{
+    return 2 * sizeof(juce::uint32) + sizeof(float)* ((juce::int64)numParameters + (juce::int64)numChannels * segmentLength);
+}
+
+void DatasetShard::writeHeader()
+{
+    auto inputsOffset = (juce::int64)headerSize;
+    auto examplesOffset = inputsOffset + (juce::int64)sizeof(float)* numInputs * numChannels * segmentLength;
+
+    stream->write("PDLS", 4);
+    stream->writeInt((int)version);
+    stream->writeInt(headerSize);
+    stream->writeInt(juce::roundToInt(sampleRate));
+    stream->writeInt(numChannels);
+    stream->writeInt(segmentLength);
+    stream->writeInt(numParameters);
+    stream->writeInt(numInputs);
+    stream->writeInt(numExamples);
+    stream->writeInt(0);
+    stream->writeInt64(inputsOffset);
+    stream->writeInt64(examplesOffset);
+    stream->writeInt64(getExampleStride());
+
+    jassert(stream->getPosition() == headerSize);
+}
+
+void DatasetShard::writeFloats (const float* data, int num)
+{
+   #if JUCE_LITTLE_ENDIAN
+    stream->write(data, sizeof(float)* (size_t)num);
+   #else
+    for (int i = 0; i < num; ++i)
+        stream->writeFloat(data[i]);
+   #endif
+}
+
+void DatasetShard::writeInput (const juce::AudioBuffer<float>& input)
+{
+    jassert(examplesWritten == 0 && inputsWritten < numInputs);
+    jassert(input.getNumChannels() == numChannels && input.getNumSamples() == segmentLength);
+
+    for (int channel = 0; channel < numChannels; ++channel)
+        writeFloats(input.getReadPointer(channel), segmentLength);
+
+    ++inputsWritten;
+}
+
+void DatasetShard::writeExample (int inputIndex, juce::uint32 parameterSeed, const float* parameters,
+                                 const juce::AudioBuffer<float>& output)
+{
+    jassert(inputsWritten == numInputs && examplesWritten < numExamples);
+    jassert(output.getNumChannels() == numChannels && output.getNumSamples() >= segmentLength);
+
+    stream->writeInt(inputIndex);
+    stream->writeInt((int)parameterSeed);
+    writeFloats(parameters, numParameters);
+
+    for (int channel = 0; channel < numChannels; ++channel)
+        writeFloats(output.getReadPointer(channel), segmentLength);
+
+    ++examplesWritten;
+}
+
+bool DatasetShard::finish()
+{
+    if (! openedOk() || inputsWritten != numInputs || examplesWritten != numExamples)
+        return false;
+
+    stream->flush();
+    auto ok = stream->getStatus().wasOk();
+    stream.reset();
+
+    if (ok)
+    {
+        file.deleteFile();
+        ok = tempFile.moveFileTo(file);
+    }
+
+    if (! ok)
+        tempFile.deleteFile();
+
+    return ok;
+}
@@ -0,0 +1,71 @@
+/*
+  ==============================================================================
+
+    DatasetShard.h
+
+  ==============================================================================
+*/
+
+#pragma once
+
+#include <JuceHeader.h>
+
+//==============================================================================
+/**
+    Writes one shard of the dataset.
+
+    A shard is a flat little-endian file that can be memory-mapped and indexed
+    without parsing anything but the header:
+
+        header       64 bytes, see below
+        inputs       numInputs x numChannels x segmentLength float32
+        examples     numExamples x exampleStride bytes, each one being
+                         uint32  inputIndex      (into this shard's inputs)
+                         uint32  parameterSeed   (low 32 bits of the global example index)
+                         float32 parameters[numParameters]   (normalised 0..1, processor order)
+                         float32 output[numChannels][segmentLength]
+
+    Header fields (all uint32 unless noted):
+        'PDLS', version, headerSize, sampleRate, numChannels, segmentLength,
+        numParameters, numInputs, numExamples, reserved,
+        uint64 inputsOffset, uint64 examplesOffset, uint64 exampleStride
+
+    Each input is stored once and shared by all the examples rendered from it.
+    The shard is written to a temporary file and only renamed into place once
+    complete, so an interrupted run never leaves a truncated shard behind.
+*/
+class DatasetShard
+{
+public:
+    static constexpr juce::uint32 version = 1;
+    static constexpr int headerSize = 64;
+
+    DatasetShard(const juce::File& file, double sampleRate, int numChannels, int segmentLength,
+                  int numParameters, int numInputs, int numExamples);
+    ~DatasetShard();
+
+    bool openedOk() const   { return stream != nullptr && stream->openedOk(); }
+
+    // Inputs must all be written before the first example.
+    void writeInput(const juce::AudioBuffer<float>& input);
+    void writeExample(int inputIndex, juce::uint32 parameterSeed, const float* parameters,
+                       const juce::AudioBuffer<float>& output);
+
+    // Renames the finished shard into place. Returns false if anything went wrong.
+    bool finish();
+
+    juce::int64 getExampleStride() const;
+
+private:
+    void writeHeader();
+    void writeFloats(const float* data, int num);
+
+    juce::File file, tempFile;
+    std::unique_ptr<juce::FileOutputStream> stream;
+
+    double sampleRate;
+    int numChannels, segmentLength, numParameters, numInputs, numExamples;
+    int inputsWritten = 0, examplesWritten = 0;
+
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR(DatasetShard)
+};
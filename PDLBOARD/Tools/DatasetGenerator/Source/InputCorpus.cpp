@@ -0,0 +1,106 @@
+/*
+  ==============================================================================
+
+    InputCorpus.cpp
+
+  ==============================================================================
+*/
+
+#include "InputCorpus.h"
+
+InputCorpus::InputCorpus (double rate, int length, int channels)
+    : sampleRate(rate), segmentLength(length), numChannels(channels)
+{
+    formatManager.registerBasicFormats();
+}
+
+int InputCorpus::addInput (const juce::File& fileOrDirectory)
+{
+    if (! fileOrDirectory.isDirectory())
+        return addFile(fileOrDirectory) ? 1 : 0;
+
+    // Sort so that the segment order (and therefore the dataset) is reproducible
+    auto found = fileOrDirectory.findChildFiles(juce::File::findFiles, true, formatManager.getWildcardForAllFormats());
+    found.sort();
+
+    int numAdded = 0;
+
+    for (auto& file : found)
+        if (addFile(file))
+            ++numAdded;
+
+    return numAdded;
+}
+
+bool InputCorpus::addFile (const juce::File& file)
+{
+    std::unique_ptr<juce::AudioFormatReader> reader(formatManager.createReaderFor(file));
+
+    if (reader == nullptr || reader->sampleRate <= 0)
+        return false;
+
+    auto fileIndex = files.size();
+    files.add(file);
+    fileSampleRates.add(reader->sampleRate);
+
+    // Length of one segment measured at the file's own sample rate
+    auto ratio = reader->sampleRate / sampleRate;
+    auto sourceSegmentLength = (juce::int64)std::ceil(segmentLength * ratio);
+
+    // Leave a few samples spare at the end for the resampler
+    for (juce::int64 start = 0; start + sourceSegmentLength + 4 <= reader->lengthInSamples; start += sourceSegmentLength)
+        segments.add({ fileIndex, start });
+
+    return true;
+}
+
+bool InputCorpus::decode (int first, int num, juce::OwnedArray<juce::AudioBuffer<float>>& destination) const
+{
+    std::unique_ptr<juce::AudioFormatReader> reader;
+    int readerFileIndex = -1;
+
+    juce::AudioBuffer<float> source;
+
+    for (int s = first; s < first + num; ++s)
+    {
+        auto& segment = segments.getReference(s);
+
+        // Segments of one file are contiguous, so a reader is only opened once per file per batch
+        if (segment.fileIndex != readerFileIndex)
+        {
+            reader.reset(formatManager.createReaderFor(files.getReference(segment.fileIndex)));
+            readerFileIndex = segment.fileIndex;
+
+            if (reader == nullptr)
+                return false;
+        }
+
+        auto ratio = fileSampleRates[segment.fileIndex] / sampleRate;
+        auto sourceLength = (int)std::ceil(segmentLength * ratio) + 4;
+        auto sourceChannels = juce::jmax(1, (int)reader->numChannels);
+
+        source.setSize(sourceChannels, sourceLength, false, false, true);
+        reader->read(&source, 0, sourceLength, segment.sourceStart, true, true);
+
+        auto* output = destination.add(new juce::AudioBuffer<float>(numChannels, segmentLength));
+
+        for (int channel = 0; channel < numChannels; ++channel)
+        {
+            // Mono inputs are copied to every channel, extra input channels are dropped
+            auto* in = source.getReadPointer(juce::jmin(channel, sourceChannels - 1));
+            auto* out = output->getWritePointer(channel);
+
+            if (ratio == 1.0)
+            {
+                juce::FloatVectorOperations::copy(out, in, segmentLength);
+            }
+            else
+            {
+                juce::LagrangeInterpolator interpolator;
+                interpolator.process(ratio, in, out, segmentLength);
+            }
+        }
+    }
+
+    return true;
+}
@@ -0,0 +1,61 @@
+/*
+  ==============================================================================
+
+    InputCorpus.h
+
+  ==============================================================================
+*/
+
+#pragma once
+
+#include <JuceHeader.h>
+
+//==============================================================================
+/**
+    The set of input recordings, cut into fixed length segments.
+
+    Scanning only opens each file to read its length, nothing is decoded until
+    a worker asks for a segment. Every segment is decoded (and resampled to the
+    render rate if needed) exactly once and then reused for every parameter set
+    rendered from it.
+*/
+class InputCorpus
+{
+public:
+    struct Segment
+    {
+        int fileIndex = 0;
+        juce::int64 sourceStart = 0;    // in samples at the file's own rate
+    };
+
+    InputCorpus(double sampleRate, int segmentLength, int numChannels);
+
+    // Adds a file, or every audio file below a directory. Returns the number of files added.
+    int addInput(const juce::File& fileOrDirectory);
+
+    const juce::Array<Segment>& getSegments() const     { return segments; }
+    const juce::File& getFile(int fileIndex) const     { return files.getReference(fileIndex); }
+
+    int getSegmentLength() const    { return segmentLength; }
+    int getNumChannels() const      { return numChannels; }
+
+    // Decodes segments [first, first + num) into destination, one segment per entry.
+    // Safe to call from several threads at once.
+    bool decode(int first, int num, juce::OwnedArray<juce::AudioBuffer<float>>& destination) const;
+
+private:
+    bool addFile(const juce::File& file);
+
+    // Only the format list is shared between threads, each decode opens its own reader
+    mutable juce::AudioFormatManager formatManager;
+
+    double sampleRate;
+    int segmentLength;
+    int numChannels;
+
+    juce::Array<juce::File> files;
+    juce::Array<double> fileSampleRates;
+    juce::Array<Segment> segments;
+
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR(InputCorpus)
+};
@@ -0,0 +1,413 @@
+/*
+  ==============================================================================
+
+    Main.cpp
+
+    Renders (input, parameters, output) training examples from the PDLBOARD
+    effect chain. See printUsage() for the command line.
+
+  ==============================================================================
+*/
+
+#include <JuceHeader.h>
+#include "../../../Source/PluginProcessor.h"
+#include "ParameterSampler.h"
+#include "InputCorpus.h"
+#include "DatasetShard.h"
+
+namespace
+{
+    struct Settings
+    {
+        juce::Array<juce::File> inputs;
+        juce::File outputFolder;
+        juce::File distributionFile;
+
+        double sampleRate = 48000.0;
+        int blockSize = 512;
+        double segmentSeconds = 2.0;
+        int parameterSetsPerInput = 16;
+        int segmentsPerShard = 64;
+        juce::int64 maxExamples = -1;
+        juce::int64 seed = 1;
+        int numThreads = juce::SystemStats::getNumCpus();
+    };
+
+    void printUsage()
+    {
+        std::cout << "DatasetGenerator --input <file or folder> [--input ...] --output <folder>" << std::endl
+                  << "    [--distribution <json>]   per-parameter distributions, see ParameterSampler.h" << std::endl
+                  << "    [--examples <n>]          stop after n examples (default: whole corpus)" << std::endl
+                  << "    [--params-per-input <n>]  parameter sets rendered per decoded segment (16)" << std::endl
+                  << "    [--segment <seconds>]     segment length (2.0)" << std::endl
+                  << "    [--shard-size <n>]        input segments per shard (64)" << std::endl
+                  << "    [--rate <hz>]             render sample rate (48000)" << std::endl
+                  << "    [--block <n>]             processBlock size (512)" << std::endl
+                  << "    [--seed <n>]              random seed (1)" << std::endl
+                  << "    [--threads <n>]           worker threads (all cores)" << std::endl;
+    }
+
+    bool parseSettings(const juce::ArgumentList& args, Settings& settings)
+    {
+        for (int i = 0; i < args.size() - 1; ++i)
+            if (args[i] == "--input")
+                settings.inputs.add(args[i + 1].resolveAsFile());
+
+        if (settings.inputs.isEmpty() || ! args.containsOption("--output"))
+            return false;
+
+        settings.outputFolder = juce::File::getCurrentWorkingDirectory().getChildFile(args.getValueForOption("--output"));
+
+        if (args.containsOption("--distribution"))
+            settings.distributionFile = args.getExistingFileForOption("--distribution");
+
+        auto intOption = [&args] (const char* option, juce::int64 fallback)
+        {
+            return args.containsOption(option) ? args.getValueForOption(option).getLargeIntValue() : fallback;
+        };
+
+        settings.maxExamples           = intOption("--examples", settings.maxExamples);
+        settings.parameterSetsPerInput = (int)juce::jmax((juce::int64)1, intOption("--params-per-input", settings.parameterSetsPerInput));
+        settings.segmentsPerShard      = (int)juce::jmax((juce::int64)1, intOption("--shard-size", settings.segmentsPerShard));
+        settings.blockSize             = (int)juce::jmax((juce::int64)1, intOption("--block", settings.blockSize));
+        settings.seed                  = intOption("--seed", settings.seed);
+        settings.numThreads            = (int)juce::jmax((juce::int64)1, intOption("--threads", settings.numThreads));
+
+        if (args.containsOption("--rate"))
+            settings.sampleRate = args.getValueForOption("--rate").getDoubleValue();
+
+        if (args.containsOption("--segment"))
+            settings.segmentSeconds = args.getValueForOption("--segment").getDoubleValue();
+
+        return settings.sampleRate > 0 && settings.segmentSeconds > 0;
+    }
+
+    //==============================================================================
+    /*
+    * Shared state of one generator run. Batches of segments are handed out
+    * through an atomic counter, every batch becomes one shard.
+    */
+    struct Job
+    {
+        const Settings& settings;
+        const InputCorpus& corpus;
+        const ParameterSampler& sampler;
+
+        int numSegments = 0;
+        juce::int64 totalExamples = 0;
+        int numBatches = 0;
+        int numChannels = 2;
+
+        std::atomic<int> nextBatch { 0 };
+        std::atomic<juce::int64> examplesDone { 0 };
+        std::atomic<bool> failed { false };
+
+        juce::CriticalSection lock;
+        std::map<int, juce::var> shardIndex;
+    };
+
+    //==============================================================================
+    /*
+    * One worker per core, each with its own processor instance so that the
+    * renders never share any DSP state.
+    */
+    class RenderWorker : public juce::Thread
+    {
+    public:
+        RenderWorker(Job& jobToUse, int index)
+            : juce::Thread("Render worker " + juce::String(index)), job(jobToUse)
+        {
+            processor = std::make_unique<PDLBOARDAudioProcessor>();
+            processor->setNonRealtime(true);
+            processor->setPlayConfigDetails(job.numChannels, job.numChannels, job.settings.sampleRate, job.settings.blockSize);
+            processor->prepareToPlay(job.settings.sampleRate, job.settings.blockSize);
+
+            parameters.resize((size_t)job.sampler.getNumParameters());
+            output.setSize(job.numChannels, job.corpus.getSegmentLength());
+        }
+
+        void run() override
+        {
+            for (;;)
+            {
+                auto batch = job.nextBatch++;
+
+                if (batch >= job.numBatches || job.failed || threadShouldExit())
+                    return;
+
+                if (! renderBatch(batch))
+                {
+                    job.failed = true;
+                    return;
+                }
+            }
+        }
+
+    private:
+        bool renderBatch(int batch)
+        {
+            auto& settings = job.settings;
+            auto first = batch * settings.segmentsPerShard;
+            auto num = juce::jmin(settings.segmentsPerShard, job.numSegments - first);
+            auto perInput = settings.parameterSetsPerInput;
+
+            // The last shard of an --examples run may stop part way through a segment's parameter sets
+            auto numExamplesFor = [&](int segment)
+            {
+                auto remaining = job.totalExamples - (juce::int64)segment * perInput;
+                return (int)juce::jlimit((juce::int64)0, (juce::int64)perInput, remaining);
+            };
+
+            auto numExamples = 0;
+
+            for (int s = first; s < first + num; ++s)
+                numExamples += numExamplesFor(s);
+
+            // Decode every input of the shard exactly once
+            juce::OwnedArray<juce::AudioBuffer<float>> inputs;
+
+            if (! job.corpus.decode(first, num, inputs))
+            {
+                std::cerr << "Failed to decode segments " << first << " to " << first + num << std::endl;
+                return false;
+            }
+
+            auto fileName = "shard_" + juce::String(batch).paddedLeft('0', 5) + ".bin";
+            DatasetShard shard(settings.outputFolder.getChildFile(fileName), settings.sampleRate, job.numChannels,
+                                job.corpus.getSegmentLength(), (int)parameters.size(), num, numExamples);
+
+            if (! shard.openedOk())
+            {
+                std::cerr << "Can't write " << fileName << std::endl;
+                return false;
+            }
+
+            for (auto* input : inputs)
+                shard.writeInput(*input);
+
+            // ... and reuse it for every parameter set rendered from it
+            for (int s = 0; s < num; ++s)
+            {
+                auto numForSegment = numExamplesFor(first + s);
+
+                for (int k = 0; k < numForSegment; ++k)
+                {
+                    auto exampleIndex = (juce::int64)(first + s) * perInput + k;
+
+                    // Seeded per example, so the dataset doesn't depend on the number of threads
+                    juce::Random random(settings.seed * 0x5DEECE66DLL + exampleIndex);
+                    job.sampler.sample(random, parameters.data());
+
+                    render(*inputs[s], parameters.data());
+                    shard.writeExample(s, (juce::uint32)exampleIndex, parameters.data(), output);
+                }
+
+                job.examplesDone += numForSegment;
+            }
+
+            if (! shard.finish())
+            {
+                std::cerr << "Failed to finish " << fileName << std::endl;
+                return false;
+            }
+
+            auto* entry = new juce::DynamicObject();
+            entry->setProperty("file", fileName);
+            entry->setProperty("numInputs", num);
+            entry->setProperty("numExamples", numExamples);
+            entry->setProperty("firstExample", (juce::int64)first * perInput);
+
+            juce::Array<juce::var> sources;
+
+            for (int s = first; s < first + num; ++s)
+            {
+                auto& segment = job.corpus.getSegments().getReference(s);
+                auto* source = new juce::DynamicObject();
+                source->setProperty("file", job.corpus.getFile(segment.fileIndex).getFullPathName());
+                source->setProperty("start", segment.sourceStart);
+                sources.add(juce::var(source));
+            }
+
+            entry->setProperty("sources", sources);
+
+            const juce::ScopedLock sl(job.lock);
+            job.shardIndex[batch] = juce::var(entry);
+            return true;
+        }
+
+        void render(const juce::AudioBuffer<float>& input, const float* normalisedParameters)
+        {
+            ParameterSampler::apply(normalisedParameters, *processor);
+
+            // Re-preparing clears the delay lines, feedback and LFO so every example starts from silence
+            processor->prepareToPlay(job.settings.sampleRate, job.settings.blockSize);
+
+            // The IR, reverb and model loaders have their own threads, and whatever they were asked for goes in with the next prepare
+            if (isLoading())
+            {
+                while (isLoading())
+                    juce::Thread::sleep(1);
+
+                processor->prepareToPlay(job.settings.sampleRate, job.settings.blockSize);
+            }
+
+            output.makeCopyOf(input, true);
+
+            auto numSamples = output.getNumSamples();
+
+            for (int start = 0; start < numSamples; start += job.settings.blockSize)
+            {
+                auto num = juce::jmin(job.settings.blockSize, numSamples - start);
+                juce::AudioBuffer<float> block(output.getArrayOfWritePointers(), job.numChannels, start, num);
+                processor->processBlock(block, midi);
+            }
+        }
+
+        bool isLoading() const
+        {
+            return processor->getAmpModel().isLoading() || processor->getCabinet().isLoading() || processor->getReverb().isLoading();
+        }
+
+        Job& job;
+        std::unique_ptr<PDLBOARDAudioProcessor> processor;
+        std::vector<float> parameters;
+        juce::AudioBuffer<float> output;
+        juce::MidiBuffer midi;
+    };
+
+    bool writeIndex(const Job& job, const juce::File& indexFile)
+    {
+        auto* layout = new juce::DynamicObject();
+        layout->setProperty("byteOrder", "little");
+        layout->setProperty("headerSize", DatasetShard::headerSize);
+        layout->setProperty("inputs", "float32[numInputs][numChannels][segmentLength]");
+        layout->setProperty("example", "uint32 inputIndex, uint32 parameterSeed, float32[numParameters] parameters, float32[numChannels][segmentLength] output");
+
+        juce::Array<juce::var> shards;
+        juce::int64 totalExamples = 0;
+
+        for (auto& entry : job.shardIndex)
+        {
+            shards.add(entry.second);
+            totalExamples += (juce::int64)entry.second["numExamples"];
+        }
+
+        auto* index = new juce::DynamicObject();
+        index->setProperty("format", "PDLS");
+        index->setProperty("version", (int)DatasetShard::version);
+        index->setProperty("sampleRate", job.settings.sampleRate);
+        index->setProperty("numChannels", job.numChannels);
+        index->setProperty("segmentLength", job.corpus.getSegmentLength());
+        index->setProperty("blockSize", job.settings.blockSize);
+        index->setProperty("seed", job.settings.seed);
+        index->setProperty("numExamples", totalExamples);
+        index->setProperty("parameters", job.sampler.toVar());
+        index->setProperty("layout", juce::var(layout));
+        index->setProperty("shards", shards);
+
+        return indexFile.replaceWithText(juce::JSON::toString(juce::var(index)));
+    }
+}
+
+//==============================================================================
+int main(int argc, char* argv[])
+{
+    juce::ScopedJuceInitialiser_GUI juceInitialiser;
+
+    juce::ArgumentList args(argc, argv);
+    Settings settings;
+
+    if (! parseSettings(args, settings))
+    {
+        printUsage();
+        return 1;
+    }
+
+    // The processor reads both channels, so mono material is rendered as dual mono
+    const int numChannels = 2;
+
+    InputCorpus corpus(settings.sampleRate, juce::roundToInt(settings.segmentSeconds * settings.sampleRate), numChannels);
+
+    for (auto& input : settings.inputs)
+        if (corpus.addInput(input) == 0)
+            std::cerr << "No readable audio in " << input.getFullPathName() << std::endl;
+
+    if (corpus.getSegments().isEmpty())
+    {
+        std::cerr << "The input corpus is empty" << std::endl;
+        return 1;
+    }
+
+    // The distribution is defined over the same layout the plugin builds in createParameterLayout()
+    PDLBOARDAudioProcessor layoutSource;
+    ParameterSampler sampler(layoutSource.getParameters());
+
+    if (settings.distributionFile != juce::File())
+    {
+        auto result = sampler.loadDistribution(settings.distributionFile);
+
+        if (result.failed())
+        {
+            std::cerr << result.getErrorMessage() << std::endl;
+            return 1;
+        }
+    }
+
+    if (! settings.outputFolder.createDirectory())
+    {
+        std::cerr << "Can't create " << settings.outputFolder.getFullPathName() << std::endl;
+        return 1;
+    }
+
+    Job job { settings, corpus, sampler };
+    job.numChannels = numChannels;
+    job.numSegments = corpus.getSegments().size();
+
+    if (settings.maxExamples > 0)
+        job.numSegments = (int)juce::jmin((juce::int64)job.numSegments,
+                                          (settings.maxExamples + settings.parameterSetsPerInput - 1) / settings.parameterSetsPerInput);
+
+    job.numBatches = (job.numSegments + settings.segmentsPerShard - 1) / settings.segmentsPerShard;
+
+    job.totalExamples = (juce::int64)job.numSegments * settings.parameterSetsPerInput;
+
+    if (settings.maxExamples > 0)
+        job.totalExamples = juce::jmin(job.totalExamples, settings.maxExamples);
+
+    auto totalExamples = job.totalExamples;
+    std::cout << "Rendering " << totalExamples << " examples from " << job.numSegments << " segments into "
+              << job.numBatches << " shards on " << settings.numThreads << " threads" << std::endl;
+
+    juce::OwnedArray<RenderWorker> workers;
+
+    for (int i = 0; i < juce::jmin(settings.numThreads, job.numBatches); ++i)
+        workers.add(new RenderWorker(job, i));
+
+    auto startTime = juce::Time::getMillisecondCounterHiRes();
+
+    for (auto* worker : workers)
+        worker->startThread();
+
+    while (std::any_of(workers.begin(), workers.end(), [](RenderWorker* w) { return w->isThreadRunning(); }))
+    {
+        juce::Thread::sleep(1000);
+
+        auto done = job.examplesDone.load();
+        auto seconds = (juce::Time::getMillisecondCounterHiRes() - startTime) / 1000.0;
+        std::cout << "\r" << done << " / " << totalExamples << " examples, "
+                  << juce::String(done / juce::jmax(seconds, 0.001), 1) << " per second" << std::flush;
+    }
+
+    std::cout << std::endl;
+
+    if (job.failed)
+        return 1;
+
+    if (! writeIndex(job, settings.outputFolder.getChildFile("index.json")))
+    {
+        std::cerr << "Failed to write the index" << std::endl;
+        return 1;
+    }
+
+    return 0;
+}
@@ -0,0 +1,239 @@
+/*
+  ==============================================================================
+
+    ParameterSampler.cpp
+
+  ==============================================================================
+*/
+
+#include "ParameterSampler.h"
+
+ParameterSampler::ParameterSampler (const juce::Array<juce::AudioProcessorParameter*>& parameters)
+{
+    for (auto* parameter : parameters)
+    {
+        auto* ranged = dynamic_cast<juce::RangedAudioParameter*>(parameter);
+        jassert(ranged);
+
+        Entry entry;
+        entry.id = ranged->paramID;
+        entry.name = ranged->getName(64);
+        entry.range = ranged->getNormalisableRange();
+        entry.defaultValue = entry.range.convertFrom0to1(ranged->getDefaultValue());
+
+        if (dynamic_cast<juce::AudioParameterBool*>(ranged) != nullptr)
+        {
+            entry.isBoolean = true;
+            entry.type = Type::bernoulli;
+            entry.a = 0.5f;
+
+            // The gate and the tuner (and its mute) would only give silent or chopped up examples
+            if (entry.id == "onoff8" || entry.id == "onoff9" || entry.id == "tunermute")
+            {
+                entry.type = Type::fixed;
+                entry.a = 0.f;
+            }
+        }
+        else if (auto* choice = dynamic_cast<juce::AudioParameterChoice*>(ranged))
+        {
+            entry.numChoices = choice->choices.size();
+            entry.type = Type::choice;
+
+            // Nothing is ever loaded here, so a user IR or a neural model would just be the fallback under another label
+            if (choice->choices.contains("User IR") || choice->choices.contains("Neural Model"))
+                for (auto& name : choice->choices)
+                    entry.weights.add(name == "User IR" || name == "Neural Model" ? 0.f : 1.f);
+        }
+        else
+        {
+            entry.a = entry.range.start;
+            entry.b = entry.range.end;
+        }
+
+        entries.add(entry);
+    }
+}
+
+juce::Result ParameterSampler::loadDistribution (const juce::File& jsonFile)
+{
+    /*
+    * Overrides the default distributions with the ones given in the file.
+    * Unknown IDs are an error so that typos don't silently fall back to uniform.
+    */
+
+    auto json = juce::JSON::parse(jsonFile);
+
+    if (! json.isObject())
+        return juce::Result::fail("Distribution file is not a JSON object: " + jsonFile.getFullPathName());
+
+    for (auto& property : json.getDynamicObject()->getProperties())
+    {
+        auto id = property.name.toString();
+        auto& spec = property.value;
+
+        auto* entry = std::find_if(entries.begin(), entries.end(), [&id](const Entry& e) { return e.id == id; });
+
+        if (entry == entries.end())
+            return juce::Result::fail("Unknown parameter ID in distribution: " + id);
+
+        auto type = spec.getProperty("type", "uniform").toString();
+
+        if (type == "uniform" || type == "loguniform")
+        {
+            entry->type = type == "uniform" ? Type::uniform : Type::logUniform;
+            entry->a = juce::jlimit(entry->range.start, entry->range.end, (float)spec.getProperty("min", entry->range.start));
+            entry->b = juce::jlimit(entry->range.start, entry->range.end, (float)spec.getProperty("max", entry->range.end));
+
+            if (entry->type == Type::logUniform && entry->a <= 0.f)
+                return juce::Result::fail("loguniform needs a positive minimum for " + id);
+        }
+        else if (type == "normal")
+        {
+            entry->type = Type::normal;
+            entry->a = spec.getProperty("mean", entry->defaultValue);
+            entry->b = spec.getProperty("sd", 0.1f * (entry->range.end - entry->range.start));
+        }
+        else if (type == "fixed")
+        {
+            entry->type = Type::fixed;
+            entry->a = spec.getProperty("value", entry->defaultValue);
+        }
+        else if (type == "bernoulli")
+        {
+            entry->type = Type::bernoulli;
+            entry->a = juce::jlimit(0.f, 1.f, (float)spec.getProperty("p", 0.5f));
+        }
+        else if (type == "choice")
+        {
+            entry->type = Type::choice;
+            entry->weights.clear();
+
+            auto weightsVar = spec.getProperty("weights", {});
+
+            if (auto* weights = weightsVar.getArray())
+                for (auto& w : *weights)
+                    entry->weights.add(juce::jmax(0.f, (float)w));
+        }
+        else
+        {
+            return juce::Result::fail("Unknown distribution type '" + type + "' for " + id);
+        }
+    }
+
+    return juce::Result::ok();
+}
+
+float ParameterSampler::samplePlainValue (const Entry& entry, juce::Random& random) const
+{
+    switch (entry.type)
+    {
+        case Type::uniform:
+            return entry.a + random.nextFloat() * (entry.b - entry.a);
+
+        case Type::logUniform:
+            return std::exp(std::log(entry.a) + random.nextFloat() * (std::log(entry.b) - std::log(entry.a)));
+
+        case Type::normal:
+        {
+            // Box-Muller, clamped to the parameter range below
+            auto u1 = juce::jmax(1.0e-7f, random.nextFloat());
+            auto u2 = random.nextFloat();
+            return entry.a + entry.b * std::sqrt(-2.f * std::log(u1)) * std::cos(juce::MathConstants<float>::twoPi * u2);
+        }
+
+        case Type::fixed:
+            return entry.a;
+
+        case Type::bernoulli:
+            return random.nextFloat() < entry.a ? 1.f : 0.f;
+
+        case Type::choice:
+        {
+            auto numChoices = juce::jmax(1, entry.numChoices);
+
+            if (entry.weights.isEmpty())
+                return (float)random.nextInt(numChoices);
+
+            float total = 0.f;
+            for (int i = 0; i < juce::jmin(numChoices, entry.weights.size()); ++i)
+                total += entry.weights[i];
+
+            auto r = random.nextFloat() * total;
+            auto lastWeighted = numChoices - 1;
+
+            // Rounding can leave r just above zero at the end, so fall back on the last choice that has a weight
+            for (int i = 0; i < juce::jmin(numChoices, entry.weights.size()); ++i)
+            {
+                if (entry.weights[i] <= 0.f)
+                    continue;
+
+                lastWeighted = i;
+                r -= entry.weights[i];
+
+                if (r <= 0.f)
+                    return (float)i;
+            }
+
+            return (float)lastWeighted;
+        }
+    }
+
+    return entry.defaultValue;
+}
+
+void ParameterSampler::sample (juce::Random& random, float* normalisedValues) const
+{
+    for (int i = 0; i < entries.size(); ++i)
+    {
+        auto& entry = entries.getReference(i);
+        auto plain = juce::jlimit(entry.range.start, entry.range.end, samplePlainValue(entry, random));
+
+        // Snap to the parameter's interval so the stored value is exactly what the processor sees
+        normalisedValues[i] = entry.range.convertTo0to1(entry.range.snapToLegalValue(plain));
+    }
+}
+
+void ParameterSampler::apply (const float* normalisedValues, juce::AudioProcessor& processor)
+{
+    auto& parameters = processor.getParameters();
+
+    for (int i = 0; i < parameters.size(); ++i)
+        parameters[i]->setValueNotifyingHost(normalisedValues[i]);
+}
+
+juce::String ParameterSampler::typeToString (Type type)
+{
+    switch (type)
+    {
+        case Type::uniform:     return "uniform";
+        case Type::logUniform:  return "loguniform";
+        case Type::normal:      return "normal";
+        case Type::fixed:       return "fixed";
+        case Type::bernoulli:   return "bernoulli";
+        case Type::choice:      return "choice";
+    }
+
+    return {};
+}
+
+juce::var ParameterSampler::toVar() const
+{
+    juce::Array<juce::var> table;
+
+    for (auto& entry : entries)
+    {
+        auto* object = new juce::DynamicObject();
+        object->setProperty("id", entry.id);
+        object->setProperty("name", entry.name);
+        object->setProperty("min", entry.range.start);
+        object->setProperty("max", entry.range.end);
+        object->setProperty("interval", entry.range.interval);
+        object->setProperty("skew", entry.range.skew);
+        object->setProperty("default", entry.defaultValue);
+        object->setProperty("kind", entry.isBoolean ? "bool" : (entry.numChoices > 0 ? "choice" : "float"));
+        object->setProperty("distribution", typeToString(entry.type));
+        table.add(juce::var(object));
+    }
+
+    return table;
+}
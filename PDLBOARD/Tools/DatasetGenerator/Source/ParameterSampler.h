@@ -0,0 +1,84 @@
+/*
+  ==============================================================================
+
+    ParameterSampler.h
+
+  ==============================================================================
+*/
+
+#pragma once
+
+#include <JuceHeader.h>
+
+//==============================================================================
+/**
+    Draws random parameter sets over the layout built by createParameterLayout().
+
+    Every parameter of the processor gets a distribution. Parameters that are not
+    mentioned in the distribution file are sampled uniformly over their full range
+    (booleans are a fair coin, choices are uniform over the choices). The
+    exceptions are what can't give a useful example without anything loaded:
+    the gate and the tuner are off, and "User IR" and "Neural Model" are never
+    chosen. A distribution file can still ask for them.
+
+    The distribution file is JSON keyed by parameter ID, with values in plain units:
+
+        {
+            "overdrive" : { "type" : "uniform",    "min" : 0.2, "max" : 1.0 },
+            "range"     : { "type" : "loguniform", "min" : 1.0, "max" : 300.0 },
+            "delaytime" : { "type" : "normal",     "mean" : 0.4, "sd" : 0.1 },
+            "onoff1"    : { "type" : "bernoulli",  "p" : 0.8 },
+            "type"      : { "type" : "choice",     "weights" : [ 0.7, 0.3 ] },
+            "volume"    : { "type" : "fixed",      "value" : 0.5 }
+        }
+*/
+class ParameterSampler
+{
+public:
+    ParameterSampler(const juce::Array<juce::AudioProcessorParameter*>& parameters);
+
+    juce::Result loadDistribution(const juce::File& jsonFile);
+
+    int getNumParameters() const    { return entries.size(); }
+
+    // Fills getNumParameters() normalised values in processor parameter order.
+    void sample(juce::Random& random, float* normalisedValues) const;
+
+    // Pushes normalised values into a processor of the same type the sampler was built from.
+    static void apply(const float* normalisedValues, juce::AudioProcessor& processor);
+
+    // Parameter table written into the dataset index.
+    juce::var toVar() const;
+
+private:
+    enum class Type
+    {
+        uniform,
+        logUniform,
+        normal,
+        fixed,
+        bernoulli,
+        choice
+    };
+
+    struct Entry
+    {
+        juce::String id;
+        juce::String name;
+        juce::NormalisableRange<float> range;
+        float defaultValue = 0.f;
+        bool isBoolean = false;
+        int numChoices = 0;
+
+        Type type = Type::uniform;
+        float a = 0.f, b = 1.f;
+        juce::Array<float> weights;
+    };
+
+    float samplePlainValue(const Entry& entry, juce::Random& random) const;
+    static juce::String typeToString(Type type);
+
+    juce::Array<Entry> entries;
+
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR(ParameterSampler)
+};
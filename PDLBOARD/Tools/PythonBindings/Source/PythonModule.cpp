@@ -0,0 +1,273 @@
+/*
+  ==============================================================================
+
+    PythonModule.cpp
+
+    pybind11 bindings for the headless PDLBOARD chain.
+
+        import numpy as np, pdlboard
+
+        chain = pdlboard.Chain(sample_rate=48000, block_size=512)
+        chain["overdrive"] = 0.8
+        chain["onoff1"] = 1
+
+        audio = np.zeros((2, 48000), dtype=np.float32)
+        chain.process(audio)                          # in place, GIL released
+
+        chains = [pdlboard.Chain(48000) for _ in range(8)]
+        pdlboard.process_batch(chains, buffers)       # one buffer per chain, in parallel
+
+    Audio is never copied. process() only accepts writable float32 arrays shaped
+    (channels, samples) whose samples are contiguous, anything else is a TypeError
+    rather than a silent conversion.
+
+  ==============================================================================
+*/
+
+#include <pybind11/pybind11.h>
+#include <pybind11/numpy.h>
+#include <pybind11/stl.h>
+#include <set>
+
+#include <JuceHeader.h>
+#include "../../Common/HeadlessChain.h"
+
+namespace py = pybind11;
+
+namespace
+{
+    /*
+    * Collects the channel pointers of a numpy array without touching the data.
+    */
+    struct ChannelPointers
+    {
+        std::array<float*, 8> channels {};
+        int numSamples = 0;
+    };
+
+    ChannelPointers getChannelPointers(py::array& array, int numChannels)
+    {
+        if (! py::isinstance<py::array_t<float>>(array))
+            throw py::type_error("audio must be a float32 numpy array");
+
+        if (numChannels > (int)ChannelPointers {}.channels.size())
+            throw py::value_error("too many channels");
+
+        if (! array.writeable())
+            throw py::type_error("audio must be writable, it is processed in place");
+
+        if (array.ndim() != 2 || array.shape(0) != numChannels)
+            throw py::type_error("audio must have shape (" + std::to_string(numChannels) + ", samples)");
+
+        if (array.shape(1) > 1 && array.strides(1) != (py::ssize_t)sizeof(float))
+            throw py::type_error("the samples of each channel must be contiguous");
+
+        if (array.shape(1) > std::numeric_limits<int>::max())
+            throw py::value_error("audio is too long");
+
+        ChannelPointers pointers;
+        pointers.numSamples = (int)array.shape(1);
+
+        auto* base = static_cast<char*>(array.mutable_data());
+
+        for (int channel = 0; channel < numChannels; ++channel)
+            pointers.channels[(size_t)channel] = reinterpret_cast<float*>(base + channel * array.strides(0));
+
+        return pointers;
+    }
+
+    void checkParameter(const HeadlessChain& chain, const std::string& id)
+    {
+        if (! chain.hasParameter(id))
+            throw py::key_error("unknown parameter '" + id + "'");
+    }
+
+    /*
+    * Processes chains[i] on buffers[i] for every i, spread over a thread pool.
+    * Each chain must appear only once, a chain is not safe to use from two threads.
+    */
+    void processBatch(std::vector<HeadlessChain*> chains, std::vector<py::object> objects, int numThreads)
+    {
+        if (chains.size() != objects.size())
+            throw py::value_error("process_batch needs one buffer per chain");
+
+        // Taken as plain objects so that pybind11 can't convert a list into a temporary copy
+        std::vector<py::array> buffers;
+
+        for (auto& object : objects)
+        {
+            if (! py::isinstance<py::array>(object))
+                throw py::type_error("buffers must be numpy arrays");
+
+            buffers.push_back(py::reinterpret_borrow<py::array>(object));
+        }
+
+        std::set<HeadlessChain*> unique(chains.begin(), chains.end());
+
+        if (unique.size() != chains.size() || unique.count(nullptr) != 0)
+            throw py::value_error("each chain can only appear once in a batch");
+
+        // Resolve every buffer while still holding the GIL
+        std::vector<ChannelPointers> pointers;
+
+        for (size_t i = 0; i < chains.size(); ++i)
+            pointers.push_back(getChannelPointers(buffers[i], chains[i]->getNumChannels()));
+
+        py::gil_scoped_release release;
+
+        if (numThreads <= 0)
+            numThreads = juce::SystemStats::getNumCpus();
+
+        juce::ThreadPool pool(juce::jmin(numThreads, juce::jmax(1, (int)chains.size())));
+
+        for (size_t i = 0; i < chains.size(); ++i)
+        {
+            auto* chain = chains[i];
+            auto* job = &pointers[i];
+            pool.addJob([chain, job] { chain->process(job->channels.data(), job->numSamples); });
+        }
+
+        while (pool.getNumJobs() > 0)
+            juce::Thread::sleep(1);
+    }
+}
+
+//==============================================================================
+PYBIND11_MODULE (pdlboard, m)
+{
+    // JUCE needs initialising once per process, and the processor expects a message manager
+    static juce::ScopedJuceInitialiser_GUI juceInitialiser;
+
+    m.doc() = "Headless PDLBOARD effect chain";
+
+    py::class_<HeadlessChain> (m, "Chain")
+        .def(py::init([] (double sampleRate, int blockSize, int channels)
+              {
+                  if (sampleRate <= 0 || blockSize <= 0)
+                      throw py::value_error("sample_rate and block_size must be positive");
+
+                  // The same layouts isBusesLayoutSupported() accepts
+                  if (channels != 1 && channels != 2)
+                      throw py::value_error("the effect chain processes mono or stereo buffers");
+
+                  return std::make_unique<HeadlessChain>(sampleRate, blockSize, channels);
+              }),
+              py::arg("sample_rate"), py::arg("block_size") = 512, py::arg("channels") = 2)
+
+        .def_property_readonly("sample_rate", &HeadlessChain::getSampleRate)
+        .def_property_readonly("block_size", &HeadlessChain::getMaxBlockSize)
+        .def_property_readonly("channels", &HeadlessChain::getNumChannels)
+
+        .def("process", [] (HeadlessChain& chain, py::array audio)
+              {
+                  auto pointers = getChannelPointers(audio, chain.getNumChannels());
+
+                  py::gil_scoped_release release;
+                  chain.process(pointers.channels.data(), pointers.numSamples);
+              },
+              py::arg("audio").noconvert(),
+              "Processes a float32 (channels, samples) array in place with the GIL released.")
+
+        .def("reset", [] (HeadlessChain& chain)
+              {
+                  py::gil_scoped_release release;
+                  chain.reset();
+              },
+              "Clears the delay lines, feedback and LFO.")
+
+        .def_property_readonly("parameter_ids", [] (const HeadlessChain& chain)
+              {
+                  std::vector<std::string> ids;
+
+                  for (auto& id : chain.getParameterIDs())
+                      ids.push_back(id.toStdString());
+
+                  return ids;
+              })
+
+        .def("get", [] (const HeadlessChain& chain, const std::string& id)
+              {
+                  checkParameter(chain, id);
+                  return chain.getParameter(id);
+              },
+              py::arg("id"), "Plain value of a parameter.")
+
+        .def("set", [] (HeadlessChain& chain, const std::string& id, float value)
+              {
+                  checkParameter(chain, id);
+                  chain.setParameter(id, value);
+              },
+              py::arg("id"), py::arg("value"), "Sets a parameter from a plain value.")
+
+        .def("get_normalised", [] (const HeadlessChain& chain, const std::string& id)
+              {
+                  checkParameter(chain, id);
+                  return chain.getParameterNormalised(id);
+              },
+              py::arg("id"))
+
+        .def("set_normalised", [] (HeadlessChain& chain, const std::string& id, float value)
+              {
+                  checkParameter(chain, id);
+                  chain.setParameterNormalised(id, value);
+              },
+              py::arg("id"), py::arg("value"))
+
+        .def("range", [] (const HeadlessChain& chain, const std::string& id)
+              {
+                  checkParameter(chain, id);
+                  auto range = chain.getParameterRange(id);
+                  return py::make_tuple(range.start, range.end, range.interval);
+              },
+              py::arg("id"), "(min, max, interval) of a parameter.")
+
+        .def("__getitem__", [] (const HeadlessChain& chain, const std::string& id)
+              {
+                  checkParameter(chain, id);
+                  return chain.getParameter(id);
+              })
+
+        .def("__setitem__", [] (HeadlessChain& chain, const std::string& id, float value)
+              {
+                  checkParameter(chain, id);
+                  chain.setParameter(id, value);
+              })
+
+        .def_property("parameters",
+              [] (const HeadlessChain& chain)
+              {
+                  py::dict values;
+
+                  for (auto& id : chain.getParameterIDs())
+                      values[py::str(id.toStdString())] = chain.getParameter(id);
+
+                  return values;
+              },
+              [] (HeadlessChain& chain, const py::dict& values)
+              {
+                  for (auto& item : values)
+                  {
+                      auto id = item.first.cast<std::string>();
+                      checkParameter(chain, id);
+                      chain.setParameter(id, item.second.cast<float>());
+                  }
+              },
+              "All parameters as {id: plain value}. Assigning a dict sets the listed ones.")
+
+        .def_property("state",
+              [] (HeadlessChain& chain)
+              {
+                  auto state = chain.getState();
+                  return py::bytes(static_cast<const char*>(state.getData()), state.getSize());
+              },
+              [] (HeadlessChain& chain, const py::bytes& data)
+              {
+                  auto bytes = std::string(data);
+                  chain.setState(bytes.data(), (int)bytes.size());
+              },
+              "Plugin state, the same blob a host would save.");
+
+    m.def("process_batch", &processBatch,
+           py::arg("chains"), py::arg("buffers"), py::arg("threads") = 0,
+           "Processes chains[i] on buffers[i] in place, in parallel, with the GIL released.");
+}
@@ -0,0 +1,175 @@
+/*
+  ==============================================================================
+
+    AutoWahTest.cpp
+
+  ==============================================================================
+*/
+
+#include <JuceHeader.h>
+#include "../../../Source/PluginProcessor.h"
+#include "../../../Source/EnvelopeFollower.h"
+#include "TestHelpers.h"
+
+/*
+* The envelope follower worked out a block at a time has to agree with the
+* same one-pole run a sample at a time, and the auto-wah it drives has to
+* open up as the playing gets louder and leave the signal alone when it's off.
+*/
+class AutoWahTest : public juce::UnitTest
+{
+public:
+    AutoWahTest() : juce::UnitTest("Auto-wah", "PDLBOARD") {}
+
+    void runTest() override
+    {
+        beginTest("The block follower matches a one-pole a sample at a time");
+        {
+            // Same attack and release, so there's only one pole to choose from
+            const float timeMs = 3.f;
+            const int numSamples = 1000;
+
+            EnvelopeFollower follower;
+            follower.prepare(sampleRate, numSamples);
+            follower.setTimes(timeMs, timeMs);
+
+            juce::Random random(48);
+            juce::AudioBuffer<float> input(2, numSamples);
+
+            for (int channel = 0; channel < 2; ++channel)
+                for (int i = 0; i < numSamples; ++i)
+                    input.setSample(channel, i, (random.nextFloat() * 2.f - 1.f) * (i < 300 ? 0.1f : 0.8f));
+
+            // Two calls, the first leaving a tail that isn't a whole register
+            follower.process(input.getArrayOfReadPointers(), 2, 333);
+
+            const float* secondHalf[] = { input.getReadPointer(0, 333), input.getReadPointer(1, 333) };
+            juce::HeapBlock<float> firstEnvelope(333);
+            std::copy(follower.getEnvelope(), follower.getEnvelope() + 333, firstEnvelope.get());
+            follower.process(secondHalf, 2, numSamples - 333);
+
+            auto a = std::exp(-1.0 / (timeMs * 0.001 * sampleRate));
+            auto y = 0.0;
+            auto worstError = 0.0;
+
+            for (int i = 0; i < numSamples; ++i)
+            {
+                auto x = (double)juce::jmax(std::abs(input.getSample(0, i)), std::abs(input.getSample(1, i)));
+                y = x + a * (y - x);
+
+                auto blockwise = i < 333 ? firstEnvelope[i] : follower.getEnvelope()[i - 333];
+                worstError = juce::jmax(worstError, std::abs(blockwise - y));
+            }
+
+            expectLessThan(worstError, 1.0e-5);
+            expectWithinAbsoluteError((double)follower.getLastValue(), y, 1.0e-5);
+        }
+
+        beginTest("Attack is quicker than release");
+        {
+            EnvelopeFollower follower;
+            follower.prepare(sampleRate, (int)sampleRate);
+            follower.setTimes(1.f, 100.f);
+
+            // A second, on for the first half of it
+            juce::AudioBuffer<float> step(1, (int)sampleRate);
+            step.clear();
+            juce::FloatVectorOperations::fill(step.getWritePointer(0), 1.f, step.getNumSamples() / 2);
+
+            follower.process(step.getArrayOfReadPointers(), 1, step.getNumSamples());
+            auto* envelope = follower.getEnvelope();
+
+            // One time constant in, each way
+            auto attackSamples = (int)(0.001 * sampleRate), releaseSamples = (int)(0.1 * sampleRate);
+            auto half = step.getNumSamples() / 2;
+
+            expectWithinAbsoluteError(envelope[attackSamples - 1], 1.f - std::exp(-1.f), 0.02f);
+            expectWithinAbsoluteError(envelope[half + releaseSamples - 1], std::exp(-1.f), 0.02f);
+        }
+
+        beginTest("Louder playing opens the wah");
+        {
+            PDLBOARDAudioProcessor processor;
+            TestHelpers::resetParametersToDefaults(processor);
+            TestHelpers::setParameter(processor, "onoff10", 1.f);
+
+            // Three octaves over the wah at rest, right where it peaks fully open
+            auto quiet = getGain(processor, 0.001f);
+            auto loud = getGain(processor, 0.5f);
+
+            expectLessThan(quiet, 0.3f);
+            expectGreaterThan(loud, 0.7f);
+        }
+
+        beginTest("Off leaves the signal alone");
+        {
+            PDLBOARDAudioProcessor processor;
+            TestHelpers::resetParametersToDefaults(processor);
+
+            GuitarEffectAudioProcessor::AutoWah wah(processor.getValueTreeState());
+            wah.prepare(sampleRate, blockSize, 2);
+
+            auto input = createSine(0.5f);
+            juce::AudioBuffer<float> output;
+            output.makeCopyOf(input);
+
+            // On for a block, so there's something left in the filter, then off
+            TestHelpers::setParameter(processor, "onoff10", 1.f);
+            juce::AudioBuffer<float> first(output.getArrayOfWritePointers(), 2, 0, blockSize);
+            wah.process(first);
+
+            TestHelpers::setParameter(processor, "onoff10", 0.f);
+
+            for (int start = blockSize; start < output.getNumSamples(); start += blockSize)
+            {
+                juce::AudioBuffer<float> block(output.getArrayOfWritePointers(), 2, start, juce::jmin(blockSize, output.getNumSamples() - start));
+                wah.process(block);
+            }
+
+            int numDifferent = 0;
+
+            for (int channel = 0; channel < 2; ++channel)
+                for (int i = blockSize; i < output.getNumSamples(); ++i)
+                    if (output.getSample(channel, i) != input.getSample(channel, i))
+                        ++numDifferent;
+
+            expectEquals(numDifferent, 0);
+        }
+    }
+
+private:
+    static constexpr double sampleRate = 48000.0;
+    static constexpr int blockSize = 256;
+    static constexpr double frequency = 2800.0;
+
+    static juce::AudioBuffer<float> createSine(float level)
+    {
+        juce::AudioBuffer<float> sine(2, (int)(0.25 * sampleRate));
+
+        for (int channel = 0; channel < 2; ++channel)
+            for (int i = 0; i < sine.getNumSamples(); ++i)
+                sine.setSample(channel, i, level * (float)std::sin(juce::MathConstants<double>::twoPi * frequency * i / sampleRate));
+
+        return sine;
+    }
+
+    // Output level over input level, once the envelope and the filter have settled
+    static float getGain(PDLBOARDAudioProcessor& processor, float level)
+    {
+        GuitarEffectAudioProcessor::AutoWah wah(processor.getValueTreeState());
+        wah.prepare(sampleRate, blockSize, 2);
+
+        auto audio = createSine(level);
+
+        for (int start = 0; start < audio.getNumSamples(); start += blockSize)
+        {
+            juce::AudioBuffer<float> block(audio.getArrayOfWritePointers(), 2, start, juce::jmin(blockSize, audio.getNumSamples() - start));
+            wah.process(block);
+        }
+
+        auto settled = audio.getNumSamples() / 2;
+        return audio.getRMSLevel(0, settled, audio.getNumSamples() - settled) / (level * juce::MathConstants<float>::sqrt2 * 0.5f);
+    }
+};
+
+static AutoWahTest autoWahTest;
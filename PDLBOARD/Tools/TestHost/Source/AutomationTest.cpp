@@ -0,0 +1,143 @@
+/*
+  ==============================================================================
+
+    AutomationTest.cpp
+
+  ==============================================================================
+*/
+
+#include <JuceHeader.h>
+#include "../../../Source/PluginProcessor.h"
+#include "TestHelpers.h"
+
+/*
+* The same automation played through the processor at different block
+* sizes has to come out sample for sample the same. A change lands on its
+* own sample unless it comes less than the minimum after the last one, and
+* then it waits until the minimum's up.
+*/
+class AutomationTest : public juce::UnitTest
+{
+public:
+    AutomationTest() : juce::UnitTest("Automation", "PDLBOARD") {}
+
+    void runTest() override
+    {
+        beginTest("Changes land on the same sample whatever the block size");
+        {
+            auto reference = render(512);
+
+            for (auto blockSize : { 64, 100, 257, 1024 })
+            {
+                auto output = render(blockSize);
+                int numDifferent = 0;
+
+                for (int i = 0; i < numSamples; ++i)
+                    if (output.getSample(0, i) != reference.getSample(0, i))
+                        ++numDifferent;
+
+                expectEquals(numDifferent, 0, "Blocks of " + juce::String(blockSize));
+            }
+        }
+
+        beginTest("Pieces between changes are never shorter than the minimum");
+        {
+            GuitarEffectAudioProcessor::Automation automation;
+            automation.setMinimumSubBlock(16);
+            automation.prepare();
+
+            juce::AudioParameterFloat parameter("test", "Test", 0.f, 1.f, 0.f);
+
+            // Bunched up, and straddling the block's end
+            for (auto position : { 3, 5, 17, 18, 40, 250, 260 })
+                automation.add(&parameter, (float)position / 1000.f, position);
+
+            juce::Array<int> lengths;
+
+            for (int start = 0; start < 256;)
+            {
+                automation.applyDueEvents();
+
+                auto length = automation.getSamplesToNextEvent(256 - start);
+                lengths.add(length);
+                automation.advance(length);
+                start += length;
+            }
+
+            // 3, 40 and 250 on their own samples, 5 to 18 together a minimum after 3
+            expect(lengths == juce::Array<int> { 3, 16, 21, 210, 6 });
+            expectWithinAbsoluteError(parameter.get(), 0.25f, 1.0e-6f);
+
+            // The last waits for the next block, and a minimum after 250
+            automation.applyDueEvents();
+            expectWithinAbsoluteError(parameter.get(), 0.25f, 1.0e-6f);
+            expectEquals(automation.getSamplesToNextEvent(256), 10);
+
+            automation.advance(10);
+            automation.applyDueEvents();
+            expectWithinAbsoluteError(parameter.get(), 0.26f, 1.0e-6f);
+        }
+    }
+
+private:
+    static constexpr double sampleRate = 48000.0;
+    static constexpr int numSamples = 48000;
+
+    // A sine through the overdrive, with its drive and switch moved at fixed times
+    juce::AudioBuffer<float> render(int blockSize)
+    {
+        PDLBOARDAudioProcessor processor;
+        TestHelpers::resetParametersToDefaults(processor);
+        TestHelpers::setParameterPlain(processor, "overdrive", 0.5f);
+
+        processor.setPlayConfigDetails(2, 2, sampleRate, blockSize);
+        processor.prepareToPlay(sampleRate, blockSize);
+
+        juce::RangedAudioParameter* drive = nullptr;
+        juce::RangedAudioParameter* onOff = nullptr;
+
+        for (auto* parameter : processor.getParameters())
+        {
+            if (auto* ranged = dynamic_cast<juce::RangedAudioParameter*>(parameter))
+            {
+                if (ranged->paramID == "overdrive")
+                    drive = ranged;
+                else if (ranged->paramID == "onoff1")
+                    onOff = ranged;
+            }
+        }
+
+        struct Change { int time; juce::RangedAudioParameter* parameter; float value; };
+        const Change changes[] = { { 1000, onOff, 1.f }, { 5003, drive, 0.2f }, { 5010, drive, 0.8f },
+                                   { 20111, drive, 0.4f }, { 30000, onOff, 0.f }, { 40007, onOff, 1.f } };
+
+        juce::AudioBuffer<float> output(2, numSamples);
+        juce::AudioBuffer<float> block(2, blockSize);
+        juce::MidiBuffer midi;
+
+        for (int start = 0; start < numSamples; start += blockSize)
+        {
+            auto length = juce::jmin(blockSize, numSamples - start);
+            block.setSize(2, length, false, false, true);
+
+            for (int i = 0; i < length; ++i)
+            {
+                auto sample = 0.3f * (float)std::sin(juce::MathConstants<double>::twoPi * 110.0 * (start + i) / sampleRate);
+                block.setSample(0, i, sample);
+                block.setSample(1, i, sample);
+            }
+
+            for (auto& change : changes)
+                if (change.time >= start && change.time < start + length)
+                    processor.getAutomation().add(change.parameter, change.value, change.time - start);
+
+            processor.processBlock(block, midi);
+            output.copyFrom(0, start, block, 0, 0, length);
+            output.copyFrom(1, start, block, 1, 0, length);
+        }
+
+        return output;
+    }
+};
+
+static AutomationTest automationTest;
@@ -0,0 +1,145 @@
+/*
+  ==============================================================================
+
+    BiquadCascadeTest.cpp
+
+  ==============================================================================
+*/
+
+#include <JuceHeader.h>
+#include "../../../Source/BiquadCascade.h"
+
+/*
+* The cookbook designs at the points they're defined by, and the cascade's
+* lanes against each other.
+*/
+class BiquadCascadeTest : public juce::UnitTest
+{
+public:
+    BiquadCascadeTest() : juce::UnitTest("Biquad cascade", "PDLBOARD") {}
+
+    void runTest() override
+    {
+        beginTest("Cookbook responses");
+        {
+            const double q = 0.7071067811865476;
+
+            auto lowPass = BiquadCoefficients::lowPass(sampleRate, 1000.0, q);
+            expectWithinAbsoluteError(getGain(lowPass, 0.0), 0.0, 0.01);
+            expectWithinAbsoluteError(getGain(lowPass, 1000.0), -3.01, 0.01);
+
+            auto highPass = BiquadCoefficients::highPass(sampleRate, 1000.0, q);
+            expectWithinAbsoluteError(getGain(highPass, 1000.0), -3.01, 0.01);
+            expectWithinAbsoluteError(getGain(highPass, 0.5 * sampleRate), 0.0, 0.01);
+
+            auto allPass = BiquadCoefficients::allPass(sampleRate, 1000.0, q);
+
+            for (auto frequency : { 50.0, 1000.0, 15000.0 })
+                expectWithinAbsoluteError(getGain(allPass, frequency), 0.0, 0.01);
+
+            auto peak = BiquadCoefficients::peak(sampleRate, 800.0, 2.0, 9.0);
+            expectWithinAbsoluteError(getGain(peak, 800.0), 9.0, 0.01);
+            expectWithinAbsoluteError(getGain(peak, 0.0), 0.0, 0.01);
+
+            auto lowShelf = BiquadCoefficients::lowShelf(sampleRate, 120.0, q, -6.0);
+            expectWithinAbsoluteError(getGain(lowShelf, 0.0), -6.0, 0.01);
+            expectWithinAbsoluteError(getGain(lowShelf, 120.0), -3.0, 0.01);
+            expectWithinAbsoluteError(getGain(lowShelf, 10000.0), 0.0, 0.05);
+
+            auto highShelf = BiquadCoefficients::highShelf(sampleRate, 3200.0, q, 12.0);
+            expectWithinAbsoluteError(getGain(highShelf, 0.5 * sampleRate), 12.0, 0.01);
+            expectWithinAbsoluteError(getGain(highShelf, 3200.0), 6.0, 0.01);
+            expectWithinAbsoluteError(getGain(highShelf, 50.0), 0.0, 0.05);
+        }
+
+        beginTest("Cascade matches its transfer function");
+        {
+            BiquadCascade<2> cascade;
+            auto first = BiquadCoefficients::peak(sampleRate, 500.0, 1.0, 6.0);
+            auto second = BiquadCoefficients::highShelf(sampleRate, 2000.0, 0.7, -4.0);
+            cascade.setCoefficients(0, first);
+            cascade.setCoefficients(1, second);
+
+            for (auto frequency : { 100.0, 500.0, 2000.0, 8000.0 })
+            {
+                cascade.reset();
+                double inputPower = 0.0, outputPower = 0.0;
+
+                for (int i = 0; i < (int)sampleRate; ++i)
+                {
+                    auto input = (float)std::sin(juce::MathConstants<double>::twoPi * frequency * i / sampleRate);
+                    auto output = cascade.processSample(BiquadCascade<2>::Vec::expand(input)).get(0);
+
+                    if (i >= (int)sampleRate / 2)
+                    {
+                        inputPower += input * input;
+                        outputPower += output * output;
+                    }
+                }
+
+                auto measured = juce::Decibels::gainToDecibels(std::sqrt(outputPower / inputPower));
+                expectWithinAbsoluteError(measured, getGain(first, frequency) + getGain(second, frequency), 0.01);
+            }
+        }
+
+        beginTest("Lanes are independent");
+        {
+            using Cascade = BiquadCascade<1>;
+
+            // Every lane its own filter, against each filter run on its own
+            Cascade together;
+            std::vector<std::unique_ptr<Cascade>> alone;
+
+            for (int lane = 0; lane < Cascade::lanes; ++lane)
+            {
+                auto c = BiquadCoefficients::lowPass(sampleRate, 200.0 * (lane + 1), 0.5 + lane);
+                together.setCoefficients(0, lane, c);
+
+                alone.push_back(std::make_unique<Cascade>());
+                alone.back()->setCoefficients(0, c);
+            }
+
+            // Channels into process(), which puts them across the lanes
+            juce::AudioBuffer<float> channels(Cascade::lanes, 512);
+            juce::Random random(1);
+
+            for (int channel = 0; channel < channels.getNumChannels(); ++channel)
+                for (int i = 0; i < channels.getNumSamples(); ++i)
+                    channels.setSample(channel, i, random.nextFloat() * 2.f - 1.f);
+
+            juce::AudioBuffer<float> expected;
+            expected.makeCopyOf(channels);
+
+            together.process(channels.getArrayOfWritePointers(), channels.getNumChannels(), 0, channels.getNumSamples());
+
+            auto worstDifference = 0.f;
+
+            for (int channel = 0; channel < expected.getNumChannels(); ++channel)
+            {
+                for (int i = 0; i < expected.getNumSamples(); ++i)
+                {
+                    auto y = alone[(size_t)channel]->processSample(Cascade::Vec::expand(expected.getSample(channel, i))).get(0);
+                    worstDifference = juce::jmax(worstDifference, std::abs(channels.getSample(channel, i) - y));
+                }
+            }
+
+            // The same arithmetic lane for lane, so exactly the same
+            expectEquals(worstDifference, 0.f);
+        }
+    }
+
+private:
+    static constexpr double sampleRate = 48000.0;
+
+    // |H(e^jw)| in dB from the coefficients
+    static double getGain(const BiquadCoefficients& c, double frequency)
+    {
+        auto z = std::polar(1.0, -juce::MathConstants<double>::twoPi * frequency / sampleRate);
+        auto numerator = (double)c.b0 + (double)c.b1 * z + (double)c.b2 * z * z;
+        auto denominator = 1.0 + (double)c.a1 * z + (double)c.a2 * z * z;
+
+        return juce::Decibels::gainToDecibels(std::abs(numerator / denominator));
+    }
+};
+
+static BiquadCascadeTest biquadCascadeTest;
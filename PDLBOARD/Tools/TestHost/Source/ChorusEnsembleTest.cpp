@@ -0,0 +1,174 @@
+/*
+  ==============================================================================
+
+    ChorusEnsembleTest.cpp
+
+  ==============================================================================
+*/
+
+#include <JuceHeader.h>
+#include "../../../Source/PluginProcessor.h"
+#include "../../../Source/ChorusEnsemble.h"
+#include "../../../Source/CircularDelay.h"
+#include "TestHelpers.h"
+
+/*
+* The ensemble's voices, a SIMD lane each, against the same voices read one
+* at a time through CircularDelay with a sin() a sample, for every number of
+* voices from one register to more than one, the sweep carrying on from the
+* phase it's handed, and the ensemble switching in through the processor
+* once there's more than one voice.
+*/
+class ChorusEnsembleTest : public juce::UnitTest
+{
+public:
+    ChorusEnsembleTest() : juce::UnitTest("Chorus ensemble", "PDLBOARD") {}
+
+    void runTest() override
+    {
+        for (auto numVoices : { 1, 3, 4, 5, 8 })
+        {
+            beginTest(juce::String(numVoices) + " voices match reading them one at a time");
+
+            ChorusEnsemble::Settings settings;
+            settings.numVoices = numVoices;
+            settings.rate = 1.3f;
+            settings.depth = 0.8f;
+            settings.offset = 0.25f;
+            settings.feedback = 0.5f;
+            settings.dryWet = 0.7f;
+
+            // Part way round, as when the single voice chorus hands its sweep over
+            auto input = createInput();
+            double expectedPhase = startPhase;
+            auto expected = renderOneAtATime(input, settings, expectedPhase);
+
+            juce::AudioBuffer<float> output;
+            output.makeCopyOf(input);
+
+            ChorusEnsemble ensemble;
+            ensemble.prepare(sampleRate);
+
+            std::vector<float> left((size_t)lineLength), right((size_t)lineLength);
+            float* lines[] = { left.data(), right.data() };
+            int writeHead = 0;
+            auto phase = (float)startPhase;
+
+            for (int start = 0; start < output.getNumSamples(); start += blockSize)
+            {
+                juce::AudioBuffer<float> block(output.getArrayOfWritePointers(), 2, start, juce::jmin(blockSize, output.getNumSamples() - start));
+                ensemble.process(block.getArrayOfWritePointers(), 2, block.getNumSamples(), lines, lineLength, writeHead, phase, settings);
+            }
+
+            auto worstError = 0.f;
+
+            for (int channel = 0; channel < 2; ++channel)
+                for (int i = 0; i < output.getNumSamples(); ++i)
+                    worstError = juce::jmax(worstError, std::abs(output.getSample(channel, i) - expected.getSample(channel, i)));
+
+            expectLessThan(worstError, 1.0e-3f);
+            expectWithinAbsoluteError((double)phase, expectedPhase - std::floor(expectedPhase), 1.0e-4);
+        }
+
+        beginTest("More than one voice switches the processor's chorus to the ensemble");
+        {
+            auto single = renderThroughProcessor(1);
+            auto ensemble = renderThroughProcessor(6);
+
+            auto numDifferent = 0;
+
+            for (int i = 0; i < single.getNumSamples(); ++i)
+                if (std::abs(single.getSample(0, i) - ensemble.getSample(0, i)) > 1.0e-3f)
+                    ++numDifferent;
+
+            expectGreaterThan(numDifferent, single.getNumSamples() / 2);
+            expectLessThan(ensemble.getMagnitude(0, ensemble.getNumSamples()), 1.f);
+        }
+    }
+
+private:
+    static constexpr double sampleRate = 48000.0;
+    static constexpr int blockSize = 256;
+    static constexpr int lineLength = 4800;
+    static constexpr double startPhase = 0.3;
+
+    static juce::AudioBuffer<float> createInput()
+    {
+        juce::AudioBuffer<float> input(2, (int)(0.5 * sampleRate));
+
+        for (int i = 0; i < input.getNumSamples(); ++i)
+        {
+            auto t = i / sampleRate;
+            input.setSample(0, i, 0.4f * (float)std::sin(juce::MathConstants<double>::twoPi * 220.0 * t));
+            input.setSample(1, i, 0.4f * (float)std::sin(juce::MathConstants<double>::twoPi * 330.0 * t));
+        }
+
+        return input;
+    }
+
+    // Every voice on its own, a sample at a time, from and on to the phase given
+    static juce::AudioBuffer<float> renderOneAtATime(const juce::AudioBuffer<float>& input, const ChorusEnsemble::Settings& settings, double& phase)
+    {
+        juce::AudioBuffer<float> output;
+        output.makeCopyOf(input);
+
+        std::vector<float> lines[2] = { std::vector<float> ((size_t)lineLength), std::vector<float> ((size_t)lineLength) };
+        float feedback[2] = {};
+        int writeHead = 0;
+
+        auto centre = 0.5 * (settings.minimumDelay + settings.maximumDelay) * sampleRate;
+        auto swing = 0.5 * (settings.maximumDelay - settings.minimumDelay) * sampleRate * settings.depth;
+
+        for (int i = 0; i < output.getNumSamples(); ++i)
+        {
+            for (int side = 0; side < 2; ++side)
+            {
+                auto x = output.getSample(side, i);
+                lines[side][(size_t)writeHead] = x + feedback[side];
+
+                auto sum = 0.f;
+
+                for (int v = 0; v < settings.numVoices; ++v)
+                {
+                    auto lfo = std::sin(juce::MathConstants<double>::twoPi * (phase + side * settings.offset + (double)v / settings.numVoices));
+                    sum += CircularDelay::read(lines[side].data(), lineLength, writeHead, (float)(centre + swing * lfo));
+                }
+
+                sum /= (float)settings.numVoices;
+                feedback[side] = sum * settings.feedback;
+                output.setSample(side, i, x * (1.f - settings.dryWet) + sum * settings.dryWet);
+            }
+
+            writeHead = (writeHead + 1) % lineLength;
+            phase += settings.rate / sampleRate;
+        }
+
+        return output;
+    }
+
+    static juce::AudioBuffer<float> renderThroughProcessor(int numVoices)
+    {
+        PDLBOARDAudioProcessor processor;
+        TestHelpers::resetParametersToDefaults(processor);
+        TestHelpers::setParameter(processor, "onoff2", 1.f);
+        TestHelpers::setParameterPlain(processor, "depth", 0.8f);
+        TestHelpers::setParameterPlain(processor, "rate", 2.f);
+        TestHelpers::setParameterPlain(processor, "chorusvoices", (float)numVoices);
+
+        processor.setPlayConfigDetails(2, 2, sampleRate, blockSize);
+        processor.prepareToPlay(sampleRate, blockSize);
+
+        auto audio = createInput();
+        juce::MidiBuffer midi;
+
+        for (int start = 0; start < audio.getNumSamples(); start += blockSize)
+        {
+            juce::AudioBuffer<float> block(audio.getArrayOfWritePointers(), 2, start, juce::jmin(blockSize, audio.getNumSamples() - start));
+            processor.processBlock(block, midi);
+        }
+
+        return audio;
+    }
+};
+
+static ChorusEnsembleTest chorusEnsembleTest;
@@ -0,0 +1,198 @@
+/*
+  ==============================================================================
+
+    ConvolutionBenchmark.cpp
+
+  ==============================================================================
+*/
+
+#include <JuceHeader.h>
+#include "../../../Source/PartitionedConvolution.h"
+
+/*
+* CPU cost of the cabinet's partitioned convolution against IR length, with a
+* plain FIR next to it for the lengths where that is still bearable. Not part of
+* the PDLBOARD category, run it with "TestHost --category Benchmarks" on a
+* release build and paste the log into the review of anything that touches
+* PartitionedConvolution.
+*
+* It also checks the convolution against the plain FIR, so a fast but wrong
+* change can't show up as an improvement.
+*/
+class ConvolutionBenchmark : public juce::UnitTest
+{
+public:
+    ConvolutionBenchmark() : juce::UnitTest("Partitioned convolution", "Benchmarks") {}
+
+    void runTest() override
+    {
+        auto random = getRandom();
+        auto input = makeNoise(random, numChannels, (int)(seconds * sampleRate));
+
+        beginTest("Matches direct convolution");
+        {
+            auto impulseResponse = makeImpulseResponse(random, 1000);
+            auto convolved = input;
+            auto direct = input;
+
+            runPartitioned(impulseResponse, 64, convolved, 37);
+            runDirect(impulseResponse, direct, 37);
+
+            float peak = 0.f, peakError = 0.f;
+
+            for (int channel = 0; channel < numChannels; ++channel)
+            {
+                for (int i = 0; i < direct.getNumSamples(); ++i)
+                {
+                    peak = juce::jmax(peak, std::abs(direct.getSample(channel, i)));
+                    peakError = juce::jmax(peakError, std::abs(convolved.getSample(channel, i) - direct.getSample(channel, i)));
+                }
+            }
+
+            auto errorDb = juce::Decibels::gainToDecibels(peakError / peak, -400.f);
+            expect(errorDb < -100.f, "Peak error " + juce::String(errorDb, 1) + " dB");
+        }
+
+        beginTest("Cost per IR length");
+        {
+            logMessage("48 kHz stereo, 256 sample blocks. ns per sample per channel, % of one core in realtime");
+
+            for (auto length : { 256, 1024, 2048, 4096, 16384, 48000 })
+            {
+                auto impulseResponse = makeImpulseResponse(random, length);
+
+                // Every run gets fresh input, output fed back in would decay into denormals
+                auto buffer = input;
+                auto line = juce::String(length).paddedLeft(' ', 6) + " taps:  partitioned " + describe(runPartitioned(impulseResponse, 64, buffer, blockSize));
+
+                // The plain FIR is only there for scale, past a few thousand taps it takes forever
+                if (length <= 4096)
+                {
+                    buffer = input;
+                    line << "   direct " << describe(runDirect(impulseResponse, buffer, blockSize));
+                }
+
+                logMessage(line);
+            }
+        }
+
+        beginTest("Cost per partition size");
+        {
+            // The cabinet uses 64: the direct part grows with the partition, the FFT part shrinks
+            auto impulseResponse = makeImpulseResponse(random, 48000);
+
+            for (auto partitionSize : { 16, 32, 64, 128, 256 })
+            {
+                auto buffer = input;
+                logMessage("Partition " + juce::String(partitionSize).paddedLeft(' ', 3) + ", 1 s IR:  "
+                           + describe(runPartitioned(impulseResponse, partitionSize, buffer, blockSize)));
+            }
+        }
+    }
+
+private:
+    static constexpr double sampleRate = 48000.0;
+    static constexpr double seconds = 4.0;
+    static constexpr int numChannels = 2;
+    static constexpr int blockSize = 256;
+
+    static juce::AudioBuffer<float> makeNoise(juce::Random& random, int channels, int length)
+    {
+        juce::AudioBuffer<float> noise(channels, length);
+
+        for (int channel = 0; channel < channels; ++channel)
+            for (int i = 0; i < length; ++i)
+                noise.setSample(channel, i, random.nextFloat() * 2.f - 1.f);
+
+        return noise;
+    }
+
+    // Decaying noise, so the tail partitions aren't just zeros
+    static juce::AudioBuffer<float> makeImpulseResponse(juce::Random& random, int length)
+    {
+        auto impulseResponse = makeNoise(random, 1, length);
+
+        for (int i = 0; i < length; ++i)
+            impulseResponse.setSample(0, i, impulseResponse.getSample(0, i) * std::exp(-4.f * (float)i / (float)length));
+
+        return impulseResponse;
+    }
+
+    // Processes the buffer in place, returns the seconds it took
+    static double runPartitioned(const juce::AudioBuffer<float>& impulseResponse, int partitionSize, juce::AudioBuffer<float>& buffer, int hostBlockSize)
+    {
+        auto maxPartitions = (impulseResponse.getNumSamples() + partitionSize - 1) / partitionSize;
+
+        PartitionedConvolution::Filter filter(impulseResponse, partitionSize, maxPartitions);
+        PartitionedConvolution convolution;
+        convolution.prepare(buffer.getNumChannels(), partitionSize, maxPartitions);
+        convolution.setFilter(&filter);
+
+        auto start = juce::Time::getHighResolutionTicks();
+
+        for (int position = 0; position < buffer.getNumSamples(); position += hostBlockSize)
+        {
+            auto num = juce::jmin(hostBlockSize, buffer.getNumSamples() - position);
+            float* channels[numChannels];
+
+            for (int channel = 0; channel < buffer.getNumChannels(); ++channel)
+                channels[channel] = buffer.getWritePointer(channel, position);
+
+            convolution.process(channels, buffer.getNumChannels(), num);
+        }
+
+        return juce::Time::highResolutionTicksToSeconds(juce::Time::getHighResolutionTicks() - start);
+    }
+
+    static double runDirect(const juce::AudioBuffer<float>& impulseResponse, juce::AudioBuffer<float>& buffer, int hostBlockSize)
+    {
+        auto length = impulseResponse.getNumSamples();
+        auto* h = impulseResponse.getReadPointer(0);
+
+        // Same trick as the convolver: history stored twice, so every window is contiguous
+        std::vector<std::vector<float>> history((size_t)buffer.getNumChannels(), std::vector<float>((size_t)(2 * length)));
+        int position = 0;
+
+        std::vector<float> reversed(h, h + length);
+        std::reverse(reversed.begin(), reversed.end());
+
+        auto start = juce::Time::getHighResolutionTicks();
+
+        for (int blockStart = 0; blockStart < buffer.getNumSamples(); blockStart += hostBlockSize)
+        {
+            auto num = juce::jmin(hostBlockSize, buffer.getNumSamples() - blockStart);
+
+            for (int i = 0; i < num; ++i)
+            {
+                for (int channel = 0; channel < buffer.getNumChannels(); ++channel)
+                {
+                    auto* data = buffer.getWritePointer(channel, blockStart);
+                    auto* x = history[(size_t)channel].data();
+
+                    x[position] = x[position + length] = data[i];
+
+                    float sum = 0.f;
+
+                    for (int k = 0; k < length; ++k)
+                        sum += x[position + 1 + k] * reversed[(size_t)k];
+
+                    data[i] = sum;
+                }
+
+                position = (position + 1) % length;
+            }
+        }
+
+        return juce::Time::highResolutionTicksToSeconds(juce::Time::getHighResolutionTicks() - start);
+    }
+
+    static juce::String describe(double elapsed)
+    {
+        auto numSamples = seconds * sampleRate * numChannels;
+
+        return juce::String(elapsed / numSamples * 1.0e9, 1).paddedLeft(' ', 8) + " ns "
+             + juce::String(100.0 * elapsed / seconds, 2).paddedLeft(' ', 7) + " %";
+    }
+};
+
+static ConvolutionBenchmark convolutionBenchmark;
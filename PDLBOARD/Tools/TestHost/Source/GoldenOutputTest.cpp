@@ -0,0 +1,419 @@
+/*
+  ==============================================================================
+
+    GoldenOutputTest.cpp
+
+  ==============================================================================
+*/
+
+#include <JuceHeader.h>
+#include "../../../Source/PluginProcessor.h"
+#include "TestHelpers.h"
+
+/*
+* Renders a matrix of presets and test signals and compares the result with the
+* golden renders in Tools/TestHost/Golden.
+*
+* Every effect has a tolerance, and a preset is held to the loosest tolerance of
+* the effects it enables. The tolerance is the peak error relative to the peak of
+* the golden render, so -90 dB means no sample is off by more than about 0.003% of
+* full scale. Exact effects must match bit for bit. Loosen an effect's entry
+* below when its maths is deliberately approximated, never the other way round.
+*
+* The golden files are 32-bit float WAVs, which round-trip exactly. Record them
+* with "TestHost --category PDLBOARD --update-golden" on a build whose output has
+* been checked by ear, and commit them together with the change that needed them.
+* A render with no golden fails, so the suite can't pass without comparing
+* against something, but it still gets its block size checks.
+*/
+class GoldenOutputTest : public juce::UnitTest
+{
+public:
+    GoldenOutputTest() : juce::UnitTest("Golden output", "PDLBOARD") {}
+
+    void runTest() override
+    {
+        auto& options = TestHelpers::getOptions();
+
+        if (options.updateGolden && ! options.goldenFolder.createDirectory())
+        {
+            expect(false, "Can't create " + options.goldenFolder.getFullPathName());
+            return;
+        }
+
+        for (auto& preset : getPresets())
+        {
+            for (auto& signal : getSignals())
+            {
+                beginTest(juce::String(preset.name) + " / " + signal.name);
+
+                auto output = render(preset, signal.audio, blockSize);
+                auto goldenFile = options.goldenFolder.getChildFile(juce::String(preset.name) + "__" + signal.name + ".wav");
+
+                if (options.updateGolden)
+                {
+                    expect(writeWav(goldenFile, output), "Can't write " + goldenFile.getFullPathName());
+                    continue;
+                }
+
+                juce::AudioBuffer<float> golden;
+
+                // Nothing to hold the render to, but the host's block size still mustn't change it
+                if (! goldenFile.existsAsFile())
+                {
+                    expect(false, "Missing golden render " + goldenFile.getFullPathName() + ", record it with --update-golden");
+                    compare(render(preset, signal.audio, 1), output, preset);
+                    compare(render(preset, signal.audio, 61), output, preset);
+                    continue;
+                }
+
+                if (! readWav(goldenFile, golden))
+                {
+                    expect(false, "Can't read golden render " + goldenFile.getFullPathName() + ", re-record it with --update-golden");
+                    continue;
+                }
+
+                compare(output, golden, preset);
+
+                // Parameters are constant, so the host's block size must not change the result
+                compare(render(preset, signal.audio, 1), golden, preset);
+                compare(render(preset, signal.audio, 61), golden, preset);
+            }
+        }
+    }
+
+private:
+    static constexpr double sampleRate = 48000.0;
+    static constexpr int blockSize = 512;
+    static constexpr int numChannels = 2;
+    static constexpr int signalLength = 48000;
+
+    static constexpr double bitExact = -std::numeric_limits<double>::infinity();
+
+    /*
+    * Allowed peak error per effect in dB. Bit-exact effects are plain arithmetic
+    * on the samples, the others call libm functions that may be replaced by
+    * approximations (atan in the overdrive, exp and log in the clipping circuits'
+    * diodes and the triode's table, sin in the chorus LFO, pow and exp in the
+    * FDN's gains, cos, sin and pow in the EQ's coefficients, tan, exp2 and pow
+    * in the auto-wah's filter and follower, pow, exp, cos and sin in the
+    * multi-tap's taps) or sum in an order the FFT engine picks (the cabinet and
+    * reverb). The ensemble's LFOs are rotated in float from sines taken at the
+    * start of each block, so its looser entry covers the host's block size
+    * moving where they land by a few millionths of a cycle.
+    */
+    static double getEffectTolerance(const juce::String& effect)
+    {
+        if (effect == "overdrive")  return -90.0;
+        if (effect == "circuit")    return -90.0;
+        if (effect == "chorus")     return -120.0;
+        if (effect == "ensemble")   return -70.0;
+        if (effect == "delay")      return bitExact;
+        if (effect == "multitap")   return -110.0;
+        if (effect == "cabinet")    return -100.0;
+        if (effect == "reverb")     return -100.0;
+        if (effect == "fdnreverb")  return -100.0;
+        if (effect == "eq")         return -120.0;
+        if (effect == "autowah")    return -100.0;
+
+        return bitExact;
+    }
+
+    struct Preset
+    {
+        const char* name;
+        juce::StringArray effects;
+        std::vector<std::pair<const char*, float>> values;     // plain values
+
+        double getTolerance() const
+        {
+            auto tolerance = bitExact;
+
+            for (auto& effect : effects)
+                tolerance = juce::jmax(tolerance, getEffectTolerance(effect));
+
+            return tolerance;
+        }
+    };
+
+    struct Signal
+    {
+        juce::String name;
+        juce::AudioBuffer<float> audio;
+    };
+
+    //==============================================================================
+    static const std::vector<Preset>& getPresets()
+    {
+        static const std::vector<Preset> presets
+        {
+            { "bypass",         {}, {} },
+
+            { "overdrive_soft", { "overdrive" },
+              { { "onoff1", 1.f }, { "overdrive", 0.3f }, { "range", 30.f }, { "blend", 0.7f }, { "volume", 1.f } } },
+
+            { "overdrive_hard", { "overdrive" },
+              { { "onoff1", 1.f }, { "overdrive", 1.f }, { "range", 300.f }, { "blend", 1.f }, { "volume", 0.8f } } },
+
+            { "diode_clipper",  { "circuit" },
+              { { "onoff1", 1.f }, { "odmode", 2.f }, { "overdrive", 0.6f }, { "odtone", 0.5f }, { "blend", 1.f }, { "volume", 1.f } } },
+
+            { "tube_screamer",  { "circuit" },
+              { { "onoff1", 1.f }, { "odmode", 3.f }, { "overdrive", 0.7f }, { "odtone", 0.4f }, { "blend", 1.f }, { "volume", 1.f } } },
+
+            { "tube_preamp",    { "circuit" },
+              { { "onoff1", 1.f }, { "odmode", 4.f }, { "overdrive", 0.5f }, { "odtone", 0.5f }, { "blend", 1.f }, { "volume", 1.f } } },
+
+            { "multiband",      { "overdrive" },
+              { { "onoff1", 1.f }, { "odmode", 5.f }, { "odbands", 2.f }, { "range", 100.f },
+                { "banddrive1", 0.1f }, { "banddrive2", 0.4f }, { "banddrive3", 0.8f }, { "banddrive4", 1.f },
+                { "bandblend1", 0.2f }, { "bandblend2", 0.6f }, { "bandblend3", 1.f }, { "bandblend4", 1.f },
+                { "bandvolume1", 1.f }, { "bandvolume2", 1.f }, { "bandvolume3", 0.8f }, { "bandvolume4", 0.6f } } },
+
+            { "chorus",         { "chorus" },
+              { { "onoff2", 1.f }, { "dry/wet1", 0.5f }, { "depth", 0.6f }, { "rate", 1.5f }, { "offset", 0.25f },
+                { "feedback1", 0.3f }, { "type", 0.f } } },
+
+            { "flanger",        { "chorus" },
+              { { "onoff2", 1.f }, { "dry/wet1", 0.5f }, { "depth", 0.8f }, { "rate", 0.3f }, { "offset", 0.f },
+                { "feedback1", 0.7f }, { "type", 1.f } } },
+
+            { "delay",          { "delay" },
+              { { "onoff3", 1.f }, { "dry/wet2", 0.4f }, { "feedback2", 0.5f }, { "delaytime", 0.25f } } },
+
+            { "chorus_ensemble", { "ensemble" },
+              { { "onoff2", 1.f }, { "dry/wet1", 0.5f }, { "depth", 0.5f }, { "rate", 0.7f }, { "offset", 0.25f },
+                { "feedback1", 0.2f }, { "type", 0.f }, { "chorusvoices", 4.f } } },
+
+            { "multi_tap",      { "multitap" },
+              { { "onoff3", 1.f }, { "delaymode", 1.f }, { "delaytaps", 4.f }, { "tapspacing", 1.f }, { "tapdecay", 0.7f },
+                { "tapspread", 0.6f }, { "taptone", 6000.f }, { "crossfeed", 0.2f },
+                { "dry/wet2", 0.4f }, { "feedback2", 0.4f }, { "delaytime", 0.3f } } },
+
+            { "ping_pong",      { "multitap" },
+              { { "onoff3", 1.f }, { "delaymode", 2.f }, { "delaytaps", 2.f }, { "tapspacing", 0.f }, { "tapdecay", 0.8f },
+                { "tapspread", 1.f }, { "taptone", 4000.f }, { "dry/wet2", 0.5f }, { "feedback2", 0.5f }, { "delaytime", 0.2f } } },
+
+            { "cabinet",        { "cabinet" },
+              { { "onoff4", 1.f }, { "cabinet", 2.f }, { "dry/wet3", 1.f }, { "cablevel", 0.f } } },
+
+            { "reverb",         { "reverb" },
+              { { "onoff5", 1.f }, { "reverb", 1.f }, { "dry/wet4", 0.5f } } },
+
+            { "fdn_reverb",     { "fdnreverb" },
+              { { "onoff6", 1.f }, { "fdnsize", 0.6f }, { "fdndecay", 3.f }, { "fdndamping", 0.3f }, { "fdnmod", 0.4f },
+                { "fdnlines", 1.f }, { "fdnfreeze", 0.f }, { "dry/wet5", 0.4f } } },
+
+            { "eq_pre_overdrive", { "eq", "overdrive" },
+              { { "onoff7", 1.f }, { "eqposition", 0.f }, { "eqlow", -6.f }, { "eqmidfreq", 700.f }, { "eqmid", 6.f },
+                { "eqmidq", 1.5f }, { "eqhigh", 2.f },
+                { "onoff1", 1.f }, { "overdrive", 0.6f }, { "range", 120.f }, { "blend", 0.8f }, { "volume", 1.f } } },
+
+            { "eq_post_overdrive", { "overdrive", "eq" },
+              { { "onoff1", 1.f }, { "overdrive", 0.6f }, { "range", 120.f }, { "blend", 0.8f }, { "volume", 1.f },
+                { "onoff7", 1.f }, { "eqposition", 1.f }, { "eqlow", 3.f }, { "eqmidfreq", 1200.f }, { "eqmid", -4.f },
+                { "eqmidq", 0.8f }, { "eqhigh", -8.f } } },
+
+            { "noise_gate",     { "gate", "overdrive", "delay" },
+              { { "onoff8", 1.f }, { "gatethreshold", -50.f }, { "gatehold", 30.f }, { "gaterelease", 60.f },
+                { "onoff1", 1.f }, { "overdrive", 1.f }, { "range", 300.f }, { "blend", 1.f }, { "volume", 0.8f },
+                { "onoff3", 1.f }, { "dry/wet2", 0.3f }, { "feedback2", 0.3f }, { "delaytime", 0.1f } } },
+
+            { "auto_wah",       { "autowah" },
+              { { "onoff10", 1.f }, { "wahfreq", 300.f }, { "wahrange", 3.f }, { "wahq", 5.f }, { "wahsens", 18.f },
+                { "wahattack", 3.f }, { "wahrelease", 120.f }, { "dry/wet6", 1.f } } },
+
+            { "full_chain",     { "overdrive", "chorus", "delay" },
+              { { "onoff1", 1.f }, { "overdrive", 0.6f }, { "range", 120.f }, { "blend", 0.8f }, { "volume", 1.f },
+                { "onoff2", 1.f }, { "dry/wet1", 0.4f }, { "depth", 0.5f }, { "rate", 0.8f }, { "offset", 0.5f },
+                { "feedback1", 0.2f }, { "type", 0.f },
+                { "onoff3", 1.f }, { "dry/wet2", 0.3f }, { "feedback2", 0.4f }, { "delaytime", 0.18f } } },
+        };
+
+        return presets;
+    }
+
+    /*
+    * All signals are generated here rather than loaded, so nothing but the
+    * golden renders has to be kept in the repository.
+    */
+    static const std::vector<Signal>& getSignals()
+    {
+        static const std::vector<Signal> signals = []
+        {
+            std::vector<Signal> result;
+
+            // Exponential sine sweep, 20 Hz to 20 kHz in 0.8 s, then silence for the tails
+            {
+                Signal sweep { "sweep", juce::AudioBuffer<float>(numChannels, signalLength) };
+                sweep.audio.clear();
+
+                const double f0 = 20.0, f1 = 20000.0, duration = 0.8;
+                const auto k = std::log(f1 / f0);
+
+                for (int i = 0; i < (int)(duration * sampleRate); ++i)
+                {
+                    auto t = i / sampleRate;
+                    auto phase = juce::MathConstants<double>::twoPi * f0 * duration / k * (std::exp(t * k / duration) - 1.0);
+
+                    for (int channel = 0; channel < numChannels; ++channel)
+                        sweep.audio.setSample(channel, i, 0.5f * (float)std::sin(phase));
+                }
+
+                result.push_back(std::move(sweep));
+            }
+
+            // Unit impulse at the start, the rest is the effects' response
+            {
+                Signal impulse { "impulse", juce::AudioBuffer<float>(numChannels, signalLength) };
+                impulse.audio.clear();
+
+                for (int channel = 0; channel < numChannels; ++channel)
+                    impulse.audio.setSample(channel, 0, 1.f);
+
+                result.push_back(std::move(impulse));
+            }
+
+            // DI guitar stand-in: Karplus-Strong plucks of E2, A2, D3 and G3 at DI level
+            {
+                Signal guitar { "di_guitar", juce::AudioBuffer<float>(numChannels, signalLength) };
+                guitar.audio.clear();
+
+                juce::Random random(0x5eed);
+                const double notes[] = { 82.41, 110.0, 146.83, 196.0 };
+
+                for (int n = 0; n < 4; ++n)
+                {
+                    auto period = juce::roundToInt(sampleRate / notes[n]);
+                    auto start = n * signalLength / 5;
+
+                    std::vector<float> string((size_t)period);
+
+                    for (auto& s : string)
+                        s = random.nextFloat() * 2.f - 1.f;
+
+                    for (int i = start, p = 0; i < signalLength; ++i, p = (p + 1) % period)
+                    {
+                        auto next = string[(size_t)((p + 1) % period)];
+                        auto out = string[(size_t)p];
+                        string[(size_t)p] = 0.996f * 0.5f * (out + next);
+
+                        for (int channel = 0; channel < numChannels; ++channel)
+                            guitar.audio.addSample(channel, i, 0.15f * out);
+                    }
+                }
+
+                result.push_back(std::move(guitar));
+            }
+
+            return result;
+        }();
+
+        return signals;
+    }
+
+    //==============================================================================
+    juce::AudioBuffer<float> render(const Preset& preset, const juce::AudioBuffer<float>& input, int hostBlockSize)
+    {
+        PDLBOARDAudioProcessor processor;
+
+        TestHelpers::resetParametersToDefaults(processor);
+
+        for (auto& value : preset.values)
+            TestHelpers::setParameterPlain(processor, value.first, value.second);
+
+        // Offline, so the reverb waits for its tail workers and every render is complete
+        processor.setNonRealtime(true);
+        processor.setPlayConfigDetails(numChannels, numChannels, sampleRate, hostBlockSize);
+        processor.prepareToPlay(sampleRate, hostBlockSize);
+
+        juce::AudioBuffer<float> output;
+        output.makeCopyOf(input);
+
+        juce::MidiBuffer midi;
+
+        for (int start = 0; start < output.getNumSamples(); start += hostBlockSize)
+        {
+            auto num = juce::jmin(hostBlockSize, output.getNumSamples() - start);
+            juce::AudioBuffer<float> block(output.getArrayOfWritePointers(), numChannels, start, num);
+            processor.processBlock(block, midi);
+        }
+
+        return output;
+    }
+
+    void compare(const juce::AudioBuffer<float>& output, const juce::AudioBuffer<float>& golden, const Preset& preset)
+    {
+        if (output.getNumChannels() != golden.getNumChannels() || output.getNumSamples() != golden.getNumSamples())
+        {
+            expect(false, "Golden render has a different shape, re-record it");
+            return;
+        }
+
+        auto tolerance = preset.getTolerance();
+        float peak = 0.f, peakError = 0.f;
+        bool identical = true;
+
+        for (int channel = 0; channel < output.getNumChannels(); ++channel)
+        {
+            auto* out = output.getReadPointer(channel);
+            auto* ref = golden.getReadPointer(channel);
+
+            for (int i = 0; i < output.getNumSamples(); ++i)
+            {
+                identical = identical && (out[i] == ref[i]);
+                peak = juce::jmax(peak, std::abs(ref[i]));
+                peakError = juce::jmax(peakError, std::abs(out[i] - ref[i]));
+            }
+        }
+
+        if (tolerance == bitExact)
+        {
+            expect(identical, juce::String(preset.name) + " must be bit-exact, peak error "
+                              + juce::String(juce::Decibels::gainToDecibels(peakError / juce::jmax(peak, 1.0e-30f), -400.f), 1) + " dB");
+            return;
+        }
+
+        auto errorDb = juce::Decibels::gainToDecibels(peakError / juce::jmax(peak, 1.0e-30f), -400.f);
+
+        expect(errorDb <= tolerance, juce::String(preset.name) + " peak error " + juce::String(errorDb, 1)
+                                     + " dB exceeds " + juce::String(tolerance, 1) + " dB");
+    }
+
+    //==============================================================================
+    static bool writeWav(const juce::File& file, const juce::AudioBuffer<float>& audio)
+    {
+        file.deleteFile();
+        auto stream = std::make_unique<juce::FileOutputStream>(file);
+
+        if (! stream->openedOk())
+            return false;
+
+        juce::WavAudioFormat format;
+        std::unique_ptr<juce::AudioFormatWriter> writer(format.createWriterFor(stream.get(), sampleRate, (unsigned int)audio.getNumChannels(), 32, {}, 0));
+
+        if (writer == nullptr)
+            return false;
+
+        // The writer owns the stream now
+        stream.release();
+        return writer->writeFromAudioSampleBuffer(audio, 0, audio.getNumSamples());
+    }
+
+    static bool readWav(const juce::File& file, juce::AudioBuffer<float>& audio)
+    {
+        if (! file.existsAsFile())
+            return false;
+
+        juce::WavAudioFormat format;
+        std::unique_ptr<juce::AudioFormatReader> reader(format.createReaderFor(new juce::FileInputStream(file), true));
+
+        if (reader == nullptr)
+            return false;
+
+        audio.setSize((int)reader->numChannels, (int)reader->lengthInSamples);
+        return reader->read(&audio, 0, audio.getNumSamples(), 0, true, true);
+    }
+};
+
+static GoldenOutputTest goldenOutputTest;
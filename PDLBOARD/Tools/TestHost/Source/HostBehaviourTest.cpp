@@ -0,0 +1,289 @@
+/*
+  ==============================================================================
+
+    HostBehaviourTest.cpp
+
+  ==============================================================================
+*/
+
+#include <JuceHeader.h>
+#include "../../../Source/PluginProcessor.h"
+#include "TestHelpers.h"
+
+/*
+* Hammers one processor instance the way real hosts do: repeated prepareToPlay
+* calls with changing sample rates and block sizes, mono and stereo layouts,
+* blocks of any size up to the prepared maximum (1 and odd sizes included) and
+* parameter automation from another thread.
+*
+* Every block is checked for writes outside its own samples (guard samples on
+* both sides of the block), NaN/Inf output and time taken. Reads outside the
+* delay lines can't be seen from here, run the Sanitize configuration to catch those.
+*/
+class HostBehaviourTest : public juce::UnitTest
+{
+public:
+    HostBehaviourTest() : juce::UnitTest("Host behaviour", "PDLBOARD") {}
+
+    void runTest() override
+    {
+        PDLBOARDAudioProcessor processor;
+
+        // getRandom() hands out a copy, keep one generator for the whole run
+        random = getRandom();
+
+        beginTest("Random prepare/process sequences");
+        {
+            for (int session = 0; session < 40 && ! hasFailed; ++session)
+                runSession(processor, randomSession(), false);
+        }
+
+        beginTest("Single sample blocks");
+        {
+            runSession(processor, { 44100.0, 1, 2, 20000 }, false);
+            runSession(processor, { 96000.0, 1, 1, 20000 }, false);
+        }
+
+        beginTest("Sample rate going up between prepares");
+        {
+            // The delay lines have to grow with the sample rate, run with the longest delay
+            TestHelpers::setParameter(processor, "delaytime", 1.f);
+
+            for (auto sampleRate : { 22050.0, 44100.0, 192000.0, 8000.0, 384000.0 })
+                runSession(processor, { sampleRate, 512, 2, 2000 }, false, false);
+        }
+
+        beginTest("Automation from another thread");
+        {
+            TestHelpers::AutomationThread automation(processor, random.nextInt64());
+            automation.startThread();
+
+            for (int session = 0; session < 20 && ! hasFailed; ++session)
+                runSession(processor, randomSession(), true);
+        }
+
+        beginTest("Timing");
+        {
+            checkTiming();
+        }
+    }
+
+private:
+    struct Session
+    {
+        double sampleRate;
+        int maxBlockSize;
+        int numChannels;
+        int numBlocks;
+    };
+
+    struct BlockTiming
+    {
+        int numSamples;
+        double sampleRate;
+        double seconds;
+    };
+
+    static constexpr int guardSamples = 16;
+    static constexpr float guardValue = 1234.5f;
+
+    Session randomSession()
+    {
+        static const double sampleRates[] = { 22050.0, 44100.0, 48000.0, 88200.0, 96000.0, 176400.0, 192000.0 };
+        static const int blockSizes[] = { 1, 7, 32, 64, 127, 256, 441, 512, 1000, 1024, 2048, 4096 };
+
+        return { sampleRates[random.nextInt(juce::numElementsInArray(sampleRates))],
+                 blockSizes[random.nextInt(juce::numElementsInArray(blockSizes))],
+                 random.nextBool() ? 2 : 1,
+                 200 + random.nextInt(800) };
+    }
+
+    void runSession(PDLBOARDAudioProcessor& processor, Session session, bool automated, bool randomiseParameters = true)
+    {
+        auto description = juce::String(session.sampleRate) + " Hz, " + juce::String(session.maxBlockSize) + " max block, "
+                         + (session.numChannels == 2 ? "stereo" : "mono");
+
+        // Hosts are allowed to release and re-prepare, or to prepare twice in a row
+        if (random.nextInt(4) == 0)
+            processor.releaseResources();
+
+        processor.setPlayConfigDetails(session.numChannels, session.numChannels, session.sampleRate, session.maxBlockSize);
+        processor.prepareToPlay(session.sampleRate, session.maxBlockSize);
+
+        if (random.nextInt(4) == 0)
+            processor.prepareToPlay(session.sampleRate, session.maxBlockSize);
+
+        if (randomiseParameters && ! automated)
+        {
+            for (auto* parameter : processor.getParameters())
+                parameter->setValueNotifyingHost(random.nextFloat());
+
+            // Mostly with every effect running, that's where the indexing is
+            for (auto* id : { "onoff1", "onoff2", "onoff3", "onoff4", "onoff5", "onoff6", "onoff7", "onoff8" })
+                TestHelpers::setParameter(processor, id, random.nextInt(5) != 0 ? 1.f : 0.f);
+        }
+
+        storage.setSize(session.numChannels, session.maxBlockSize + 2 * guardSamples, false, false, true);
+
+        for (int block = 0; block < session.numBlocks; ++block)
+        {
+            auto numSamples = pickBlockSize(session.maxBlockSize);
+
+            fillInput(numSamples, session.sampleRate);
+
+            juce::AudioBuffer<float> view(storage.getArrayOfWritePointers(), session.numChannels, guardSamples, numSamples);
+
+            auto start = juce::Time::getHighResolutionTicks();
+            processor.processBlock(view, midi);
+            auto end = juce::Time::getHighResolutionTicks();
+
+            timings.push_back({ numSamples, session.sampleRate, juce::Time::highResolutionTicksToSeconds(end - start) });
+
+            if (! checkBlock(numSamples, description + ", block " + juce::String(block) + " of " + juce::String(numSamples)))
+                return;
+        }
+    }
+
+    int pickBlockSize(int maxBlockSize)
+    {
+        switch (random.nextInt(4))
+        {
+            case 0:     return maxBlockSize;
+            case 1:     return 1;
+            case 2:     return juce::jmin(maxBlockSize, 2 * random.nextInt(juce::jmax(1, maxBlockSize / 2)) + 1);
+            default:    return 1 + random.nextInt(maxBlockSize);
+        }
+    }
+
+    void fillInput(int numSamples, double sampleRate)
+    {
+        for (int channel = 0; channel < storage.getNumChannels(); ++channel)
+        {
+            auto* data = storage.getWritePointer(channel);
+
+            for (int i = 0; i < guardSamples; ++i)
+            {
+                data[i] = guardValue;
+                data[guardSamples + numSamples + i] = guardValue;
+            }
+
+            auto* block = data + guardSamples;
+
+            switch (random.nextInt(5))
+            {
+                case 0:
+                    juce::FloatVectorOperations::clear(block, numSamples);
+                    break;
+
+                case 1:
+                    juce::FloatVectorOperations::clear(block, numSamples);
+                    block[random.nextInt(numSamples)] = 1.f;
+                    break;
+
+                case 2:
+                    // Far above full scale, like a badly gain-staged DI
+                    for (int i = 0; i < numSamples; ++i)
+                        block[i] = (random.nextFloat() * 2.f - 1.f) * 16.f;
+                    break;
+
+                case 3:
+                    for (int i = 0; i < numSamples; ++i)
+                        block[i] = std::sin(juce::MathConstants<float>::twoPi * 110.f * (float)(phase + i) / (float)sampleRate);
+                    break;
+
+                default:
+                    for (int i = 0; i < numSamples; ++i)
+                        block[i] = random.nextFloat() * 2.f - 1.f;
+                    break;
+            }
+        }
+
+        phase += numSamples;
+    }
+
+    bool checkBlock(int numSamples, const juce::String& where)
+    {
+        for (int channel = 0; channel < storage.getNumChannels(); ++channel)
+        {
+            auto* data = storage.getReadPointer(channel);
+
+            for (int i = 0; i < guardSamples; ++i)
+            {
+                if (data[i] != guardValue || data[guardSamples + numSamples + i] != guardValue)
+                {
+                    expect(false, "Write outside the block: " + where + ", channel " + juce::String(channel));
+                    hasFailed = true;
+                    return false;
+                }
+            }
+
+            for (int i = 0; i < numSamples; ++i)
+            {
+                if (! std::isfinite(data[guardSamples + i]))
+                {
+                    expect(false, "Non-finite output: " + where + ", channel " + juce::String(channel) + ", sample " + juce::String(i));
+                    hasFailed = true;
+                    return false;
+                }
+            }
+        }
+
+        return true;
+    }
+
+    void checkTiming()
+    {
+        /*
+        * Small blocks are dominated by scheduling noise, so only blocks of 64
+        * samples or more count. A block is an outlier if it costs far more per
+        * sample than the median; an overrun if it takes longer than it lasts.
+        * A few of either can be the machine, many of them are the code.
+        */
+        std::vector<double> costs;
+
+        for (auto& timing : timings)
+            if (timing.numSamples >= 64)
+                costs.push_back(timing.seconds / timing.numSamples);
+
+        if (costs.empty())
+            return;
+
+        auto sorted = costs;
+        std::sort(sorted.begin(), sorted.end());
+
+        auto median = sorted[sorted.size() / 2];
+        auto p99 = sorted[(sorted.size() * 99) / 100];
+        auto worst = sorted.back();
+
+        int numOutliers = 0, numOverruns = 0;
+
+        for (auto& timing : timings)
+        {
+            if (timing.numSamples < 64)
+                continue;
+
+            if (timing.seconds > juce::jmax(20.0 * median * timing.numSamples, 0.0005))
+                ++numOutliers;
+
+            if (timing.seconds > timing.numSamples / timing.sampleRate)
+                ++numOverruns;
+        }
+
+        logMessage("Per-sample cost over " + juce::String((int)costs.size()) + " blocks: median "
+                   + juce::String(median * 1.0e9, 1) + " ns, p99 " + juce::String(p99 * 1.0e9, 1)
+                   + " ns, worst " + juce::String(worst * 1.0e9, 1) + " ns. "
+                   + juce::String(numOutliers) + " outliers, " + juce::String(numOverruns) + " realtime overruns");
+
+        expect(numOutliers <= (int)costs.size() / 200, "Too many slow blocks");
+        expect(numOverruns <= (int)costs.size() / 1000, "Blocks took longer than realtime");
+    }
+
+    juce::Random random;
+    juce::AudioBuffer<float> storage;
+    juce::MidiBuffer midi;
+    std::vector<BlockTiming> timings;
+    juce::int64 phase = 0;
+    bool hasFailed = false;
+};
+
+static HostBehaviourTest hostBehaviourTest;
@@ -0,0 +1,61 @@
+/*
+  ==============================================================================
+
+    Main.cpp
+
+    Runs the PDLBOARD unit tests against the real processor.
+
+        TestHost [--category <name>] [--seed <n>] [--golden <folder>] [--update-golden]
+
+    "--category Benchmarks" runs the benchmarks instead of the tests.
+
+    --update-golden re-records the golden renders instead of comparing against
+    them. Only do that on a build whose output has been checked by ear. A render
+    with no golden fails without it.
+
+    Exits with 1 if any test failed, so it can gate a build.
+
+  ==============================================================================
+*/
+
+#include <JuceHeader.h>
+#include "TestHelpers.h"
+
+int main(int argc, char* argv[])
+{
+    juce::ScopedJuceInitialiser_GUI juceInitialiser;
+    juce::ArgumentList args(argc, argv);
+
+    auto seed = args.containsOption("--seed") ? args.getValueForOption("--seed").getLargeIntValue()
+                                              : juce::Random::getSystemRandom().nextInt64();
+
+    auto category = args.containsOption("--category") ? args.getValueForOption("--category")
+                                                      : juce::String("PDLBOARD");
+
+    auto& options = TestHelpers::getOptions();
+    options.updateGolden = args.containsOption("--update-golden");
+
+    // By default the golden files live next to the test sources. __FILE__ is relative in some build systems.
+    auto workingDirectory = juce::File::getCurrentWorkingDirectory();
+
+    options.goldenFolder = args.containsOption("--golden")
+                               ? workingDirectory.getChildFile(args.getValueForOption("--golden"))
+                               : workingDirectory.getChildFile(__FILE__).getParentDirectory().getSiblingFile("Golden");
+
+    juce::UnitTestRunner runner;
+    runner.setAssertOnFailure(false);
+    runner.runTestsInCategory(category, seed);
+
+    int numFailures = 0;
+
+    for (int i = 0; i < runner.getNumResults(); ++i)
+        numFailures += runner.getResult(i)->failures;
+
+    if (runner.getNumResults() == 0)
+    {
+        std::cerr << "No tests in category " << category << std::endl;
+        return 1;
+    }
+
+    return numFailures > 0 ? 1 : 0;
+}
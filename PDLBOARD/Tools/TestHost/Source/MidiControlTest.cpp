@@ -0,0 +1,148 @@
+/*
+  ==============================================================================
+
+    MidiControlTest.cpp
+
+  ==============================================================================
+*/
+
+#include <JuceHeader.h>
+#include "../../../Source/PluginProcessor.h"
+#include "../../../Source/PresetBank.h"
+#include "TestHelpers.h"
+
+/*
+* MIDI into the processor: a footswitch landing where it was sent, on the
+* automation's grid, presses that bounce, learning a controller and keeping
+* it with the session, and program changes going through to the preset bank.
+*/
+class MidiControlTest : public juce::UnitTest
+{
+public:
+    MidiControlTest() : juce::UnitTest("MIDI control", "PDLBOARD") {}
+
+    void runTest() override
+    {
+        beginTest("A footswitch lands where it was sent");
+        {
+            PDLBOARDAudioProcessor processor;
+            TestHelpers::resetParametersToDefaults(processor);
+            TestHelpers::setParameterPlain(processor, "overdrive", 0.5f);
+
+            processor.setPlayConfigDetails(2, 2, sampleRate, blockSize);
+            processor.prepareToPlay(sampleRate, blockSize);
+
+            juce::AudioBuffer<float> block(2, blockSize);
+            juce::MidiBuffer midi;
+
+            // The default mapping, the overdrive's footswitch
+            const int switchAt = 100;
+            midi.addEvent(juce::MidiMessage::controllerEvent(1, 80, 127), switchAt);
+
+            for (int channel = 0; channel < 2; ++channel)
+                juce::FloatVectorOperations::fill(block.getWritePointer(channel), 0.25f, blockSize);
+
+            processor.processBlock(block, midi);
+
+            expectEquals(TestHelpers::getParameterPlain(processor, "onoff1"), 1.f);
+
+            for (int i = 0; i < switchAt; ++i)
+                expectEquals(block.getSample(0, i), 0.25f, "Switched early");
+
+            expectNotEquals(block.getSample(0, switchAt), 0.25f, "Switched late");
+        }
+
+        beginTest("A footswitch toggles once a press");
+        {
+            PDLBOARDAudioProcessor processor;
+            TestHelpers::resetParametersToDefaults(processor);
+
+            juce::AudioBuffer<float> block(2, blockSize);
+            block.clear();
+
+            // Down, held, up, down again
+            juce::MidiBuffer midi;
+            int position = 0;
+
+            for (auto value : { 127, 127, 0, 127 })
+                midi.addEvent(juce::MidiMessage::controllerEvent(1, 82, value), position += 10);
+
+            processor.processBlock(block, midi);
+            expectEquals(TestHelpers::getParameterPlain(processor, "onoff3"), 0.f);
+
+            // Anything unmapped leaves the block whole and the parameters alone
+            juce::MidiBuffer unmapped;
+            unmapped.addEvent(juce::MidiMessage::noteOn(1, 40, 1.f), 10);
+            unmapped.addEvent(juce::MidiMessage::controllerEvent(1, 30, 127), 20);
+
+            processor.processBlock(block, unmapped);
+            expectEquals(TestHelpers::getParameterPlain(processor, "onoff3"), 0.f);
+        }
+
+        beginTest("Learnt controllers stay with the session");
+        {
+            PDLBOARDAudioProcessor processor;
+            TestHelpers::resetParametersToDefaults(processor);
+
+            juce::AudioBuffer<float> block(2, blockSize);
+            block.clear();
+
+            processor.getMidiControl().learn("dry/wet2");
+            expect(processor.getMidiControl().isLearning());
+
+            juce::MidiBuffer midi;
+            midi.addEvent(juce::MidiMessage::controllerEvent(1, 20, 127), 0);
+            processor.processBlock(block, midi);
+
+            expect(! processor.getMidiControl().isLearning());
+            expectEquals(processor.getMidiControl().getMapping(20), juce::String("dry/wet2"));
+            expect(! processor.getMidiControl().isToggle(20));
+            expectWithinAbsoluteError(TestHelpers::getParameterPlain(processor, "dry/wet2"), 1.f, 1.0e-4f);
+
+            juce::MemoryBlock session;
+            processor.getStateInformation(session);
+
+            PDLBOARDAudioProcessor restored;
+            restored.setStateInformation(session.getData(), (int)session.getSize());
+            expectEquals(restored.getMidiControl().getMapping(20), juce::String("dry/wet2"));
+            expectEquals(restored.getMidiControl().getMapping(80), juce::String("onoff1"));
+        }
+
+        beginTest("Program changes switch to the bank's presets");
+        {
+            auto file = juce::File::getSpecialLocation(juce::File::tempDirectory).getNonexistentChildFile("pdlboard_midi", ".pdlk");
+
+            std::vector<PresetBank::Entry> entries(2);
+            entries[0].preset.name = "Clean";
+            entries[1].preset.name = "Echo";
+            entries[1].preset.values = { { "onoff3", 1.f }, { "delaytime", 0.25f } };
+            expect(PresetBank::write(file, entries));
+
+            PDLBOARDAudioProcessor processor;
+            TestHelpers::resetParametersToDefaults(processor);
+            expect(processor.loadPresetBank(file));
+
+            juce::AudioBuffer<float> block(2, blockSize);
+            block.clear();
+
+            juce::MidiBuffer midi;
+            midi.addEvent(juce::MidiMessage::programChange(1, 1), 0);
+            processor.processBlock(block, midi);
+
+            for (int n = 0; n < 200 && (processor.getCurrentProgram() != 1 || processor.getPresets().isSwitching()); ++n)
+                juce::Thread::sleep(5);
+
+            expectEquals(processor.getCurrentProgram(), 1);
+            expectEquals(processor.getPresets().getCurrentName(), juce::String("Echo"));
+            expectEquals(TestHelpers::getParameterPlain(processor, "onoff3"), 1.f);
+
+            file.deleteFile();
+        }
+    }
+
+private:
+    static constexpr double sampleRate = 48000.0;
+    static constexpr int blockSize = 512;
+};
+
+static MidiControlTest midiControlTest;
@@ -0,0 +1,147 @@
+/*
+  ==============================================================================
+
+    ModulationMatrixTest.cpp
+
+  ==============================================================================
+*/
+
+#include <JuceHeader.h>
+#include "../../../Source/PluginProcessor.h"
+#include "TestHelpers.h"
+
+/*
+* The modulation matrix moving parameters around where they were left:
+* text that doesn't make sense being refused, an LFO swinging a parameter
+* either side of its centre and letting go of it without ever writing to the
+* parameter itself, the centre following whatever else moves the parameter,
+* and a MIDI controller as a source.
+*/
+class ModulationMatrixTest : public juce::UnitTest
+{
+public:
+    ModulationMatrixTest() : juce::UnitTest("Modulation matrix", "PDLBOARD") {}
+
+    void runTest() override
+    {
+        beginTest("Modulation that doesn't make sense is refused");
+        {
+            PDLBOARDAudioProcessor processor;
+            auto& modulation = processor.getModulation();
+
+            expect(modulation.setModulation("lfo1 triangle 2, lfo1 > dry/wet2 0.5"));
+
+            for (auto text : { "lfo5 sine 1", "lfo1 wobble 1", "lfo1 sine 100", "env1 > nothing 0.5",
+                               "lfo1 > dry/wet2 2", "midi1 200", "env2 10", "lfo1 > onoff8 0.5" })
+            {
+                expect(! modulation.setModulation(text), text);
+                expect(modulation.getModulationError().isNotEmpty());
+            }
+
+            expectEquals(modulation.getModulation(), juce::String("lfo1 triangle 2, lfo1 > dry/wet2 0.5"));
+        }
+
+        beginTest("An LFO swings a parameter around its centre, then lets it go");
+        {
+            PDLBOARDAudioProcessor processor;
+            TestHelpers::resetParametersToDefaults(processor);
+            TestHelpers::setParameter(processor, "dry/wet2", 0.5f);
+            prepare(processor);
+
+            expect(processor.getModulation().setModulation("lfo1 sine 5, lfo1 > dry/wet2 0.25"));
+
+            auto lowest = 1.f, highest = 0.f;
+
+            // A second, five cycles
+            for (int n = 0; n < 48000 / blockSize; ++n)
+            {
+                process(processor);
+
+                auto value = getModulated(processor, "dry/wet2");
+                lowest = juce::jmin(lowest, value);
+                highest = juce::jmax(highest, value);
+
+                // Only the pedals hear about it
+                expectEquals(getParameter(processor, "dry/wet2")->getValue(), 0.5f);
+            }
+
+            expectWithinAbsoluteError(lowest, 0.25f, 0.02f);
+            expectWithinAbsoluteError(highest, 0.75f, 0.02f);
+
+            expect(processor.getModulation().setModulation({}));
+            process(processor);
+            expectEquals(getModulated(processor, "dry/wet2"), 0.5f);
+        }
+
+        beginTest("Moving a modulated parameter moves its centre");
+        {
+            PDLBOARDAudioProcessor processor;
+            TestHelpers::resetParametersToDefaults(processor);
+            TestHelpers::setParameter(processor, "dry/wet2", 0.5f);
+            prepare(processor);
+
+            // A square, so it's always a whole depth away from the centre
+            expect(processor.getModulation().setModulation("lfo1 square 0.1, lfo1 > dry/wet2 0.1"));
+            process(processor);
+            expectWithinAbsoluteError(getModulated(processor, "dry/wet2"), 0.6f, 1.0e-4f);
+
+            TestHelpers::setParameter(processor, "dry/wet2", 0.2f);
+            process(processor);
+            expectWithinAbsoluteError(getModulated(processor, "dry/wet2"), 0.3f, 1.0e-4f);
+
+            expect(processor.getModulation().setModulation({}));
+            process(processor);
+            expectWithinAbsoluteError(getModulated(processor, "dry/wet2"), 0.2f, 1.0e-4f);
+        }
+
+        beginTest("A MIDI controller as a source");
+        {
+            PDLBOARDAudioProcessor processor;
+            TestHelpers::resetParametersToDefaults(processor);
+            TestHelpers::setParameter(processor, "dry/wet2", 0.f);
+            prepare(processor);
+
+            expect(processor.getModulation().setModulation("midi1 7, midi1 > dry/wet2 1"));
+
+            juce::MidiBuffer midi;
+            midi.addEvent(juce::MidiMessage::controllerEvent(1, 7, 127), 0);
+            process(processor, midi);
+            process(processor);
+
+            expectWithinAbsoluteError(getModulated(processor, "dry/wet2"), 1.f, 1.0e-4f);
+            expectEquals(processor.getModulation().getSourceValue(GuitarEffectAudioProcessor::ModulationMatrix::numLFOs
+                                                                  + GuitarEffectAudioProcessor::ModulationMatrix::numEnvelopes), 1.f);
+        }
+    }
+
+private:
+    static constexpr double sampleRate = 48000.0;
+    static constexpr int blockSize = 256;
+
+    static void prepare(PDLBOARDAudioProcessor& processor)
+    {
+        processor.setPlayConfigDetails(2, 2, sampleRate, blockSize);
+        processor.prepareToPlay(sampleRate, blockSize);
+    }
+
+    static void process(PDLBOARDAudioProcessor& processor, juce::MidiBuffer midi = {})
+    {
+        juce::AudioBuffer<float> block(2, blockSize);
+        block.clear();
+        processor.processBlock(block, midi);
+    }
+
+    static juce::RangedAudioParameter* getParameter(PDLBOARDAudioProcessor& processor, const juce::String& id)
+    {
+        return processor.getValueTreeState().getParameter(id);
+    }
+
+    // Normalised, where the pedals read it
+    static float getModulated(PDLBOARDAudioProcessor& processor, const juce::String& id)
+    {
+        auto* parameter = getParameter(processor, id);
+        return juce::jlimit(0.f, 1.f, parameter->getValue() + processor.getModulation().getOffset(*parameter));
+    }
+};
+
+static ModulationMatrixTest modulationMatrixTest;
@@ -0,0 +1,261 @@
+/*
+  ==============================================================================
+
+    MultiTapDelayTest.cpp
+
+  ==============================================================================
+*/
+
+#include <JuceHeader.h>
+#include "../../../Source/PluginProcessor.h"
+#include "../../../Source/MultiTapDelay.h"
+#include "TestHelpers.h"
+
+/*
+* An impulse through the multi-tap delay: every tap's echo where its time
+* puts it, at its gain and on its side, ping-pong bouncing the feedback from
+* side to side, a changed tap gliding to its new time rather than clicking,
+* over the same time whatever the block size, and the processor's delay
+* time setting where the pattern ends.
+*/
+class MultiTapDelayTest : public juce::UnitTest
+{
+public:
+    MultiTapDelayTest() : juce::UnitTest("Multi-tap delay", "PDLBOARD") {}
+
+    void runTest() override
+    {
+        beginTest("Each tap lands at its time, gain and pan");
+        {
+            MultiTapDelay::Tap taps[2];
+            taps[0].time = 0.01f;
+            taps[0].pan = -1.f;
+            taps[1].time = 0.02f;
+            taps[1].gain = 0.5f;
+            taps[1].pan = 1.f;
+
+            MultiTapDelay::Settings settings;
+            settings.feedback = 0.f;
+            settings.dryWet = 1.f;
+
+            auto output = renderImpulse(taps, 2, settings, { 1.f, 1.f });
+
+            // Hard over is the middle's gain times root two
+            expectWithinAbsoluteError(getEcho(output, 0, 480), juce::MathConstants<float>::sqrt2, 1.0e-3f);
+            expectWithinAbsoluteError(getEcho(output, 1, 480), 0.f, 1.0e-6f);
+            expectWithinAbsoluteError(getEcho(output, 0, 960), 0.f, 1.0e-6f);
+            expectWithinAbsoluteError(getEcho(output, 1, 960), 0.5f * juce::MathConstants<float>::sqrt2, 1.0e-3f);
+
+            expectEquals(findPeak(output, 0, 0, 960), 480);
+            expectEquals(findPeak(output, 1, 480, 1440), 960);
+        }
+
+        beginTest("Ping-pong bounces from side to side");
+        {
+            MultiTapDelay::Tap tap;
+            tap.time = 0.01f;
+
+            MultiTapDelay::Settings settings;
+            settings.feedback = 0.5f;
+            settings.pingPong = true;
+            settings.dryWet = 1.f;
+
+            // Only in on the left, summed into the left line
+            auto output = renderImpulse(&tap, 1, settings, { 1.f, 0.f });
+
+            expectWithinAbsoluteError(getEcho(output, 0, 480), 0.5f, 1.0e-3f);
+            expectWithinAbsoluteError(getEcho(output, 1, 480), 0.f, 1.0e-6f);
+            expectWithinAbsoluteError(getEcho(output, 0, 960), 0.f, 1.0e-3f);
+            expectWithinAbsoluteError(getEcho(output, 1, 960), 0.25f, 1.0e-3f);
+            expectWithinAbsoluteError(getEcho(output, 0, 1440), 0.125f, 1.0e-3f);
+            expectWithinAbsoluteError(getEcho(output, 1, 1440), 0.f, 1.0e-3f);
+        }
+
+        beginTest("A new tap time glides rather than jumps");
+        {
+            MultiTapDelay::Tap tap;
+            tap.time = 0.01f;
+
+            MultiTapDelay::Settings settings;
+            settings.feedback = 0.f;
+            settings.dryWet = 1.f;
+
+            MultiTapDelay delay;
+            delay.prepare(sampleRate);
+            delay.setTaps(&tap, 1);
+
+            std::vector<float> left((size_t)lineLength), right((size_t)lineLength);
+            float* lines[] = { left.data(), right.data() };
+            int writeHead = 0;
+
+            // A slow sine, where a jump of a millisecond would be a step of over half its height
+            juce::AudioBuffer<float> output(2, 8 * blockSize);
+
+            for (int channel = 0; channel < 2; ++channel)
+                for (int i = 0; i < output.getNumSamples(); ++i)
+                    output.setSample(channel, i, (float)std::sin(juce::MathConstants<double>::twoPi * 100.0 * i / sampleRate));
+
+            for (int start = 0; start < output.getNumSamples(); start += blockSize)
+            {
+                if (start == 4 * blockSize)
+                {
+                    tap.time = 0.011f;
+                    delay.setTaps(&tap, 1);
+                }
+
+                juce::AudioBuffer<float> block(output.getArrayOfWritePointers(), 2, start, blockSize);
+                delay.process(block.getArrayOfWritePointers(), 2, blockSize, lines, lineLength, writeHead, settings);
+            }
+
+            // Once the echo's going, never more than the sine's own slope, bent a little by the glide
+            auto largestStep = 0.f;
+
+            for (int i = 2 * blockSize; i < output.getNumSamples(); ++i)
+                largestStep = juce::jmax(largestStep, std::abs(output.getSample(0, i) - output.getSample(0, i - 1)));
+
+            expectLessThan(largestStep, 0.03f);
+        }
+
+        beginTest("A glide takes as long whatever the block size");
+        {
+            // Small blocks would otherwise glide in a fraction of the time, and click
+            auto large = renderTapChange(blockSize);
+            auto small = renderTapChange(32);
+
+            auto largestDifference = 0.f;
+
+            for (int channel = 0; channel < 2; ++channel)
+                for (int i = 0; i < large.getNumSamples(); ++i)
+                    largestDifference = juce::jmax(largestDifference, std::abs(large.getSample(channel, i) - small.getSample(channel, i)));
+
+            expectEquals(largestDifference, 0.f);
+        }
+
+        beginTest("The delay time sets where the pattern ends");
+        {
+            PDLBOARDAudioProcessor processor;
+            TestHelpers::resetParametersToDefaults(processor);
+            TestHelpers::setParameter(processor, "onoff3", 1.f);
+            TestHelpers::setParameterPlain(processor, "delaymode", 1.f);
+            TestHelpers::setParameterPlain(processor, "delaytaps", 4.f);
+            TestHelpers::setParameterPlain(processor, "delaytime", 0.1f);
+            TestHelpers::setParameterPlain(processor, "tapspread", 0.f);
+
+            processor.setPlayConfigDetails(2, 2, sampleRate, blockSize);
+            processor.prepareToPlay(sampleRate, blockSize);
+
+            juce::AudioBuffer<float> audio(2, 6000);
+            audio.clear();
+            audio.setSample(0, 0, 1.f);
+            audio.setSample(1, 0, 1.f);
+
+            juce::MidiBuffer midi;
+
+            for (int start = 0; start < audio.getNumSamples(); start += blockSize)
+            {
+                juce::AudioBuffer<float> block(audio.getArrayOfWritePointers(), 2, start, juce::jmin(blockSize, audio.getNumSamples() - start));
+                processor.processBlock(block, midi);
+            }
+
+            // Evenly spread over 100 ms, and nothing between them once each has died away
+            for (int tap = 1; tap <= 4; ++tap)
+            {
+                auto at = tap * 1200;
+                expectEquals(findPeak(audio, 0, at - 600, at + 600), at);
+                expectLessThan(audio.getMagnitude(0, at + 300, 300), 1.0e-3f);
+            }
+        }
+    }
+
+private:
+    static constexpr double sampleRate = 48000.0;
+    static constexpr int blockSize = 256;
+    static constexpr int lineLength = 4800;
+
+    static juce::AudioBuffer<float> renderImpulse(const MultiTapDelay::Tap* taps, int numTaps,
+                                                  const MultiTapDelay::Settings& settings, std::array<float, 2> impulse)
+    {
+        MultiTapDelay delay;
+        delay.prepare(sampleRate);
+        delay.setTaps(taps, numTaps);
+
+        std::vector<float> left((size_t)lineLength), right((size_t)lineLength);
+        float* lines[] = { left.data(), right.data() };
+        int writeHead = 0;
+
+        juce::AudioBuffer<float> output(2, 2400);
+        output.clear();
+        output.setSample(0, 0, impulse[0]);
+        output.setSample(1, 0, impulse[1]);
+
+        for (int start = 0; start < output.getNumSamples(); start += blockSize)
+        {
+            juce::AudioBuffer<float> block(output.getArrayOfWritePointers(), 2, start, juce::jmin(blockSize, output.getNumSamples() - start));
+            delay.process(block.getArrayOfWritePointers(), 2, block.getNumSamples(), lines, lineLength, writeHead, settings);
+        }
+
+        return output;
+    }
+
+    // A sine through two taps, the second moved and a third added part way through
+    static juce::AudioBuffer<float> renderTapChange(int numSamplesPerBlock)
+    {
+        MultiTapDelay::Tap taps[3];
+        taps[0].time = 0.01f;
+        taps[1].time = 0.02f;
+        taps[2].time = 0.03f;
+
+        MultiTapDelay::Settings settings;
+        settings.feedback = 0.5f;
+
+        MultiTapDelay delay;
+        delay.prepare(sampleRate);
+
+        std::vector<float> left((size_t)lineLength), right((size_t)lineLength);
+        float* lines[] = { left.data(), right.data() };
+        int writeHead = 0;
+
+        juce::AudioBuffer<float> output(2, 8 * blockSize);
+
+        for (int channel = 0; channel < 2; ++channel)
+            for (int i = 0; i < output.getNumSamples(); ++i)
+                output.setSample(channel, i, (float)std::sin(juce::MathConstants<double>::twoPi * 100.0 * i / sampleRate));
+
+        for (int start = 0; start < output.getNumSamples(); start += numSamplesPerBlock)
+        {
+            if (start == 4 * blockSize)
+                taps[1].time = 0.025f;
+
+            delay.setTaps(taps, start < 4 * blockSize ? 2 : 3);
+
+            juce::AudioBuffer<float> block(output.getArrayOfWritePointers(), 2, start, numSamplesPerBlock);
+            delay.process(block.getArrayOfWritePointers(), 2, numSamplesPerBlock, lines, lineLength, writeHead, settings);
+        }
+
+        return output;
+    }
+
+    // Everything an echo starting at the sample puts out, the tap's low-pass letting it all through in the end
+    static float getEcho(const juce::AudioBuffer<float>& output, int channel, int start)
+    {
+        auto sum = 0.f;
+
+        for (int i = start; i < start + 480; ++i)
+            sum += output.getSample(channel, i);
+
+        return sum;
+    }
+
+    static int findPeak(const juce::AudioBuffer<float>& output, int channel, int start, int end)
+    {
+        auto peak = start;
+
+        for (int i = start; i < end; ++i)
+            if (std::abs(output.getSample(channel, i)) > std::abs(output.getSample(channel, peak)))
+                peak = i;
+
+        return peak;
+    }
+};
+
+static MultiTapDelayTest multiTapDelayTest;
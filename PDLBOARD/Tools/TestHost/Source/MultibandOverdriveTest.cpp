@@ -0,0 +1,95 @@
+/*
+  ==============================================================================
+
+    MultibandOverdriveTest.cpp
+
+  ==============================================================================
+*/
+
+#include <JuceHeader.h>
+#include "../../../Source/MultibandOverdrive.h"
+
+/*
+* The crossovers with the atan kept out of the way (blend at 0, so each band is
+* only its clean signal), then the atan itself.
+*/
+class MultibandOverdriveTest : public juce::UnitTest
+{
+public:
+    MultibandOverdriveTest() : juce::UnitTest("Multiband overdrive", "PDLBOARD") {}
+
+    void runTest() override
+    {
+        const float crossovers[] = { 2500.f, 200.f, 800.f };
+
+        beginTest("Bands sum back to flat");
+        {
+            for (int numBands = 1; numBands <= MultibandOverdrive::maximumBands; ++numBands)
+            {
+                MultibandOverdrive overdrive;
+                overdrive.setCrossovers(numBands, crossovers);
+                overdrive.prepare(sampleRate);
+
+                // Volume 2 undoes the atan's halving
+                for (int band = 0; band < MultibandOverdrive::maximumBands; ++band)
+                    overdrive.setBand(band, 1.f, 0.f, 2.f);
+
+                for (auto frequency : { 50.0, 200.0, 500.0, 800.0, 1600.0, 2500.0, 8000.0 })
+                    expectWithinAbsoluteError(measureGain(overdrive, frequency), 0.0, 0.01);
+            }
+        }
+
+        beginTest("A band on its own");
+        {
+            MultibandOverdrive overdrive;
+            overdrive.setCrossovers(4, crossovers);
+            overdrive.prepare(sampleRate);
+
+            // Only the band from 800 Hz to 2.5 kHz
+            for (int band = 0; band < MultibandOverdrive::maximumBands; ++band)
+                overdrive.setBand(band, 1.f, 0.f, band == 2 ? 2.f : 0.f);
+
+            expectGreaterThan(measureGain(overdrive, 1400.0), -3.0);
+
+            // Each crossover is -6 dB, and 24 dB an octave past it
+            expectWithinAbsoluteError(measureGain(overdrive, 2500.0), -6.0, 0.5);
+            expectLessThan(measureGain(overdrive, 200.0), -40.0);
+            expectLessThan(measureGain(overdrive, 10000.0), -40.0);
+        }
+
+        beginTest("Fast atan");
+        {
+            double worstError = 0.0;
+
+            for (double x = -100.0; x < 100.0; x += 0.001)
+                worstError = juce::jmax(worstError, std::abs((double)MultibandOverdrive::fastAtan((float)x) - std::atan(x)));
+
+            expect(worstError < 2.0e-5, "Worst error " + juce::String(worstError));
+        }
+    }
+
+private:
+    static constexpr double sampleRate = 48000.0;
+
+    // In dB, once the filters have settled
+    static double measureGain(MultibandOverdrive& overdrive, double frequency)
+    {
+        overdrive.reset();
+
+        std::vector<float> samples((size_t)sampleRate);
+
+        for (size_t i = 0; i < samples.size(); ++i)
+            samples[i] = (float)std::sin(juce::MathConstants<double>::twoPi * frequency * (double)i / sampleRate);
+
+        overdrive.process(samples.data(), (int)samples.size());
+
+        double power = 0.0;
+
+        for (size_t i = samples.size() / 2; i < samples.size(); ++i)
+            power += samples[i] * samples[i];
+
+        return juce::Decibels::gainToDecibels(std::sqrt(power / (double)(samples.size() / 4)), -200.0);
+    }
+};
+
+static MultibandOverdriveTest multibandOverdriveTest;
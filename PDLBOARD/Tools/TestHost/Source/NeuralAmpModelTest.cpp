@@ -0,0 +1,283 @@
+/*
+  ==============================================================================
+
+    NeuralAmpModelTest.cpp
+
+  ==============================================================================
+*/
+
+#include <JuceHeader.h>
+#include "../../../Source/NeuralAmpModel.h"
+#include "TestHelpers.h"
+
+namespace
+{
+    // A second of something like a guitar: a decaying low note with a bit of noise on it
+    std::vector<float> makeGuitar(int length, double sampleRate, juce::Random& random)
+    {
+        std::vector<float> signal((size_t)length);
+
+        for (int i = 0; i < length; ++i)
+        {
+            auto t = i / sampleRate;
+            signal[(size_t)i] = (float)(0.8 * std::exp(-2.0 * t) * std::sin(juce::MathConstants<double>::twoPi * 110.0 * t))
+                               + 0.05f * (random.nextFloat() * 2.f - 1.f);
+        }
+
+        return signal;
+    }
+
+    // Flat random weights in the layout NeuralAmpModel.cpp documents for WaveNet models
+    juce::var createWaveNetModel(int channels, int kernelSize, const juce::Array<juce::var>& dilations, juce::Random& random)
+    {
+        auto layerSize = 2 * channels * channels * kernelSize + 2 * channels + channels * channels + channels;
+        auto numWeights = 2 * channels + dilations.size() * layerSize + channels + 1;
+
+        juce::Array<juce::var> weights;
+
+        for (int i = 0; i < numWeights; ++i)
+            weights.add(0.4f * (random.nextFloat() * 2.f - 1.f));
+
+        auto* model = new juce::DynamicObject();
+        model->setProperty("architecture", "WaveNet");
+        model->setProperty("channels", channels);
+        model->setProperty("kernel_size", kernelSize);
+        model->setProperty("dilations", dilations);
+        model->setProperty("weights", weights);
+
+        return juce::var(model);
+    }
+}
+
+/*
+* The engine against a plain double precision LSTM and GRU written straight
+* from PyTorch's equations, and the loader's refusals.
+*/
+class NeuralAmpModelTest : public juce::UnitTest
+{
+public:
+    NeuralAmpModelTest() : juce::UnitTest("Neural amp model", "PDLBOARD") {}
+
+    void runTest() override
+    {
+        random = getRandom();
+
+        beginTest("LSTM and GRU match a double precision reference");
+        {
+            for (auto* unitType : { "LSTM", "GRU" })
+            {
+                for (auto hiddenSize : { 12, 40 })
+                {
+                    auto json = TestHelpers::createRecurrentModel(unitType, hiddenSize, random);
+
+                    juce::String error;
+                    auto model = NeuralAmpModel::fromJSON(json, error);
+                    expect(model != nullptr, error);
+
+                    if (model == nullptr)
+                        continue;
+
+                    auto input = makeGuitar(48000, 48000.0, random);
+                    auto output = input;
+
+                    // Odd blocks, the state has to carry across them
+                    for (int start = 0; start < (int)output.size(); start += 173)
+                        model->process(output.data() + start, output.data() + start, juce::jmin(173, (int)output.size() - start));
+
+                    auto reference = runReference(json, input);
+                    double peakError = 0.0;
+
+                    for (size_t i = 0; i < input.size(); ++i)
+                        peakError = juce::jmax(peakError, std::abs(reference[i] - output[i]));
+
+                    // The activations are approximations good to about 1e-4
+                    expect(peakError < 1.0e-3, model->getDescription() + " peak error " + juce::String(peakError));
+                }
+            }
+        }
+
+        beginTest("Clones start from silence with the same weights");
+        {
+            juce::String error;
+            auto model = NeuralAmpModel::fromJSON(TestHelpers::createRecurrentModel("LSTM", 20, random), error);
+            expect(model != nullptr, error);
+
+            auto input = makeGuitar(4800, 48000.0, random);
+            auto first = input, second = input;
+
+            model->process(first.data(), first.data(), (int)first.size());
+            model->clone()->process(second.data(), second.data(), (int)second.size());
+
+            expect(first == second);
+        }
+
+        beginTest("WaveNet models load and run");
+        {
+            juce::String error;
+            auto model = NeuralAmpModel::fromJSON(createWaveNetModel(8, 3, { 1, 2, 4, 8, 16, 32, 64, 128 }, random), error);
+            expect(model != nullptr, error);
+
+            if (model != nullptr)
+            {
+                auto signal = makeGuitar(4800, 48000.0, random);
+                model->process(signal.data(), signal.data(), (int)signal.size());
+
+                for (auto sample : signal)
+                    expect(std::isfinite(sample));
+            }
+        }
+
+        beginTest("Models it can't run are refused with a reason");
+        {
+            juce::String error;
+
+            expect(NeuralAmpModel::fromJSON(TestHelpers::createRecurrentModel("LSTM", 10, random), error) == nullptr);
+            expect(error.contains("hidden_size"), error);
+
+            error.clear();
+            auto json = TestHelpers::createRecurrentModel("GRU", 16, random);
+            json["state_dict"].getDynamicObject()->setProperty("rec.bias_hh_l0", juce::Array<juce::var> { 1.0, 2.0 });
+            expect(NeuralAmpModel::fromJSON(json, error) == nullptr);
+            expect(error.contains("rec.bias_hh_l0"), error);
+
+            error.clear();
+            expect(NeuralAmpModel::fromJSON(createWaveNetModel(6, 3, { 1, 2 }, random), error) == nullptr);
+            expect(error.contains("channels"), error);
+
+            error.clear();
+            expect(NeuralAmpModel::fromJSON(juce::JSON::parse(juce::String("{ \"hello\": 1 }")), error) == nullptr);
+            expect(error.isNotEmpty());
+        }
+    }
+
+private:
+    static std::vector<double> runReference(const juce::var& json, const std::vector<float>& input)
+    {
+        auto modelData = json["model_data"];
+        auto stateDict = json["state_dict"];
+
+        auto isLSTM = modelData["unit_type"].toString() == "LSTM";
+        auto hiddenSize = (int)modelData["hidden_size"];
+        auto numGates = isLSTM ? 4 : 3;
+
+        auto inputWeights = stateDict["rec.weight_ih_l0"];
+        auto hiddenWeights = stateDict["rec.weight_hh_l0"];
+        auto inputBias = stateDict["rec.bias_ih_l0"];
+        auto hiddenBias = stateDict["rec.bias_hh_l0"];
+        auto linearWeights = stateDict["lin.weight"][0];
+        auto linearBias = (double)stateDict["lin.bias"][0];
+
+        auto sigmoid = [] (double x) { return 1.0 / (1.0 + std::exp(-x)); };
+
+        std::vector<double> hidden((size_t)hiddenSize, 0.0), cell((size_t)hiddenSize, 0.0);
+        std::vector<double> fromInput((size_t)(numGates * hiddenSize)), fromHidden((size_t)(numGates * hiddenSize));
+        std::vector<double> output;
+
+        for (auto sample : input)
+        {
+            for (int row = 0; row < numGates * hiddenSize; ++row)
+            {
+                fromInput[(size_t)row] = (double)inputWeights[row][0] * sample + (double)inputBias[row];
+                fromHidden[(size_t)row] = (double)hiddenBias[row];
+
+                for (int column = 0; column < hiddenSize; ++column)
+                    fromHidden[(size_t)row] += (double)hiddenWeights[row][column] * hidden[(size_t)column];
+            }
+
+            for (int j = 0; j < hiddenSize; ++j)
+            {
+                auto gate = [&] (int index) { return fromInput[(size_t)(index * hiddenSize + j)] + fromHidden[(size_t)(index * hiddenSize + j)]; };
+
+                if (isLSTM)
+                {
+                    cell[(size_t)j] = sigmoid(gate(1)) * cell[(size_t)j] + sigmoid(gate(0)) * std::tanh(gate(2));
+                    hidden[(size_t)j] = sigmoid(gate(3)) * std::tanh(cell[(size_t)j]);
+                }
+                else
+                {
+                    auto reset = sigmoid(gate(0));
+                    auto update = sigmoid(gate(1));
+                    auto candidate = std::tanh(fromInput[(size_t)(2 * hiddenSize + j)] + reset * fromHidden[(size_t)(2 * hiddenSize + j)]);
+
+                    hidden[(size_t)j] = (1.0 - update) * candidate + update * hidden[(size_t)j];
+                }
+            }
+
+            auto y = linearBias + sample;
+
+            for (int j = 0; j < hiddenSize; ++j)
+                y += (double)linearWeights[j] * hidden[(size_t)j];
+
+            output.push_back(y);
+        }
+
+        return output;
+    }
+
+    juce::Random random;
+};
+
+static NeuralAmpModelTest neuralAmpModelTest;
+
+//==============================================================================
+/*
+* How many mono instances of each model size one core keeps up with at 48 kHz,
+* which is what decides how many captures a board can run. Single threaded, so
+* it's per core whatever the machine. Run it with "TestHost --category
+* Benchmarks" on a release build.
+*/
+class NeuralAmpBenchmark : public juce::UnitTest
+{
+public:
+    NeuralAmpBenchmark() : juce::UnitTest("Neural amp model", "Benchmarks") {}
+
+    void runTest() override
+    {
+        random = getRandom();
+
+        beginTest("Instances per core");
+        {
+            logMessage("48 kHz mono, 256 sample blocks, " + juce::String(seconds, 0) + " s of audio per model");
+
+            auto input = makeGuitar((int)(seconds * sampleRate), sampleRate, random);
+
+            for (auto* unitType : { "LSTM", "GRU" })
+                for (auto hiddenSize : { 8, 16, 20, 32, 40, 64 })
+                    report(TestHelpers::createRecurrentModel(unitType, hiddenSize, random), input);
+
+            report(createWaveNetModel(8, 3, { 1, 2, 4, 8, 16, 32, 64, 128, 256, 512 }, random), input);
+            report(createWaveNetModel(16, 3, { 1, 2, 4, 8, 16, 32, 64, 128, 256, 512 }, random), input);
+        }
+    }
+
+private:
+    static constexpr double sampleRate = 48000.0;
+    static constexpr double seconds = 5.0;
+    static constexpr int blockSize = 256;
+
+    void report(const juce::var& json, const std::vector<float>& input)
+    {
+        juce::String error;
+        auto model = NeuralAmpModel::fromJSON(json, error);
+        expect(model != nullptr, error);
+
+        if (model == nullptr)
+            return;
+
+        auto buffer = input;
+        auto ticks = juce::Time::getHighResolutionTicks();
+
+        for (int start = 0; start < (int)buffer.size(); start += blockSize)
+            model->process(buffer.data() + start, buffer.data() + start, juce::jmin(blockSize, (int)buffer.size() - start));
+
+        auto elapsed = juce::Time::highResolutionTicksToSeconds(juce::Time::getHighResolutionTicks() - ticks);
+
+        logMessage(model->getDescription().paddedRight(' ', 26)
+                   + juce::String(1.0e9 * elapsed / (double)buffer.size(), 1).paddedLeft(' ', 8) + " ns/sample"
+                   + juce::String(seconds / elapsed, 1).paddedLeft(' ', 9) + " instances");
+    }
+
+    juce::Random random;
+};
+
+static NeuralAmpBenchmark neuralAmpBenchmark;
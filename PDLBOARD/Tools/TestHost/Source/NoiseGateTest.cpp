@@ -0,0 +1,149 @@
+/*
+  ==============================================================================
+
+    NoiseGateTest.cpp
+
+  ==============================================================================
+*/
+
+#include <JuceHeader.h>
+#include "../../../Source/PluginProcessor.h"
+#include "TestHelpers.h"
+
+/*
+* The gate through the whole processor, in mono so the legacy delay loop runs
+* once a sample: hum under the threshold, a note's attack through the
+* lookahead, and the chain going idle only once the delay has died away.
+*/
+class NoiseGateTest : public juce::UnitTest
+{
+public:
+    NoiseGateTest() : juce::UnitTest("Noise gate", "PDLBOARD") {}
+
+    void runTest() override
+    {
+        beginTest("Latency follows the on / off");
+        {
+            PDLBOARDAudioProcessor processor;
+            prepare(processor);
+            expectEquals(processor.getLatencySamples(), 0);
+
+            TestHelpers::setParameter(processor, "onoff8", 1.f);
+            expectEquals(processor.getLatencySamples(), lookahead);
+
+            TestHelpers::setParameter(processor, "onoff8", 0.f);
+            expectEquals(processor.getLatencySamples(), 0);
+        }
+
+        beginTest("Hum under the threshold is silenced");
+        {
+            PDLBOARDAudioProcessor processor;
+            prepare(processor);
+            TestHelpers::setParameter(processor, "onoff8", 1.f);
+            TestHelpers::setParameterPlain(processor, "gatethreshold", -40.f);
+
+            // 50 Hz at -60 dB, under the threshold, through the hardest overdrive
+            TestHelpers::setParameter(processor, "onoff1", 1.f);
+            TestHelpers::setParameterPlain(processor, "range", 300.f);
+
+            juce::AudioBuffer<float> audio(1, (int)sampleRate);
+
+            for (int i = 0; i < audio.getNumSamples(); ++i)
+                audio.setSample(0, i, 0.001f * (float)std::sin(juce::MathConstants<double>::twoPi * 50.0 * i / sampleRate));
+
+            render(processor, audio);
+
+            expectEquals(audio.getMagnitude(0, audio.getNumSamples()), 0.f);
+        }
+
+        beginTest("A note comes through with its attack");
+        {
+            PDLBOARDAudioProcessor processor;
+            prepare(processor);
+            TestHelpers::setParameter(processor, "onoff8", 1.f);
+            TestHelpers::setParameterPlain(processor, "gatethreshold", -40.f);
+
+            auto input = createNote(0.2, 0.1);
+            juce::AudioBuffer<float> output;
+            output.makeCopyOf(input);
+
+            render(processor, output);
+
+            // Fully open by the time the note's first sample comes out of the lookahead
+            auto noteStart = (int)(0.2 * sampleRate);
+            auto worstDifference = 0.f;
+
+            for (int i = noteStart; i < noteStart + (int)(0.1 * sampleRate); ++i)
+                worstDifference = juce::jmax(worstDifference, std::abs(output.getSample(0, i + lookahead) - input.getSample(0, i)));
+
+            expectLessThan(worstDifference, 1.0e-5f);
+        }
+
+        beginTest("The delay rings on, then the chain idles");
+        {
+            PDLBOARDAudioProcessor processor;
+            prepare(processor);
+            TestHelpers::setParameter(processor, "onoff8", 1.f);
+            TestHelpers::setParameterPlain(processor, "gatethreshold", -40.f);
+            TestHelpers::setParameterPlain(processor, "gatehold", 50.f);
+            TestHelpers::setParameterPlain(processor, "gaterelease", 100.f);
+
+            TestHelpers::setParameter(processor, "onoff3", 1.f);
+            TestHelpers::setParameterPlain(processor, "delaytime", 0.1f);
+            TestHelpers::setParameterPlain(processor, "feedback2", 0.5f);
+            TestHelpers::setParameterPlain(processor, "dry/wet2", 0.5f);
+
+            auto audio = createNote(0.2, 0.1, 3.5);
+            render(processor, audio);
+
+            // The gate's shut by 0.5 seconds, the echoes carry on
+            auto echoes = audio.getMagnitude(0, (int)(0.5 * sampleRate), (int)(0.1 * sampleRate));
+            expectGreaterThan(echoes, 0.01f);
+
+            // Halving every echo takes them under -100 dB in 17 repeats, but never to
+            // zero, so silence here means the delay stopped running
+            auto end = audio.getMagnitude(0, (int)(3.0 * sampleRate), (int)(0.5 * sampleRate));
+            expectEquals(end, 0.f);
+        }
+    }
+
+private:
+    static constexpr double sampleRate = 48000.0;
+    static constexpr int blockSize = 256;
+
+    // The gate's attack time at this rate
+    static constexpr int lookahead = 48;
+
+    static void prepare(PDLBOARDAudioProcessor& processor)
+    {
+        TestHelpers::resetParametersToDefaults(processor);
+
+        processor.setPlayConfigDetails(1, 1, sampleRate, blockSize);
+        processor.prepareToPlay(sampleRate, blockSize);
+    }
+
+    static void render(PDLBOARDAudioProcessor& processor, juce::AudioBuffer<float>& audio)
+    {
+        juce::MidiBuffer midi;
+
+        for (int start = 0; start < audio.getNumSamples(); start += blockSize)
+        {
+            juce::AudioBuffer<float> block(audio.getArrayOfWritePointers(), 1, start, juce::jmin(blockSize, audio.getNumSamples() - start));
+            processor.processBlock(block, midi);
+        }
+    }
+
+    // A 220 Hz note starting at its peak, in silence
+    static juce::AudioBuffer<float> createNote(double start, double length, double total = 1.0)
+    {
+        juce::AudioBuffer<float> audio(1, (int)(total * sampleRate));
+        audio.clear();
+
+        for (int i = 0; i < (int)(length * sampleRate); ++i)
+            audio.setSample(0, (int)(start * sampleRate) + i, 0.5f * (float)std::cos(juce::MathConstants<double>::twoPi * 220.0 * i / sampleRate));
+
+        return audio;
+    }
+};
+
+static NoiseGateTest noiseGateTest;
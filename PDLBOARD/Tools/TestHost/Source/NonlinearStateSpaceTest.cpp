@@ -0,0 +1,155 @@
+/*
+  ==============================================================================
+
+    NonlinearStateSpaceTest.cpp
+
+  ==============================================================================
+*/
+
+#include <JuceHeader.h>
+#include "../../../Source/TubePreamp.h"
+
+/*
+* The DK solver against circuits worked out by hand, and its table against the
+* Newton solve it stands in for.
+*/
+class NonlinearStateSpaceTest : public juce::UnitTest
+{
+public:
+    NonlinearStateSpaceTest() : juce::UnitTest("Nonlinear state space", "PDLBOARD") {}
+
+    void runTest() override
+    {
+        beginTest("Diode clipper matches a trapezoidal solve");
+        {
+            // A resistor into a capacitor with an anti-parallel diode pair across it, one port
+            const double R = 2200.0, C = 10.0e-9, Is = 2.52e-9, Vt = 1.752 * 25.85e-3;
+
+            NonlinearStateSpace::Circuit circuit;
+            circuit.addInput(1, 0);
+            circuit.addResistor(1, 2, R);
+            circuit.addCapacitor(2, 0, C);
+            circuit.addNonlinearPort(2, 0);
+            circuit.setOutput(2, 0);
+            circuit.setNonlinearity([=] (const double* v, double* i, double* jacobian)
+            {
+                i[0] = 2.0 * Is * std::sinh(v[0] / Vt);
+                jacobian[0] = 2.0 * Is * std::cosh(v[0] / Vt) / Vt;
+            });
+
+            NonlinearStateSpace model(circuit, sampleRate, 3.0, 256);
+            NonlinearStateSpace::Channel channel(model);
+
+            auto f = [&] (double v, double input) { return (input - v) / (R * C) - 2.0 * Is * std::sinh(v / Vt) / C; };
+            double v = 0.0, previousInput = 0.0, worstSimulated = 0.0, worstTabulated = 0.0;
+
+            std::vector<double> input;
+
+            for (int i = 0; i < 9600; ++i)
+                input.push_back(3.0 * std::sin(juce::MathConstants<double>::twoPi * 220.0 * i / sampleRate));
+
+            auto simulated = model.simulate(input);
+
+            for (size_t i = 0; i < input.size(); ++i)
+            {
+                auto previousSlope = f(v, previousInput);
+                auto next = v;
+
+                for (int iteration = 0; iteration < 50; ++iteration)
+                {
+                    auto residual = next - v - 0.5 / sampleRate * (previousSlope + f(next, input[i]));
+                    auto derivative = 1.0 + 0.5 / sampleRate * (1.0 / (R * C) + 2.0 * Is * std::cosh(next / Vt) / (Vt * C));
+                    next -= residual / derivative;
+                }
+
+                v = next;
+                previousInput = input[i];
+
+                worstSimulated = juce::jmax(worstSimulated, std::abs(simulated[i] - v));
+                worstTabulated = juce::jmax(worstTabulated, std::abs((double)channel.processSample((float)input[i]) - v));
+            }
+
+            expect(worstSimulated < 1.0e-9, "Simulated worst error " + juce::String(worstSimulated) + " V");
+            expect(worstTabulated < 5.0e-3, "Tabulated worst error " + juce::String(worstTabulated) + " V");
+        }
+
+        beginTest("Triode stage's table follows its Newton solve");
+        {
+            NonlinearStateSpace model(TubePreamp::createStage(), sampleRate, TubePreamp::maximumInput, 256);
+
+            for (auto amplitude : { 0.05, 0.5, 2.0, 8.0, TubePreamp::maximumInput })
+            {
+                std::vector<double> input;
+
+                for (int i = 0; i < 9600; ++i)
+                    input.push_back(amplitude * std::sin(juce::MathConstants<double>::twoPi * 220.0 * i / sampleRate));
+
+                auto simulated = model.simulate(input);
+                NonlinearStateSpace::Channel channel(model);
+                double worstError = 0.0, peak = 0.0;
+
+                for (size_t i = 0; i < input.size(); ++i)
+                {
+                    worstError = juce::jmax(worstError, std::abs((double)channel.processSample((float)input[i]) - simulated[i]));
+                    peak = juce::jmax(peak, std::abs(simulated[i]));
+                }
+
+                // About 10 dB better for every doubling of the table
+                auto errorDecibels = juce::Decibels::gainToDecibels(worstError / peak, -200.0);
+                expect(errorDecibels < -35.0, juce::String(amplitude) + " V in, " + juce::String(errorDecibels) + " dB");
+            }
+        }
+
+        beginTest("Triode stage's gain and swing");
+        {
+            NonlinearStateSpace model(TubePreamp::createStage(), sampleRate, TubePreamp::maximumInput, 256);
+            NonlinearStateSpace::Channel channel(model);
+
+            // Silence stays at the operating point, which the table has a point on
+            auto worstSilence = 0.f;
+
+            for (int i = 0; i < 4800; ++i)
+                worstSilence = juce::jmax(worstSilence, std::abs(channel.processSample(0.f)));
+
+            expect(worstSilence < 1.0e-6f, "Silence came out at " + juce::String(worstSilence) + " V");
+
+            // A bypassed 12AX7 stage with a 100k load, roughly mu ra / (ra + RL) with ra about 60k
+            auto measure = [&] (double amplitude, double& gain, double& swingUp, double& swingDown)
+            {
+                channel.reset();
+                double inputPower = 0.0, outputPower = 0.0;
+                swingUp = swingDown = 0.0;
+
+                for (int i = 0; i < (int)sampleRate; ++i)
+                {
+                    auto input = amplitude * std::sin(juce::MathConstants<double>::twoPi * 1000.0 * i / sampleRate);
+                    auto output = (double)channel.processSample((float)input);
+
+                    if (i >= (int)sampleRate / 2)
+                    {
+                        inputPower += input * input;
+                        outputPower += output * output;
+                        swingUp = juce::jmax(swingUp, output);
+                        swingDown = juce::jmax(swingDown, -output);
+                    }
+                }
+
+                gain = std::sqrt(outputPower / inputPower);
+            };
+
+            double gain, up, down;
+            measure(0.01, gain, up, down);
+            expect(gain > 50.0 && gain < 75.0, "Small signal gain " + juce::String(gain));
+
+            // Driven hard it clips, and not symmetrically
+            measure(10.0, gain, up, down);
+            expect(gain < 15.0, "Large signal gain " + juce::String(gain));
+            expect(std::abs(up - down) > 0.05 * juce::jmax(up, down), juce::String(up) + " V up, " + juce::String(down) + " V down");
+        }
+    }
+
+private:
+    static constexpr double sampleRate = 48000.0;
+};
+
+static NonlinearStateSpaceTest nonlinearStateSpaceTest;
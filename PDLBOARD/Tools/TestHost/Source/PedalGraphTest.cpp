@@ -0,0 +1,208 @@
+/*
+  ==============================================================================
+
+    PedalGraphTest.cpp
+
+  ==============================================================================
+*/
+
+#include <JuceHeader.h>
+#include "../../../Source/PedalGraph.h"
+#include "../../../Source/PluginProcessor.h"
+#include "TestHelpers.h"
+
+/*
+* Routings compiled and run on stand-in pedals that each do one easily
+* followed thing to the signal, so the mix that comes out says which pedals
+* ran, in what order and in which branch. Then the processor taking a new
+* routing from its loader thread.
+*/
+class PedalGraphTest : public juce::UnitTest
+{
+public:
+    PedalGraphTest() : juce::UnitTest("Pedal graph", "PDLBOARD") {}
+
+    void runTest() override
+    {
+        beginTest("Series runs in order");
+        {
+            auto schedule = compile(PedalGraph::defaultRouting);
+            expect(schedule != nullptr);
+            expectEquals(schedule->getNumBuffers(), 1);
+
+            // ((1 * 2 + 1) * 3 * 0.5 - 1) + 10
+            expectEquals(run(*schedule), 13.5f);
+            expectEquals(effects.order, juce::String("autowah overdrive chorus delay cabinet reverb fdnreverb"));
+
+            // Overdrive, chorus and delay in a row are one step, so the processor can interleave them
+            expectEquals(schedule->getNumSteps(), 5);
+            expectEquals(compile("chorus > overdrive > delay")->getNumSteps(), 3);
+        }
+
+        beginTest("Splits mix their branches back at equal levels");
+        {
+            auto schedule = compile("[chorus | delay]");
+            expectEquals(run(*schedule), 2.5f);
+            expectEquals(schedule->getNumBuffers(), 2);
+
+            // Dry and delayed
+            expectEquals(run(*compile("[ | delay]")), 2.f);
+
+            // 2, then [3 > [9 | 2] | 1], so (5.5 + 1) / 2
+            auto nested = compile("overdrive > [chorus > [delay | reverb] | cabinet]");
+            expectEquals(run(*nested), 3.25f);
+            expectEquals(nested->getNumBuffers(), 3);
+            expectEquals(effects.order, juce::String("overdrive chorus delay reverb cabinet"));
+        }
+
+        beginTest("Routings come back tidied up");
+        {
+            expectEquals(compile("  Overdrive>chorus>[delay|  reverb ]")->getRouting(),
+                         juce::String("overdrive > chorus > [delay | reverb]"));
+        }
+
+        beginTest("Nonsense is refused with a reason");
+        {
+            for (auto* routing : { "overdrive > fuzz", "chorus > delay > chorus", "[chorus | delay", "overdrive >", "delay ] reverb" })
+            {
+                juce::String error;
+                expect(PedalGraph::compile(routing, 2, blockSize, error) == nullptr, routing);
+                expect(error.isNotEmpty(), routing);
+            }
+        }
+
+        beginTest("Blocks longer than the buffers are split up");
+        {
+            auto schedule = compile("overdrive > [chorus | delay]");
+            juce::AudioBuffer<float> buffer(2, 1000);
+            buffer.clear();
+
+            for (int channel = 0; channel < 2; ++channel)
+                for (int i = 0; i < buffer.getNumSamples(); ++i)
+                    buffer.setSample(channel, i, 1.f);
+
+            effects.order.clear();
+            effects.numCalls = 0;
+            schedule->process(buffer, effects);
+
+            // (2 + 1 + 6) / 2 everywhere, with every pedal run once a block
+            auto worstDifference = 0.f;
+
+            for (int channel = 0; channel < 2; ++channel)
+                for (int i = 0; i < buffer.getNumSamples(); ++i)
+                    worstDifference = juce::jmax(worstDifference, std::abs(buffer.getSample(channel, i) - 4.5f));
+
+            expectEquals(worstDifference, 0.f);
+            expectEquals(effects.numCalls, 3 * ((1000 + blockSize - 1) / blockSize));
+        }
+
+        beginTest("Processor picks up a new routing and keeps it with the session");
+        {
+            PDLBOARDAudioProcessor processor;
+            TestHelpers::resetParametersToDefaults(processor);
+
+            processor.setPlayConfigDetails(2, 2, 44100.0, blockSize);
+            processor.prepareToPlay(44100.0, blockSize);
+
+            auto& routing = processor.getRouting();
+            expectEquals(routing.getRouting(), juce::String(PedalGraph::defaultRouting));
+
+            expect(routing.setRouting("reverb > [delay | chorus] > overdrive"));
+            auto expected = juce::String("reverb > [delay | chorus] > overdrive");
+
+            for (int n = 0; n < 200 && routing.getRouting() != expected; ++n)
+                juce::Thread::sleep(5);
+
+            expectEquals(routing.getRouting(), expected);
+
+            // Refused, and the last good one carries on
+            expect(! routing.setRouting("reverb > reverb"));
+            expect(routing.getRoutingError().isNotEmpty());
+            expectEquals(routing.getRouting(), expected);
+
+            // The schedule itself is swapped in here, on the audio thread
+            juce::AudioBuffer<float> block(2, blockSize);
+            juce::MidiBuffer midi;
+            block.clear();
+            processor.processBlock(block, midi);
+
+            juce::MemoryBlock session;
+            processor.getStateInformation(session);
+
+            PDLBOARDAudioProcessor restored;
+            restored.setStateInformation(session.getData(), (int)session.getSize());
+            restored.setPlayConfigDetails(2, 2, 44100.0, blockSize);
+            restored.prepareToPlay(44100.0, blockSize);
+
+            expectEquals(restored.getRouting().getRouting(), expected);
+        }
+    }
+
+private:
+    static constexpr int blockSize = 64;
+
+    // overdrive * 2, chorus + 1, delay * 3, cabinet * 0.5, reverb - 1, fdnreverb + 10, and the auto-wah leaves it
+    struct StandIns : public PedalGraph::Effects
+    {
+        void processPedal(PedalGraph::Pedal pedal, juce::AudioBuffer<float>& buffer) override
+        {
+            if (order.isNotEmpty())
+                order << " ";
+
+            order << PedalGraph::getName(pedal);
+            ++numCalls;
+
+            for (int channel = 0; channel < buffer.getNumChannels(); ++channel)
+            {
+                for (int i = 0; i < buffer.getNumSamples(); ++i)
+                {
+                    auto x = buffer.getSample(channel, i);
+
+                    switch (pedal)
+                    {
+                        case PedalGraph::Pedal::overdrive:  x *= 2.f; break;
+                        case PedalGraph::Pedal::chorus:     x += 1.f; break;
+                        case PedalGraph::Pedal::delay:      x *= 3.f; break;
+                        case PedalGraph::Pedal::cabinet:    x *= 0.5f; break;
+                        case PedalGraph::Pedal::reverb:     x -= 1.f; break;
+                        case PedalGraph::Pedal::fdnReverb:  x += 10.f; break;
+                        case PedalGraph::Pedal::autoWah:    break;
+                    }
+
+                    buffer.setSample(channel, i, x);
+                }
+            }
+        }
+
+        juce::String order;
+        int numCalls = 0;
+    };
+
+    std::unique_ptr<PedalGraph::Schedule> compile(const juce::String& routing)
+    {
+        juce::String error;
+        auto schedule = PedalGraph::compile(routing, 2, blockSize, error);
+        expectEquals(error, juce::String(), routing);
+
+        return schedule;
+    }
+
+    // What a block of 1s comes out as
+    float run(PedalGraph::Schedule& schedule)
+    {
+        juce::AudioBuffer<float> buffer(2, blockSize);
+
+        for (int channel = 0; channel < 2; ++channel)
+            for (int i = 0; i < blockSize; ++i)
+                buffer.setSample(channel, i, 1.f);
+
+        effects.order.clear();
+        schedule.process(buffer, effects);
+
+        return buffer.getSample(1, blockSize - 1);
+    }
+
+    StandIns effects;
+};
+
+static PedalGraphTest pedalGraphTest;
@@ -0,0 +1,132 @@
+/*
+  ==============================================================================
+
+    PitchDetectorTest.cpp
+
+  ==============================================================================
+*/
+
+#include <JuceHeader.h>
+#include "../../../Source/PitchDetector.h"
+#include "../../../Source/PluginProcessor.h"
+#include "TestHelpers.h"
+
+/*
+* At the rate and window size the tuner uses: sines over the whole range, a
+* note whose second harmonic is louder than its fundamental, then noise and
+* silence, which mustn't read as notes. Then the tuner in the processor,
+* with its analyser thread.
+*/
+class PitchDetectorTest : public juce::UnitTest
+{
+public:
+    PitchDetectorTest() : juce::UnitTest("Pitch detector", "PDLBOARD") {}
+
+    void runTest() override
+    {
+        PitchDetector detector(sampleRate, windowSize);
+        std::vector<float> window((size_t)windowSize);
+        juce::Random random(7);
+
+        beginTest("Sines from low B to the top frets");
+        {
+            for (auto frequency : { 30.87, 41.2, 82.41, 110.0, 146.83, 196.0, 246.94, 329.63, 659.26, 1318.51 })
+            {
+                auto phase = random.nextDouble() * juce::MathConstants<double>::twoPi;
+
+                for (int i = 0; i < windowSize; ++i)
+                    window[(size_t)i] = 0.5f * (float)std::sin(juce::MathConstants<double>::twoPi * frequency * i / sampleRate + phase);
+
+                auto result = detector.detect(window.data());
+
+                // The parabola is least accurate on the shortest periods, 8 samples at the top
+                expectWithinAbsoluteError(getCents(result.frequency, frequency), 0.0, frequency > 1000.0 ? 2.0 : 0.5);
+                expectGreaterThan(result.clarity, 0.95f);
+            }
+        }
+
+        beginTest("A loud second harmonic isn't the octave");
+        {
+            const double frequency = 110.0;
+            const float harmonics[] = { 0.3f, 1.f, 0.6f, 0.4f, 0.2f };
+
+            for (int i = 0; i < windowSize; ++i)
+            {
+                auto sample = 0.0;
+
+                for (int h = 0; h < (int)juce::numElementsInArray(harmonics); ++h)
+                    sample += harmonics[h] * std::sin(juce::MathConstants<double>::twoPi * frequency * (h + 1) * i / sampleRate);
+
+                window[(size_t)i] = 0.3f * (float)sample;
+            }
+
+            auto result = detector.detect(window.data());
+
+            expectWithinAbsoluteError(getCents(result.frequency, frequency), 0.0, 1.0);
+            expectGreaterThan(result.clarity, 0.95f);
+        }
+
+        beginTest("Noise and silence aren't notes");
+        {
+            for (auto& sample : window)
+                sample = random.nextFloat() - 0.5f;
+
+            expectLessThan(detector.detect(window.data()).clarity, 0.5f);
+
+            std::fill(window.begin(), window.end(), 0.f);
+            expectEquals(detector.detect(window.data()).frequency, 0.f);
+        }
+
+        beginTest("Tuner finds the open A off the audio thread");
+        {
+            PDLBOARDAudioProcessor processor;
+            TestHelpers::resetParametersToDefaults(processor);
+            TestHelpers::setParameter(processor, "onoff9", 1.f);
+
+            const double hostRate = 44100.0;
+            const int blockSize = 512;
+
+            processor.setPlayConfigDetails(2, 2, hostRate, blockSize);
+            processor.prepareToPlay(hostRate, blockSize);
+
+            juce::AudioBuffer<float> block(2, blockSize);
+            juce::MidiBuffer midi;
+            auto heard = 0.f;
+            auto outputPeak = 0.f;
+
+            // About as fast as a host would send it, so the FIFO never fills
+            for (int n = 0; n < 200 && heard == 0.f; ++n)
+            {
+                for (int i = 0; i < blockSize; ++i)
+                {
+                    auto sample = 0.4f * (float)std::sin(juce::MathConstants<double>::twoPi * 110.0 * (n * blockSize + i) / hostRate);
+                    block.setSample(0, i, sample);
+                    block.setSample(1, i, sample);
+                }
+
+                processor.processBlock(block, midi);
+                outputPeak = juce::jmax(outputPeak, block.getMagnitude(0, blockSize));
+
+                juce::Thread::sleep(5);
+                heard = processor.getTuner().getFrequency();
+            }
+
+            expectWithinAbsoluteError(getCents(heard, 110.0), 0.0, 1.0);
+
+            // Muted by default while it's on
+            expectEquals(outputPeak, 0.f);
+        }
+    }
+
+private:
+    // What the tuner hands it: 44.1 kHz decimated by 4
+    static constexpr double sampleRate = 11025.0;
+    static constexpr int windowSize = 2048;
+
+    static double getCents(double measured, double expected)
+    {
+        return measured > 0.0 ? 1200.0 * std::log2(measured / expected) : 10000.0;
+    }
+};
+
+static PitchDetectorTest pitchDetectorTest;
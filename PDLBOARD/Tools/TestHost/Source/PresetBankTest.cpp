@@ -0,0 +1,185 @@
+/*
+  ==============================================================================
+
+    PresetBankTest.cpp
+
+  ==============================================================================
+*/
+
+#include <JuceHeader.h>
+#include "../../../Source/PluginProcessor.h"
+#include "../../../Source/PresetBank.h"
+#include "TestHelpers.h"
+
+/*
+* A bank of a few thousand presets written and mapped back: every preset
+* coming out as it went in, the name, tag and effect indexes agreeing with a
+* plain search, files that aren't a whole bank, and the host's program
+* change going through the preset engine.
+*/
+class PresetBankTest : public juce::UnitTest
+{
+public:
+    PresetBankTest() : juce::UnitTest("Preset bank", "PDLBOARD") {}
+
+    void runTest() override
+    {
+        juce::Random random(44);
+        auto folder = juce::File::getSpecialLocation(juce::File::tempDirectory).getNonexistentChildFile("pdlboard_bank", {});
+        folder.createDirectory();
+
+        auto file = folder.getChildFile("bank.pdlk");
+        auto entries = createEntries(random, 3000);
+
+        beginTest("Presets come back as they went in");
+        {
+            expect(PresetBank::write(file, entries));
+
+            PresetBank bank(file);
+            expect(bank.isValid());
+            expectEquals(bank.getNumPresets(), (int)entries.size());
+
+            for (int i = 0; i < (int)entries.size(); i += 97)
+            {
+                auto preset = bank.getPreset(i);
+                auto& original = entries[(size_t)i];
+
+                expectEquals(preset.name, original.preset.name);
+                expectEquals(preset.routing, original.preset.routing);
+                expect(bank.getTags(i) == original.tags, original.preset.name);
+                expectEquals((int)preset.values.size(), (int)original.preset.values.size());
+
+                for (auto& value : original.preset.values)
+                    expectEquals(getValue(preset, value.first), value.second, original.preset.name + " " + value.first);
+            }
+        }
+
+        beginTest("Indexes agree with searching every preset");
+        {
+            PresetBank bank(file);
+
+            for (int i = 0; i < (int)entries.size(); i += 113)
+            {
+                auto name = entries[(size_t)i].preset.name;
+                expectEquals(bank.findByName(name), i);
+                expectEquals(bank.findByName(name.toUpperCase()), i);
+            }
+
+            expectEquals(bank.findByName("Nothing called this"), -1);
+
+            for (auto& tag : bank.getAllTags())
+            {
+                juce::Array<int> expected;
+
+                for (int i = 0; i < (int)entries.size(); ++i)
+                    if (entries[(size_t)i].tags.contains(tag))
+                        expected.add(i);
+
+                expect(bank.findByTag(tag) == expected, tag);
+            }
+
+            expect(bank.findByTag("untagged").isEmpty());
+
+            auto effects = PresetBank::overdrive | PresetBank::delay;
+            auto found = bank.findByEffects(effects);
+            int numExpected = 0;
+
+            for (auto& entry : entries)
+                if (getValue(entry.preset, "onoff1") > 0.5f && getValue(entry.preset, "onoff3") > 0.5f)
+                    ++numExpected;
+
+            expectEquals(found.size(), numExpected);
+
+            for (auto i : found)
+                expectEquals(bank.getEffects(i) & effects, effects);
+        }
+
+        beginTest("Anything that isn't a whole bank isn't mapped");
+        {
+            juce::MemoryBlock contents;
+            file.loadFileAsData(contents);
+
+            auto cut = folder.getChildFile("cut.pdlk");
+
+            for (auto length : { 0, 20, 48, (int)contents.getSize() / 2, (int)contents.getSize() - 1 })
+            {
+                cut.replaceWithData(contents.getData(), (size_t)length);
+                expect(! PresetBank(cut).isValid(), "Cut to " + juce::String(length));
+            }
+
+            // Right length, but a preset pointing off the end of the strings
+            static_cast<char*>(contents.getData())[48 + 3] = 0x7f;
+            cut.replaceWithData(contents.getData(), contents.getSize());
+            expect(! PresetBank(cut).isValid());
+
+            expect(! PresetBank(folder.getChildFile("missing.pdlk")).isValid());
+        }
+
+        beginTest("Program changes switch to the bank's presets");
+        {
+            PDLBOARDAudioProcessor processor;
+            TestHelpers::resetParametersToDefaults(processor);
+
+            expectEquals(processor.getNumPrograms(), 1);
+            expect(processor.loadPresetBank(file));
+            expect(! processor.loadPresetBank(folder.getChildFile("missing.pdlk")));
+            expectEquals(processor.getNumPrograms(), (int)entries.size());
+            expectEquals(processor.getProgramName(1234), entries[1234].preset.name);
+
+            processor.setCurrentProgram(1234);
+
+            for (int n = 0; n < 200 && processor.getPresets().isSwitching(); ++n)
+                juce::Thread::sleep(5);
+
+            expectEquals(processor.getCurrentProgram(), 1234);
+            expectEquals(processor.getPresets().getCurrentName(), entries[1234].preset.name);
+
+            for (auto& value : entries[1234].preset.values)
+                expectWithinAbsoluteError(TestHelpers::getParameterPlain(processor, value.first), value.second, 1.0e-4f, value.first);
+        }
+
+        folder.deleteRecursively();
+    }
+
+private:
+    // Switches, a few of each pedal's settings and a routing, all on real steps of their parameters
+    static std::vector<PresetBank::Entry> createEntries(juce::Random& random, int numEntries)
+    {
+        const juce::StringArray tags { "ambient", "blues", "clean", "crunch", "lead", "metal", "rhythm", "worship" };
+        const juce::StringArray routings { "", "overdrive > chorus > delay", "[chorus | delay] > overdrive", "overdrive > [chorus | delay]" };
+
+        std::vector<PresetBank::Entry> entries;
+
+        for (int i = 0; i < numEntries; ++i)
+        {
+            PresetBank::Entry entry;
+            entry.preset.name = "Preset " + juce::String(i).paddedLeft('0', 4);
+            entry.preset.routing = routings[random.nextInt(routings.size())];
+
+            for (int n = 1; n <= 8; ++n)
+                entry.preset.values.emplace_back("onoff" + juce::String(n), random.nextBool() ? 1.f : 0.f);
+
+            entry.preset.values.emplace_back("overdrive", (float)random.nextInt(11) / 10.f);
+            entry.preset.values.emplace_back("dry/wet2", (float)random.nextInt(11) / 10.f);
+
+            for (auto& tag : tags)
+                if (random.nextInt(4) == 0)
+                    entry.tags.add(tag);
+
+            entries.push_back(entry);
+        }
+
+        return entries;
+    }
+
+    static float getValue(const GuitarEffectAudioProcessor::Presets::Preset& preset, const juce::String& id)
+    {
+        for (auto& value : preset.values)
+            if (value.first == id)
+                return value.second;
+
+        return -1.f;
+    }
+};
+
+static PresetBankTest presetBankTest;
@@ -0,0 +1,165 @@
+/*
+  ==============================================================================
+
+    PresetTest.cpp
+
+  ==============================================================================
+*/
+
+#include <JuceHeader.h>
+#include "../../../Source/PluginProcessor.h"
+#include "TestHelpers.h"
+
+/*
+* A preset switch in the middle of a steady note: every block has to be all
+* the old preset or all the new one, and the crossfade between them mustn't
+* step or go quiet. Then a switch with nothing playing, which can't wait for
+* an audio thread that isn't running.
+*/
+class PresetTest : public juce::UnitTest
+{
+public:
+    PresetTest() : juce::UnitTest("Preset switching", "PDLBOARD") {}
+
+    void runTest() override
+    {
+        GuitarEffectAudioProcessor::Presets::Preset preset;
+        preset.name = "Slapback";
+        preset.values = { { "onoff1", 1.f }, { "overdrive", 0.1f }, { "range", 10.f },
+                          { "onoff3", 1.f }, { "delaytime", 0.12f }, { "dry/wet2", 0.3f }, { "feedback2", 0.2f } };
+        preset.routing = "[overdrive | delay]";
+
+        beginTest("Switches land whole, crossfaded");
+        {
+            PDLBOARDAudioProcessor processor;
+            TestHelpers::resetParametersToDefaults(processor);
+
+            processor.setPlayConfigDetails(2, 2, sampleRate, blockSize);
+            processor.prepareToPlay(sampleRate, blockSize);
+
+            juce::AudioBuffer<float> block(2, blockSize);
+            juce::MidiBuffer midi;
+
+            auto previous = 0.f;
+            auto biggestStep = 0.f;
+            auto quietestBlock = 1.f;
+            int numBlocks = 0, numSwitched = 0;
+
+            processor.getPresets().load(preset);
+
+            for (; numBlocks < 400 && (numSwitched < 20 || processor.getPresets().isSwitching()); ++numBlocks)
+            {
+                for (int i = 0; i < blockSize; ++i)
+                {
+                    auto sample = 0.05f * (float)std::sin(juce::MathConstants<double>::twoPi * 110.0 * (numBlocks * blockSize + i) / sampleRate);
+                    block.setSample(0, i, sample);
+                    block.setSample(1, i, sample);
+                }
+
+                processor.processBlock(block, midi);
+
+                // Only the audio thread puts values in while it's running, all of them at once
+                auto numIn = countValuesIn(processor, preset);
+                expect(numIn == 0 || numIn == (int)preset.values.size(), "Half a preset was heard");
+
+                for (int i = 0; i < blockSize; ++i)
+                {
+                    auto sample = block.getSample(0, i);
+                    biggestStep = juce::jmax(biggestStep, std::abs(sample - previous));
+                    previous = sample;
+                }
+
+                // Once the sine's had a quarter cycle to get going
+                if (numBlocks > 2)
+                    quietestBlock = juce::jmin(quietestBlock, block.getMagnitude(0, 0, blockSize));
+
+                if (numIn == (int)preset.values.size() && ! processor.getPresets().isSwitching())
+                    ++numSwitched;
+
+                // Some time for the loader, like the gap between a host's callbacks
+                juce::Thread::sleep(1);
+            }
+
+            expectEquals(countValuesIn(processor, preset), (int)preset.values.size());
+            expectEquals(processor.getPresets().getCurrentName(), juce::String("Slapback"));
+            expectEquals(processor.getRouting().getRouting(), juce::String("[overdrive | delay]"));
+
+            // A 110 Hz sine at 0.05 moves by about 0.0007 a sample, so anything near 0.05 is the switch stepping
+            expectLessThan(biggestStep, 0.02f);
+
+            // Over a block of 110 Hz the sine always gets most of the way up, so no block goes quiet
+            expectGreaterThan(quietestBlock, 0.02f);
+        }
+
+        beginTest("With audio coming through, the audio thread switches");
+        {
+            PDLBOARDAudioProcessor processor;
+            TestHelpers::resetParametersToDefaults(processor);
+
+            processor.setPlayConfigDetails(2, 2, sampleRate, blockSize);
+            processor.prepareToPlay(sampleRate, blockSize);
+
+            juce::AudioBuffer<float> block(2, blockSize);
+            juce::MidiBuffer midi;
+            block.clear();
+
+            // One block, so the loader knows audio's coming, then longer than the idle timeout
+            processor.processBlock(block, midi);
+            processor.getPresets().load(preset);
+            juce::Thread::sleep(20);
+            processor.processBlock(block, midi);
+
+            // Taken up by that block, however long the host waits after it
+            expectEquals(countValuesIn(processor, preset), (int)preset.values.size());
+
+            juce::Thread::sleep(GuitarEffectAudioProcessor::Presets::idleTimeoutMs + 50);
+            expect(! processor.getPresets().isSwitching());
+            expectEquals(processor.getRouting().getRouting(), juce::String("[overdrive | delay]"));
+        }
+
+        beginTest("Switching with no audio still goes in");
+        {
+            PDLBOARDAudioProcessor processor;
+            TestHelpers::resetParametersToDefaults(processor);
+
+            processor.getPresets().load(preset);
+
+            for (int n = 0; n < 200 && processor.getPresets().isSwitching(); ++n)
+                juce::Thread::sleep(5);
+
+            expect(! processor.getPresets().isSwitching());
+            expectEquals(countValuesIn(processor, preset), (int)preset.values.size());
+
+            // Everything the preset leaves out goes back to its default
+            TestHelpers::setParameterPlain(processor, "onoff2", 1.f);
+
+            GuitarEffectAudioProcessor::Presets::Preset clean;
+            clean.name = "Clean";
+            processor.getPresets().load(clean);
+
+            for (int n = 0; n < 200 && processor.getPresets().isSwitching(); ++n)
+                juce::Thread::sleep(5);
+
+            expectEquals(countValuesIn(processor, preset), 0);
+            expectEquals(TestHelpers::getParameterPlain(processor, "onoff2"), 0.f);
+        }
+    }
+
+private:
+    static constexpr double sampleRate = 48000.0;
+    static constexpr int blockSize = 256;
+
+    // How many of the preset's values the processor has
+    static int countValuesIn(PDLBOARDAudioProcessor& processor, const GuitarEffectAudioProcessor::Presets::Preset& preset)
+    {
+        int numIn = 0;
+
+        for (auto& entry : preset.values)
+            if (std::abs(TestHelpers::getParameterPlain(processor, entry.first) - entry.second) < 1.0e-4f)
+                ++numIn;
+
+        return numIn;
+    }
+};
+
+static PresetTest presetTest;
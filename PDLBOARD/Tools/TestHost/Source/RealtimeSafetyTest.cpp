@@ -0,0 +1,408 @@
+/*
+  ==============================================================================
+
+    RealtimeSafetyTest.cpp
+
+  ==============================================================================
+*/
+
+#include <JuceHeader.h>
+#include "../../../Source/PluginProcessor.h"
+#include "../../../Source/RealtimeSafety.h"
+#include "TestHelpers.h"
+
+// Only meaningful with the interceptors built in, as the Debug and Release configurations do. Sanitize leaves them out,
+// as AddressSanitizer brings its own malloc.
+#if PDLBOARD_REALTIME_SAFETY_CHECKS
+
+/*
+* Drives processBlock like a host would while the RealtimeSafety interceptors
+* are active, and fails on anything that could block the audio thread.
+*/
+class RealtimeSafetyTest : public juce::UnitTest
+{
+public:
+    RealtimeSafetyTest() : juce::UnitTest("Realtime safety", "PDLBOARD") {}
+
+    void runTest() override
+    {
+        logMessage("Intercepting: " + RealtimeSafety::getInterceptedCalls());
+
+        // getRandom() hands out a copy, keep one generator for the whole run
+        random = getRandom();
+
+        beginTest("Detector catches an allocation on the audio thread");
+        {
+            RealtimeSafety::clearReports();
+
+            {
+                RealtimeSafety::ScopedAudioThread audioThread;
+                juce::HeapBlock<char> block(64);
+                block[0] = 1;
+            }
+
+            // If this fails the interceptors aren't linked in and the test below means nothing
+            expect(RealtimeSafety::getNumViolations() > 0, "No violation was recorded");
+            RealtimeSafety::clearReports();
+        }
+
+        beginTest("processBlock with every bypass combination");
+        {
+            PDLBOARDAudioProcessor processor;
+            prepare(processor);
+
+            for (int combination = 0; combination < 64; ++combination)
+            {
+                TestHelpers::setParameter(processor, "onoff1", (combination & 1) != 0 ? 1.f : 0.f);
+                TestHelpers::setParameter(processor, "onoff2", (combination & 2) != 0 ? 1.f : 0.f);
+                TestHelpers::setParameter(processor, "onoff3", (combination & 4) != 0 ? 1.f : 0.f);
+                TestHelpers::setParameter(processor, "onoff4", (combination & 8) != 0 ? 1.f : 0.f);
+                TestHelpers::setParameter(processor, "onoff5", (combination & 16) != 0 ? 1.f : 0.f);
+                TestHelpers::setParameter(processor, "onoff6", (combination & 32) != 0 ? 1.f : 0.f);
+
+                runBlocks(processor, 100);
+            }
+
+            expectNoViolations();
+        }
+
+        beginTest("processBlock under automation from another thread");
+        {
+            PDLBOARDAudioProcessor processor;
+            prepare(processor);
+
+            for (auto* id : { "onoff1", "onoff2", "onoff3", "onoff4", "onoff5", "onoff6" })
+                TestHelpers::setParameter(processor, id, 1.f);
+
+            TestHelpers::AutomationThread automation(processor, random.nextInt64());
+            automation.startThread();
+
+            runBlocks(processor, 2000);
+
+            automation.stopThread(1000);
+            expectNoViolations();
+        }
+
+        beginTest("The later pedals in every on / off combination");
+        {
+            PDLBOARDAudioProcessor processor;
+            prepare(processor);
+
+            for (auto* id : { "onoff1", "onoff2", "onoff3" })
+                TestHelpers::setParameter(processor, id, 1.f);
+
+            // The EQ, the gate, the tuner and the auto-wah, the EQ each side of the overdrive and the tuner muting or not
+            for (int combination = 0; combination < 64; ++combination)
+            {
+                TestHelpers::setParameter(processor, "onoff7", (combination & 1) != 0 ? 1.f : 0.f);
+                TestHelpers::setParameter(processor, "onoff8", (combination & 2) != 0 ? 1.f : 0.f);
+                TestHelpers::setParameter(processor, "onoff9", (combination & 4) != 0 ? 1.f : 0.f);
+                TestHelpers::setParameter(processor, "onoff10", (combination & 8) != 0 ? 1.f : 0.f);
+                TestHelpers::setParameter(processor, "eqposition", (combination & 16) != 0 ? 1.f : 0.f);
+                TestHelpers::setParameter(processor, "tunermute", (combination & 32) != 0 ? 1.f : 0.f);
+
+                runBlocks(processor, 50);
+            }
+
+            expectNoViolations();
+        }
+
+        beginTest("The chorus ensemble at every voice count");
+        {
+            PDLBOARDAudioProcessor processor;
+            prepare(processor);
+
+            TestHelpers::setParameter(processor, "onoff2", 1.f);
+
+            for (int voices = 1; voices <= 8; ++voices)
+            {
+                TestHelpers::setParameterPlain(processor, "chorusvoices", (float)voices);
+                TestHelpers::setParameterPlain(processor, "type", (float)(voices % 2));
+                runBlocks(processor, 50);
+            }
+
+            expectNoViolations();
+        }
+
+        beginTest("Multi-tap and ping-pong, retuned while processing");
+        {
+            PDLBOARDAudioProcessor processor;
+            prepare(processor);
+
+            TestHelpers::setParameter(processor, "onoff3", 1.f);
+            expect(processor.getModulation().setModulation("lfo1 sine 2, lfo1 > delaytime 0.3, lfo1 > tapspread 0.5, lfo1 > tapdecay 0.2"));
+
+            // Every mode, tap count and spacing, each change glided to over the next block
+            for (int change = 0; change < 48; ++change)
+            {
+                TestHelpers::setParameterPlain(processor, "delaymode", (float)(change % 3));
+                TestHelpers::setParameterPlain(processor, "delaytaps", (float)(1 + change % MultiTapDelay::maximumTaps));
+                TestHelpers::setParameterPlain(processor, "tapspacing", (float)(change % 4));
+                TestHelpers::setParameterPlain(processor, "delaytime", 0.05f + 0.02f * (float)(change % 10));
+                TestHelpers::setParameterPlain(processor, "crossfeed", (float)(change % 5) * 0.25f);
+                runBlocks(processor, 20);
+            }
+
+            expect(processor.getModulation().setModulation(""));
+            runBlocks(processor, 1);
+            expectNoViolations();
+        }
+
+        beginTest("MIDI footswitches, controllers and program changes");
+        {
+            PDLBOARDAudioProcessor processor;
+            prepare(processor);
+
+            // The gate too, so its latency change comes from inside the block
+            processor.getMidiControl().setMapping(20, "onoff8", true);
+            processor.getMidiControl().setMapping(21, "delaytime", false);
+            processor.getMidiControl().setMapping(22, "overdrive", false);
+
+            // Built before the blocks, like a host's buffer. Every block gets the same messages.
+            for (int position = 0; position < blockSize; position += 16)
+            {
+                auto value = (position * 127) / blockSize;
+
+                midi.addEvent(juce::MidiMessage::controllerEvent(1, 80 + (position / 16) % 3, value > 63 ? 127 : 0), position);
+                midi.addEvent(juce::MidiMessage::controllerEvent(1, 20, position % 32 == 0 ? 127 : 0), position + 1);
+                midi.addEvent(juce::MidiMessage::controllerEvent(1, 21, value), position + 2);
+                midi.addEvent(juce::MidiMessage::controllerEvent(1, 22, 127 - value), position + 3);
+            }
+
+            midi.addEvent(juce::MidiMessage::programChange(1, 3), 100);
+
+            runBlocks(processor, 500);
+            midi.clear();
+
+            expectNoViolations();
+        }
+
+        beginTest("Automation events at their samples");
+        {
+            PDLBOARDAudioProcessor processor;
+            prepare(processor);
+
+            auto& state = processor.getValueTreeState();
+            juce::RangedAudioParameter* parameters[] = { state.getParameter("onoff8"), state.getParameter("overdrive"),
+                                                         state.getParameter("delaytime"), state.getParameter("wahfreq"),
+                                                         state.getParameter("onoff10"), state.getParameter("eqmid") };
+
+            for (auto* id : { "onoff1", "onoff3", "onoff7" })
+                TestHelpers::setParameter(processor, id, 1.f);
+
+            for (int block = 0; block < 500; ++block)
+            {
+                // Bunched up and spread out, some closer together than the minimum piece
+                for (int event = 0; event < 12; ++event)
+                {
+                    auto* parameter = parameters[random.nextInt(juce::numElementsInArray(parameters))];
+                    auto position = random.nextInt(blockSize);
+
+                    if (parameter->paramID.startsWith("onoff"))
+                        processor.getAutomation().addToggle(parameter, position);
+                    else
+                        processor.getAutomation().add(parameter, random.nextFloat(), position);
+                }
+
+                runBlocks(processor, 1);
+            }
+
+            expectNoViolations();
+        }
+
+        beginTest("Modulation from every kind of source, changed while processing");
+        {
+            PDLBOARDAudioProcessor processor;
+            prepare(processor);
+
+            for (auto* id : { "onoff1", "onoff2", "onoff3", "onoff7", "onoff10" })
+                TestHelpers::setParameter(processor, id, 1.f);
+
+            const char* modulations[] =
+            {
+                "lfo1 sine 3, lfo1 > delaytime 0.2, lfo1 > depth 0.5",
+                "env1 10 200, env1 > wahfreq 0.5, env1 > overdrive 0.3, lfo2 square 1, lfo2 > eqmid 0.4",
+                "midi1 7, midi1 > dry/wet2 1, lfo3 saw 0.5, lfo3 > delaytime -0.3, lfo4 triangle 8, lfo4 > wahq 0.2",
+                ""
+            };
+
+            midi.addEvent(juce::MidiMessage::controllerEvent(1, 7, 100), 10);
+
+            // Every change hands a new matrix to the audio thread, the old one comes back to be deleted
+            for (int change = 0; change < 16; ++change)
+            {
+                expect(processor.getModulation().setModulation(modulations[change % juce::numElementsInArray(modulations)]));
+                runBlocks(processor, 50);
+            }
+
+            midi.clear();
+            expectNoViolations();
+        }
+
+        beginTest("Preset switches while processing");
+        {
+            PDLBOARDAudioProcessor processor;
+            prepare(processor);
+
+            GuitarEffectAudioProcessor::Presets::Preset first, second;
+            first.name = "First";
+            first.values = { { "onoff1", 1.f }, { "overdrive", 0.7f }, { "onoff8", 1.f }, { "onoff10", 1.f } };
+            first.routing = "autowah > overdrive > [chorus | delay] > cabinet";
+
+            second.name = "Second";
+            second.values = { { "onoff2", 1.f }, { "chorusvoices", 4.f }, { "onoff3", 1.f }, { "delaytime", 0.3f }, { "onoff7", 1.f } };
+
+            for (int swap = 0; swap < 12; ++swap)
+            {
+                processor.getPresets().load(swap % 2 == 0 ? first : second);
+
+                // The audio thread switches it in at the start of a block, with time between blocks like a host's
+                for (int block = 0; block < 100; ++block)
+                {
+                    runBlocks(processor, 1);
+                    juce::Thread::sleep(1);
+                }
+            }
+
+            expectNoViolations();
+        }
+
+        beginTest("Routing swaps while processing");
+        {
+            PDLBOARDAudioProcessor processor;
+            prepare(processor);
+
+            for (auto* id : { "onoff1", "onoff2", "onoff3", "onoff4", "onoff10" })
+                TestHelpers::setParameter(processor, id, 1.f);
+
+            const char* routings[] =
+            {
+                "delay > chorus > overdrive > autowah",
+                "[overdrive | chorus | delay] > cabinet",
+                "autowah > [overdrive > chorus | delay] > reverb",
+                PedalGraph::defaultRouting
+            };
+
+            // Each one compiled on the loader thread and swapped in at the start of a block
+            for (int swap = 0; swap < 16; ++swap)
+            {
+                expect(processor.getRouting().setRouting(routings[swap % juce::numElementsInArray(routings)]));
+                runBlocks(processor, 50);
+            }
+
+            expectNoViolations();
+        }
+
+        beginTest("Cabinet IR swaps while processing");
+        {
+            PDLBOARDAudioProcessor processor;
+            prepare(processor);
+
+            TestHelpers::setParameter(processor, "onoff4", 1.f);
+            TestHelpers::setParameterPlain(processor, "cabinet", 3.f);
+
+            // A 44.1 kHz IR, so the loader has to resample it as well
+            juce::TemporaryFile irFile(juce::String(".wav"));
+            auto impulseResponse = GuitarEffectAudioProcessor::Cabinet::createBuiltInImpulseResponse(2, 44100.0);
+
+            {
+                juce::WavAudioFormat format;
+                std::unique_ptr<juce::AudioFormatWriter> writer(format.createWriterFor(new juce::FileOutputStream(irFile.getFile()), 44100.0, 1, 32, {}, 0));
+                expect(writer != nullptr && writer->writeFromAudioSampleBuffer(impulseResponse, 0, impulseResponse.getNumSamples()));
+            }
+
+            for (int swap = 0; swap < 20; ++swap)
+            {
+                processor.getCabinet().loadImpulseResponse(irFile.getFile());
+                runBlocks(processor, 50);
+            }
+
+            expectNoViolations();
+        }
+
+        beginTest("Reverb engine swaps while processing");
+        {
+            PDLBOARDAudioProcessor processor;
+            prepare(processor);
+
+            TestHelpers::setParameter(processor, "onoff5", 1.f);
+
+            // Every change builds a new engine on the loader thread, the old one is faded out and handed back
+            for (int swap = 0; swap < 12; ++swap)
+            {
+                TestHelpers::setParameterPlain(processor, "reverb", (float)(swap % 3));
+                runBlocks(processor, 100);
+            }
+
+            expectNoViolations();
+        }
+
+        beginTest("Amp model swaps while processing");
+        {
+            PDLBOARDAudioProcessor processor;
+            prepare(processor);
+
+            TestHelpers::setParameter(processor, "onoff1", 1.f);
+            TestHelpers::setParameterPlain(processor, "odmode", 1.f);
+
+            // Two different models, so every swap crossfades from one kind to the other
+            juce::TemporaryFile lstmFile(juce::String(".json")), gruFile(juce::String(".json"));
+            expect(lstmFile.getFile().replaceWithText(juce::JSON::toString(TestHelpers::createRecurrentModel("LSTM", 20, random))));
+            expect(gruFile.getFile().replaceWithText(juce::JSON::toString(TestHelpers::createRecurrentModel("GRU", 12, random))));
+
+            for (int swap = 0; swap < 12; ++swap)
+            {
+                processor.getAmpModel().loadModel(swap % 2 == 0 ? lstmFile.getFile() : gruFile.getFile());
+                runBlocks(processor, 50);
+            }
+
+            expectEquals(processor.getAmpModel().getLoadError(), juce::String());
+            expectNoViolations();
+        }
+    }
+
+private:
+    static constexpr double sampleRate = 48000.0;
+    static constexpr int blockSize = 256;
+
+    void prepare(PDLBOARDAudioProcessor& processor)
+    {
+        processor.setPlayConfigDetails(2, 2, sampleRate, blockSize);
+        processor.prepareToPlay(sampleRate, blockSize);
+
+        // Everything the "host" needs is allocated up front
+        buffer.setSize(2, blockSize);
+        RealtimeSafety::clearReports();
+    }
+
+    void runBlocks(PDLBOARDAudioProcessor& processor, int numBlocks)
+    {
+        for (int block = 0; block < numBlocks; ++block)
+        {
+            for (int channel = 0; channel < buffer.getNumChannels(); ++channel)
+                for (int i = 0; i < blockSize; ++i)
+                    buffer.setSample(channel, i, random.nextFloat() * 2.f - 1.f);
+
+            processor.processBlock(buffer, midi);
+        }
+    }
+
+    void expectNoViolations()
+    {
+        auto numViolations = RealtimeSafety::getNumViolations();
+
+        for (auto& report : RealtimeSafety::getReports())
+            logMessage(report.toString());
+
+        expectEquals(numViolations, 0, "processBlock did something that isn't realtime safe");
+        RealtimeSafety::clearReports();
+    }
+
+    juce::Random random;
+    juce::AudioBuffer<float> buffer;
+    juce::MidiBuffer midi;
+};
+
+static RealtimeSafetyTest realtimeSafetyTest;
+
+#endif
@@ -0,0 +1,191 @@
+/*
+  ==============================================================================
+
+    ReverbBenchmark.cpp
+
+  ==============================================================================
+*/
+
+#include <JuceHeader.h>
+#include "../../../Source/NonUniformConvolution.h"
+
+/*
+* What the reverb's convolution costs the audio thread, against IR length, next
+* to the cabinet's uniform convolution run on the same IRs. Uniform partitions
+* get more expensive with every second of IR, the non-uniform split should stay
+* flat because everything past the head is on the workers.
+*
+* The non-uniform runs are paced like a host would call them, so the workers
+* have their real deadlines, and a deadline miss is reported next to the timing.
+* Run it with "TestHost --category Benchmarks" on a release build.
+*/
+class ReverbBenchmark : public juce::UnitTest
+{
+public:
+    ReverbBenchmark() : juce::UnitTest("Non-uniform convolution", "Benchmarks") {}
+
+    void runTest() override
+    {
+        random = getRandom();
+
+        beginTest("Matches direct convolution");
+        {
+            auto impulseResponse = makeImpulseResponse(3.0);
+            auto input = makeNoise((int)(4.0 * sampleRate));
+            auto output = input;
+
+            NonUniformConvolution convolution(impulseResponse, numChannels, blockSize);
+
+            // Waits for the workers, so every block is there however fast this runs
+            convolution.setNonRealtime(true);
+            process(convolution, output, 97);
+
+            // A plain FIR on every sample would take minutes, every 101st is plenty
+            double peak = 0.0, peakError = 0.0;
+
+            for (int channel = 0; channel < numChannels; ++channel)
+            {
+                auto* h = impulseResponse.getReadPointer(channel);
+                auto* x = input.getReadPointer(channel);
+
+                for (int i = 0; i < output.getNumSamples(); i += 101)
+                {
+                    double sum = 0.0;
+
+                    for (int k = 0; k <= juce::jmin(i, impulseResponse.getNumSamples() - 1); ++k)
+                        sum += (double)h[k] * x[i - k];
+
+                    peak = juce::jmax(peak, std::abs(sum));
+                    peakError = juce::jmax(peakError, std::abs(sum - output.getSample(channel, i)));
+                }
+            }
+
+            auto errorDb = juce::Decibels::gainToDecibels(peakError / peak, -400.0);
+            expect(errorDb < -100.0, "Peak error " + juce::String(errorDb, 1) + " dB");
+            expectEquals(convolution.getNumDeadlineMisses(), 0);
+        }
+
+        beginTest("Audio thread cost per IR length");
+        {
+            logMessage("48 kHz stereo, 256 sample blocks. Mean and worst callback in us, the budget is "
+                       + juce::String(1.0e6 * blockSize / sampleRate, 0) + " us");
+
+            auto input = makeNoise((int)(seconds * sampleRate));
+
+            for (auto length : { 1.0, 2.0, 5.0, 10.0 })
+            {
+                auto impulseResponse = makeImpulseResponse(length);
+
+                auto buffer = input;
+                NonUniformConvolution convolution(impulseResponse, numChannels, blockSize);
+                auto nonUniform = process(convolution, buffer, blockSize, true);
+
+                buffer = input;
+                auto uniform = processUniform(impulseResponse, buffer);
+
+                logMessage(juce::String(length, 0).paddedLeft(' ', 2) + " s IR:  non-uniform " + nonUniform.toString()
+                           + ", " + juce::String(convolution.getNumDeadlineMisses()) + " missed"
+                           + "   uniform " + uniform.toString());
+            }
+        }
+    }
+
+private:
+    static constexpr double sampleRate = 48000.0;
+    static constexpr double seconds = 3.0;
+    static constexpr int numChannels = 2;
+    static constexpr int blockSize = 256;
+
+    struct Timing
+    {
+        double mean = 0.0, worst = 0.0;
+
+        juce::String toString() const
+        {
+            return juce::String(mean * 1.0e6, 1).paddedLeft(' ', 7) + " / " + juce::String(worst * 1.0e6, 1).paddedLeft(' ', 7);
+        }
+    };
+
+    juce::AudioBuffer<float> makeNoise(int length)
+    {
+        juce::AudioBuffer<float> noise(numChannels, length);
+
+        for (int channel = 0; channel < numChannels; ++channel)
+            for (int i = 0; i < length; ++i)
+                noise.setSample(channel, i, random.nextFloat() * 2.f - 1.f);
+
+        return noise;
+    }
+
+    // Stereo decaying noise, about what a real room IR looks like to the maths
+    juce::AudioBuffer<float> makeImpulseResponse(double length)
+    {
+        auto impulseResponse = makeNoise((int)(length * sampleRate));
+
+        for (int channel = 0; channel < numChannels; ++channel)
+            for (int i = 0; i < impulseResponse.getNumSamples(); ++i)
+                impulseResponse.setSample(channel, i, impulseResponse.getSample(channel, i) * std::exp(-6.9f * (float)i / (float)impulseResponse.getNumSamples()));
+
+        return impulseResponse;
+    }
+
+    template <typename Convolution>
+    static Timing run(Convolution& convolution, juce::AudioBuffer<float>& buffer, int hostBlockSize, bool pace)
+    {
+        Timing timing;
+        int numBlocks = 0;
+        auto start = juce::Time::getMillisecondCounterHiRes();
+
+        for (int position = 0; position < buffer.getNumSamples(); position += hostBlockSize)
+        {
+            auto num = juce::jmin(hostBlockSize, buffer.getNumSamples() - position);
+            float* channels[numChannels];
+
+            for (int channel = 0; channel < numChannels; ++channel)
+                channels[channel] = buffer.getWritePointer(channel, position);
+
+            auto ticks = juce::Time::getHighResolutionTicks();
+            convolution.process(channels, numChannels, num);
+            auto elapsed = juce::Time::highResolutionTicksToSeconds(juce::Time::getHighResolutionTicks() - ticks);
+
+            timing.mean += elapsed;
+            timing.worst = juce::jmax(timing.worst, elapsed);
+            ++numBlocks;
+
+            // Like a soundcard: the next callback comes when the next block is due, not straight away
+            if (pace)
+            {
+                auto due = start + 1000.0 * (position + num) / sampleRate;
+
+                while (juce::Time::getMillisecondCounterHiRes() < due)
+                    juce::Thread::sleep(1);
+            }
+        }
+
+        timing.mean /= juce::jmax(1, numBlocks);
+        return timing;
+    }
+
+    static Timing process(NonUniformConvolution& convolution, juce::AudioBuffer<float>& buffer, int hostBlockSize, bool pace = false)
+    {
+        return run(convolution, buffer, hostBlockSize, pace);
+    }
+
+    static Timing processUniform(const juce::AudioBuffer<float>& impulseResponse, juce::AudioBuffer<float>& buffer)
+    {
+        // The cabinet's partition size, all of the IR on the audio thread
+        constexpr int partitionSize = 64;
+        auto maxPartitions = (impulseResponse.getNumSamples() + partitionSize - 1) / partitionSize;
+
+        PartitionedConvolution::Filter filter(impulseResponse, partitionSize, maxPartitions);
+        PartitionedConvolution convolution;
+        convolution.prepare(numChannels, partitionSize, maxPartitions);
+        convolution.setFilter(&filter);
+
+        return run(convolution, buffer, blockSize, false);
+    }
+
+    juce::Random random;
+};
+
+static ReverbBenchmark reverbBenchmark;
@@ -0,0 +1,242 @@
+/*
+  ==============================================================================
+
+    SessionStateTest.cpp
+
+  ==============================================================================
+*/
+
+#include <JuceHeader.h>
+#include "../../../Source/PluginProcessor.h"
+#include "../../../Source/SessionState.h"
+#include "TestHelpers.h"
+
+/*
+* Sessions saved and restored through the binary format: every parameter
+* coming back, sessions from older builds, data that isn't a session, the
+* ValueTree sessions saved before the format existed, and embedded files.
+*/
+class SessionStateTest : public juce::UnitTest
+{
+public:
+    SessionStateTest() : juce::UnitTest("Session state", "PDLBOARD") {}
+
+    void runTest() override
+    {
+        juce::Random random(43);
+
+        beginTest("Every parameter is in the table");
+        {
+            PDLBOARDAudioProcessor processor;
+            auto& table = SessionState::getParameterTable();
+
+            for (auto* parameter : processor.getParameters())
+                if (auto* ranged = dynamic_cast<juce::RangedAudioParameter*>(parameter))
+                    expect(table.contains(ranged->paramID), ranged->paramID + " needs adding to the end of the table");
+        }
+
+        beginTest("Everything comes back");
+        {
+            PDLBOARDAudioProcessor processor;
+            randomise(processor, random);
+            expect(processor.getRouting().setRouting("[chorus | delay] > overdrive"));
+
+            juce::MemoryBlock session;
+            processor.getStateInformation(session);
+
+            // A float for each parameter and a few properties
+            expectLessThan((int)session.getSize(), 1024);
+
+            PDLBOARDAudioProcessor restored;
+            restored.setStateInformation(session.getData(), (int)session.getSize());
+            expectEquals(countDifferences(processor, restored), 0);
+
+            restored.setPlayConfigDetails(2, 2, 44100.0, 512);
+            restored.prepareToPlay(44100.0, 512);
+            expectEquals(restored.getRouting().getRouting(), juce::String("[chorus | delay] > overdrive"));
+        }
+
+        beginTest("Sessions from before a parameter existed give it its default");
+        {
+            PDLBOARDAudioProcessor processor;
+            randomise(processor, random);
+
+            juce::MemoryBlock session;
+            processor.getStateInformation(session);
+
+            // As if the last three parameters hadn't been added yet
+            auto numValues = SessionState::getParameterTable().size();
+            auto* bytes = static_cast<const char*>(session.getData());
+
+            juce::MemoryOutputStream older;
+            older.write(bytes, 8);
+            older.writeInt(numValues - 3);
+            older.write(bytes + 12, (size_t)(numValues - 3) * 4);
+            older.write(bytes + 12 + numValues * 4, session.getSize() - 12 - (size_t)numValues * 4);
+
+            PDLBOARDAudioProcessor restored;
+            randomise(restored, random);
+            restored.setStateInformation(older.getData(), (int)older.getDataSize());
+
+            auto& table = SessionState::getParameterTable();
+
+            for (int i = 0; i < numValues; ++i)
+            {
+                auto expected = i < numValues - 3 ? getNormalised(processor, table[i]) : getDefault(restored, table[i]);
+                expectWithinAbsoluteError(getNormalised(restored, table[i]), expected, 1.0e-6f, table[i]);
+            }
+        }
+
+        beginTest("Anything that isn't a whole session is left alone");
+        {
+            PDLBOARDAudioProcessor processor;
+            randomise(processor, random);
+
+            juce::MemoryBlock session;
+            processor.getStateInformation(session);
+
+            PDLBOARDAudioProcessor restored;
+            randomise(restored, random);
+            auto before = getValues(restored);
+
+            for (auto length : { 3, 12, 100, (int)session.getSize() - 1 })
+            {
+                expect(! SessionState::read(restored.getValueTreeState(), session.getData(), length));
+                expect(getValues(restored) == before, "Cut to " + juce::String(length));
+            }
+
+            const char junk[] = "<?xml version=\"1.0\"?><nothing/>";
+            expect(! SessionState::read(restored.getValueTreeState(), junk, (int)sizeof(junk)));
+            expect(getValues(restored) == before);
+        }
+
+        beginTest("Sessions saved as a ValueTree still load");
+        {
+            PDLBOARDAudioProcessor processor;
+            randomise(processor, random);
+
+            // How every session was saved before
+            juce::MemoryBlock session;
+            processor.foleys::MagicProcessor::getStateInformation(session);
+
+            PDLBOARDAudioProcessor restored;
+            restored.setStateInformation(session.getData(), (int)session.getSize());
+            expectEquals(countDifferences(processor, restored), 0);
+        }
+
+        beginTest("Embedded files come back where the originals have gone");
+        {
+            auto folder = juce::File::getSpecialLocation(juce::File::tempDirectory).getNonexistentChildFile("pdlboard_session", {});
+            folder.createDirectory();
+
+            auto original = folder.getChildFile("cab.wav");
+            writeImpulseResponse(original);
+
+            juce::MemoryBlock contents;
+            original.loadFileAsData(contents);
+
+            PDLBOARDAudioProcessor processor;
+            processor.setEmbedFilesInState(true);
+            processor.getCabinet().loadImpulseResponse(original);
+
+            juce::MemoryBlock session;
+            processor.getStateInformation(session);
+            expectGreaterThan((int)session.getSize(), 1024);
+
+            // Moved to another machine
+            original.deleteFile();
+
+            PDLBOARDAudioProcessor restored;
+            auto unpacked = folder.getChildFile("Embedded");
+            expect(SessionState::read(restored.getValueTreeState(), session.getData(), (int)session.getSize(), unpacked));
+
+            auto files = unpacked.findChildFiles(juce::File::findFiles, false, "cab-*.wav");
+            expectEquals(files.size(), 1);
+
+            juce::MemoryBlock unpackedContents;
+
+            if (files.size() == 1)
+                files.getReference(0).loadFileAsData(unpackedContents);
+
+            expect(unpackedContents == contents);
+
+            // Saved again, the session points at the unpacked one
+            juce::MemoryBlock resaved;
+            restored.getStateInformation(resaved);
+
+            if (files.size() == 1)
+                expect(contains(resaved, files.getReference(0).getFullPathName()));
+
+            folder.deleteRecursively();
+        }
+    }
+
+private:
+    static void randomise(PDLBOARDAudioProcessor& processor, juce::Random& random)
+    {
+        for (auto* parameter : processor.getParameters())
+            parameter->setValueNotifyingHost(random.nextFloat());
+    }
+
+    static float getNormalised(PDLBOARDAudioProcessor& processor, const juce::String& id)
+    {
+        for (auto* parameter : processor.getParameters())
+            if (auto* ranged = dynamic_cast<juce::RangedAudioParameter*>(parameter))
+                if (ranged->paramID == id)
+                    return ranged->getValue();
+
+        return -1.f;
+    }
+
+    static float getDefault(PDLBOARDAudioProcessor& processor, const juce::String& id)
+    {
+        for (auto* parameter : processor.getParameters())
+            if (auto* ranged = dynamic_cast<juce::RangedAudioParameter*>(parameter))
+                if (ranged->paramID == id)
+                    return ranged->getDefaultValue();
+
+        return -1.f;
+    }
+
+    static int countDifferences(PDLBOARDAudioProcessor& a, PDLBOARDAudioProcessor& b)
+    {
+        int numDifferent = 0;
+
+        for (auto& id : SessionState::getParameterTable())
+            if (std::abs(getNormalised(a, id) - getNormalised(b, id)) > 1.0e-6f)
+                ++numDifferent;
+
+        return numDifferent;
+    }
+
+    static std::vector<float> getValues(PDLBOARDAudioProcessor& processor)
+    {
+        std::vector<float> values;
+
+        for (auto* parameter : processor.getParameters())
+            values.push_back(parameter->getValue());
+
+        return values;
+    }
+
+    static bool contains(const juce::MemoryBlock& block, const juce::String& text)
+    {
+        auto* begin = static_cast<const char*>(block.getData());
+        auto* end = begin + block.getSize();
+
+        return std::search(begin, end, text.toRawUTF8(), text.toRawUTF8() + text.getNumBytesAsUTF8()) != end;
+    }
+
+    static void writeImpulseResponse(const juce::File& file)
+    {
+        auto impulseResponse = GuitarEffectAudioProcessor::Cabinet::createBuiltInImpulseResponse(2, 48000.0);
+
+        juce::WavAudioFormat format;
+        std::unique_ptr<juce::AudioFormatWriter> writer(format.createWriterFor(new juce::FileOutputStream(file), 48000.0, 1, 32, {}, 0));
+
+        if (writer != nullptr)
+            writer->writeFromAudioSampleBuffer(impulseResponse, 0, impulseResponse.getNumSamples());
+    }
+};
+
+static SessionStateTest sessionStateTest;
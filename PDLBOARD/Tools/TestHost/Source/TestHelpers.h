@@ -0,0 +1,147 @@
+/*
+  ==============================================================================
+
+    TestHelpers.h
+
+  ==============================================================================
+*/
+
+#pragma once
+
+#include <JuceHeader.h>
+
+namespace TestHelpers
+{
+    // Command line options that tests need, filled in by main().
+    struct Options
+    {
+        bool updateGolden = false;
+        juce::File goldenFolder;
+    };
+
+    inline Options& getOptions()
+    {
+        static Options options;
+        return options;
+    }
+
+    // Sets a parameter by its layout ID from a normalised value, like host automation would.
+    inline void setParameter(juce::AudioProcessor& processor, const juce::String& id, float normalisedValue)
+    {
+        for (auto* parameter : processor.getParameters())
+            if (auto* withID = dynamic_cast<juce::AudioProcessorParameterWithID*>(parameter))
+                if (withID->paramID == id)
+                    withID->setValueNotifyingHost(normalisedValue);
+    }
+
+    // Sets a parameter by its layout ID from a plain value, e.g. 0..300 for "range".
+    inline void setParameterPlain(juce::AudioProcessor& processor, const juce::String& id, float value)
+    {
+        for (auto* parameter : processor.getParameters())
+            if (auto* ranged = dynamic_cast<juce::RangedAudioParameter*>(parameter))
+                if (ranged->paramID == id)
+                    ranged->setValueNotifyingHost(ranged->convertTo0to1(value));
+    }
+
+    // A parameter's plain value by its layout ID, 0 for one that doesn't exist.
+    inline float getParameterPlain(juce::AudioProcessor& processor, const juce::String& id)
+    {
+        for (auto* parameter : processor.getParameters())
+            if (auto* ranged = dynamic_cast<juce::RangedAudioParameter*>(parameter))
+                if (ranged->paramID == id)
+                    return ranged->convertFrom0to1(ranged->getValue());
+
+        return 0.f;
+    }
+
+    inline void resetParametersToDefaults(juce::AudioProcessor& processor)
+    {
+        for (auto* parameter : processor.getParameters())
+            parameter->setValueNotifyingHost(parameter->getDefaultValue());
+    }
+
+    /*
+    * What a GuitarML style LSTM or GRU model file holds, with random weights at
+    * about the scale PyTorch initialises them to. Skip is on, like most captures.
+    */
+    inline juce::var createRecurrentModel(const juce::String& unitType, int hiddenSize, juce::Random& random)
+    {
+        auto numGates = unitType == "LSTM" ? 4 : 3;
+        auto scale = 1.f / std::sqrt((float)hiddenSize);
+
+        auto tensor = [&] (int rows, int columns)
+        {
+            juce::Array<juce::var> values;
+
+            for (int row = 0; row < rows; ++row)
+            {
+                if (columns == 0)
+                {
+                    values.add(scale * (random.nextFloat() * 2.f - 1.f));
+                    continue;
+                }
+
+                juce::Array<juce::var> rowValues;
+
+                for (int column = 0; column < columns; ++column)
+                    rowValues.add(scale * (random.nextFloat() * 2.f - 1.f));
+
+                values.add(rowValues);
+            }
+
+            return juce::var(values);
+        };
+
+        auto* modelData = new juce::DynamicObject();
+        modelData->setProperty("model", "SimpleRNN");
+        modelData->setProperty("input_size", 1);
+        modelData->setProperty("output_size", 1);
+        modelData->setProperty("num_layers", 1);
+        modelData->setProperty("unit_type", unitType);
+        modelData->setProperty("hidden_size", hiddenSize);
+        modelData->setProperty("skip", 1);
+
+        auto* stateDict = new juce::DynamicObject();
+        stateDict->setProperty("rec.weight_ih_l0", tensor(numGates * hiddenSize, 1));
+        stateDict->setProperty("rec.weight_hh_l0", tensor(numGates * hiddenSize, hiddenSize));
+        stateDict->setProperty("rec.bias_ih_l0", tensor(numGates * hiddenSize, 0));
+        stateDict->setProperty("rec.bias_hh_l0", tensor(numGates * hiddenSize, 0));
+        stateDict->setProperty("lin.weight", tensor(1, hiddenSize));
+        stateDict->setProperty("lin.bias", tensor(1, 0));
+
+        auto* model = new juce::DynamicObject();
+        model->setProperty("model_data", juce::var(modelData));
+        model->setProperty("state_dict", juce::var(stateDict));
+
+        return juce::var(model);
+    }
+
+    //==============================================================================
+    // Moves every parameter to random values as fast as a busy host would.
+    class AutomationThread : public juce::Thread
+    {
+    public:
+        AutomationThread(juce::AudioProcessor& p, juce::int64 seed)
+            : juce::Thread("Automation"), processor(p), random(seed) {}
+
+        ~AutomationThread() override
+        {
+            stopThread(1000);
+        }
+
+        void run() override
+        {
+            while (! threadShouldExit())
+            {
+                for (auto* parameter : processor.getParameters())
+                    parameter->setValueNotifyingHost(random.nextFloat());
+
+                wait(1);
+            }
+        }
+
+    private:
+        juce::AudioProcessor& processor;
+        juce::Random random;
+    };
+}
@@ -0,0 +1,155 @@
+/*
+  ==============================================================================
+
+    WaveDigitalFilterTest.cpp
+
+  ==============================================================================
+*/
+
+#include <JuceHeader.h>
+#include "../../../Source/ClippingCircuits.h"
+
+/*
+* The WDF parts against the circuit equations solved the long way: the linear
+* ones against their bilinear transfer functions, the diode clipper against a
+* trapezoidal-rule Newton solve of its ODE, which is what a WDF is equivalent
+* to when nothing is approximated.
+*/
+class WaveDigitalFilterTest : public juce::UnitTest
+{
+public:
+    WaveDigitalFilterTest() : juce::UnitTest("Wave digital filters", "PDLBOARD") {}
+
+    void runTest() override
+    {
+        beginTest("Wright omega");
+        {
+            double worstError = 0.0;
+
+            for (double x = -20.0; x < 200.0; x += 0.01)
+            {
+                // Newton to convergence from the asymptotes
+                auto w = x > 1.0 ? x - std::log(x) : std::exp(x);
+
+                for (int i = 0; i < 50; ++i)
+                    w -= (w + std::log(w) - x) / (1.0 + 1.0 / w);
+
+                worstError = juce::jmax(worstError, std::abs((double)WDF::wrightOmega((float)x) - w));
+            }
+
+            expect(worstError < 3.0e-3, "Worst error " + juce::String(worstError));
+        }
+
+        beginTest("RC low-pass matches its bilinear transfer function");
+        {
+            using Source = WDF::ResistiveVoltageSource<double>;
+            using Capacitor = WDF::Capacitor<double>;
+            using Tree = WDF::Parallel<Source, Capacitor>;
+
+            Source source(1000.0);
+            Capacitor capacitor(220.0e-9);
+            Tree tree(source, capacitor);
+            WDF::OpenCircuit<Tree> root(tree);
+            root.prepare(sampleRate);
+
+            // 1 / (1 + sRC) with s = 2 fs (1 - z^-1) / (1 + z^-1)
+            auto k = 2.0 * sampleRate * 1000.0 * 220.0e-9;
+            double x1 = 0.0, y1 = 0.0, worstError = 0.0;
+
+            for (int i = 0; i < 4800; ++i)
+            {
+                auto x = std::sin(0.05 * i) + 0.3 * std::sin(0.71 * i);
+                auto y = (x + x1 - (1.0 - k) * y1) / (1.0 + k);
+                x1 = x;
+                y1 = y;
+
+                source.setVoltage(x);
+                root.process();
+
+                worstError = juce::jmax(worstError, std::abs(root.voltage() - y));
+            }
+
+            expect(worstError < 1.0e-12, "Worst error " + juce::String(worstError));
+        }
+
+        beginTest("Diode clipper matches a trapezoidal solve");
+        {
+            DiodeClipper clipper;
+            clipper.prepare(sampleRate);
+
+            // C dv/dt = (input - v) / R - 2 Is sinh(v / nVt), the pair conducting both ways
+            const double R = 2200.0, C = 10.0e-9, Is = 2.52e-9, Vt = 1.752 * 25.85e-3;
+            auto f = [&] (double v, double input) { return (input - v) / (R * C) - 2.0 * Is * std::sinh(v / Vt) / C; };
+
+            double v = 0.0, previousInput = 0.0, worstError = 0.0;
+
+            for (int i = 0; i < 9600; ++i)
+            {
+                // Loud enough that the diodes conduct hard
+                auto input = 3.0 * std::sin(juce::MathConstants<double>::twoPi * 220.0 * i / sampleRate);
+                auto previousSlope = f(v, previousInput);
+                auto next = v;
+
+                for (int iteration = 0; iteration < 50; ++iteration)
+                {
+                    auto residual = next - v - 0.5 / sampleRate * (previousSlope + f(next, input));
+                    auto derivative = 1.0 + 0.5 / sampleRate * (1.0 / (R * C) + 2.0 * Is * std::cosh(next / Vt) / (Vt * C));
+                    next -= residual / derivative;
+                }
+
+                v = next;
+                previousInput = input;
+
+                worstError = juce::jmax(worstError, std::abs(clipper.processSample((float)input) - v));
+            }
+
+            // Mostly the omega approximation, the one diode that isn't conducting is the rest
+            expect(worstError < 1.0e-3, "Worst error " + juce::String(worstError) + " V");
+        }
+
+        beginTest("Tube Screamer's small signal gain");
+        {
+            for (auto drive : { 0.f, 0.5f, 1.f })
+            {
+                for (auto frequency : { 100.0, 720.0, 3000.0 })
+                {
+                    TubeScreamerClipper clipper;
+                    clipper.prepare(sampleRate);
+                    clipper.setDrive(drive);
+
+                    // Far too quiet to clip, so it's 1 + Zf / Zg at the warped frequency. The diodes
+                    // still leak a little, Is / nVt for the one the pair's solution counts.
+                    auto omega = 2.0 * sampleRate * std::tan(juce::MathConstants<double>::pi * frequency / sampleRate);
+                    std::complex<double> s(0.0, omega);
+                    auto diodeConductance = 2.52e-9 / (1.752 * 25.85e-3);
+                    auto feedback = 1.0 / (1.0 / (51.0e3 + 500.0e3 * drive * drive) + diodeConductance + s * 51.0e-12);
+                    auto ground = 4700.0 + 1.0 / (s * 47.0e-9);
+                    auto expected = std::abs(1.0 + feedback / ground);
+
+                    double inputPower = 0.0, outputPower = 0.0;
+
+                    for (int i = 0; i < (int)sampleRate; ++i)
+                    {
+                        auto input = 1.0e-4 * std::sin(juce::MathConstants<double>::twoPi * frequency * i / sampleRate);
+                        auto output = (double)clipper.processSample((float)input);
+
+                        // Past the RC's settling
+                        if (i >= (int)sampleRate / 2)
+                        {
+                            inputPower += input * input;
+                            outputPower += output * output;
+                        }
+                    }
+
+                    auto gain = std::sqrt(outputPower / inputPower);
+                    expectWithinAbsoluteError(gain / expected, 1.0, 0.01);
+                }
+            }
+        }
+    }
+
+private:
+    static constexpr double sampleRate = 48000.0;
+};
+
+static WaveDigitalFilterTest waveDigitalFilterTest;